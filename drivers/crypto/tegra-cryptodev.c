@@ -31,12 +31,21 @@
 #include <linux/scatterlist.h>
 #include <linux/uaccess.h>
 #include <linux/nospec.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/sched.h>
+#include <linux/capability.h>
+#include <linux/workqueue.h>
 #include <soc/tegra/chip-id.h>
 #include <crypto/rng.h>
 #include <crypto/hash.h>
 #include <linux/platform/tegra/common.h>
 #include <soc/tegra/fuse.h>
 #include <crypto/akcipher.h>
+#include <crypto/algapi.h>
 #include <crypto/internal/skcipher.h>
 
 #include "tegra-cryptodev.h"
@@ -52,6 +61,16 @@
 #define MAX_RSA_MSG_LEN 256
 #define MAX_RSA1_MSG_LEN 512
 
+/*
+ * Every keyed aes tfm holds an SE keyslot until it is freed, so only a
+ * few are kept per open file and those are released once idle.
+ */
+#define TEGRA_CRYPTO_AES_MAX_CACHED	2
+#define TEGRA_CRYPTO_AES_IDLE_MS	1000
+
+/* user pages pinned by vectored requests per open file */
+#define TEGRA_CRYPTO_VEC_MAX_PINNED	(SZ_16M >> PAGE_SHIFT)
+
 enum tegra_se_pka1_ecc_type {
 	ECC_POINT_MUL,
 	ECC_POINT_ADD,
@@ -61,9 +80,28 @@ enum tegra_se_pka1_ecc_type {
 	ECC_INVALID,
 };
 
+/* last key programmed into an aes tfm, to skip redundant setkey calls */
+struct tegra_crypto_key_cache {
+	u8 key[TEGRA_CRYPTO_MAX_KEY_SIZE];
+	unsigned int keylen;
+	int use_ssk;
+	bool valid;
+};
+
 struct tegra_crypto_ctx {
-	/*ecb, cbc, ofb, ctr */
+	/*
+	 * ecb, cbc, ofb, ctr, xts: cbc lives as long as the file, up to
+	 * TEGRA_CRYPTO_AES_MAX_CACHED of the others are kept while in use
+	 */
 	struct crypto_skcipher *aes_tfm[TEGRA_CRYPTO_MAX];
+	struct tegra_crypto_key_cache aes_key[TEGRA_CRYPTO_MAX];
+	unsigned long aes_last_used[TEGRA_CRYPTO_MAX];
+	unsigned int aes_nr_cached;
+	struct delayed_work aes_idle_work;
+	/* bounce pages of TEGRA_CRYPTO_IOCTL_PROCESS_REQ */
+	unsigned long *xbuf[NBUFS];
+	/* serializes aes requests, tfm and key setup */
+	struct mutex lock;
 	/* rsa512, rsa1024, rsa1536, rsa2048 */
 	struct crypto_akcipher *rsa_tfm[4];
 	/* rsa512, rsa768, rsa1024, rsa1536, rsa2048, rsa3072, rsa4096 */
@@ -76,6 +114,45 @@ struct tegra_crypto_ctx {
 	u8 seed[TEGRA_CRYPTO_RNG_SEED_SIZE];
 	int use_ssk;
 	bool skip_exit;
+
+	/* vectored requests */
+	atomic_t vec_inflight;
+	unsigned int vec_nr_batches;
+	/* pinned pages, also charged to locked_vm of the opener's mm */
+	atomic_long_t vec_pinned;
+	struct mm_struct *mm;
+	struct list_head vec_done;
+	spinlock_t vec_lock;
+	wait_queue_head_t vec_wq;
+};
+
+struct tegra_crypt_vec_batch;
+
+struct tegra_crypt_vec_entry {
+	struct skcipher_request *req;
+	struct sg_table src_sgt;
+	struct sg_table dst_sgt;
+	struct page **pages;
+	unsigned int nr_pages;
+	unsigned int nr_src_pages;
+	unsigned int nr_charged;
+	bool in_place;
+	u8 iv[TEGRA_CRYPTO_IV_SIZE];
+	int status;
+	struct tegra_crypt_vec_batch *batch;
+};
+
+struct tegra_crypt_vec_batch {
+	struct tegra_crypto_ctx *ctx;
+	struct list_head list;
+	struct tegra_crypt_vec_op __user *uops;
+	struct eventfd_ctx *eventfd;
+	struct completion done;
+	atomic_t pending;
+	bool async;
+	u64 cookie;
+	unsigned int nr_ops;
+	struct tegra_crypt_vec_entry entries[];
 };
 
 struct tegra_crypto_completion {
@@ -140,6 +217,46 @@ static void free_bufs(unsigned long *buf[NBUFS])
 		free_page((unsigned long)buf[i]);
 }
 
+/* called with ctx->lock held */
+static void tegra_crypto_put_aes_tfm(struct tegra_crypto_ctx *ctx,
+				     unsigned int op)
+{
+	/* vectored requests in flight may still use the tfm */
+	wait_event(ctx->vec_wq, !atomic_read(&ctx->vec_inflight));
+
+	crypto_free_skcipher(ctx->aes_tfm[op]);
+	ctx->aes_tfm[op] = NULL;
+	ctx->aes_key[op].valid = false;
+	ctx->aes_nr_cached--;
+}
+
+static void tegra_crypto_aes_idle_work(struct work_struct *work)
+{
+	struct tegra_crypto_ctx *ctx = container_of(to_delayed_work(work),
+					struct tegra_crypto_ctx, aes_idle_work);
+	unsigned long idle = msecs_to_jiffies(TEGRA_CRYPTO_AES_IDLE_MS);
+	bool rearm = false;
+	int i;
+
+	mutex_lock(&ctx->lock);
+
+	for (i = 0; i < TEGRA_CRYPTO_MAX; i++) {
+		if (i == TEGRA_CRYPTO_CBC || !ctx->aes_tfm[i])
+			continue;
+
+		if (atomic_read(&ctx->vec_inflight) ||
+		    time_before(jiffies, ctx->aes_last_used[i] + idle))
+			rearm = true;
+		else
+			tegra_crypto_put_aes_tfm(ctx, i);
+	}
+
+	mutex_unlock(&ctx->lock);
+
+	if (rearm)
+		schedule_delayed_work(&ctx->aes_idle_work, idle);
+}
+
 static int tegra_crypto_dev_open(struct inode *inode, struct file *filp)
 {
 	struct tegra_crypto_ctx *ctx;
@@ -164,10 +281,52 @@ static int tegra_crypto_dev_open(struct inode *inode, struct file *filp)
 		kfree(ctx);
 		return ret;
 	}
+
+	mutex_init(&ctx->lock);
+	INIT_DELAYED_WORK(&ctx->aes_idle_work, tegra_crypto_aes_idle_work);
+	atomic_set(&ctx->vec_inflight, 0);
+	atomic_long_set(&ctx->vec_pinned, 0);
+	ctx->mm = current->mm;
+	if (ctx->mm)
+		atomic_inc(&ctx->mm->mm_count);
+	INIT_LIST_HEAD(&ctx->vec_done);
+	spin_lock_init(&ctx->vec_lock);
+	init_waitqueue_head(&ctx->vec_wq);
+
 	filp->private_data = ctx;
 	return ret;
 }
 
+static void tegra_crypt_vec_free(struct tegra_crypt_vec_batch *batch);
+
+static void tegra_crypto_ctx_cleanup(struct tegra_crypto_ctx *ctx)
+{
+	struct tegra_crypt_vec_batch *batch, *next;
+	int i;
+
+	/* batch completion runs under vec_lock, taking it once after the
+	 * wait makes sure the last completion has left the ctx
+	 */
+	wait_event(ctx->vec_wq, !atomic_read(&ctx->vec_inflight));
+	spin_lock_irq(&ctx->vec_lock);
+	spin_unlock_irq(&ctx->vec_lock);
+
+	list_for_each_entry_safe(batch, next, &ctx->vec_done, list) {
+		list_del(&batch->list);
+		tegra_crypt_vec_free(batch);
+	}
+
+	cancel_delayed_work_sync(&ctx->aes_idle_work);
+
+	for (i = 0; i < TEGRA_CRYPTO_MAX; i++) {
+		if (i != TEGRA_CRYPTO_CBC && ctx->aes_tfm[i])
+			crypto_free_skcipher(ctx->aes_tfm[i]);
+	}
+
+	if (ctx->xbuf[0])
+		free_bufs(ctx->xbuf);
+}
+
 static int tegra_crypto_dev_release(struct inode *inode, struct file *filp)
 {
 	struct tegra_crypto_ctx *ctx = filp->private_data;
@@ -181,6 +340,8 @@ static int tegra_crypto_dev_release(struct inode *inode, struct file *filp)
 	static struct crypto_skcipher *store_tfm[
 					TEGRA_CRYPTO_AES_TEST_KEYSLOTS];
 
+	tegra_crypto_ctx_cleanup(ctx);
+
 	/* Only when skip_exit is false, the concerned tfm is freed,
 	 * else it is just saved in store_tfm that is freed later
 	 */
@@ -201,7 +362,9 @@ static int tegra_crypto_dev_release(struct inode *inode, struct file *filp)
 		tfm_index = 0;
 	}
 out:
-	kfree(ctx);
+	if (ctx->mm)
+		mmdrop(ctx->mm);
+	kzfree(ctx);
 	filp->private_data = NULL;
 
 	return ret;
@@ -217,6 +380,100 @@ static void tegra_crypt_complete(struct crypto_async_request *req, int err)
 	}
 }
 
+static const char * const aes_algo[TEGRA_CRYPTO_MAX] = {
+	"ecb(aes)", "cbc(aes)", "ofb(aes)", "ctr(aes)", "xts(aes)",
+};
+
+static bool tegra_crypto_aes_keylen_valid(unsigned int keylen)
+{
+	switch (keylen & CRYPTO_KEY_LEN_MASK) {
+	case TEGRA_CRYPTO_KEY_128_SIZE:
+	case TEGRA_CRYPTO_KEY_192_SIZE:
+	case TEGRA_CRYPTO_KEY_256_SIZE:
+	case TEGRA_CRYPTO_KEY_512_SIZE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * called with ctx->lock held; the tfm is cached until it has been idle for
+ * TEGRA_CRYPTO_AES_IDLE_MS or another mode needs its place
+ */
+static struct crypto_skcipher *
+tegra_crypto_get_aes_tfm(struct tegra_crypto_ctx *ctx, unsigned int op)
+{
+	struct crypto_skcipher *tfm = ctx->aes_tfm[op];
+	int i, lru = -1;
+
+	if (tfm)
+		goto out;
+
+	if (ctx->aes_nr_cached >= TEGRA_CRYPTO_AES_MAX_CACHED) {
+		for (i = 0; i < TEGRA_CRYPTO_MAX; i++) {
+			if (i == TEGRA_CRYPTO_CBC || !ctx->aes_tfm[i])
+				continue;
+			if (lru < 0 || time_before(ctx->aes_last_used[i],
+						   ctx->aes_last_used[lru]))
+				lru = i;
+		}
+		tegra_crypto_put_aes_tfm(ctx, lru);
+	}
+
+	tfm = crypto_alloc_skcipher(aes_algo[op],
+		CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("Failed to load transform for %s: %ld\n",
+			aes_algo[op], PTR_ERR(tfm));
+		return tfm;
+	}
+
+	ctx->aes_tfm[op] = tfm;
+	ctx->aes_nr_cached++;
+	schedule_delayed_work(&ctx->aes_idle_work,
+			      msecs_to_jiffies(TEGRA_CRYPTO_AES_IDLE_MS));
+out:
+	ctx->aes_last_used[op] = jiffies;
+	return tfm;
+}
+
+/* called with ctx->lock held */
+static int tegra_crypto_set_aes_key(struct tegra_crypto_ctx *ctx,
+				    unsigned int op,
+				    const char *key, unsigned int keylen)
+{
+	struct tegra_crypto_key_cache *kc = &ctx->aes_key[op];
+	struct crypto_skcipher *tfm = ctx->aes_tfm[op];
+	unsigned int len = keylen & CRYPTO_KEY_LEN_MASK;
+	int ret;
+
+	if (kc->valid && kc->keylen == keylen &&
+	    kc->use_ssk == ctx->use_ssk &&
+	    (ctx->use_ssk || !crypto_memneq(kc->key, key, len)))
+		return 0;
+
+	/* vectored requests in flight still use the current key */
+	wait_event(ctx->vec_wq, !atomic_read(&ctx->vec_inflight));
+
+	kc->valid = false;
+
+	ret = crypto_skcipher_setkey(tfm, ctx->use_ssk ? NULL : (const u8 *)key,
+				     keylen);
+	if (ret < 0) {
+		pr_err("setkey failed");
+		return ret;
+	}
+
+	if (!ctx->use_ssk)
+		memcpy(kc->key, key, len);
+	kc->keylen = keylen;
+	kc->use_ssk = ctx->use_ssk;
+	kc->valid = true;
+
+	return 0;
+}
+
 static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 				struct tegra_crypt_req *crypt_req)
 {
@@ -224,75 +481,56 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 	struct skcipher_request *req = NULL;
 	struct scatterlist in_sg;
 	struct scatterlist out_sg;
-	unsigned long *xbuf[NBUFS];
+	unsigned long **xbuf = ctx->xbuf;
 	int ret = 0, size = 0;
 	unsigned long total = 0;
-	const u8 *key = NULL;
 	struct tegra_crypto_completion tcrypt_complete;
-	char aes_algo[5][10] = {"ecb(aes)", "cbc(aes)", "ofb(aes)", "ctr(aes)",
-				"xts(aes)"};
 
-	if (crypt_req->op != TEGRA_CRYPTO_CBC) {
-		if (crypt_req->op >= TEGRA_CRYPTO_MAX)
-			return -EINVAL;
+	if (crypt_req->op >= TEGRA_CRYPTO_MAX)
+		return -EINVAL;
 
-		crypt_req->op = array_index_nospec(crypt_req->op,
-							TEGRA_CRYPTO_MAX);
+	crypt_req->op = array_index_nospec(crypt_req->op, TEGRA_CRYPTO_MAX);
 
-		tfm = crypto_alloc_skcipher(aes_algo[crypt_req->op],
-			CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC, 0);
-		if (IS_ERR(tfm)) {
-			pr_err("Failed to load transform for %s: %ld\n",
-				aes_algo[crypt_req->op], PTR_ERR(tfm));
-			ret = PTR_ERR(tfm);
-			goto out;
-		}
+	if (!tegra_crypto_aes_keylen_valid(crypt_req->keylen)) {
+		pr_err("crypt_req keylen invalid");
+		return -EINVAL;
+	}
 
-		ctx->aes_tfm[crypt_req->op] = tfm;
-		filp->private_data = ctx;
-	} else {
-		tfm = ctx->aes_tfm[TEGRA_CRYPTO_CBC];
-		ctx->skip_exit = crypt_req->skip_exit;
-		filp->private_data = ctx;
+	mutex_lock(&ctx->lock);
+
+	tfm = tegra_crypto_get_aes_tfm(ctx, crypt_req->op);
+	if (IS_ERR(tfm)) {
+		ret = PTR_ERR(tfm);
+		goto out;
 	}
 
+	if (crypt_req->op == TEGRA_CRYPTO_CBC)
+		ctx->skip_exit = crypt_req->skip_exit;
+
 	req = skcipher_request_alloc(tfm, GFP_KERNEL);
 	if (!req) {
 		pr_err("%s: Failed to allocate request\n", __func__);
 		ret = -ENOMEM;
-		goto free_tfm;
-	}
-
-	if (((crypt_req->keylen &
-		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_128_SIZE) &&
-		((crypt_req->keylen &
-		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_192_SIZE) &&
-		((crypt_req->keylen &
-		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_256_SIZE) &&
-		((crypt_req->keylen &
-		CRYPTO_KEY_LEN_MASK) != TEGRA_CRYPTO_KEY_512_SIZE)) {
-		ret = -EINVAL;
-		pr_err("crypt_req keylen invalid");
-		goto process_req_out;
+		goto out;
 	}
 
 	crypto_skcipher_clear_flags(tfm, ~0);
 
-	if (!ctx->use_ssk)
-		key = crypt_req->key;
-
 	if (!crypt_req->skip_key) {
-		ret = crypto_skcipher_setkey(tfm, key, crypt_req->keylen);
-		if (ret < 0) {
-			pr_err("setkey failed");
+		ret = tegra_crypto_set_aes_key(ctx, crypt_req->op,
+					       crypt_req->key,
+					       crypt_req->keylen);
+		if (ret < 0)
 			goto process_req_out;
-		}
 	}
 
-	ret = alloc_bufs(xbuf);
-	if (ret < 0) {
-		pr_err("alloc_bufs failed");
-		goto process_req_out;
+	if (!xbuf[0]) {
+		ret = alloc_bufs(xbuf);
+		if (ret < 0) {
+			pr_err("alloc_bufs failed");
+			xbuf[0] = NULL;
+			goto process_req_out;
+		}
 	}
 
 	init_completion(&tcrypt_complete.restart);
@@ -308,7 +546,7 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 		if (ret) {
 			ret = -EFAULT;
 			pr_debug("%s: copy_from_user failed (%d)\n", __func__, ret);
-			goto process_req_buf_out;
+			goto process_req_out;
 		}
 		sg_init_one(&in_sg, xbuf[0], size);
 		sg_init_one(&out_sg, xbuf[1], size);
@@ -331,17 +569,23 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 			/* crypto driver is asynchronous */
 			ret = wait_for_completion_timeout(&tcrypt_complete.restart,
 						msecs_to_jiffies(5000));
-			if (ret == 0)
-				goto process_req_buf_out;
+			if (ret == 0) {
+				/* the request may still complete into the
+				 * bounce pages, do not reuse them
+				 */
+				ret = -ETIMEDOUT;
+				xbuf[0] = NULL;
+				goto process_req_out;
+			}
 
 			if (tcrypt_complete.req_err < 0) {
 				ret = tcrypt_complete.req_err;
-				goto process_req_buf_out;
+				goto process_req_out;
 			}
 		} else if (ret < 0) {
 			pr_debug("%scrypt failed (%d)\n",
 				crypt_req->encrypt ? "en" : "de", ret);
-			goto process_req_buf_out;
+			goto process_req_out;
 		}
 
 		ret = copy_to_user((void __user *)crypt_req->result,
@@ -350,7 +594,7 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 			ret = -EFAULT;
 			pr_debug("%s: copy_to_user failed (%d)\n", __func__,
 					ret);
-			goto process_req_buf_out;
+			goto process_req_out;
 		}
 
 		total -= size;
@@ -358,17 +602,399 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 		crypt_req->plaintext += size;
 	}
 
-process_req_buf_out:
-	free_bufs(xbuf);
 process_req_out:
 	skcipher_request_free(req);
-free_tfm:
-	if (crypt_req->op != TEGRA_CRYPTO_CBC)
-		crypto_free_skcipher(tfm);
 out:
+	mutex_unlock(&ctx->lock);
+	return ret;
+}
+
+/* charges nr pinned pages to the file and to RLIMIT_MEMLOCK */
+static int tegra_crypt_vec_charge(struct tegra_crypto_ctx *ctx,
+				  unsigned long nr)
+{
+	unsigned long limit = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+	int ret = 0;
+
+	if (!ctx->mm)
+		return -EFAULT;
+
+	if (atomic_long_add_return(nr, &ctx->vec_pinned) >
+	    TEGRA_CRYPTO_VEC_MAX_PINNED) {
+		atomic_long_sub(nr, &ctx->vec_pinned);
+		return -ENOMEM;
+	}
+
+	down_write(&ctx->mm->mmap_sem);
+	if (ctx->mm->locked_vm + nr > limit && !capable(CAP_IPC_LOCK))
+		ret = -ENOMEM;
+	else
+		ctx->mm->locked_vm += nr;
+	up_write(&ctx->mm->mmap_sem);
+
+	if (ret)
+		atomic_long_sub(nr, &ctx->vec_pinned);
+
 	return ret;
 }
 
+/* may run on release, when ctx->mm is no longer current->mm */
+static void tegra_crypt_vec_uncharge(struct tegra_crypto_ctx *ctx,
+				     unsigned long nr)
+{
+	down_write(&ctx->mm->mmap_sem);
+	ctx->mm->locked_vm -= nr;
+	up_write(&ctx->mm->mmap_sem);
+
+	atomic_long_sub(nr, &ctx->vec_pinned);
+}
+
+static int tegra_crypt_vec_pin(struct tegra_crypt_vec_entry *e,
+			       const struct tegra_crypt_vec_op *uop)
+{
+	unsigned long src = uop->src, dst = uop->dst;
+	unsigned int nr_src, nr_dst = 0;
+	int ret;
+
+	e->in_place = src == dst;
+
+	nr_src = DIV_ROUND_UP(offset_in_page(src) + uop->len, PAGE_SIZE);
+	if (!e->in_place)
+		nr_dst = DIV_ROUND_UP(offset_in_page(dst) + uop->len,
+				      PAGE_SIZE);
+
+	ret = tegra_crypt_vec_charge(e->batch->ctx, nr_src + nr_dst);
+	if (ret)
+		return ret;
+	e->nr_charged = nr_src + nr_dst;
+
+	e->pages = kcalloc(nr_src + nr_dst, sizeof(*e->pages), GFP_KERNEL);
+	if (!e->pages)
+		return -ENOMEM;
+
+	e->nr_src_pages = nr_src;
+
+	ret = get_user_pages_fast(src & PAGE_MASK, nr_src, e->in_place,
+				  e->pages);
+	if (ret > 0)
+		e->nr_pages = ret;
+	if (ret != nr_src)
+		return ret < 0 ? ret : -EFAULT;
+
+	if (!e->in_place) {
+		ret = get_user_pages_fast(dst & PAGE_MASK, nr_dst, 1,
+					  e->pages + nr_src);
+		if (ret > 0)
+			e->nr_pages += ret;
+		if (ret != nr_dst)
+			return ret < 0 ? ret : -EFAULT;
+	}
+
+	ret = sg_alloc_table_from_pages(&e->src_sgt, e->pages, nr_src,
+					offset_in_page(src), uop->len,
+					GFP_KERNEL);
+	if (ret || e->in_place)
+		return ret;
+
+	return sg_alloc_table_from_pages(&e->dst_sgt, e->pages + nr_src,
+					 nr_dst, offset_in_page(dst),
+					 uop->len, GFP_KERNEL);
+}
+
+static void tegra_crypt_vec_unpin(struct tegra_crypt_vec_entry *e)
+{
+	unsigned int i, first_dst = e->in_place ? 0 : e->nr_src_pages;
+
+	sg_free_table(&e->src_sgt);
+	sg_free_table(&e->dst_sgt);
+
+	for (i = 0; i < e->nr_pages; i++) {
+		if (i >= first_dst)
+			set_page_dirty_lock(e->pages[i]);
+		put_page(e->pages[i]);
+	}
+
+	kfree(e->pages);
+
+	if (e->nr_charged)
+		tegra_crypt_vec_uncharge(e->batch->ctx, e->nr_charged);
+}
+
+static void tegra_crypt_vec_free(struct tegra_crypt_vec_batch *batch)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->nr_ops; i++) {
+		skcipher_request_free(batch->entries[i].req);
+		tegra_crypt_vec_unpin(&batch->entries[i]);
+	}
+
+	if (batch->eventfd)
+		eventfd_ctx_put(batch->eventfd);
+
+	kfree(batch);
+}
+
+/* writes the per-op status back to user space, returns the first error */
+static int tegra_crypt_vec_put_status(struct tegra_crypt_vec_batch *batch)
+{
+	unsigned int i;
+	int status, err = 0;
+
+	for (i = 0; i < batch->nr_ops; i++) {
+		status = batch->entries[i].status;
+
+		if (put_user(status, &batch->uops[i].status))
+			return -EFAULT;
+
+		if (!err && status)
+			err = status;
+	}
+
+	return err;
+}
+
+static void tegra_crypt_vec_batch_done(struct tegra_crypt_vec_batch *batch)
+{
+	struct tegra_crypto_ctx *ctx = batch->ctx;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctx->vec_lock, flags);
+
+	if (batch->async) {
+		if (batch->eventfd)
+			eventfd_signal(batch->eventfd, 1);
+		list_add_tail(&batch->list, &ctx->vec_done);
+	} else {
+		complete(&batch->done);
+	}
+
+	atomic_dec(&ctx->vec_inflight);
+	wake_up(&ctx->vec_wq);
+
+	spin_unlock_irqrestore(&ctx->vec_lock, flags);
+}
+
+static void tegra_crypt_vec_complete(struct crypto_async_request *req, int err)
+{
+	struct tegra_crypt_vec_entry *e = req->data;
+	struct tegra_crypt_vec_batch *batch = e->batch;
+
+	/* a backlogged request has been queued to the engine */
+	if (err == -EINPROGRESS)
+		return;
+
+	e->status = err;
+
+	if (atomic_dec_and_test(&batch->pending))
+		tegra_crypt_vec_batch_done(batch);
+}
+
+static int tegra_crypt_vec_prepare(struct tegra_crypt_vec_batch *batch,
+				   struct crypto_skcipher *tfm,
+				   struct tegra_crypt_vec_req *vreq)
+{
+	struct tegra_crypt_vec_entry *e;
+	struct tegra_crypt_vec_op uop;
+	struct scatterlist *dst;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < batch->nr_ops; i++) {
+		e = &batch->entries[i];
+		e->batch = batch;
+
+		if (copy_from_user(&uop, &batch->uops[i], sizeof(uop)))
+			return -EFAULT;
+
+		if (!uop.len || uop.len > TEGRA_CRYPTO_VEC_MAX_OP_SIZE)
+			return -EINVAL;
+
+		ret = tegra_crypt_vec_pin(e, &uop);
+		if (ret)
+			return ret;
+
+		e->req = skcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!e->req)
+			return -ENOMEM;
+
+		memcpy(e->iv, uop.iv, sizeof(e->iv));
+		dst = e->in_place ? e->src_sgt.sgl : e->dst_sgt.sgl;
+
+		skcipher_request_set_callback(e->req,
+			CRYPTO_TFM_REQ_MAY_BACKLOG,
+			tegra_crypt_vec_complete, e);
+		skcipher_request_set_crypt(e->req, e->src_sgt.sgl, dst,
+			uop.len, vreq->skip_iv ? NULL : e->iv);
+	}
+
+	return 0;
+}
+
+/*
+ * All operations of a batch are queued to the engine back to back and
+ * complete asynchronously, the user pages are mapped for the duration of
+ * the batch instead of being bounced through kernel pages.
+ */
+static int tegra_crypt_vec_submit(struct tegra_crypto_ctx *ctx,
+				  struct tegra_crypt_vec_req *vreq)
+{
+	struct tegra_crypt_vec_batch *batch;
+	struct tegra_crypt_vec_entry *e;
+	struct crypto_skcipher *tfm;
+	bool async = vreq->flags & TEGRA_CRYPTO_VEC_ASYNC;
+	unsigned int i;
+	int ret;
+
+	if (vreq->op >= TEGRA_CRYPTO_MAX)
+		return -EINVAL;
+
+	vreq->op = array_index_nospec(vreq->op, TEGRA_CRYPTO_MAX);
+
+	if (!vreq->nr_ops || vreq->nr_ops > TEGRA_CRYPTO_VEC_MAX_OPS)
+		return -EINVAL;
+
+	if (vreq->flags & ~(TEGRA_CRYPTO_VEC_ASYNC | TEGRA_CRYPTO_VEC_EVENTFD))
+		return -EINVAL;
+
+	if ((vreq->flags & TEGRA_CRYPTO_VEC_EVENTFD) && !async)
+		return -EINVAL;
+
+	if (!vreq->skip_key && !tegra_crypto_aes_keylen_valid(vreq->keylen)) {
+		pr_err("crypt_req keylen invalid");
+		return -EINVAL;
+	}
+
+	batch = kzalloc(sizeof(*batch) +
+			vreq->nr_ops * sizeof(batch->entries[0]), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+
+	batch->ctx = ctx;
+	batch->uops = u64_to_user_ptr(vreq->ops);
+	batch->nr_ops = vreq->nr_ops;
+	batch->cookie = vreq->cookie;
+	batch->async = async;
+	init_completion(&batch->done);
+	INIT_LIST_HEAD(&batch->list);
+
+	if (vreq->flags & TEGRA_CRYPTO_VEC_EVENTFD) {
+		batch->eventfd = eventfd_ctx_fdget(vreq->eventfd);
+		if (IS_ERR(batch->eventfd)) {
+			ret = PTR_ERR(batch->eventfd);
+			batch->eventfd = NULL;
+			goto out_free;
+		}
+	}
+
+	mutex_lock(&ctx->lock);
+
+	if (async && ctx->vec_nr_batches >= TEGRA_CRYPTO_VEC_MAX_BATCHES) {
+		ret = -EBUSY;
+		goto out_unlock;
+	}
+
+	tfm = tegra_crypto_get_aes_tfm(ctx, vreq->op);
+	if (IS_ERR(tfm)) {
+		ret = PTR_ERR(tfm);
+		goto out_unlock;
+	}
+
+	if (!vreq->skip_key) {
+		ret = tegra_crypto_set_aes_key(ctx, vreq->op, vreq->key,
+					       vreq->keylen);
+		if (ret < 0)
+			goto out_unlock;
+	}
+
+	ret = tegra_crypt_vec_prepare(batch, tfm, vreq);
+	if (ret)
+		goto out_unlock;
+
+	/* the extra count keeps the batch alive until all ops are queued */
+	atomic_set(&batch->pending, batch->nr_ops + 1);
+	atomic_inc(&ctx->vec_inflight);
+
+	for (i = 0; i < batch->nr_ops; i++) {
+		e = &batch->entries[i];
+
+		ret = vreq->encrypt ? crypto_skcipher_encrypt(e->req) :
+				      crypto_skcipher_decrypt(e->req);
+		if (ret != -EINPROGRESS && ret != -EBUSY) {
+			e->status = ret;
+			atomic_dec(&batch->pending);
+		}
+	}
+
+	if (atomic_dec_and_test(&batch->pending))
+		tegra_crypt_vec_batch_done(batch);
+
+	if (async) {
+		ctx->vec_nr_batches++;
+		mutex_unlock(&ctx->lock);
+		return 0;
+	}
+
+	wait_for_completion(&batch->done);
+	mutex_unlock(&ctx->lock);
+
+	ret = tegra_crypt_vec_put_status(batch);
+	tegra_crypt_vec_free(batch);
+	return ret;
+
+out_unlock:
+	mutex_unlock(&ctx->lock);
+out_free:
+	tegra_crypt_vec_free(batch);
+	return ret;
+}
+
+static int tegra_crypt_vec_reap(struct tegra_crypto_ctx *ctx,
+				struct tegra_crypt_vec_result *res)
+{
+	struct tegra_crypt_vec_batch *batch;
+
+	mutex_lock(&ctx->lock);
+
+	spin_lock_irq(&ctx->vec_lock);
+	batch = list_first_entry_or_null(&ctx->vec_done,
+					 struct tegra_crypt_vec_batch, list);
+	if (batch)
+		list_del(&batch->list);
+	spin_unlock_irq(&ctx->vec_lock);
+
+	if (batch)
+		ctx->vec_nr_batches--;
+
+	mutex_unlock(&ctx->lock);
+
+	if (!batch)
+		return -EAGAIN;
+
+	res->cookie = batch->cookie;
+	res->nr_ops = batch->nr_ops;
+	res->status = tegra_crypt_vec_put_status(batch);
+
+	tegra_crypt_vec_free(batch);
+	return 0;
+}
+
+static unsigned int tegra_crypto_dev_poll(struct file *filp,
+					  poll_table *wait)
+{
+	struct tegra_crypto_ctx *ctx = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &ctx->vec_wq, wait);
+
+	spin_lock_irq(&ctx->vec_lock);
+	if (!list_empty(&ctx->vec_done))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock_irq(&ctx->vec_lock);
+
+	return mask;
+}
+
 static int wait_async_op(struct tegra_crypto_completion *tr, int ret)
 {
 	if (ret == -EINPROGRESS || ret == -EBUSY) {
@@ -1434,6 +2060,8 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 	struct tegra_sha_req_shash sha_req_shash;
 	struct tegra_rsa_req rsa_req;
 	struct tegra_rsa_req_ahash rsa_req_ah;
+	struct tegra_crypt_vec_req vec_req;
+	struct tegra_crypt_vec_result vec_res;
 #ifdef CONFIG_COMPAT
 	struct tegra_crypt_req_32 crypt_req_32;
 	struct tegra_rng_req_32 rng_req_32;
@@ -1490,6 +2118,28 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 		ret = process_crypt_req(filp, ctx, &crypt_req);
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC:
+		if (copy_from_user(&vec_req, (void __user *)arg,
+				   sizeof(vec_req))) {
+			pr_err("%s: copy_from_user fail\n", __func__);
+			return -EFAULT;
+		}
+		ret = tegra_crypt_vec_submit(ctx, &vec_req);
+		memzero_explicit(vec_req.key, sizeof(vec_req.key));
+		break;
+
+	case TEGRA_CRYPTO_IOCTL_VEC_RESULT:
+		ret = tegra_crypt_vec_reap(ctx, &vec_res);
+		if (ret)
+			break;
+
+		if (copy_to_user((void __user *)arg, &vec_res,
+				 sizeof(vec_res))) {
+			pr_err("%s: copy_to_user fail\n", __func__);
+			return -EFAULT;
+		}
+		break;
+
 #ifdef CONFIG_COMPAT
 	case TEGRA_CRYPTO_IOCTL_SET_SEED_32:
 		if (copy_from_user(&rng_req_32, (void __user *)arg,
@@ -1835,6 +2485,7 @@ static const struct file_operations tegra_crypto_fops = {
 	.open = tegra_crypto_dev_open,
 	.release = tegra_crypto_dev_release,
 	.unlocked_ioctl = tegra_crypto_dev_ioctl,
+	.poll = tegra_crypto_dev_poll,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl =  tegra_crypto_dev_ioctl,
 #endif
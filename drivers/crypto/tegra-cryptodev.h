@@ -177,6 +177,58 @@ struct tegra_crypt_req_32 {
 		_IOWR(0x98, 121, struct tegra_crypt_req_32)
 #endif
 
+/* one operation of a TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC batch, the src and
+ * dst user pages are mapped directly (no bounce copies), src may equal dst
+ */
+struct tegra_crypt_vec_op {
+	__u64 src;
+	__u64 dst;
+	__u32 len;
+	__s32 status; /* written back on completion */
+	__u8 iv[TEGRA_CRYPTO_IV_SIZE];
+};
+
+#define TEGRA_CRYPTO_VEC_MAX_OPS	64
+#define TEGRA_CRYPTO_VEC_MAX_OP_SIZE	SZ_1M
+/* async batches submitted and not yet reaped per open file */
+#define TEGRA_CRYPTO_VEC_MAX_BATCHES	32
+
+/* return once the batch is submitted, reap it with VEC_RESULT */
+#define TEGRA_CRYPTO_VEC_ASYNC		(1 << 0)
+/* signal the eventfd when an async batch completes */
+#define TEGRA_CRYPTO_VEC_EVENTFD	(1 << 1)
+
+/* a pointer to this struct needs to be passed to:
+ * TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC
+ * The layout is the same for 32-bit and 64-bit callers.
+ */
+struct tegra_crypt_vec_req {
+	__u32 op; /* e.g. TEGRA_CRYPTO_ECB */
+	__u32 encrypt;
+	char key[TEGRA_CRYPTO_MAX_KEY_SIZE];
+	__u32 keylen;
+	__u32 skip_key;
+	__u32 skip_iv;
+	__u32 flags;
+	__s32 eventfd;
+	__u32 nr_ops;
+	__u64 ops; /* struct tegra_crypt_vec_op array */
+	__u64 cookie; /* returned by TEGRA_CRYPTO_IOCTL_VEC_RESULT */
+};
+#define TEGRA_CRYPTO_IOCTL_PROCESS_REQ_VEC	\
+		_IOWR(0x98, 111, struct tegra_crypt_vec_req)
+
+/* reaps one completed async batch, -EAGAIN if there is none; the per-op
+ * status is written back to the ops array of the batch
+ */
+struct tegra_crypt_vec_result {
+	__u64 cookie;
+	__u32 nr_ops;
+	__s32 status; /* first error of the batch */
+};
+#define TEGRA_CRYPTO_IOCTL_VEC_RESULT	\
+		_IOR(0x98, 112, struct tegra_crypt_vec_result)
+
 /* pointer to this struct should be passed to:
  * TEGRA_CRYPTO_IOCTL_SET_SEED
  * TEGRA_CRYPTO_IOCTL_GET_RANDOM
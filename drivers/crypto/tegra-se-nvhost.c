@@ -49,6 +49,13 @@
 #include <linux/version.h>
 #include <linux/pm_qos.h>
 #include <linux/jiffies.h>
+#include <linux/wait.h>
+#include <linux/bitmap.h>
+#include <linux/ktime.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
 #include <linux/platform/tegra/emc_bwmgr.h>
 
 #include "tegra-se-nvhost.h"
@@ -84,6 +91,8 @@ enum tegra_se_aes_op_mode {
 	SE_AES_OP_MODE_XTS	/* XTS mode */
 };
 
+#define SE_NUM_OP_MODES		(SE_AES_OP_MODE_XTS + 1)
+
 /* Security Engine key table type */
 enum tegra_se_key_table_type {
 	SE_KEY_TABLE_TYPE_KEY,	/* Key */
@@ -118,6 +127,24 @@ enum tegra_se_callback {
 	SHA_CB,
 };
 
+/* Per operation mode request statistics */
+struct tegra_se_op_stats {
+	u64 reqs;
+	u64 bytes;
+	u64 errors;
+	u64 lat_ns;	/* Sum of queue-to-completion latencies */
+	u64 lat_max_ns;
+};
+
+/* Result of one benchmark run for a given algorithm and size */
+struct tegra_se_bench_result {
+	const char *alg;
+	unsigned int size;
+	unsigned int ops;
+	u64 ns;
+	int err;
+};
+
 struct tegra_se_dev {
 	struct platform_device *pdev;
 	struct device *dev;
@@ -165,7 +192,11 @@ struct tegra_se_dev {
 	dma_addr_t aes_buf_addr;
 	void *aes_bufs[SE_MAX_AESBUF_ALLOC];
 	dma_addr_t aes_buf_addrs[SE_MAX_AESBUF_ALLOC];
-	atomic_t aes_buf_stat[SE_MAX_AESBUF_ALLOC];
+	/* Busy staging slots; a gather owns a contiguous run of slots */
+	DECLARE_BITMAP(aes_buf_map, SE_MAX_AESBUF_ALLOC);
+	spinlock_t aes_buf_lock;
+	wait_queue_head_t aes_buf_wq;
+	unsigned int aesbuf_nr;
 	dma_addr_t aes_addr;
 	dma_addr_t aes_cur_addr;
 	unsigned int cmdbuf_cnt;
@@ -174,6 +205,23 @@ struct tegra_se_dev {
 	unsigned int aesbuf_entry;
 	u32 *aes_cmdbuf_cpuvaddr;
 	dma_addr_t aes_cmdbuf_iova;
+	wait_queue_head_t cmdbuf_wq;	/* Woken when a cmdbuf is freed */
+	atomic_t cmdbuf_busy;	/* Number of cmdbufs owned by jobs */
+	unsigned int coalesce_tasks;	/* Current coalescing limit */
+	/* Lock to protect statistics, taken from completion callbacks */
+	spinlock_t stats_lock;
+	struct tegra_se_op_stats stats[SE_NUM_OP_MODES];
+	u64 nr_submits;
+	u64 nr_batched;
+	u64 nr_cmdbuf_waits;
+	u64 nr_aesbuf_waits;
+	u64 nr_dynmem;
+	ktime_t stats_start;
+	/* Lock to serialize benchmark runs */
+	struct mutex bench_lock;
+	struct tegra_se_bench_result *bench;
+	unsigned int bench_cnt;
+	unsigned int bench_depth;
 	struct pm_qos_request boost_cpufreq_req;
 	/* Lock to protect cpufreq boost status */
 	struct mutex boost_cpufreq_lock;
@@ -195,6 +243,7 @@ struct tegra_se_req_context {
 	u32 config;
 	u32 crypto_config;
 	struct tegra_se_dev *se_dev;
+	ktime_t start;	/* Time the request was queued */
 };
 
 struct tegra_se_priv_data {
@@ -214,6 +263,7 @@ struct tegra_se_priv_data {
 	dma_addr_t iova;
 	unsigned int cmdbuf_node;
 	unsigned int aesbuf_entry;
+	unsigned int aesbuf_nr;
 };
 
 /* Security Engine AES context */
@@ -429,6 +479,42 @@ static int tegra_se_init_cmdbuf_addr(struct tegra_se_dev *se_dev)
 	return 0;
 }
 
+static void tegra_se_stats_add(struct tegra_se_dev *se_dev, u64 *counter,
+			       u64 val)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&se_dev->stats_lock, flags);
+	*counter += val;
+	spin_unlock_irqrestore(&se_dev->stats_lock, flags);
+}
+
+static void tegra_se_account_req(struct tegra_se_dev *se_dev, u32 op_mode,
+				 unsigned int nbytes, ktime_t start, int err)
+{
+	struct tegra_se_op_stats *st;
+	unsigned long flags;
+	u64 lat;
+
+	if (op_mode >= SE_NUM_OP_MODES)
+		return;
+
+	lat = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock_irqsave(&se_dev->stats_lock, flags);
+	st = &se_dev->stats[op_mode];
+	if (err) {
+		st->errors++;
+	} else {
+		st->reqs++;
+		st->bytes += nbytes;
+		st->lat_ns += lat;
+		if (lat > st->lat_max_ns)
+			st->lat_max_ns = lat;
+	}
+	spin_unlock_irqrestore(&se_dev->stats_lock, flags);
+}
+
 static void tegra_se_free_key_slot(struct tegra_se_slot *slot)
 {
 	if (slot) {
@@ -717,14 +803,91 @@ static unsigned int tegra_se_count_sgs(struct scatterlist *sl, u32 nbytes)
 	return sg_nents;
 }
 
+/*
+ * Slot 0 of cmdbuf_addr_list overlaps aes_cmdbuf_cpuvaddr, which the
+ * synchronous (NONE callback) paths write directly under se_dev->mtx,
+ * so only slots 1 .. SE_MAX_SUBMIT_CHAIN_SZ - 1 are handed out to jobs.
+ */
+static int tegra_se_try_get_cmdbuf(struct tegra_se_dev *se_dev)
+{
+	unsigned int index = se_dev->cmdbuf_list_entry;
+	int i;
+
+	for (i = 1; i < SE_MAX_SUBMIT_CHAIN_SZ; i++) {
+		index = (index % (SE_MAX_SUBMIT_CHAIN_SZ - 1)) + 1;
+		if (atomic_cmpxchg(&se_dev->cmdbuf_addr_list[index].free,
+				   1, 0) == 1) {
+			atomic_inc(&se_dev->cmdbuf_busy);
+			return index;
+		}
+	}
+
+	return -EBUSY;
+}
+
+static void tegra_se_put_cmdbuf(struct tegra_se_dev *se_dev,
+				unsigned int index)
+{
+	atomic_set(&se_dev->cmdbuf_addr_list[index].free, 1);
+	atomic_dec(&se_dev->cmdbuf_busy);
+	wake_up(&se_dev->cmdbuf_wq);
+}
+
+/* Sleep until a job completion returns a cmdbuf to the list */
+static int tegra_se_get_free_cmdbuf(struct tegra_se_dev *se_dev)
+{
+	int index;
+
+	index = tegra_se_try_get_cmdbuf(se_dev);
+	if (index >= 0)
+		return index;
+
+	tegra_se_stats_add(se_dev, &se_dev->nr_cmdbuf_waits, 1);
+	if (!wait_event_timeout(se_dev->cmdbuf_wq,
+				(index = tegra_se_try_get_cmdbuf(se_dev)) >= 0,
+				msecs_to_jiffies(SE_CMDBUF_WAIT_TIMEOUT_MS)))
+		return -ETIMEDOUT;
+
+	return index;
+}
+
+static int tegra_se_try_get_aesbuf(struct tegra_se_dev *se_dev,
+				   unsigned int nr)
+{
+	unsigned long flags, start;
+
+	spin_lock_irqsave(&se_dev->aes_buf_lock, flags);
+	start = bitmap_find_next_zero_area(se_dev->aes_buf_map,
+					   SE_MAX_AESBUF_ALLOC, 0, nr, 0);
+	if (start < SE_MAX_AESBUF_ALLOC)
+		bitmap_set(se_dev->aes_buf_map, start, nr);
+	spin_unlock_irqrestore(&se_dev->aes_buf_lock, flags);
+
+	return (start < SE_MAX_AESBUF_ALLOC) ? (int)start : -ENOMEM;
+}
+
+static void tegra_se_put_aesbuf(struct tegra_se_dev *se_dev,
+				unsigned int start, unsigned int nr)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&se_dev->aes_buf_lock, flags);
+	bitmap_clear(se_dev->aes_buf_map, start, nr);
+	spin_unlock_irqrestore(&se_dev->aes_buf_lock, flags);
+
+	wake_up(&se_dev->aes_buf_wq);
+}
 
 static void tegra_se_sha_complete_callback(void *priv, int nr_completed)
 {
 	struct tegra_se_priv_data *priv_data = priv;
 	struct ahash_request *req;
 	struct tegra_se_dev *se_dev;
+	struct tegra_se_sha_context *sha_ctx;
+	struct tegra_se_req_context *req_ctx;
 
 	se_dev = priv_data->se_dev;
+	tegra_se_put_cmdbuf(se_dev, priv_data->cmdbuf_node);
 
 	req = priv_data->sha_req;
 	if (!req) {
@@ -741,6 +904,11 @@ static void tegra_se_sha_complete_callback(void *priv, int nr_completed)
 		tegra_unmap_sg(se_dev->dev, &priv_data->sg, DMA_FROM_DEVICE,
 			       priv_data->bytes_mapped);
 
+	sha_ctx = crypto_ahash_ctx(crypto_ahash_reqtfm(req));
+	req_ctx = ahash_request_ctx(req);
+	tegra_se_account_req(se_dev, sha_ctx->op_mode, req->nbytes,
+			     req_ctx->start, 0);
+
 	req->base.complete(&req->base, 0);
 
 	devm_kfree(se_dev->dev, priv_data);
@@ -751,12 +919,13 @@ static void tegra_se_aes_complete_callback(void *priv, int nr_completed)
 	int i = 0;
 	struct tegra_se_priv_data *priv_data = priv;
 	struct ablkcipher_request *req;
+	struct tegra_se_req_context *req_ctx;
 	struct tegra_se_dev *se_dev;
 	void *buf;
 	u32 num_sgs;
 
 	se_dev = priv_data->se_dev;
-	atomic_set(&se_dev->cmdbuf_addr_list[priv_data->cmdbuf_node].free, 1);
+	tegra_se_put_cmdbuf(se_dev, priv_data->cmdbuf_node);
 
 	if (!priv_data->req_cnt) {
 		devm_kfree(se_dev->dev, priv_data);
@@ -786,6 +955,9 @@ static void tegra_se_aes_complete_callback(void *priv, int nr_completed)
 					    req->nbytes);
 
 		buf += req->nbytes;
+		req_ctx = ablkcipher_request_ctx(req);
+		tegra_se_account_req(se_dev, req_ctx->op_mode, req->nbytes,
+				     req_ctx->start, 0);
 		req->base.complete(&req->base, 0);
 	}
 
@@ -799,7 +971,8 @@ static void tegra_se_aes_complete_callback(void *priv, int nr_completed)
 		else
 			kfree(priv_data->buf);
 	} else {
-		atomic_set(&se_dev->aes_buf_stat[priv_data->aesbuf_entry], 1);
+		tegra_se_put_aesbuf(se_dev, priv_data->aesbuf_entry,
+				    priv_data->aesbuf_nr);
 	}
 
 	devm_kfree(se_dev->dev, priv_data);
@@ -909,6 +1082,7 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 		} else {
 			priv->buf = se_dev->aes_bufs[se_dev->aesbuf_entry];
 			priv->aesbuf_entry = se_dev->aesbuf_entry;
+			priv->aesbuf_nr = se_dev->aesbuf_nr;
 		}
 
 		priv->buf_addr = se_dev->aes_addr;
@@ -936,6 +1110,7 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 		priv->sha_dst_mapped = se_dev->sha_dst_mapped;
 		priv->sha_last = se_dev->sha_last;
 		priv->buf_addr = se_dev->dst_ll->addr;
+		priv->cmdbuf_node = se_dev->cmdbuf_list_entry;
 
 		err = nvhost_intr_register_fast_notifier(
 			se_dev->pdev, job->sp->id, job->sp->fence,
@@ -950,10 +1125,6 @@ static int tegra_se_channel_submit_gather(struct tegra_se_dev *se_dev,
 		nvhost_syncpt_wait_timeout_ext(
 			se_dev->pdev, job->sp->id, job->sp->fence,
 			(u32)MAX_SCHEDULE_TIMEOUT, NULL, NULL);
-
-		if (se_dev->cmdbuf_addr_list)
-			atomic_set(&se_dev->cmdbuf_addr_list[
-				   se_dev->cmdbuf_list_entry].free, 1);
 	}
 
 	se_dev->req_cnt = 0;
@@ -1216,21 +1387,25 @@ static int tegra_se_send_sha_data(struct tegra_se_dev *se_dev,
 	struct tegra_se_ll *src_ll = se_dev->src_ll;
 	struct tegra_se_ll *dst_ll = se_dev->dst_ll;
 	unsigned int total = count, val;
+	unsigned int index;
 	u64 msg_len;
 
-	cmdbuf_cpuvaddr = dma_alloc_attrs(se_dev->dev->parent, SZ_4K,
-					  &cmdbuf_iova, GFP_KERNEL,
-					  __DMA_ATTR(attrs));
-	if (!cmdbuf_cpuvaddr) {
-		dev_err(se_dev->dev, "Failed to allocate cmdbuf\n");
-		return -ENOMEM;
+	err = tegra_se_get_free_cmdbuf(se_dev);
+	if (err < 0) {
+		dev_err(se_dev->dev, "Couldn't get free cmdbuf\n");
+		return err;
 	}
 
+	index = err;
+	err = 0;
+
+	cmdbuf_cpuvaddr = se_dev->cmdbuf_addr_list[index].cmdbuf_addr;
+	cmdbuf_iova = se_dev->cmdbuf_addr_list[index].iova;
+	se_dev->cmdbuf_list_entry = index;
+
 	while (total) {
 		if (src_ll->data_len & SE_BUFF_SIZE_MASK) {
-			dma_free_attrs(se_dev->dev->parent, SZ_4K,
-				       cmdbuf_cpuvaddr, cmdbuf_iova,
-				       __DMA_ATTR(attrs));
+			tegra_se_put_cmdbuf(se_dev, index);
 			return -EINVAL;
 		}
 
@@ -1308,11 +1483,12 @@ static int tegra_se_send_sha_data(struct tegra_se_dev *se_dev,
 
 	cmdbuf_num_words = i;
 
+	/* The cmdbuf is returned by the SHA completion callback */
 	err = tegra_se_channel_submit_gather(se_dev, cmdbuf_cpuvaddr,
 					     cmdbuf_iova, 0, cmdbuf_num_words,
 					     SHA_CB);
-	dma_free_attrs(se_dev->dev->parent, SZ_4K, cmdbuf_cpuvaddr,
-		       cmdbuf_iova, __DMA_ATTR(attrs));
+	if (err)
+		tegra_se_put_cmdbuf(se_dev, index);
 
 	return err;
 }
@@ -1454,7 +1630,8 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev)
 	void *buf;
 	int i, ret = 0;
 	u32 num_sgs;
-	unsigned int index = 0;
+	unsigned int nr = 0;
+	int index = 0;
 
 	if (unlikely(se_dev->dynamic_mem)) {
 		if (se_dev->ioc)
@@ -1468,22 +1645,20 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev)
 			return -ENOMEM;
 		buf = se_dev->aes_buf;
 	} else {
-		index = se_dev->aesbuf_entry + 1;
-		for (i = 0; i < SE_MAX_AESBUF_TIMEOUT; i++, index++) {
-			index = index % SE_MAX_AESBUF_ALLOC;
-			if (atomic_read(&se_dev->aes_buf_stat[index])) {
-				se_dev->aesbuf_entry = index;
-				atomic_set(&se_dev->aes_buf_stat[index], 0);
-				break;
+		/* Stage the whole gather in a contiguous run of pool slots */
+		nr = DIV_ROUND_UP(se_dev->gather_buf_sz, SE_MAX_GATHER_BUF_SZ);
+		index = tegra_se_try_get_aesbuf(se_dev, nr);
+		if (index < 0) {
+			tegra_se_stats_add(se_dev, &se_dev->nr_aesbuf_waits, 1);
+			if (!wait_event_timeout(se_dev->aes_buf_wq,
+				(index = tegra_se_try_get_aesbuf(se_dev, nr)) >= 0,
+				msecs_to_jiffies(SE_AESBUF_WAIT_TIMEOUT_MS))) {
+				pr_err("aes_buffer not available\n");
+				return -ETIMEDOUT;
 			}
-			if (i % SE_MAX_AESBUF_ALLOC == 0)
-				udelay(SE_WAIT_UDELAY);
-		}
-
-		if (i == SE_MAX_AESBUF_TIMEOUT) {
-			pr_err("aes_buffer not available\n");
-			return -ETIMEDOUT;
 		}
+		se_dev->aesbuf_entry = index;
+		se_dev->aesbuf_nr = nr;
 		buf = se_dev->aes_bufs[index];
 	}
 
@@ -1520,8 +1695,8 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev)
 			if (unlikely(se_dev->dynamic_mem))
 				kfree(se_dev->aes_buf);
 			else
-				atomic_set(&se_dev->aes_buf_stat[index], 1);
-			return ret;
+				tegra_se_put_aesbuf(se_dev, index, nr);
+			return -EINVAL;
 		}
 
 		se_dev->aes_addr = sg_dma_address(&se_dev->sg);
@@ -1532,6 +1707,24 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev)
 	return 0;
 }
 
+static void tegra_se_free_ablk_buf(struct tegra_se_dev *se_dev)
+{
+	if (!se_dev->ioc)
+		dma_unmap_sg(se_dev->dev, &se_dev->sg, 1, DMA_BIDIRECTIONAL);
+
+	if (unlikely(se_dev->dynamic_mem)) {
+		if (se_dev->ioc)
+			dma_free_coherent(se_dev->dev, se_dev->gather_buf_sz,
+					  se_dev->aes_buf,
+					  se_dev->aes_buf_addr);
+		else
+			kfree(se_dev->aes_buf);
+	} else {
+		tegra_se_put_aesbuf(se_dev, se_dev->aesbuf_entry,
+				    se_dev->aesbuf_nr);
+	}
+}
+
 static int tegra_se_prepare_cmdbuf(struct tegra_se_dev *se_dev,
 				   u32 *cpuvaddr, dma_addr_t iova)
 {
@@ -1584,40 +1777,22 @@ static int tegra_se_prepare_cmdbuf(struct tegra_se_dev *se_dev,
 	return ret;
 }
 
-static int tegra_se_get_free_cmdbuf(struct tegra_se_dev *se_dev)
-{
-	int i = 0;
-	unsigned int index = se_dev->cmdbuf_list_entry + 1;
-
-	for (i = 0; i < SE_MAX_CMDBUF_TIMEOUT; i++, index++) {
-		index = index % SE_MAX_SUBMIT_CHAIN_SZ;
-		if (atomic_read(&se_dev->cmdbuf_addr_list[index].free)) {
-			atomic_set(&se_dev->cmdbuf_addr_list[index].free, 0);
-			break;
-		}
-		if (i % SE_MAX_SUBMIT_CHAIN_SZ == 0)
-			udelay(SE_WAIT_UDELAY);
-	}
-
-	return (i == SE_MAX_CMDBUF_TIMEOUT) ? -ENOMEM : index;
-}
-
 static void tegra_se_process_new_req(struct tegra_se_dev *se_dev)
 {
 	struct ablkcipher_request *req;
+	struct tegra_se_req_context *req_ctx;
 	u32 *cpuvaddr = NULL;
 	dma_addr_t iova = 0;
 	unsigned int index = 0;
+	unsigned int req_cnt = se_dev->req_cnt;
 	int err = 0, i = 0;
 
 	tegra_se_boost_cpu_freq(se_dev);
 
-	for (i = 0; i < se_dev->req_cnt; i++) {
-		req = se_dev->reqs[i];
-		if (req->nbytes != SE_STATIC_MEM_ALLOC_BUFSZ) {
-			se_dev->dynamic_mem = true;
-			break;
-		}
+	/* Only gathers too large for the staging pool are allocated */
+	if (se_dev->gather_buf_sz > SE_MAX_AESBUF_POOL_SZ) {
+		se_dev->dynamic_mem = true;
+		tegra_se_stats_add(se_dev, &se_dev->nr_dynmem, 1);
 	}
 
 	err = tegra_se_setup_ablk_req(se_dev);
@@ -1646,15 +1821,20 @@ static void tegra_se_process_new_req(struct tegra_se_dev *se_dev)
 		goto cmdbuf_out;
 	se_dev->dynamic_mem = false;
 
+	tegra_se_stats_add(se_dev, &se_dev->nr_submits, 1);
+	tegra_se_stats_add(se_dev, &se_dev->nr_batched, req_cnt);
+
 	return;
 cmdbuf_out:
-	atomic_set(&se_dev->cmdbuf_addr_list[index].free, 1);
+	tegra_se_put_cmdbuf(se_dev, index);
 index_out:
-	dma_unmap_sg(se_dev->dev, &se_dev->sg, 1, DMA_BIDIRECTIONAL);
-	kfree(se_dev->aes_buf);
+	tegra_se_free_ablk_buf(se_dev);
 mem_out:
 	for (i = 0; i < se_dev->req_cnt; i++) {
 		req = se_dev->reqs[i];
+		req_ctx = ablkcipher_request_ctx(req);
+		tegra_se_account_req(se_dev, req_ctx->op_mode, req->nbytes,
+				     req_ctx->start, err);
 		req->base.complete(&req->base, err);
 	}
 	se_dev->req_cnt = 0;
@@ -1663,6 +1843,36 @@ mem_out:
 	se_dev->dynamic_mem = false;
 }
 
+static unsigned int tegra_se_peek_req_nbytes(struct crypto_queue *queue)
+{
+	struct crypto_async_request *async_req;
+
+	if (list_empty(&queue->list))
+		return 0;
+
+	async_req = list_first_entry(&queue->list,
+				     struct crypto_async_request, list);
+
+	return ablkcipher_request_cast(async_req)->nbytes;
+}
+
+/*
+ * Grow the batch while requests are left behind in the queue and shrink
+ * it once a batch drains the queue with room to spare, so that a light
+ * load is submitted right away and a heavy one with fewer, larger gathers.
+ */
+static void tegra_se_adapt_coalescing(struct tegra_se_dev *se_dev)
+{
+	if (se_dev->queue.qlen)
+		se_dev->coalesce_tasks = min_t(unsigned int,
+					       se_dev->coalesce_tasks * 2,
+					       SE_MAX_TASKS_PER_SUBMIT);
+	else if (se_dev->req_cnt <= se_dev->coalesce_tasks / 2)
+		se_dev->coalesce_tasks = max_t(unsigned int,
+					       se_dev->coalesce_tasks / 2,
+					       SE_MIN_COALESCE_TASKS);
+}
+
 static void tegra_se_work_handler(struct work_struct *work)
 {
 	struct tegra_se_dev *se_dev = container_of(work, struct tegra_se_dev,
@@ -1670,12 +1880,14 @@ static void tegra_se_work_handler(struct work_struct *work)
 	struct crypto_async_request *async_req = NULL;
 	struct crypto_async_request *backlog = NULL;
 	struct ablkcipher_request *req;
+	unsigned int limit;
 	bool process_requests;
 
 	mutex_lock(&se_dev->mtx);
 	do {
 		process_requests = false;
 		mutex_lock(&se_dev->lock);
+		limit = se_dev->coalesce_tasks;
 		do {
 			backlog = crypto_get_backlog(&se_dev->queue);
 			async_req = crypto_dequeue_request(&se_dev->queue);
@@ -1696,8 +1908,13 @@ static void tegra_se_work_handler(struct work_struct *work)
 			} else {
 				break;
 			}
-		} while (se_dev->queue.qlen &&
-			 (se_dev->req_cnt < SE_MAX_TASKS_PER_SUBMIT));
+		} while (se_dev->queue.qlen && (se_dev->req_cnt < limit) &&
+			 (se_dev->gather_buf_sz +
+			  tegra_se_peek_req_nbytes(&se_dev->queue) <=
+			  SE_MAX_COALESCE_BYTES));
+
+		if (process_requests)
+			tegra_se_adapt_coalescing(se_dev);
 		mutex_unlock(&se_dev->lock);
 
 		if (process_requests)
@@ -1709,8 +1926,11 @@ static void tegra_se_work_handler(struct work_struct *work)
 static int tegra_se_aes_queue_req(struct tegra_se_dev *se_dev,
 				  struct ablkcipher_request *req)
 {
+	struct tegra_se_req_context *req_ctx = ablkcipher_request_ctx(req);
 	int err = 0;
 
+	req_ctx->start = ktime_get();
+
 	mutex_lock(&se_dev->lock);
 	err = ablkcipher_enqueue_request(&se_dev->queue, req);
 
@@ -1856,8 +2076,9 @@ static void tegra_se_init_aesbuf(struct tegra_se_dev *se_dev)
 		if (se_dev->ioc)
 			se_dev->aes_buf_addrs[i] = buf_addr +
 						(i * SE_MAX_GATHER_BUF_SZ);
-		atomic_set(&se_dev->aes_buf_stat[i], 1);
 	}
+
+	bitmap_zero(se_dev->aes_buf_map, SE_MAX_AESBUF_ALLOC);
 }
 
 static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
@@ -1927,7 +2148,6 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 
 	cpuvaddr = se_dev->cmdbuf_addr_list[index].cmdbuf_addr;
 	iova = se_dev->cmdbuf_addr_list[index].iova;
-	atomic_set(&se_dev->cmdbuf_addr_list[index].free, 0);
 	se_dev->cmdbuf_list_entry = index;
 
 	/* load the key */
@@ -1938,20 +2158,24 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 			SE_KEY_TABLE_TYPE_KEY, se_dev->opcode_addr, cpuvaddr,
 			iova, AES_CB);
 	} else {
+		/*
+		 * Both halves share the cmdbuf: wait for the first one so
+		 * that only the second completion returns it to the list.
+		 */
 		keylen = keylen / 2;
 		ret = tegra_se_send_key_data(
 			se_dev, pdata, keylen, ctx->slot->slot_num,
 			SE_KEY_TABLE_TYPE_XTS_KEY1, se_dev->opcode_addr,
-			cpuvaddr, iova, AES_CB);
-		if (ret)
-			goto keyslt_free;
-
-		ret = tegra_se_send_key_data(se_dev, pdata + keylen, keylen,
-					     ctx->slot->slot_num,
-					     SE_KEY_TABLE_TYPE_XTS_KEY2,
-					     se_dev->opcode_addr, cpuvaddr,
-					     iova, AES_CB);
+			cpuvaddr, iova, NONE);
+		if (!ret)
+			ret = tegra_se_send_key_data(
+				se_dev, pdata + keylen, keylen,
+				ctx->slot->slot_num,
+				SE_KEY_TABLE_TYPE_XTS_KEY2,
+				se_dev->opcode_addr, cpuvaddr, iova, AES_CB);
 	}
+	if (ret)
+		tegra_se_put_cmdbuf(se_dev, index);
 keyslt_free:
 	if (ret)
 		tegra_se_free_key_slot(ctx->slot);
@@ -2286,6 +2510,7 @@ static int tegra_se_sha_op(struct ahash_request *req, bool is_last,
 {
 	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
 	struct tegra_se_sha_context *sha_ctx = crypto_ahash_ctx(tfm);
+	struct tegra_se_req_context *req_ctx = ahash_request_ctx(req);
 	struct tegra_se_dev *se_dev = se_devices[SE_SHA];
 	u32 mode;
 	int ret;
@@ -2329,6 +2554,8 @@ static int tegra_se_sha_op(struct ahash_request *req, bool is_last,
 		}
 	};
 
+	req_ctx->start = ktime_get();
+
 	switch (crypto_ahash_digestsize(tfm)) {
 	case SHA1_DIGEST_SIZE:
 		sha_ctx->op_mode = SE_AES_OP_MODE_SHA1;
@@ -4087,6 +4314,449 @@ static const struct of_device_id tegra_se_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, tegra_se_of_match);
 
+#ifdef CONFIG_DEBUG_FS
+static const char * const tegra_se_op_mode_names[SE_NUM_OP_MODES] = {
+	[SE_AES_OP_MODE_CBC] = "cbc",
+	[SE_AES_OP_MODE_ECB] = "ecb",
+	[SE_AES_OP_MODE_CTR] = "ctr",
+	[SE_AES_OP_MODE_OFB] = "ofb",
+	[SE_AES_OP_MODE_CMAC] = "cmac",
+	[SE_AES_OP_MODE_RNG_DRBG] = "rng_drbg",
+	[SE_AES_OP_MODE_SHA1] = "sha1",
+	[SE_AES_OP_MODE_SHA224] = "sha224",
+	[SE_AES_OP_MODE_SHA256] = "sha256",
+	[SE_AES_OP_MODE_SHA384] = "sha384",
+	[SE_AES_OP_MODE_SHA512] = "sha512",
+	[SE_AES_OP_MODE_XTS] = "xts",
+};
+
+static int tegra_se_stats_show(struct seq_file *s, void *unused)
+{
+	struct tegra_se_dev *se_dev = s->private;
+	struct tegra_se_op_stats stats[SE_NUM_OP_MODES];
+	struct tegra_se_op_stats *st;
+	u64 submits, batched, cmdbuf_waits, aesbuf_waits, dynmem;
+	unsigned long flags;
+	u64 elapsed_ns;
+	int i;
+
+	spin_lock_irqsave(&se_dev->stats_lock, flags);
+	memcpy(stats, se_dev->stats, sizeof(stats));
+	submits = se_dev->nr_submits;
+	batched = se_dev->nr_batched;
+	cmdbuf_waits = se_dev->nr_cmdbuf_waits;
+	aesbuf_waits = se_dev->nr_aesbuf_waits;
+	dynmem = se_dev->nr_dynmem;
+	elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), se_dev->stats_start));
+	spin_unlock_irqrestore(&se_dev->stats_lock, flags);
+
+	seq_printf(s, "%-8s %10s %14s %8s %8s %10s %10s\n", "mode", "reqs",
+		   "bytes", "errors", "MB/s", "avg_us", "max_us");
+	for (i = 0; i < SE_NUM_OP_MODES; i++) {
+		st = &stats[i];
+		if (!st->reqs && !st->errors)
+			continue;
+
+		seq_printf(s, "%-8s %10llu %14llu %8llu %8llu %10llu %10llu\n",
+			   tegra_se_op_mode_names[i], st->reqs, st->bytes,
+			   st->errors,
+			   elapsed_ns ? div64_u64(st->bytes * 1000,
+						  elapsed_ns) : 0,
+			   st->reqs ? div64_u64(st->lat_ns,
+						st->reqs * 1000) : 0,
+			   div_u64(st->lat_max_ns, 1000));
+	}
+
+	seq_printf(s, "\nsubmits: %llu\n", submits);
+	seq_printf(s, "reqs_per_submit: %llu\n",
+		   submits ? div64_u64(batched, submits) : 0);
+	seq_printf(s, "coalesce_limit: %u\n", se_dev->coalesce_tasks);
+	seq_printf(s, "cmdbufs_busy: %d\n", atomic_read(&se_dev->cmdbuf_busy));
+	seq_printf(s, "cmdbuf_waits: %llu\n", cmdbuf_waits);
+	seq_printf(s, "aesbuf_waits: %llu\n", aesbuf_waits);
+	seq_printf(s, "dynmem_allocs: %llu\n", dynmem);
+
+	return 0;
+}
+
+static int tegra_se_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_stats_show, inode->i_private);
+}
+
+/* Any write clears the counters and restarts the throughput window */
+static ssize_t tegra_se_stats_write(struct file *file,
+				    const char __user *buf, size_t count,
+				    loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct tegra_se_dev *se_dev = s->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&se_dev->stats_lock, flags);
+	memset(se_dev->stats, 0, sizeof(se_dev->stats));
+	se_dev->nr_submits = 0;
+	se_dev->nr_batched = 0;
+	se_dev->nr_cmdbuf_waits = 0;
+	se_dev->nr_aesbuf_waits = 0;
+	se_dev->nr_dynmem = 0;
+	se_dev->stats_start = ktime_get();
+	spin_unlock_irqrestore(&se_dev->stats_lock, flags);
+
+	return count;
+}
+
+static const struct file_operations tegra_se_stats_fops = {
+	.open		= tegra_se_stats_open,
+	.read		= seq_read,
+	.write		= tegra_se_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * benchmark: "echo <depth> > benchmark" keeps up to depth requests in
+ * flight for each algorithm served by this engine and each size from
+ * SE_BENCH_MIN_SIZE to SE_BENCH_MAX_SIZE; reading shows the last run.
+ */
+static const struct {
+	const char *name;
+	enum tegra_se_algo algo;
+	unsigned int keylen;
+} tegra_se_bench_algs[] = {
+	{ "cbc-aes-tegra", SE_AES, AES_KEYSIZE_128 },
+	{ "ctr-aes-tegra", SE_AES, AES_KEYSIZE_128 },
+	{ "xts-aes-tegra", SE_AES, 2 * AES_KEYSIZE_128 },
+	{ "tegra-se-sha1", SE_SHA, 0 },
+	{ "tegra-se-sha256", SE_SHA, 0 },
+	{ "tegra-se-sha512", SE_SHA, 0 },
+};
+
+struct tegra_se_bench_ctx {
+	struct completion done;
+	atomic_t pending;
+	int err;
+};
+
+static void tegra_se_bench_done(struct tegra_se_bench_ctx *b, int err)
+{
+	if (err)
+		b->err = err;
+	if (atomic_dec_and_test(&b->pending))
+		complete(&b->done);
+}
+
+static void tegra_se_bench_complete(struct crypto_async_request *areq,
+				    int err)
+{
+	/* Backlogged request has just been moved to the queue */
+	if (err == -EINPROGRESS)
+		return;
+
+	tegra_se_bench_done(areq->data, err);
+}
+
+static int tegra_se_bench_encrypt(void *req)
+{
+	return crypto_ablkcipher_encrypt(req);
+}
+
+static int tegra_se_bench_digest(void *req)
+{
+	return crypto_ahash_digest(req);
+}
+
+static int tegra_se_bench_rounds(struct tegra_se_bench_ctx *b,
+				 int (*submit)(void *req), void **reqs,
+				 unsigned int depth, unsigned int rounds,
+				 u64 *ns)
+{
+	ktime_t start = ktime_get();
+	unsigned int r, i;
+	int ret;
+
+	b->err = 0;
+	for (r = 0; r < rounds && !b->err; r++) {
+		reinit_completion(&b->done);
+		/* Bias so the last callback can't complete a partial round */
+		atomic_set(&b->pending, depth + 1);
+		for (i = 0; i < depth; i++) {
+			ret = submit(reqs[i]);
+			if (ret != -EINPROGRESS && ret != -EBUSY)
+				tegra_se_bench_done(b, ret);
+		}
+		if (!atomic_dec_and_test(&b->pending))
+			wait_for_completion(&b->done);
+	}
+	*ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	return b->err;
+}
+
+static int tegra_se_bench_ablk(const char *name, unsigned int keylen,
+			       void **bufs, unsigned int depth,
+			       unsigned int size, unsigned int rounds,
+			       u64 *ns)
+{
+	struct crypto_ablkcipher *tfm;
+	struct tegra_se_bench_ctx b;
+	struct scatterlist *sg;
+	void **reqs;
+	u8 *iv;
+	u8 key[2 * AES_KEYSIZE_128];
+	unsigned int i;
+	int ret;
+
+	tfm = crypto_alloc_ablkcipher(name, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	memset(key, 0x5a, sizeof(key));
+	ret = crypto_ablkcipher_setkey(tfm, key, keylen);
+	if (ret)
+		goto free_tfm;
+
+	reqs = kcalloc(depth, sizeof(*reqs), GFP_KERNEL);
+	sg = kcalloc(depth, sizeof(*sg), GFP_KERNEL);
+	iv = kcalloc(depth, TEGRA_SE_AES_IV_SIZE, GFP_KERNEL);
+	if (!reqs || !sg || !iv) {
+		ret = -ENOMEM;
+		goto free_reqs;
+	}
+
+	init_completion(&b.done);
+	for (i = 0; i < depth; i++) {
+		reqs[i] = ablkcipher_request_alloc(tfm, GFP_KERNEL);
+		if (!reqs[i]) {
+			ret = -ENOMEM;
+			goto free_reqs;
+		}
+		sg_init_one(&sg[i], bufs[i], size);
+		ablkcipher_request_set_callback(reqs[i],
+						CRYPTO_TFM_REQ_MAY_BACKLOG,
+						tegra_se_bench_complete, &b);
+		ablkcipher_request_set_crypt(reqs[i], &sg[i], &sg[i], size,
+					     iv + i * TEGRA_SE_AES_IV_SIZE);
+	}
+
+	ret = tegra_se_bench_rounds(&b, tegra_se_bench_encrypt, reqs, depth,
+				    rounds, ns);
+free_reqs:
+	for (i = 0; reqs && i < depth; i++)
+		ablkcipher_request_free(reqs[i]);
+	kfree(iv);
+	kfree(sg);
+	kfree(reqs);
+free_tfm:
+	crypto_free_ablkcipher(tfm);
+
+	return ret;
+}
+
+static int tegra_se_bench_hash(const char *name, void **bufs,
+			       unsigned int depth, unsigned int size,
+			       unsigned int rounds, u64 *ns)
+{
+	struct crypto_ahash *tfm;
+	struct tegra_se_bench_ctx b;
+	struct scatterlist *sg;
+	void **reqs;
+	unsigned int i;
+	int ret;
+
+	tfm = crypto_alloc_ahash(name, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	reqs = kcalloc(depth, sizeof(*reqs), GFP_KERNEL);
+	sg = kcalloc(depth, sizeof(*sg), GFP_KERNEL);
+	if (!reqs || !sg) {
+		ret = -ENOMEM;
+		goto free_reqs;
+	}
+
+	init_completion(&b.done);
+	for (i = 0; i < depth; i++) {
+		reqs[i] = ahash_request_alloc(tfm, GFP_KERNEL);
+		if (!reqs[i]) {
+			ret = -ENOMEM;
+			goto free_reqs;
+		}
+		sg_init_one(&sg[i], bufs[i], size);
+		ahash_request_set_callback(reqs[i],
+					   CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   tegra_se_bench_complete, &b);
+		/* The digest is mapped with the request length */
+		ahash_request_set_crypt(reqs[i], &sg[i], bufs[depth + i],
+					size);
+	}
+
+	ret = tegra_se_bench_rounds(&b, tegra_se_bench_digest, reqs, depth,
+				    rounds, ns);
+free_reqs:
+	for (i = 0; reqs && i < depth; i++)
+		ahash_request_free(reqs[i]);
+	kfree(sg);
+	kfree(reqs);
+	crypto_free_ahash(tfm);
+
+	return ret;
+}
+
+static int tegra_se_bench_run(struct tegra_se_dev *se_dev,
+			      unsigned int depth)
+{
+	struct tegra_se_bench_result *res, *r;
+	unsigned int i, a, size, ops, cnt = 0;
+	void **bufs;
+	int ret = 0;
+
+	res = kcalloc(ARRAY_SIZE(tegra_se_bench_algs) * SE_BENCH_NR_SIZES,
+		      sizeof(*res), GFP_KERNEL);
+	bufs = kcalloc(2 * depth, sizeof(*bufs), GFP_KERNEL);
+	if (!res || !bufs) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < 2 * depth; i++) {
+		bufs[i] = kmalloc(SE_BENCH_MAX_SIZE, GFP_KERNEL);
+		if (!bufs[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		memset(bufs[i], i, SE_BENCH_MAX_SIZE);
+	}
+
+	for (a = 0; a < ARRAY_SIZE(tegra_se_bench_algs); a++) {
+		if (se_devices[tegra_se_bench_algs[a].algo] != se_dev)
+			continue;
+
+		for (size = SE_BENCH_MIN_SIZE; size <= SE_BENCH_MAX_SIZE;
+		     size <<= 1) {
+			ops = max_t(unsigned int, SE_BENCH_BYTES / size,
+				    SE_BENCH_MIN_OPS);
+			r = &res[cnt++];
+			r->alg = tegra_se_bench_algs[a].name;
+			r->size = size;
+			r->ops = roundup(ops, depth);
+
+			if (tegra_se_bench_algs[a].algo == SE_AES)
+				r->err = tegra_se_bench_ablk(r->alg,
+					tegra_se_bench_algs[a].keylen, bufs,
+					depth, size, r->ops / depth, &r->ns);
+			else
+				r->err = tegra_se_bench_hash(r->alg, bufs,
+					depth, size, r->ops / depth, &r->ns);
+		}
+	}
+
+	kfree(se_dev->bench);
+	se_dev->bench = res;
+	se_dev->bench_cnt = cnt;
+	se_dev->bench_depth = depth;
+	res = NULL;
+out:
+	for (i = 0; bufs && i < 2 * depth; i++)
+		kfree(bufs[i]);
+	kfree(bufs);
+	kfree(res);
+
+	return ret;
+}
+
+static int tegra_se_bench_show(struct seq_file *s, void *unused)
+{
+	struct tegra_se_dev *se_dev = s->private;
+	struct tegra_se_bench_result *r;
+	unsigned int i;
+
+	mutex_lock(&se_dev->bench_lock);
+	if (!se_dev->bench_cnt) {
+		seq_puts(s, "no results, write the queue depth to run\n");
+		goto out;
+	}
+
+	seq_printf(s, "depth: %u\n", se_dev->bench_depth);
+	seq_printf(s, "%-16s %8s %8s %10s %10s\n", "alg", "size", "ops",
+		   "MB/s", "ns/op");
+	for (i = 0; i < se_dev->bench_cnt; i++) {
+		r = &se_dev->bench[i];
+		if (r->err) {
+			seq_printf(s, "%-16s %8u error %d\n", r->alg, r->size,
+				   r->err);
+			continue;
+		}
+		seq_printf(s, "%-16s %8u %8u %10llu %10llu\n", r->alg,
+			   r->size, r->ops,
+			   r->ns ? div64_u64((u64)r->size * r->ops * 1000,
+					     r->ns) : 0,
+			   div_u64(r->ns, r->ops));
+	}
+out:
+	mutex_unlock(&se_dev->bench_lock);
+
+	return 0;
+}
+
+static int tegra_se_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_bench_show, inode->i_private);
+}
+
+static ssize_t tegra_se_bench_write(struct file *file,
+				    const char __user *buf, size_t count,
+				    loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct tegra_se_dev *se_dev = s->private;
+	unsigned int depth;
+	int ret;
+
+	ret = kstrtouint_from_user(buf, count, 0, &depth);
+	if (ret)
+		return ret;
+
+	if (!depth)
+		depth = SE_BENCH_DEF_DEPTH;
+	depth = min_t(unsigned int, depth, SE_BENCH_MAX_DEPTH);
+
+	mutex_lock(&se_dev->bench_lock);
+	ret = tegra_se_bench_run(se_dev, depth);
+	mutex_unlock(&se_dev->bench_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations tegra_se_bench_fops = {
+	.open		= tegra_se_bench_open,
+	.read		= seq_read,
+	.write		= tegra_se_bench_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_se_debugfs_init(struct tegra_se_dev *se_dev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(se_dev->pdev);
+	struct dentry *de = pdata->debugfs;
+
+	if (!de)
+		return;
+
+	debugfs_create_file("stats", S_IRUGO | S_IWUSR, de, se_dev,
+			    &tegra_se_stats_fops);
+
+	if (se_devices[SE_AES] == se_dev || se_devices[SE_SHA] == se_dev)
+		debugfs_create_file("benchmark", S_IRUGO | S_IWUSR, de,
+				    se_dev, &tegra_se_bench_fops);
+}
+#else
+static inline void tegra_se_debugfs_init(struct tegra_se_dev *se_dev)
+{
+}
+#endif
+
 static bool is_algo_supported(struct device_node *node, char *algo)
 {
 	if (of_property_match_string(node, "supported-algos", algo) >= 0)
@@ -4218,6 +4888,14 @@ static int tegra_se_probe(struct platform_device *pdev)
 	}
 
 	mutex_init(&se_dev->mtx);
+	init_waitqueue_head(&se_dev->cmdbuf_wq);
+	atomic_set(&se_dev->cmdbuf_busy, 0);
+	spin_lock_init(&se_dev->aes_buf_lock);
+	init_waitqueue_head(&se_dev->aes_buf_wq);
+	se_dev->coalesce_tasks = SE_INIT_COALESCE_TASKS;
+	spin_lock_init(&se_dev->stats_lock);
+	se_dev->stats_start = ktime_get();
+	mutex_init(&se_dev->bench_lock);
 	INIT_WORK(&se_dev->se_work, tegra_se_work_handler);
 	se_dev->se_work_q = alloc_workqueue("se_work_q",
 					    WQ_HIGHPRI | WQ_UNBOUND, 1);
@@ -4370,7 +5048,7 @@ static int tegra_se_probe(struct platform_device *pdev)
 	tegra_se_init_aesbuf(se_dev);
 
 	if (is_algo_supported(node, "drbg") || is_algo_supported(node, "aes") ||
-	    is_algo_supported(node, "cmac")) {
+	    is_algo_supported(node, "cmac") || is_algo_supported(node, "sha")) {
 		se_dev->aes_cmdbuf_cpuvaddr = dma_alloc_attrs(
 			se_dev->dev->parent, SZ_16K * SE_MAX_SUBMIT_CHAIN_SZ,
 			&se_dev->aes_cmdbuf_iova, GFP_KERNEL,
@@ -4387,6 +5065,8 @@ static int tegra_se_probe(struct platform_device *pdev)
 
 	tegra_se_boost_cpu_init(se_dev);
 
+	tegra_se_debugfs_init(se_dev);
+
 	dev_info(se_dev->dev, "%s: complete", __func__);
 
 	return 0;
@@ -4461,7 +5141,10 @@ static int tegra_se_remove(struct platform_device *pdev)
 		destroy_workqueue(se_dev->se_work_q);
 
 	mutex_destroy(&se_dev->mtx);
+	/* Drops the debugfs directory before the results go away */
 	nvhost_client_device_release(pdev);
+	kfree(se_dev->bench);
+	mutex_destroy(&se_dev->bench_lock);
 	mutex_destroy(&pdata->lock);
 
 	return 0;
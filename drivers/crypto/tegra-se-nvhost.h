@@ -216,13 +216,26 @@
 #define SE_MAX_MEM_ALLOC		4194304
 #define SE_MAX_GATHER_BUF_SZ		32768
 #define SE_MAX_AESBUF_ALLOC	(SE_MAX_MEM_ALLOC / SE_MAX_GATHER_BUF_SZ)
-#define SE_MAX_AESBUF_TIMEOUT		(20 * SE_MAX_AESBUF_ALLOC)
-
-/* FIXME: The below 2 macros should fine tuned
- * based on discussions with CPU team
- */
-#define SE_MAX_CMDBUF_TIMEOUT		(200 * SE_MAX_SUBMIT_CHAIN_SZ)
-#define SE_WAIT_UDELAY			500 /* micro seconds */
+/* Largest gather staged in the pool; anything bigger is allocated */
+#define SE_MAX_AESBUF_POOL_SZ		(SE_MAX_MEM_ALLOC / 4)
+
+/* Time to wait for a free cmdbuf or staging buffer */
+#define SE_CMDBUF_WAIT_TIMEOUT_MS	100
+#define SE_AESBUF_WAIT_TIMEOUT_MS	100
+
+/* Adaptive request coalescing bounds */
+#define SE_MIN_COALESCE_TASKS		1
+#define SE_INIT_COALESCE_TASKS		8
+#define SE_MAX_COALESCE_BYTES		(8 * SE_MAX_GATHER_BUF_SZ)
+
+/* In-kernel benchmark parameters */
+#define SE_BENCH_DEF_DEPTH		8
+#define SE_BENCH_MAX_DEPTH		16
+#define SE_BENCH_MIN_SIZE		512
+#define SE_BENCH_MAX_SIZE		65536
+#define SE_BENCH_NR_SIZES		8 /* SE_BENCH_MIN_SIZE << 0..7 */
+#define SE_BENCH_BYTES			(4 * 1024 * 1024)
+#define SE_BENCH_MIN_OPS		64
 
 #define SE_KEYSLOT_TIMEOUT		100
 #define SE_KEYSLOT_MDELAY		1000
@@ -271,8 +284,6 @@
 #define SE_HASH_RESULT_REG_OFFSET	0x13c
 #define SE_CMAC_RESULT_REG_OFFSET	0x4c4
 
-#define SE_STATIC_MEM_ALLOC_BUFSZ	512
-
 #define TEGRA_SE_KEY_256_SIZE		32
 #define TEGRA_SE_KEY_512_SIZE		64
 #define TEGRA_SE_KEY_192_SIZE		24
@@ -17,6 +17,8 @@
  */
 
 #include <linux/bitops.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dmaengine.h>
 #include <linux/dma-mapping.h>
@@ -24,6 +26,7 @@
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/of.h>
@@ -35,6 +38,8 @@
 #include <linux/tegra_pm_domains.h>
 #include <linux/version.h>
 #include <linux/reset.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/platform/tegra/tegra-mc-sid.h>
 #include <dt-bindings/memory/tegra-swgroup.h>
 
@@ -164,6 +169,19 @@
 /* Channel base address offset from GPCDMA base address */
 #define TEGRA_GPCDMA_CHANNEL_BASE_ADD_OFFSET	0x10000
 
+/*
+ * Default per-channel pool sizes, used unless DT overrides them through
+ * "nvidia,preallocated-descs" and "nvidia,preallocated-sg".
+ */
+#define TEGRA_GPCDMA_DEF_DESC_POOL		32
+#define TEGRA_GPCDMA_DEF_SG_POOL		128
+
+/* Callbacks collected per tasklet lock hold */
+#define TEGRA_GPCDMA_CB_BATCH			16
+
+/* Back to back completions handled in one interrupt */
+#define TEGRA_GPCDMA_ISR_BUDGET			8
+
 struct tegra_dma;
 
 /*
@@ -252,6 +270,10 @@ struct tegra_dma_channel {
 	struct list_head	free_dma_desc;
 	struct list_head	cb_desc;
 
+	/* Fixed pools backing the free lists, sized at probe */
+	struct tegra_dma_desc	*desc_pool;
+	struct tegra_dma_sg_req	*sg_pool;
+
 	/* ISR handler and tasklet for bottom half of isr handling */
 	dma_isr_handler		isr_handler;
 	struct tasklet_struct	tasklet;
@@ -271,6 +293,13 @@ struct tegra_dma {
 	void __iomem			*base_addr;
 	const struct tegra_dma_chip_data *chip_data;
 	struct reset_control *rst;
+	int desc_pool_size;
+	int sg_pool_size;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *debugfs;
+	u32 bench_size;
+	u32 bench_iters;
+#endif
 	/* Last member of the structure */
 	struct tegra_dma_channel channels[0];
 };
@@ -335,35 +364,26 @@ static void tegra_dma_desc_put(struct tegra_dma_channel *tdc,
 	if (!list_empty(&dma_desc->tx_list))
 		list_splice_init(&dma_desc->tx_list, &tdc->free_sg_req);
 	dma_desc->txd.flags = DMA_CTRL_ACK;
-	list_add_tail(&dma_desc->node, &tdc->free_dma_desc);
+	list_add(&dma_desc->node, &tdc->free_dma_desc);
 	raw_spin_unlock_irqrestore(&tdc->lock, flags);
 }
 
-static struct tegra_dma_desc *tegra_dma_desc_alloc(
-		struct tegra_dma_channel *tdc, bool prealloc)
+/*
+ * Return a finished descriptor to the free list, where tx_status() can
+ * still find it. Acked descriptors go to the head so that
+ * tegra_dma_desc_get() normally reuses the first entry; the ones still
+ * waiting for an ack queue up behind them. Called with tdc->lock held.
+ */
+static void tegra_dma_desc_retire(struct tegra_dma_channel *tdc,
+		struct tegra_dma_desc *dma_desc)
 {
-	struct tegra_dma_desc *dma_desc;
-
-	BUG_ON(tdc2dev(tdc) == NULL);
-
-	dma_desc = devm_kzalloc(tdc2dev(tdc), sizeof(*dma_desc), GFP_ATOMIC);
-	if (!dma_desc) {
-		dev_err(tdc2dev(tdc), "dma_desc alloc failed\n");
-		return NULL;
-	}
-
-	dma_async_tx_descriptor_init(&dma_desc->txd, &tdc->dma_chan);
-	dma_desc->txd.tx_submit = tegra_dma_tx_submit;
-
-	INIT_LIST_HEAD(&dma_desc->tx_list);
-
-	if (prealloc)
-		tegra_dma_desc_put(tdc, dma_desc);
-
-	return dma_desc;
+	if (async_tx_test_ack(&dma_desc->txd))
+		list_add(&dma_desc->node, &tdc->free_dma_desc);
+	else
+		list_add_tail(&dma_desc->node, &tdc->free_dma_desc);
 }
 
-/* Get DMA desc from free list, if not there then allocate it.  */
+/* Get DMA desc from the channel pool, NULL once it is exhausted. */
 static struct tegra_dma_desc *tegra_dma_desc_get(
 		struct tegra_dma_channel *tdc)
 {
@@ -372,7 +392,10 @@ static struct tegra_dma_desc *tegra_dma_desc_get(
 
 	raw_spin_lock_irqsave(&tdc->lock, flags);
 
-	/* Do not allocate if desc are waiting for ack */
+	/*
+	 * Skip desc waiting for ack. The walk only goes past the head for
+	 * descriptors acked after completion and is bounded by the pool.
+	 */
 	list_for_each_entry(dma_desc, &tdc->free_dma_desc, node) {
 		if (async_tx_test_ack(&dma_desc->txd)) {
 			list_del(&dma_desc->node);
@@ -384,7 +407,7 @@ static struct tegra_dma_desc *tegra_dma_desc_get(
 
 	raw_spin_unlock_irqrestore(&tdc->lock, flags);
 
-	return tegra_dma_desc_alloc(tdc, false);
+	return NULL;
 }
 
 static void tegra_dma_sg_req_put(
@@ -400,28 +423,13 @@ static void tegra_dma_sg_req_put(
 		 * on the same level, without conditionals
 		 */
 		raw_spin_lock_irqsave(&tdc->lock, flags);
-		list_add_tail(&sgreq->node, &tdc->free_sg_req);
+		list_add(&sgreq->node, &tdc->free_sg_req);
 		raw_spin_unlock_irqrestore(&tdc->lock, flags);
 	} else {
-		list_add_tail(&sgreq->node, &tdc->free_sg_req);
+		list_add(&sgreq->node, &tdc->free_sg_req);
 	}
 }
 
-static struct tegra_dma_sg_req *tegra_dma_sg_req_alloc(
-		struct tegra_dma_channel *tdc,
-		bool prealloc)
-{
-	struct tegra_dma_sg_req *sg_req = NULL;
-	sg_req = devm_kzalloc(tdc2dev(tdc), sizeof(struct tegra_dma_sg_req), GFP_ATOMIC);
-	if (!sg_req) {
-		dev_err(tdc2dev(tdc), "sg_req alloc failed\n");
-		return NULL;
-	}
-	if (prealloc)
-		tegra_dma_sg_req_put(tdc, sg_req, true);
-	return sg_req;
-}
-
 static struct tegra_dma_sg_req *tegra_dma_sg_req_get(
 		struct tegra_dma_channel *tdc)
 {
@@ -433,12 +441,10 @@ static struct tegra_dma_sg_req *tegra_dma_sg_req_get(
 		sg_req = list_first_entry(&tdc->free_sg_req,
 					typeof(*sg_req), node);
 		list_del(&sg_req->node);
-		raw_spin_unlock_irqrestore(&tdc->lock, flags);
-		return sg_req;
 	}
 	raw_spin_unlock_irqrestore(&tdc->lock, flags);
 
-	return tegra_dma_sg_req_alloc(tdc, false);
+	return sg_req;
 }
 
 static int tegra_dma_slave_config(struct dma_chan *dc,
@@ -604,7 +610,7 @@ static void tegra_dma_abort_all(struct tegra_dma_channel *tdc)
 		if (sgreq->last_sg) {
 			dma_desc = sgreq->dma_desc;
 			dma_desc->dma_status = DMA_ERROR;
-			list_add_tail(&dma_desc->node, &tdc->free_dma_desc);
+			tegra_dma_desc_retire(tdc, dma_desc);
 
 			/* Add in cb list if it is not there. */
 			if (!dma_desc->cb_count)
@@ -665,7 +671,7 @@ static void handle_once_dma_done(struct tegra_dma_channel *tdc,
 		if (!dma_desc->cb_count)
 			list_add_tail(&dma_desc->cb_node, &tdc->cb_desc);
 		dma_desc->cb_count++;
-		list_add_tail(&dma_desc->node, &tdc->free_dma_desc);
+		tegra_dma_desc_retire(tdc, dma_desc);
 	}
 	tegra_dma_sg_req_put(tdc, sgreq, false);
 
@@ -705,30 +711,43 @@ static void handle_cont_sngl_cycle_dma_done(struct tegra_dma_channel *tdc,
 	return;
 }
 
+/*
+ * Callbacks are collected in batches under one lock hold and run with the
+ * lock dropped, so a burst of completions costs one lock round trip per
+ * batch instead of one per descriptor.
+ */
 static void tegra_dma_tasklet(unsigned long data)
 {
 	struct tegra_dma_channel *tdc = (struct tegra_dma_channel *)data;
-	dma_async_tx_callback callback = NULL;
-	void *callback_param = NULL;
+	struct {
+		dma_async_tx_callback callback;
+		void *callback_param;
+		int cb_count;
+	} cb[TEGRA_GPCDMA_CB_BATCH];
 	struct tegra_dma_desc *dma_desc;
 	unsigned long flags;
-	int cb_count;
+	int i, n;
 
-	raw_spin_lock_irqsave(&tdc->lock, flags);
-	while (!list_empty(&tdc->cb_desc)) {
-		dma_desc  = list_first_entry(&tdc->cb_desc,
-					typeof(*dma_desc), cb_node);
-		list_del(&dma_desc->cb_node);
-		callback = dma_desc->txd.callback;
-		callback_param = dma_desc->txd.callback_param;
-		cb_count = dma_desc->cb_count;
-		dma_desc->cb_count = 0;
-		raw_spin_unlock_irqrestore(&tdc->lock, flags);
-		while (cb_count-- && callback)
-			callback(callback_param);
+	do {
+		n = 0;
 		raw_spin_lock_irqsave(&tdc->lock, flags);
-	}
-	raw_spin_unlock_irqrestore(&tdc->lock, flags);
+		while (!list_empty(&tdc->cb_desc) &&
+				n < TEGRA_GPCDMA_CB_BATCH) {
+			dma_desc  = list_first_entry(&tdc->cb_desc,
+						typeof(*dma_desc), cb_node);
+			list_del(&dma_desc->cb_node);
+			cb[n].callback = dma_desc->txd.callback;
+			cb[n].callback_param = dma_desc->txd.callback_param;
+			cb[n].cb_count = dma_desc->cb_count;
+			dma_desc->cb_count = 0;
+			n++;
+		}
+		raw_spin_unlock_irqrestore(&tdc->lock, flags);
+
+		for (i = 0; i < n; i++)
+			while (cb[i].cb_count-- && cb[i].callback)
+				cb[i].callback(cb[i].callback_param);
+	} while (n == TEGRA_GPCDMA_CB_BATCH);
 }
 
 static void tegra_dma_chan_decode_error(struct tegra_dma_channel *tdc, unsigned int err_status)
@@ -771,6 +790,7 @@ static irqreturn_t tegra_dma_isr(int irq, void *dev_id)
 	unsigned long status;
 	unsigned long flags;
 	unsigned int err_status;
+	int budget = 0;
 
 	raw_spin_lock_irqsave(&tdc->lock, flags);
 
@@ -784,15 +804,25 @@ static irqreturn_t tegra_dma_isr(int irq, void *dev_id)
 	}
 
 	if (status & TEGRA_GPCDMA_STATUS_ISE_EOC) {
-		tdc_write(tdc, TEGRA_GPCDMA_CHAN_STATUS, TEGRA_GPCDMA_STATUS_ISE_EOC);
-		if (tdc->isr_handler)
+		/*
+		 * A short request started by the handler may already be
+		 * done by the time it returns, retire it in the same pass
+		 * instead of taking another interrupt for it.
+		 */
+		do {
+			tdc_write(tdc, TEGRA_GPCDMA_CHAN_STATUS,
+					TEGRA_GPCDMA_STATUS_ISE_EOC);
+			if (!tdc->isr_handler) {
+				dev_err(tdc->tdma->dev,
+					"GPCDMA CH%d: status %lx ISR handler absent!\n",
+					tdc->id, status);
+				tegra_dma_dump_chan_regs(tdc);
+				break;
+			}
 			tdc->isr_handler(tdc, false);
-		else {
-			dev_err(tdc->tdma->dev,
-				"GPCDMA CH%d: status %lx ISR handler absent!\n",
-				tdc->id, status);
-			tegra_dma_dump_chan_regs(tdc);
-		}
+			status = tdc_read(tdc, TEGRA_GPCDMA_CHAN_STATUS);
+		} while ((status & TEGRA_GPCDMA_STATUS_ISE_EOC) &&
+				++budget < TEGRA_GPCDMA_ISR_BUDGET);
 		tasklet_schedule(&tdc->tasklet);
 		raw_spin_unlock_irqrestore(&tdc->lock, flags);
 		return IRQ_HANDLED;
@@ -1319,6 +1349,7 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
 	unsigned long csr, mc_seq, apb_ptr = 0, mmio_seq = 0;
 	struct list_head req_list;
 	struct tegra_dma_sg_req *sg_req = NULL;
+	dma_addr_t seg_start = 0, seg_end = 0;
 	u32 burst_size;
 	enum dma_slave_buswidth slave_bw = 0;
 	int ret;
@@ -1402,6 +1433,27 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
 			return NULL;
 		}
 
+		/*
+		 * The controller has no descriptor fetch, so each request
+		 * costs an interrupt and a reprogram. Entries that continue
+		 * the previous one in bus address space, as page lists
+		 * mapped through the SMMU usually do, are folded into that
+		 * request and move as one transfer.
+		 */
+		if (sg_req && mem == seg_end &&
+		    upper_32_bits(seg_start) == upper_32_bits(mem + len - 1) &&
+		    sg_req->req_len + len <=
+				tdc->tdma->chip_data->max_dma_count) {
+			sg_req->req_len += len;
+			sg_req->ch_regs.wcount = ((sg_req->req_len - 4) >> 2);
+			mmio_seq |= get_burst_size(tdc, burst_size, slave_bw,
+							sg_req->req_len);
+			sg_req->ch_regs.mmio_seq = mmio_seq;
+			dma_desc->bytes_requested += len;
+			seg_end = mem + len;
+			continue;
+		}
+
 		sg_req = tegra_dma_sg_req_get(tdc);
 		if (!sg_req) {
 			dev_err(tdc2dev(tdc), "Dma sg-req not available\n");
@@ -1411,6 +1463,8 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
 
 		mmio_seq |= get_burst_size(tdc, burst_size, slave_bw, len);
 		dma_desc->bytes_requested += len;
+		seg_start = mem;
+		seg_end = mem + len;
 
 		if (direction == DMA_MEM_TO_DEV) {
 			sg_req->ch_regs.src_ptr = mem;
@@ -1635,6 +1689,36 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_dma_cyclic(
 static int tegra_dma_alloc_chan_resources(struct dma_chan *dc)
 {
 	struct tegra_dma_channel *tdc = to_tegra_dma_chan(dc);
+	struct tegra_dma *tdma = tdc->tdma;
+	unsigned long flags;
+	int i;
+
+	tdc->desc_pool = kcalloc(tdma->desc_pool_size,
+				sizeof(*tdc->desc_pool), GFP_KERNEL);
+	tdc->sg_pool = kcalloc(tdma->sg_pool_size,
+				sizeof(*tdc->sg_pool), GFP_KERNEL);
+	if (!tdc->desc_pool || !tdc->sg_pool) {
+		kfree(tdc->desc_pool);
+		kfree(tdc->sg_pool);
+		tdc->desc_pool = NULL;
+		tdc->sg_pool = NULL;
+		return -ENOMEM;
+	}
+
+	raw_spin_lock_irqsave(&tdc->lock, flags);
+	for (i = 0; i < tdma->desc_pool_size; i++) {
+		struct tegra_dma_desc *dma_desc = &tdc->desc_pool[i];
+
+		dma_async_tx_descriptor_init(&dma_desc->txd, &tdc->dma_chan);
+		dma_desc->txd.tx_submit = tegra_dma_tx_submit;
+		dma_desc->txd.flags = DMA_CTRL_ACK;
+		INIT_LIST_HEAD(&dma_desc->tx_list);
+		INIT_LIST_HEAD(&dma_desc->cb_node);
+		list_add_tail(&dma_desc->node, &tdc->free_dma_desc);
+	}
+	for (i = 0; i < tdma->sg_pool_size; i++)
+		list_add_tail(&tdc->sg_pool[i].node, &tdc->free_sg_req);
+	raw_spin_unlock_irqrestore(&tdc->lock, flags);
 
 	dma_cookie_init(&tdc->dma_chan);
 	tdc->config_init = false;
@@ -1664,6 +1748,14 @@ static void tegra_dma_free_chan_resources(struct dma_chan *dc)
 	tdc->isr_handler = NULL;
 	tdc->slave_id = -1;
 	raw_spin_unlock_irqrestore(&tdc->lock, flags);
+
+	/* No callback may still be looking at the pools */
+	tasklet_kill(&tdc->tasklet);
+
+	kfree(tdc->desc_pool);
+	kfree(tdc->sg_pool);
+	tdc->desc_pool = NULL;
+	tdc->sg_pool = NULL;
 }
 
 static struct dma_chan *tegra_dma_of_xlate(struct of_phandle_args *dma_spec,
@@ -1683,6 +1775,165 @@ static struct dma_chan *tegra_dma_of_xlate(struct of_phandle_args *dma_spec,
 	return chan;
 }
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * dmatest-style throughput check of the memcpy and memset prep paths.
+ * Reading "memcpy" or "memset" under the controller's debugfs directory
+ * runs bench_iters transfers of bench_size bytes on a free channel.
+ */
+static bool tegra_dma_bench_filter(struct dma_chan *chan, void *param)
+{
+	return chan->device == param;
+}
+
+static void tegra_dma_bench_done(void *param)
+{
+	complete(param);
+}
+
+static int tegra_dma_bench_run(struct seq_file *s, bool fill)
+{
+	struct tegra_dma *tdma = s->private;
+	struct dma_device *dma_dev = &tdma->dma_dev;
+	u32 size = tdma->bench_size;
+	u32 iters = tdma->bench_iters;
+	struct dma_async_tx_descriptor *txd;
+	struct completion done;
+	struct dma_chan *chan;
+	dma_cap_mask_t mask;
+	dma_addr_t src_dma, dst_dma;
+	void *src, *dst;
+	ktime_t start;
+	u64 bytes;
+	s64 ns;
+	u32 i;
+	int ret = 0;
+
+	if (!size || !iters || (size & 3) ||
+			size > tdma->chip_data->max_dma_count)
+		return -EINVAL;
+
+	dma_cap_zero(mask);
+	dma_cap_set(fill ? DMA_MEMSET : DMA_MEMCPY, mask);
+	chan = dma_request_channel(mask, tegra_dma_bench_filter, dma_dev);
+	if (!chan)
+		return -EBUSY;
+
+	src = dma_alloc_coherent(tdma->dev, size, &src_dma, GFP_KERNEL);
+	dst = dma_alloc_coherent(tdma->dev, size, &dst_dma, GFP_KERNEL);
+	if (!src || !dst) {
+		ret = -ENOMEM;
+		goto free_buf;
+	}
+
+	start = ktime_get();
+	for (i = 0; i < iters; i++) {
+		init_completion(&done);
+		if (fill)
+			txd = dma_dev->device_prep_dma_memset(chan, dst_dma,
+					0xa5, size,
+					DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+		else
+			txd = dma_dev->device_prep_dma_memcpy(chan, dst_dma,
+					src_dma, size,
+					DMA_PREP_INTERRUPT | DMA_CTRL_ACK);
+		if (!txd) {
+			ret = -ENOMEM;
+			break;
+		}
+		txd->callback = tegra_dma_bench_done;
+		txd->callback_param = &done;
+		dmaengine_submit(txd);
+		dma_async_issue_pending(chan);
+
+		if (!wait_for_completion_timeout(&done,
+				msecs_to_jiffies(1000))) {
+			dmaengine_terminate_all(chan);
+			ret = -ETIMEDOUT;
+			break;
+		}
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	if (!ret) {
+		bytes = (u64)size * iters;
+		seq_printf(s, "%s: %u x %u bytes in %lld us, %llu MB/s\n",
+			fill ? "memset" : "memcpy", iters, size,
+			div_s64(ns, NSEC_PER_USEC),
+			div64_u64(bytes * NSEC_PER_USEC, ns ? ns : 1));
+	}
+
+free_buf:
+	if (dst)
+		dma_free_coherent(tdma->dev, size, dst, dst_dma);
+	if (src)
+		dma_free_coherent(tdma->dev, size, src, src_dma);
+	dma_release_channel(chan);
+	return ret;
+}
+
+static int tegra_dma_bench_memcpy_show(struct seq_file *s, void *data)
+{
+	return tegra_dma_bench_run(s, false);
+}
+
+static int tegra_dma_bench_memset_show(struct seq_file *s, void *data)
+{
+	return tegra_dma_bench_run(s, true);
+}
+
+static int tegra_dma_bench_memcpy_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_dma_bench_memcpy_show, inode->i_private);
+}
+
+static int tegra_dma_bench_memset_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_dma_bench_memset_show, inode->i_private);
+}
+
+static const struct file_operations tegra_dma_bench_memcpy_fops = {
+	.open		= tegra_dma_bench_memcpy_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static const struct file_operations tegra_dma_bench_memset_fops = {
+	.open		= tegra_dma_bench_memset_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_dma_debugfs_init(struct tegra_dma *tdma)
+{
+	tdma->bench_size = SZ_64K;
+	tdma->bench_iters = 1000;
+
+	tdma->debugfs = debugfs_create_dir(dev_name(tdma->dev), NULL);
+	if (IS_ERR_OR_NULL(tdma->debugfs))
+		return;
+
+	debugfs_create_u32("bench_size", S_IRUGO | S_IWUSR, tdma->debugfs,
+			&tdma->bench_size);
+	debugfs_create_u32("bench_iters", S_IRUGO | S_IWUSR, tdma->debugfs,
+			&tdma->bench_iters);
+	debugfs_create_file("memcpy", S_IRUSR, tdma->debugfs, tdma,
+			&tegra_dma_bench_memcpy_fops);
+	debugfs_create_file("memset", S_IRUSR, tdma->debugfs, tdma,
+			&tegra_dma_bench_memset_fops);
+}
+
+static void tegra_dma_debugfs_remove(struct tegra_dma *tdma)
+{
+	debugfs_remove_recursive(tdma->debugfs);
+}
+#else
+static inline void tegra_dma_debugfs_init(struct tegra_dma *tdma) { }
+static inline void tegra_dma_debugfs_remove(struct tegra_dma *tdma) { }
+#endif
+
 static const struct tegra_dma_chip_data tegra186_dma_chip_data = {
 	.nr_channels = 32,
 	.channel_reg_size = 0x10000,
@@ -1780,9 +2031,7 @@ static int tegra_dma_probe(struct platform_device *pdev)
 
 		/*
 		 * if these properties are unreadable, leave them zeroes
-		 * zeroes imply:
-		 * - NO preallocated sg requests
-		 * - NO preallocated descriptors
+		 * zeroes imply the default pool sizes
 		 */
 		of_property_read_u32(pdev->dev.of_node,
 			"nvidia,preallocated-descs", &preallocated_desc);
@@ -1803,6 +2052,10 @@ static int tegra_dma_probe(struct platform_device *pdev)
 
 	tdma->dev = &pdev->dev;
 	tdma->chip_data = cdata;
+	tdma->desc_pool_size = preallocated_desc ? preallocated_desc :
+					TEGRA_GPCDMA_DEF_DESC_POOL;
+	tdma->sg_pool_size = preallocated_sg ? preallocated_sg :
+					TEGRA_GPCDMA_DEF_SG_POOL;
 	platform_set_drvdata(pdev, tdma);
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -1829,7 +2082,6 @@ static int tegra_dma_probe(struct platform_device *pdev)
 	INIT_LIST_HEAD(&tdma->dma_dev.channels);
 	for (i = 0; i < cdata->nr_channels; i++) {
 		struct tegra_dma_channel *tdc = &tdma->channels[i];
-		int p;
 
 		tdc->chan_base_offset = TEGRA_GPCDMA_CHANNEL_BASE_ADD_OFFSET +
 				start_chan_idx * cdata->channel_reg_size +
@@ -1861,17 +2113,6 @@ static int tegra_dma_probe(struct platform_device *pdev)
 		INIT_LIST_HEAD(&tdc->free_dma_desc);
 		INIT_LIST_HEAD(&tdc->cb_desc);
 
-		/*
-		 * pre-allocate stuff
-		 */
-		for (p = 0; p < preallocated_desc; p++)
-			if (!tegra_dma_desc_alloc(tdc, true))
-				break;
-
-		for (p = 0; p < preallocated_sg; p++)
-			if (!tegra_dma_sg_req_alloc(tdc, true))
-				break;
-
 		/* program stream-id for this channel */
 		tegra_dma_program_sid(tdc, i, stream_id);
 	}
@@ -1930,6 +2171,8 @@ static int tegra_dma_probe(struct platform_device *pdev)
 		goto err_unregister_dma_dev;
 	}
 
+	tegra_dma_debugfs_init(tdma);
+
 	dev_info(&pdev->dev, "GPC DMA driver register %d channels\n",
 			cdata->nr_channels);
 	return 0;
@@ -1951,6 +2194,7 @@ static int tegra_dma_remove(struct platform_device *pdev)
 	int i;
 	struct tegra_dma_channel *tdc;
 
+	tegra_dma_debugfs_remove(tdma);
 	dma_async_device_unregister(&tdma->dma_dev);
 
 	for (i = 0; i < tdma->chip_data->nr_channels; ++i) {
@@ -28,6 +28,7 @@
 #include <linux/keventlib.h>
 
 #include "eventlib.h"
+#include "tracebuf.h"
 
 #define KEVENTLIB_VERSION		"0.2"
 
@@ -68,7 +69,8 @@ static struct eventlib_module {
 	struct list_head providers;
 	atomic_t nr_providers;
 
-	spinlock_t lock;
+	/* writers of events share it, provider list changes take it alone */
+	rwlock_t lock;
 
 	int test_id;
 } ctx;
@@ -104,7 +106,7 @@ static int keventlib_init(struct eventlib_provider_info *info)
 	el_ctx->w2r_shm_size = (uint32_t)info->w2r_size;
 	el_ctx->r2w_shm = NULL;
 	el_ctx->r2w_shm_size = 0;
-	el_ctx->flags = 0;
+	el_ctx->flags = EVENTLIB_FLAG_MULTI_WRITER;
 
 	ret = eventlib_init(el_ctx);
 	if (ret)
@@ -251,6 +253,7 @@ provider_init(struct eventlib_provider_info *info,
 	      const char *schema, size_t schema_size)
 {
 	int ret = 0, id;
+	unsigned long flags;
 
 	info->data = NULL;
 	info->data_size = 0;
@@ -292,7 +295,7 @@ provider_init(struct eventlib_provider_info *info,
 
 	INIT_LIST_HEAD(&info->list);
 
-	spin_lock(&ctx.lock);
+	write_lock_irqsave(&ctx.lock, flags);
 
 	id = get_free_id();
 	if (id < 0) {
@@ -306,12 +309,12 @@ provider_init(struct eventlib_provider_info *info,
 	list_add_tail(&info->list, &ctx.providers);
 	atomic_inc(&ctx.nr_providers);
 
-	spin_unlock(&ctx.lock);
+	write_unlock_irqrestore(&ctx.lock, flags);
 
 	return 0;
 
 err_get_id:
-	spin_unlock(&ctx.lock);
+	write_unlock_irqrestore(&ctx.lock, flags);
 	eventlib_close(&info->el_ctx);
 
 err_sysfs:
@@ -384,21 +387,28 @@ static void free_provider(struct eventlib_provider_info *info)
 static void unregister_all_providers(void)
 {
 	struct eventlib_provider_info *info, *next;
+	unsigned long flags;
 
-	spin_lock(&ctx.lock);
+	write_lock_irqsave(&ctx.lock, flags);
 	list_for_each_entry_safe(info, next, &ctx.providers, list)
 		free_provider(info);
-	spin_unlock(&ctx.lock);
+	write_unlock_irqrestore(&ctx.lock, flags);
 }
 
 int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 {
 	int err = 0;
 	struct eventlib_provider_info *info;
+	unsigned long flags;
 
 	pr_debug("%s: size: %#zx\n", __func__, size);
 
-	spin_lock(&ctx.lock);
+	/*
+	 * Providers are multi-writer, so concurrent writers only share the
+	 * lock. Interrupts stay off so that a writer is never interrupted
+	 * by another one between reserving and committing its event.
+	 */
+	read_lock_irqsave(&ctx.lock, flags);
 
 	info = find_provider_info(id);
 	if (!info) {
@@ -414,11 +424,94 @@ int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 	eventlib_write(&info->el_ctx, 0, type, ts, data, size);
 
 err_out:
-	spin_unlock(&ctx.lock);
+	read_unlock_irqrestore(&ctx.lock, flags);
 	return err;
 }
 EXPORT_SYMBOL(keventlib_write);
 
+size_t keventlib_event_size(size_t size)
+{
+	return sizeof(u64) + sizeof(struct tracehdr) + ALIGN(size, sizeof(u64));
+}
+EXPORT_SYMBOL(keventlib_event_size);
+
+int keventlib_reserve(int id, struct keventlib_batch *batch, size_t size)
+{
+	struct eventlib_provider_info *info;
+	int err;
+
+	BUILD_BUG_ON(sizeof(batch->resv) < sizeof(struct eventlib_resv));
+
+	if (size > U32_MAX)
+		return -EINVAL;
+
+	/* held until keventlib_commit(), see keventlib_write() */
+	read_lock_irqsave(&ctx.lock, batch->flags);
+
+	info = find_provider_info(id);
+	if (!info) {
+		err = -ENOENT;
+		goto err_out;
+	}
+
+	if (!info->data) {
+		err = -ENOMEM;
+		goto err_out;
+	}
+
+	err = eventlib_reserve(&info->el_ctx, 0,
+			       (struct eventlib_resv *)batch->resv, size);
+	if (err)
+		goto err_out;
+
+	batch->provider = info;
+	return 0;
+
+err_out:
+	read_unlock_irqrestore(&ctx.lock, batch->flags);
+	return err;
+}
+EXPORT_SYMBOL(keventlib_reserve);
+
+void *keventlib_reserve_event(struct keventlib_batch *batch, size_t size,
+			      uint32_t type, uint64_t ts)
+{
+	struct eventlib_provider_info *info = batch->provider;
+
+	if (size > U32_MAX)
+		return NULL;
+
+	return eventlib_reserve_event(&info->el_ctx,
+				      (struct eventlib_resv *)batch->resv,
+				      type, ts, size);
+}
+EXPORT_SYMBOL(keventlib_reserve_event);
+
+void keventlib_commit(struct keventlib_batch *batch)
+{
+	struct eventlib_provider_info *info = batch->provider;
+
+	eventlib_commit(&info->el_ctx, (struct eventlib_resv *)batch->resv);
+	read_unlock_irqrestore(&ctx.lock, batch->flags);
+}
+EXPORT_SYMBOL(keventlib_commit);
+
+void *keventlib_reserve_one(int id, struct keventlib_batch *batch,
+			    size_t size, uint32_t type, uint64_t ts)
+{
+	void *payload;
+
+	if (keventlib_reserve(id, batch, keventlib_event_size(size)))
+		return NULL;
+
+	payload = keventlib_reserve_event(batch, size, type, ts);
+	if (!payload)
+		keventlib_commit(batch);
+
+	return payload;
+}
+EXPORT_SYMBOL(keventlib_reserve_one);
+
 int keventlib_register(size_t size, const char *name,
 		       const char *schema, size_t schema_size)
 {
@@ -447,24 +540,25 @@ EXPORT_SYMBOL(keventlib_register);
 void keventlib_unregister(int id)
 {
 	struct eventlib_provider_info *info;
+	unsigned long flags;
 
 	if (!is_initialized) {
 		pr_warn("keventlib is not initialized\n");
 		return;
 	}
 
-	spin_lock(&ctx.lock);
+	write_lock_irqsave(&ctx.lock, flags);
 
 	info = find_provider_info(id);
 	if (!info) {
 		pr_err("Unregistered provider: %d\n", id);
-		spin_unlock(&ctx.lock);
+		write_unlock_irqrestore(&ctx.lock, flags);
 		return;
 	}
 
 	free_provider(info);
 
-	spin_unlock(&ctx.lock);
+	write_unlock_irqrestore(&ctx.lock, flags);
 }
 EXPORT_SYMBOL(keventlib_unregister);
 
@@ -503,7 +597,7 @@ eventlib_module_init(void)
 	atomic_set(&ctx.nr_providers, 0);
 
 	INIT_LIST_HEAD(&ctx.providers);
-	spin_lock_init(&ctx.lock);
+	rwlock_init(&ctx.lock);
 
 	ctx.kobj_root = kobject_create_and_add(EVENTLIB_SYSFS_DIR_NAME,
 					       kernel_kobj);
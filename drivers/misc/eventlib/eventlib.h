@@ -30,6 +30,11 @@
 /* Possible init flags */
 #define EVENTLIB_FLAG_INIT_FILTERING (1 << 0)
 
+/* Writer side only: allow concurrent eventlib_write() calls on the same
+ * trace buffer. Does not change the shared memory format.
+ */
+#define EVENTLIB_FLAG_MULTI_WRITER   (1 << 1)
+
 /* These are used to ensure binary compatibility between library and caller
  * If eventlib_ctx is ever changed in incompatible way, EVENTLIB_CTX_VERSION
  * must be increased.
@@ -152,11 +157,51 @@ void eventlib_close(struct eventlib_ctx *ctx);
  *
  * This operation never fails.
  * Data may be truncated if too large. Old events may get overwritten.
+ * Calls for the same buffer must be serialized by the caller, unless the
+ * context was initialized with EVENTLIB_FLAG_MULTI_WRITER.
  */
 
 void eventlib_write(struct eventlib_ctx *ctx, uint32_t idx,
 	event_type_t type, event_timestamp_t ts, void *data, uint32_t size);
 
+/* Reserve space in a trace buffer for one or more events that are then
+ * serialized in place and published together. To be called on writer side.
+ *
+ * eventlib_reserve() reserves `size` bytes, the sum of eventlib_event_size()
+ * of all events to be added. eventlib_reserve_event() returns where the
+ * payload of the next event goes, eventlib_commit() publishes all of them
+ * with one set of barriers. Every reservation must be committed promptly,
+ * as later writers of the same buffer wait for it to become visible. Calls
+ * must be serialized as for eventlib_write(), from reserve until commit,
+ * unless the context was initialized with EVENTLIB_FLAG_MULTI_WRITER.
+ *
+ * Possible return values of eventlib_reserve():
+ *   0 - ok
+ *   -EPROTO - called on reader side
+ *   -EINVAL - invalid buffer id, or size is zero, unaligned or larger
+ *      than eventlib_event_size() of the largest event
+ *
+ * eventlib_reserve_event() returns NULL if the event does not fit in the
+ * remaining reserved space or is too large to be stored untruncated.
+ */
+
+struct eventlib_resv {
+	/* Private storage space used for internal use; must not be touched */
+	char local_mem[0x40] __aligned(8);
+};
+
+uint32_t eventlib_event_size(struct eventlib_ctx *ctx, uint32_t idx,
+	uint32_t size);
+
+int eventlib_reserve(struct eventlib_ctx *ctx, uint32_t idx,
+	struct eventlib_resv *resv, uint32_t size);
+
+void *eventlib_reserve_event(struct eventlib_ctx *ctx,
+	struct eventlib_resv *resv, event_type_t type, event_timestamp_t ts,
+	uint32_t size);
+
+void eventlib_commit(struct eventlib_ctx *ctx, struct eventlib_resv *resv);
+
 /* Try to extract many events from trace buffer. To be called at reader side.
  * It is not guaranteed that any particular event will be delivered.
  * Delivery order is always preserved with newest events first (LIFO).
@@ -150,7 +150,68 @@ void eventlib_write(struct eventlib_ctx *ctx, uint32_t idx,
 	hdr.params = ts;
 	hdr.reserved = type;
 
-	tracebuf_push(&ctx->priv->tbuf[idx].tbuf_ctx, &hdr, data, size);
+	if (ctx->flags & EVENTLIB_FLAG_MULTI_WRITER)
+		tracebuf_push_mp(&ctx->priv->tbuf[idx].tbuf_ctx,
+			&hdr, data, size);
+	else
+		tracebuf_push(&ctx->priv->tbuf[idx].tbuf_ctx,
+			&hdr, data, size);
+}
+
+struct tbuf_resv {
+	uint32_t idx;
+	struct tracebuf_resv resv;
+};
+
+uint32_t eventlib_event_size(struct eventlib_ctx *ctx, uint32_t idx,
+	uint32_t size)
+{
+	if (idx >= ctx->num_buffers)
+		return 0;
+
+	return tracebuf_event_size(&ctx->priv->tbuf[idx].tbuf_ctx, size);
+}
+
+int eventlib_reserve(struct eventlib_ctx *ctx, uint32_t idx,
+	struct eventlib_resv *resv, uint32_t size)
+{
+	struct tbuf_resv *r = (struct tbuf_resv *)resv->local_mem;
+
+	if (sizeof(resv->local_mem) < sizeof(struct tbuf_resv))
+		return -ENOMEM;
+
+	if (ctx->direction != EVENTLIB_DIRECTION_WRITER)
+		return -EPROTO;
+
+	if (idx >= ctx->num_buffers)
+		return -EINVAL;
+
+	r->idx = idx;
+
+	return tracebuf_reserve(&ctx->priv->tbuf[idx].tbuf_ctx,
+		&r->resv, size);
+}
+
+void *eventlib_reserve_event(struct eventlib_ctx *ctx,
+	struct eventlib_resv *resv, event_type_t type, event_timestamp_t ts,
+	uint32_t size)
+{
+	struct tbuf_resv *r = (struct tbuf_resv *)resv->local_mem;
+	struct tracehdr hdr;
+
+	hdr.params = ts;
+	hdr.length = size;
+	hdr.reserved = type;
+
+	return tracebuf_reserve_event(&ctx->priv->tbuf[r->idx].tbuf_ctx,
+		&r->resv, &hdr, size);
+}
+
+void eventlib_commit(struct eventlib_ctx *ctx, struct eventlib_resv *resv)
+{
+	struct tbuf_resv *r = (struct tbuf_resv *)resv->local_mem;
+
+	tracebuf_commit(&ctx->priv->tbuf[r->idx].tbuf_ctx, &r->resv);
 }
 
 static int tbuf_pull_single(struct eventlib_tbuf_ctx *tbuf,
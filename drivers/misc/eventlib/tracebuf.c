@@ -257,6 +257,218 @@ void tracebuf_push(struct tracectx *ctx, struct tracehdr *hdr,
 #endif
 }
 
+static inline uint32_t event_size(uint32_t paylen)
+{
+	uint32_t padding;
+
+	padding = (MIN_WORD_SIZE - (paylen % MIN_WORD_SIZE)) % MIN_WORD_SIZE;
+
+	return (uint32_t)sizeof(uint64_t) +
+		(uint32_t)sizeof(struct tracehdr) + paylen + padding;
+}
+
+uint32_t tracebuf_event_size(struct tracectx *ctx, uint32_t paylen)
+{
+	if (paylen > ctx->maxsize)
+		paylen = ctx->maxsize;
+
+	return event_size(paylen);
+}
+
+int tracebuf_reserve(struct tracectx *ctx, struct tracebuf_resv *resv,
+	uint32_t size)
+{
+	uint64_t position;
+	uint64_t update;
+	uint64_t start;
+	uint64_t end;
+	bool wrapped;
+
+	if (size == 0 || (size % MIN_WORD_SIZE) != 0)
+		return -EINVAL;
+
+	if (size > event_size(ctx->maxsize))
+		return -EINVAL;
+
+	/*
+	 * Reserve space by advancing the reserve index with a CAS on the
+	 * packed position. Reservations made while earlier ones are still
+	 * being written all lie between valid and reserve in the same wrap.
+	 * A wrap is only taken once every earlier reservation has been
+	 * committed, and nobody reserves behind a pending wrap, so that
+	 * reserve < valid always means "wrap in progress", exactly as in
+	 * the single writer case.
+	 */
+
+	while (1) {
+		position = read64(&ctx->shared->position);
+		start = GET_RESERVE(position);
+
+		if (start < GET_VALID(position))
+			continue;
+
+		wrapped = (start + size) > ctx->length;
+
+		if (wrapped && GET_VALID(position) != start)
+			continue;
+
+		end = wrapped ? size : start + size;
+
+		update = SET_WRAPCNT(GET_WRAPCNT(position) + (wrapped ? 1 : 0))
+			| SET_RESERVE(end)
+			| SET_VALID(GET_VALID(position));
+
+		if (cas64(&ctx->shared->position, position, update))
+			break;
+	}
+
+	resv->start = start;
+	resv->end = end;
+	resv->cursor = end - size;
+	resv->count = 0;
+	resv->wrapped = wrapped;
+
+#ifdef ENABLE_DEBUG_HOOK
+	debug_callback(ctx, "reserved");
+#endif
+
+	return 0;
+}
+
+void *tracebuf_reserve_event(struct tracectx *ctx, struct tracebuf_resv *resv,
+	struct tracehdr *hdr, uint32_t paylen)
+{
+	uint32_t padding;
+	uint32_t offset;
+	uintptr_t addr;
+	void *payload;
+
+	if (paylen > ctx->maxsize)
+		return NULL;
+
+	offset = event_size(paylen);
+	padding = offset - paylen - (uint32_t)sizeof(uint64_t) -
+		(uint32_t)sizeof(struct tracehdr);
+
+	if (resv->end - resv->cursor < offset)
+		return NULL;
+
+	/*
+	 * Events are carved bottom up, so that they end up in the same
+	 * order as separately pushed ones. The sequence ID is filled in
+	 * by tracebuf_commit().
+	 */
+
+	addr = ctx->begin + resv->cursor;
+	payload = (void *)addr;
+
+	addr += paylen;
+	memset((void *)addr, 0, padding);
+
+	addr += padding;
+	hdr->seqid = 0;
+	memcpy((void *)addr, hdr, sizeof(struct tracehdr));
+
+	addr += sizeof(struct tracehdr);
+	*(uint64_t *)addr = offset;
+
+	resv->cursor += offset;
+	resv->count++;
+
+	return payload;
+}
+
+void tracebuf_commit(struct tracectx *ctx, struct tracebuf_resv *resv)
+{
+	uint64_t position;
+	uint64_t update;
+	uint64_t seqid;
+	uint64_t top;
+	uint32_t i;
+	uintptr_t addr;
+
+	/* Space reserved but not carved into events is skipped by readers */
+	if (resv->cursor != resv->end) {
+		addr = ctx->begin + resv->end - sizeof(uint64_t);
+		*(uint64_t *)addr = SET_TOP32(NEXT_DATA_OFF)
+			| SET_LOW32(resv->end - resv->cursor);
+	}
+
+	/*
+	 * Commit in reservation order: wait until every earlier reservation
+	 * has advanced valid up to our start. Sequence IDs are taken here
+	 * so that they increase with position and tracebuf_pull() readers
+	 * see the same stream as with a single writer.
+	 */
+
+	while (GET_VALID(read64(&ctx->shared->position)) != resv->start)
+		read_barrier();
+
+	seqid = read64(&ctx->shared->seqid);
+	write64(&ctx->shared->seqid, seqid + resv->count);
+	resv->seqid = seqid;
+
+	top = resv->cursor;
+	for (i = resv->count; i > 0; i--) {
+		struct tracehdr *hdr;
+
+		addr = ctx->begin + top - sizeof(uint64_t);
+		hdr = (struct tracehdr *)(addr - sizeof(struct tracehdr));
+		hdr->seqid = seqid + i - 1;
+		top -= *(uint64_t *)addr;
+	}
+
+	if (resv->wrapped == true) {
+		addr = ctx->begin + resv->start;
+
+		if (addr < ctx->end) {
+			*((uint64_t *)ctx->end - 1) =
+				SET_TOP32(NEXT_DATA_OFF)
+				| SET_LOW32(ctx->end - addr);
+		}
+	}
+
+#ifdef ENABLE_DEBUG_HOOK
+	debug_callback(ctx, " written");
+#endif
+
+	write_barrier();
+
+	do {
+		position = read64(&ctx->shared->position);
+		update = SET_WRAPCNT(GET_WRAPCNT(position))
+			| SET_RESERVE(GET_RESERVE(position))
+			| SET_VALID(resv->end);
+	} while (!cas64(&ctx->shared->position, position, update));
+
+#ifdef ENABLE_DEBUG_HOOK
+	debug_callback(ctx, "advanced");
+#endif
+}
+
+void tracebuf_push_mp(struct tracectx *ctx, struct tracehdr *hdr,
+	void *payload, uint32_t paylen)
+{
+	struct tracebuf_resv resv;
+	void *addr;
+
+	hdr->length = (uint32_t)paylen;
+
+	if (paylen > ctx->maxsize)
+		paylen = ctx->maxsize;
+
+	if (tracebuf_reserve(ctx, &resv, event_size(paylen)) != 0)
+		return;
+
+	addr = tracebuf_reserve_event(ctx, &resv, hdr, paylen);
+	if (addr != NULL)
+		memcpy(addr, payload, paylen);
+
+	tracebuf_commit(ctx, &resv);
+
+	hdr->seqid = resv.seqid;
+}
+
 int tracebuf_pull(struct tracectx *ctx, struct pullstate *state,
 	struct tracehdr *hdr, void *payload, uint32_t *paylen)
 {
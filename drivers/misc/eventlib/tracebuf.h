@@ -49,6 +49,15 @@ struct tracehdr {
 	uint32_t reserved;
 } __packed;
 
+struct tracebuf_resv {
+	uint64_t start;
+	uint64_t end;
+	uint64_t cursor;
+	uint64_t seqid;
+	uint32_t count;
+	bool     wrapped;
+};
+
 struct pullstate {
 	uint64_t wrapcnt;
 	uint64_t current;
@@ -122,6 +131,93 @@ int tracebuf_bind(struct tracectx *ctx, void *buffer, uint32_t length);
 void tracebuf_push(struct tracectx *ctx, struct tracehdr *hdr,
 	void *payload, uint32_t paylen);
 
+/*
+ * Description for tracebuf_push_mp()
+ *   - Same as tracebuf_push(), but safe to call concurrently from any
+ *     number of writers on the same buffer without external locking.
+ *   - Space is reserved with a compare-and-swap on the shared position
+ *     and payloads are copied in parallel. Messages become visible to
+ *     readers in reservation order, so a writer may briefly wait for
+ *     writers that reserved before it; callers must not be preempted by
+ *     another writer of the same buffer on the same CPU while inside.
+ *   - Must not be mixed with tracebuf_push() on the same buffer. The
+ *     shared memory format is unchanged, so readers need no changes.
+ * Parameters
+ *   - Same as tracebuf_push().
+ * Return values
+ *   - Operation never fails.
+ */
+
+void tracebuf_push_mp(struct tracectx *ctx, struct tracehdr *hdr,
+	void *payload, uint32_t paylen);
+
+/*
+ * Description for tracebuf_event_size()
+ *   - Returns the buffer space taken by one message with a payload of
+ *     `paylen` bytes, after truncation to tracebuf.maxsize. Sums of
+ *     these values are passed to tracebuf_reserve().
+ * Parameters
+ *   - Param `ctx` and `paylen` are provided by the caller.
+ * Return values
+ *   - Operation never fails.
+ */
+
+uint32_t tracebuf_event_size(struct tracectx *ctx, uint32_t paylen);
+
+/*
+ * Description for tracebuf_reserve()
+ *   - Reserve `size` bytes of message space for one or more messages,
+ *     which are then carved out with tracebuf_reserve_event(), filled
+ *     in place and published together with tracebuf_commit().
+ *   - Uses the same lock-free reservation as tracebuf_push_mp() and may
+ *     be mixed with it. Every reservation must be committed promptly;
+ *     later writers wait for it before their messages become visible.
+ *   - A single reservation can hold at most one maximum sized message.
+ * Parameters
+ *   - Param `ctx` and `size` are provided by the caller.
+ *   - Param `resv` is filled by the callee on success.
+ * Return values
+ *   - Returns -EINVAL if `size` is zero, unaligned or too large.
+ *   - Returns 0 on success.
+ */
+
+int tracebuf_reserve(struct tracectx *ctx, struct tracebuf_resv *resv,
+	uint32_t size);
+
+/*
+ * Description for tracebuf_reserve_event()
+ *   - Carve the next message out of a reservation and return a pointer
+ *     to its payload, which the caller fills before tracebuf_commit().
+ *   - The payload is not truncated; messages larger than
+ *     tracebuf.maxsize are refused.
+ * Parameters
+ *   - Param `ctx` and `resv` are provided by the caller.
+ *   - Param `hdr.params`, `hdr.length` and `hdr.reserved` are provided
+ *     by the caller, `hdr.seqid` is filled at commit time.
+ *   - Param `paylen` is provided by the caller.
+ * Return values
+ *   - Returns NULL if the message does not fit in the reservation.
+ *   - Returns the payload address on success.
+ */
+
+void *tracebuf_reserve_event(struct tracectx *ctx, struct tracebuf_resv *resv,
+	struct tracehdr *hdr, uint32_t paylen);
+
+/*
+ * Description for tracebuf_commit()
+ *   - Publish all messages carved out of a reservation to readers, with
+ *     one set of barriers for the whole batch. Unused reserved space is
+ *     skipped by readers.
+ *   - Assigns consecutive sequence IDs to the messages, the first of
+ *     which is stored in `resv.seqid`.
+ * Parameters
+ *   - Param `ctx` and `resv` are provided by the caller.
+ * Return values
+ *   - Operation never fails.
+ */
+
+void tracebuf_commit(struct tracectx *ctx, struct tracebuf_resv *resv);
+
 /*
  * Description for tracebuf_pull()
  *   - Attempt to get a message from the buffer; may fail for many
@@ -125,4 +125,12 @@ static inline uint64_t increment64(volatile uint64_t *addr)
 	return prev;
 }
 
+/* Full barrier compare-and-swap, returns true if *addr was updated */
+static inline bool cas64(volatile uint64_t *addr, uint64_t expected,
+	uint64_t value)
+{
+	assert(((uintptr_t)addr & (sizeof(uint64_t) - 1)) == 0);
+	return __sync_bool_compare_and_swap(addr, expected, value);
+}
+
 #endif
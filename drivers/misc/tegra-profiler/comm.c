@@ -26,11 +26,15 @@
 #include <linux/mm.h>
 #include <linux/circ_buf.h>
 #include <linux/uaccess.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/irq_work.h>
 
 #include <linux/tegra_profiler.h>
 
 #include "comm.h"
 #include "quadd.h"
+#include "hrt.h"
 #include "version.h"
 
 struct quadd_ring_buffer {
@@ -40,7 +44,16 @@ struct quadd_ring_buffer {
 	size_t max_fill_count;
 	size_t nr_skipped_samples;
 
+	/* dropped samples not yet reported by a lost record */
+	u32 nr_lost;
+
+	/* the reader is woken once the fill count reaches the watermark */
+	size_t wakeup_watermark;
+	bool wakeup_pending;
+	struct irq_work wakeup_work;
+
 	struct quadd_mmap_area *mmap;
+	int cpu_id;
 
 	raw_spinlock_t lock;
 };
@@ -60,6 +73,8 @@ struct quadd_comm_ctx {
 
 	struct list_head mmap_areas;
 	raw_spinlock_t mmaps_lock;
+
+	wait_queue_head_t read_wait;
 };
 
 struct comm_cpu_context {
@@ -96,13 +111,56 @@ rb_write(struct quadd_ring_buffer_hdr *rb_hdr,
 	rb_hdr->pos_write = head;
 }
 
+static void
+write_lost_record(struct quadd_ring_buffer *rb,
+		  struct quadd_ring_buffer_hdr *hdr)
+{
+	struct quadd_record_data record;
+	struct quadd_lost_data *s = &record.lost;
+
+	memset(&record, 0, sizeof(record));
+
+	record.record_type = QUADD_RECORD_TYPE_LOST;
+	record.extra_size = 0;
+
+	s->time = quadd_get_time();
+	s->cpu = rb->cpu_id;
+	s->count = rb->nr_lost;
+
+	rb_write(hdr, rb->buf, &record, sizeof(record));
+
+	rb->nr_lost = 0;
+	rb->rb_hdr->reserved[QUADD_RB_HDR_IDX_LOST_RECORDS]++;
+}
+
+static void rb_wakeup_work(struct irq_work *work)
+{
+	wake_up_interruptible(&comm_ctx.read_wait);
+}
+
+/*
+ * Samples are put from scheduler hooks and timer interrupts, where a direct
+ * wake_up() may deadlock on the runqueue lock; defer it to an irq_work.
+ * Only the first crossing of the watermark is signalled, the flag is
+ * rearmed by device_poll().
+ */
+static void
+rb_check_wakeup(struct quadd_ring_buffer *rb, size_t fill_count)
+{
+	if (fill_count < rb->wakeup_watermark || rb->wakeup_pending)
+		return;
+
+	rb->wakeup_pending = true;
+	irq_work_queue(&rb->wakeup_work);
+}
+
 static ssize_t
 write_sample(struct quadd_ring_buffer *rb,
 	     struct quadd_record_data *sample,
 	     const struct quadd_iovec *vec, int vec_count)
 {
 	int i;
-	size_t len = 0, c;
+	size_t len = 0, need, c;
 	struct quadd_ring_buffer_hdr hdr, *rb_hdr = rb->rb_hdr;
 
 	if (!rb_hdr)
@@ -116,16 +174,25 @@ write_sample(struct quadd_ring_buffer *rb,
 	sample->extra_size = len;
 	len += sizeof(*sample);
 
+	/* pending drops are reported right before the next sample */
+	need = len;
+	if (rb->nr_lost)
+		need += sizeof(struct quadd_record_data);
+
 	hdr.size = rb_hdr->size;
 	hdr.pos_write = rb_hdr->pos_write;
 	hdr.pos_read = READ_ONCE(rb_hdr->pos_read);
 
 	c = CIRC_SPACE(hdr.pos_write, hdr.pos_read, hdr.size);
-	if (len > c) {
-		pr_err_once("[cpu: %d] warning: buffer has been overflowed\n",
-			    smp_processor_id());
+	if (need > c)
 		return -ENOSPC;
-	}
+
+	/*
+	 * The space is reserved for the whole record, the header and the
+	 * producer's iovecs are copied straight into the mmapped ring.
+	 */
+	if (rb->nr_lost)
+		write_lost_record(rb, &hdr);
 
 	rb_write(&hdr, rb->buf, sample, sizeof(*sample));
 
@@ -145,6 +212,8 @@ write_sample(struct quadd_ring_buffer *rb,
 	 */
 	smp_store_release(&rb_hdr->pos_write, hdr.pos_write);
 
+	rb_check_wakeup(rb, c);
+
 	return len;
 }
 
@@ -200,12 +269,15 @@ put_sample(struct quadd_record_data *data,
 
 	err = write_sample(rb, data, vec, vec_count);
 	if (err < 0) {
-		pr_err_once("%s: error: write sample\n", __func__);
 		rb->nr_skipped_samples++;
 
 		rb_hdr = rb->rb_hdr;
-		if (rb_hdr)
+		if (rb_hdr) {
 			rb_hdr->skipped_samples++;
+
+			if (rb->nr_lost < U32_MAX)
+				rb->nr_lost++;
+		}
 	}
 
 	raw_spin_unlock_irqrestore(&rb->lock, flags);
@@ -273,8 +345,9 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 	      struct quadd_mmap_area *mmap)
 {
 	unsigned int cpu_id;
-	size_t size;
+	size_t size, watermark;
 	unsigned long flags;
+	bool resize = false;
 	struct vm_area_struct *vma;
 	struct quadd_ring_buffer *rb;
 	struct quadd_ring_buffer_hdr *rb_hdr;
@@ -301,15 +374,36 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 
 	size -= PAGE_SIZE;
 
+	watermark = mmap_rb->reserved[QUADD_MMAP_RB_IDX_WAKEUP_WATERMARK];
+	if (watermark == 0 || watermark >= size)
+		watermark = size / 2;
+
 	raw_spin_lock_irqsave(&rb->lock, flags);
 
+	/*
+	 * The daemon may hand over a new area while the session is running
+	 * (e.g. to grow the buffer). The old one is marked as stopped so that
+	 * it is drained by the reader, the counters and pending drops carry
+	 * over to the new area.
+	 */
+	if (rb->rb_hdr && rb->mmap != mmap) {
+		rb->rb_hdr->state = QUADD_RB_STATE_STOPPED;
+		resize = true;
+	}
+
 	mmap->rb = rb;
 
 	rb->mmap = mmap;
 	rb->buf = (char *)mmap->data + PAGE_SIZE;
 
-	rb->max_fill_count = 0;
-	rb->nr_skipped_samples = 0;
+	if (!resize) {
+		rb->max_fill_count = 0;
+		rb->nr_skipped_samples = 0;
+		rb->nr_lost = 0;
+	}
+
+	rb->wakeup_watermark = watermark;
+	rb->wakeup_pending = false;
 
 	mmap_hdr = mmap->data;
 
@@ -328,10 +422,19 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 	rb_hdr->max_fill_count = 0;
 	rb_hdr->skipped_samples = 0;
 
+	rb_hdr->reserved[QUADD_RB_HDR_IDX_WAKEUP_WATERMARK] = watermark;
+	rb_hdr->reserved[QUADD_RB_HDR_IDX_LOST_RECORDS] = 0;
+
 	rb_hdr->state = QUADD_RB_STATE_ACTIVE;
 
 	raw_spin_unlock_irqrestore(&rb->lock, flags);
 
+	if (resize) {
+		pr_info("[cpu: %d] ring buffer has been resized: %zu\n",
+			cpu_id, size);
+		wake_up_interruptible(&comm_ctx.read_wait);
+	}
+
 	pr_debug("[cpu: %d] init_mmap_hdr: vma: %#lx - %#lx, data: %p - %p\n",
 		 cpu_id,
 		 vma->vm_start, vma->vm_end,
@@ -343,38 +446,65 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 static void rb_stop(void)
 {
 	int cpu_id;
+	unsigned long flags;
 	struct quadd_ring_buffer *rb;
-	struct quadd_ring_buffer_hdr *rb_hdr;
+	struct quadd_ring_buffer_hdr hdr, *rb_hdr;
 	struct comm_cpu_context *cc;
 
 	for_each_possible_cpu(cpu_id) {
 		cc = &per_cpu(cpu_ctx, cpu_id);
 
 		rb = &cc->rb;
-		rb_hdr = rb->rb_hdr;
 
-		if (!rb_hdr)
+		raw_spin_lock_irqsave(&rb->lock, flags);
+
+		rb_hdr = rb->rb_hdr;
+		if (!rb_hdr) {
+			raw_spin_unlock_irqrestore(&rb->lock, flags);
 			continue;
+		}
+
+		/* report the drops of the tail of the session if possible */
+		if (rb->nr_lost) {
+			hdr.size = rb_hdr->size;
+			hdr.pos_write = rb_hdr->pos_write;
+			hdr.pos_read = READ_ONCE(rb_hdr->pos_read);
+
+			if (CIRC_SPACE(hdr.pos_write, hdr.pos_read, hdr.size) >=
+			    sizeof(struct quadd_record_data)) {
+				write_lost_record(rb, &hdr);
+				smp_store_release(&rb_hdr->pos_write,
+						  hdr.pos_write);
+			}
+		}
 
 		pr_info("[%d] skipped samples/max filling: %zu/%zu\n",
 			cpu_id, rb->nr_skipped_samples, rb->max_fill_count);
 
 		rb_hdr->state = QUADD_RB_STATE_STOPPED;
+
+		raw_spin_unlock_irqrestore(&rb->lock, flags);
 	}
+
+	wake_up_interruptible(&comm_ctx.read_wait);
 }
 
-static void rb_reset(struct quadd_ring_buffer *rb)
+static void rb_reset(struct quadd_mmap_area *mmap)
 {
 	unsigned long flags;
+	struct quadd_ring_buffer *rb = mmap->rb;
 
 	if (!rb)
 		return;
 
 	raw_spin_lock_irqsave(&rb->lock, flags);
 
-	rb->mmap = NULL;
-	rb->buf = NULL;
-	rb->rb_hdr = NULL;
+	/* the area might have been replaced by a resize */
+	if (rb->mmap == mmap) {
+		rb->mmap = NULL;
+		rb->buf = NULL;
+		rb->rb_hdr = NULL;
+	}
 
 	raw_spin_unlock_irqrestore(&rb->lock, flags);
 }
@@ -768,7 +898,7 @@ static void mmap_close(struct vm_area_struct *vma)
 	if (mmap->type == QUADD_MMAP_TYPE_EXTABS)
 		comm_ctx.control->delete_mmap(mmap);
 	else if (mmap->type == QUADD_MMAP_TYPE_RB)
-		rb_reset(mmap->rb);
+		rb_reset(mmap);
 	else
 		pr_warn("warning: mmap area is uninitialized\n");
 
@@ -870,6 +1000,43 @@ device_mmap(struct file *filp, struct vm_area_struct *vma)
 	return 0;
 }
 
+static unsigned int
+device_poll(struct file *file, poll_table *wait)
+{
+	int cpu_id;
+	size_t fill_count;
+	unsigned long flags;
+	unsigned int mask = 0;
+	struct quadd_ring_buffer *rb;
+	struct quadd_ring_buffer_hdr *rb_hdr;
+
+	poll_wait(file, &comm_ctx.read_wait, wait);
+
+	for_each_possible_cpu(cpu_id) {
+		rb = &per_cpu(cpu_ctx, cpu_id).rb;
+
+		raw_spin_lock_irqsave(&rb->lock, flags);
+
+		rb_hdr = rb->rb_hdr;
+		if (rb_hdr) {
+			rb->wakeup_pending = false;
+
+			fill_count = CIRC_CNT(rb_hdr->pos_write,
+					      READ_ONCE(rb_hdr->pos_read),
+					      rb_hdr->size);
+
+			if (fill_count >= rb->wakeup_watermark ||
+			    (fill_count > 0 &&
+			     rb_hdr->state != QUADD_RB_STATE_ACTIVE))
+				mask |= POLLIN | POLLRDNORM;
+		}
+
+		raw_spin_unlock_irqrestore(&rb->lock, flags);
+	}
+
+	return mask;
+}
+
 static void unregister(void)
 {
 	misc_deregister(comm_ctx.misc_dev);
@@ -882,6 +1049,7 @@ static const struct file_operations qm_fops = {
 	.unlocked_ioctl	= device_ioctl,
 	.compat_ioctl	= device_ioctl,
 	.mmap		= device_mmap,
+	.poll		= device_poll,
 };
 
 static int comm_init(void)
@@ -913,6 +1081,8 @@ static int comm_init(void)
 	INIT_LIST_HEAD(&comm_ctx.mmap_areas);
 	raw_spin_lock_init(&comm_ctx.mmaps_lock);
 
+	init_waitqueue_head(&comm_ctx.read_wait);
+
 	for_each_possible_cpu(cpu_id) {
 		struct comm_cpu_context *cc = &per_cpu(cpu_ctx, cpu_id);
 		struct quadd_ring_buffer *rb = &cc->rb;
@@ -923,6 +1093,12 @@ static int comm_init(void)
 
 		rb->max_fill_count = 0;
 		rb->nr_skipped_samples = 0;
+		rb->nr_lost = 0;
+
+		rb->cpu_id = cpu_id;
+		rb->wakeup_watermark = 0;
+		rb->wakeup_pending = false;
+		init_irq_work(&rb->wakeup_work, rb_wakeup_work);
 
 		raw_spin_lock_init(&rb->lock);
 	}
@@ -950,7 +1126,12 @@ quadd_comm_events_init(struct quadd_ctx *ctx,
 
 void quadd_comm_events_exit(void)
 {
+	int cpu_id;
+
 	mutex_lock(&comm_ctx.io_mutex);
 	unregister();
 	mutex_unlock(&comm_ctx.io_mutex);
+
+	for_each_possible_cpu(cpu_id)
+		irq_work_sync(&per_cpu(cpu_ctx, cpu_id).rb.wakeup_work);
 }
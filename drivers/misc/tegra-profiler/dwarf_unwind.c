@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/err.h>
+#include <linux/percpu.h>
 
 #include <asm/unaligned.h>
 
@@ -111,6 +112,41 @@ struct regs_state {
 
 #define DW_MAX_RS_STACK_DEPTH	8
 
+#define DW_UNW_CACHE_SIZE	16
+
+#define DW_UNW_CACHE_FDE_EH	(1 << 0)
+#define DW_UNW_CACHE_FDE_DEBUG	(1 << 1)
+
+/*
+ * Recently resolved frames: the rules are only valid for the region
+ * generation they were decoded in, since expressions point into the
+ * mmapped tables.
+ */
+struct dw_unw_cache_entry {
+	unsigned long vm_start;
+	unsigned long pc;
+
+	unsigned int gen;
+	unsigned int stamp;
+
+	u8 valid;
+	u8 mode;
+	u8 fde_mask;
+	s8 rs_is_eh;		/* table of the cached rules, -1 if none */
+
+	struct regs_state rs;
+};
+
+struct dw_unw_cache {
+	struct dw_unw_cache_entry entries[DW_UNW_CACHE_SIZE];
+	unsigned int stamp;
+};
+
+struct dw_unw_cache_stats {
+	u64 hits;
+	u64 misses;
+};
+
 struct stackframe {
 	unsigned long pc;
 	unsigned long vregs[QUADD_NUM_REGS];
@@ -130,6 +166,8 @@ struct dwarf_cpu_context {
 
 	struct stackframe sf;
 	int dw_ptr_size;
+
+	struct dw_unw_cache cache;
 };
 
 struct quadd_dwarf_context {
@@ -183,6 +221,8 @@ struct eh_sec_data {
 
 static struct quadd_dwarf_context ctx;
 
+static DEFINE_PER_CPU(struct dw_unw_cache_stats, unw_cache_stats);
+
 static inline int regnum_sp(int mode)
 {
 	return (mode == DW_MODE_ARM32) ?
@@ -1645,9 +1685,11 @@ dwarf_find_fde(struct ex_region_info *ri,
 		if (pc == init_loc)
 			return (void *)fde_addr;
 
-		if (ti->tf_end > 0) {
+		/* pairs with smp_wmb() in quadd_unwind_set_tail_info() */
+		end = READ_ONCE(ti->tf_end);
+		if (end > 0) {
+			smp_rmb();
 			start = ti->tf_start;
-			end = ti->tf_end;
 		} else {
 			struct dw_cie cie;
 			struct dw_fde fde;
@@ -1794,21 +1836,79 @@ static long def_cfa(struct stackframe *sf, struct regs_state *rs)
 	return 0;
 }
 
+static struct dw_unw_cache_entry *
+unw_cache_lookup(struct dw_unw_cache *cache,
+		 struct ex_region_info *ri,
+		 unsigned long pc, int mode)
+{
+	int i;
+	struct dw_unw_cache_entry *ce;
+	unsigned int gen = quadd_unwind_get_gen();
+
+	for (i = 0; i < DW_UNW_CACHE_SIZE; i++) {
+		ce = &cache->entries[i];
+
+		if (ce->valid && ce->pc == pc &&
+		    ce->vm_start == ri->vm_start &&
+		    ce->gen == gen && ce->mode == mode) {
+			ce->stamp = ++cache->stamp;
+			return ce;
+		}
+	}
+
+	return NULL;
+}
+
+static struct dw_unw_cache_entry *
+unw_cache_insert(struct dw_unw_cache *cache,
+		 struct ex_region_info *ri,
+		 unsigned long pc, int mode,
+		 int is_eh, int is_debug)
+{
+	int i;
+	unsigned int age, max_age = 0;
+	struct dw_unw_cache_entry *ce, *victim = &cache->entries[0];
+
+	for (i = 0; i < DW_UNW_CACHE_SIZE; i++) {
+		ce = &cache->entries[i];
+
+		if (!ce->valid) {
+			victim = ce;
+			break;
+		}
+
+		age = cache->stamp - ce->stamp;
+		if (age > max_age) {
+			max_age = age;
+			victim = ce;
+		}
+	}
+
+	victim->vm_start = ri->vm_start;
+	victim->pc = pc;
+	victim->gen = quadd_unwind_get_gen();
+	victim->stamp = ++cache->stamp;
+
+	victim->mode = mode;
+	victim->fde_mask = (is_eh ? DW_UNW_CACHE_FDE_EH : 0) |
+			   (is_debug ? DW_UNW_CACHE_FDE_DEBUG : 0);
+	victim->rs_is_eh = -1;
+	victim->valid = 1;
+
+	return victim;
+}
+
 static long
-unwind_frame(struct ex_region_info *ri,
-	     struct stackframe *sf,
-	     struct vm_area_struct *vma_sp,
-	     int is_eh)
+dwarf_get_rules(struct ex_region_info *ri,
+		struct stackframe *sf,
+		int is_eh)
 {
-	int i, num_regs;
 	long err;
 	unsigned char *insn_end;
-	unsigned long addr, return_addr, val, user_reg_size;
 	struct dw_fde fde;
 	struct dw_cie cie;
 	unsigned long pc = sf->pc;
 	struct regs_state *rs, *rs_initial;
-	int mode = sf->mode;
 
 	err = dwarf_decode(ri, sf, &cie, &fde, pc, is_eh);
 	if (err < 0)
@@ -1822,7 +1922,7 @@ unwind_frame(struct ex_region_info *ri,
 	rs->cfa_register = -1;
 	rs_initial->cfa_register = -1;
 
-	rules_cleanup(rs, mode);
+	rules_cleanup(rs, sf->mode);
 
 	if (cie.initial_insn) {
 		insn_end = cie.initial_insn + cie.initial_insn_len;
@@ -1842,6 +1942,39 @@ unwind_frame(struct ex_region_info *ri,
 			return err;
 	}
 
+	return 0;
+}
+
+static long
+unwind_frame(struct ex_region_info *ri,
+	     struct stackframe *sf,
+	     struct vm_area_struct *vma_sp,
+	     struct dw_unw_cache_entry *ce,
+	     int is_eh)
+{
+	int i, num_regs;
+	long err;
+	unsigned long addr, return_addr, val, user_reg_size;
+	unsigned long pc = sf->pc;
+	struct regs_state *rs = &sf->rs;
+	int mode = sf->mode;
+
+	if (ce && ce->rs_is_eh == is_eh) {
+		memcpy(rs, &ce->rs, sizeof(*rs));
+		__this_cpu_inc(unw_cache_stats.hits);
+	} else {
+		err = dwarf_get_rules(ri, sf, is_eh);
+		if (err < 0)
+			return err;
+
+		__this_cpu_inc(unw_cache_stats.misses);
+
+		if (ce) {
+			memcpy(&ce->rs, rs, sizeof(*rs));
+			ce->rs_is_eh = is_eh;
+		}
+	}
+
 	pr_debug("mode: %s\n", (mode == DW_MODE_ARM32) ? "arm32" : "arm64");
 	pr_debug("initial cfa: %#lx\n", sf->cfa);
 
@@ -1948,6 +2081,8 @@ unwind_backtrace(struct quadd_callchain *cc,
 	struct ex_region_info ri_new, *prev_ri = NULL;
 	unsigned int unw_type;
 	int is_eh = 1, mode = sf->mode;
+	struct dw_unw_cache_entry *ce;
+	struct dwarf_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
 
 	cc->urc_dwarf = QUADD_URC_FAILURE;
 	user_reg_size = get_user_reg_size(mode);
@@ -1994,10 +2129,20 @@ unwind_backtrace(struct quadd_callchain *cc,
 			prev_ri = ri = &ri_new;
 		}
 
-		if (!is_fde_entry_exist(ri, sf->pc, &__is_eh, &__is_debug)) {
-			pr_debug("eh/debug fde entries are not existed\n");
-			cc->urc_dwarf = QUADD_URC_IDX_NOT_FOUND;
-			break;
+		ce = unw_cache_lookup(&cpu_ctx->cache, ri, sf->pc, mode);
+		if (ce) {
+			__is_eh = ce->fde_mask & DW_UNW_CACHE_FDE_EH;
+			__is_debug = ce->fde_mask & DW_UNW_CACHE_FDE_DEBUG;
+		} else {
+			if (!is_fde_entry_exist(ri, sf->pc,
+						&__is_eh, &__is_debug)) {
+				pr_debug("eh/debug fde entries are not existed\n");
+				cc->urc_dwarf = QUADD_URC_IDX_NOT_FOUND;
+				break;
+			}
+
+			ce = unw_cache_insert(&cpu_ctx->cache, ri, sf->pc,
+					      mode, __is_eh, __is_debug);
 		}
 		pr_debug("is_eh: %d, is_debug: %d\n", __is_eh, __is_debug);
 
@@ -2009,12 +2154,12 @@ unwind_backtrace(struct quadd_callchain *cc,
 				is_eh = 1;
 		}
 
-		err = unwind_frame(ri, sf, vma_sp, is_eh);
+		err = unwind_frame(ri, sf, vma_sp, ce, is_eh);
 		if (err < 0) {
 			if (__is_eh && __is_debug) {
 				is_eh ^= 1;
 
-				err = unwind_frame(ri, sf, vma_sp, is_eh);
+				err = unwind_frame(ri, sf, vma_sp, ce, is_eh);
 				if (err < 0) {
 					cc->urc_dwarf = -err;
 					break;
@@ -2188,12 +2333,18 @@ quadd_get_user_cc_dwarf(struct quadd_event_context *event_ctx,
 
 int quadd_dwarf_unwind_start(void)
 {
+	int cpu_id;
+
 	if (!atomic_cmpxchg(&ctx.started, 0, 1)) {
 		ctx.cpu_ctx = alloc_percpu(struct dwarf_cpu_context);
 		if (!ctx.cpu_ctx) {
 			atomic_set(&ctx.started, 0);
 			return -ENOMEM;
 		}
+
+		for_each_possible_cpu(cpu_id)
+			memset(per_cpu_ptr(&unw_cache_stats, cpu_id), 0,
+			       sizeof(struct dw_unw_cache_stats));
 	}
 
 	return 0;
@@ -2205,6 +2356,22 @@ void quadd_dwarf_unwind_stop(void)
 		free_percpu(ctx.cpu_ctx);
 }
 
+void quadd_dwarf_unwind_get_cache_stats(u64 *hits, u64 *misses)
+{
+	int cpu_id;
+	struct dw_unw_cache_stats *stats;
+
+	*hits = 0;
+	*misses = 0;
+
+	for_each_possible_cpu(cpu_id) {
+		stats = per_cpu_ptr(&unw_cache_stats, cpu_id);
+
+		*hits += stats->hits;
+		*misses += stats->misses;
+	}
+}
+
 int quadd_dwarf_unwind_init(void)
 {
 	atomic_set(&ctx.started, 0);
@@ -17,6 +17,8 @@
 #ifndef __QUADD_DWARF_UNWIND_H
 #define __QUADD_DWARF_UNWIND_H
 
+#include <linux/types.h>
+
 struct quadd_callchain;
 struct quadd_event_context;
 
@@ -32,4 +34,6 @@ int quadd_dwarf_unwind_start(void);
 void quadd_dwarf_unwind_stop(void);
 int quadd_dwarf_unwind_init(void);
 
+void quadd_dwarf_unwind_get_cache_stats(u64 *hits, u64 *misses);
+
 #endif  /* __QUADD_DWARF_UNWIND_H */
@@ -47,8 +47,13 @@ enum regs {
 	PC = 15
 };
 
+/*
+ * The table only holds pointers to the per-mmap region entries, so adding
+ * or removing a region copies a pointer array and the entries themselves
+ * are never duplicated. Entries are freed after a grace period.
+ */
 struct regions_data {
-	struct ex_region_info *entries;
+	struct ex_region_info **entries;
 
 	unsigned long curr_nr;
 	unsigned long size;
@@ -62,6 +67,9 @@ struct quadd_unwind_ctx {
 	pid_t pid;
 	unsigned long ex_tables_size;
 	raw_spinlock_t lock;
+
+	/* incremented each time regions are removed from the table */
+	atomic_t gen;
 };
 
 struct unwind_idx {
@@ -212,48 +220,48 @@ add_ex_region(struct regions_data *rd,
 	      struct ex_region_info *new_entry)
 {
 	unsigned int i_min, i_max, mid;
-	struct ex_region_info *array = rd->entries;
+	struct ex_region_info **array = rd->entries;
 	unsigned long size = rd->curr_nr;
 
 	if (!array)
 		return 0;
 
 	if (size == 0) {
-		memcpy(&array[0], new_entry, sizeof(*new_entry));
+		array[0] = new_entry;
 		return 1;
-	} else if (size == 1 && array[0].vm_start == new_entry->vm_start) {
+	} else if (size == 1 && array[0]->vm_start == new_entry->vm_start) {
 		return 0;
 	}
 
 	i_min = 0;
 	i_max = size;
 
-	if (array[0].vm_start > new_entry->vm_start) {
+	if (array[0]->vm_start > new_entry->vm_start) {
 		memmove(array + 1, array,
 			size * sizeof(*array));
-		memcpy(&array[0], new_entry, sizeof(*new_entry));
+		array[0] = new_entry;
 		return 1;
-	} else if (array[size - 1].vm_start < new_entry->vm_start) {
-		memcpy(&array[size], new_entry, sizeof(*new_entry));
+	} else if (array[size - 1]->vm_start < new_entry->vm_start) {
+		array[size] = new_entry;
 		return 1;
 	}
 
 	while (i_min < i_max) {
 		mid = i_min + (i_max - i_min) / 2;
 
-		if (new_entry->vm_start <= array[mid].vm_start)
+		if (new_entry->vm_start <= array[mid]->vm_start)
 			i_max = mid;
 		else
 			i_min = mid + 1;
 	}
 
-	if (array[i_max].vm_start == new_entry->vm_start)
+	if (array[i_max]->vm_start == new_entry->vm_start)
 		return 0;
 
 	memmove(array + i_max + 1,
 		array + i_max,
 		(size - i_max) * sizeof(*array));
-	memcpy(&array[i_max], new_entry, sizeof(*new_entry));
+	array[i_max] = new_entry;
 	return 1;
 }
 
@@ -262,7 +270,7 @@ remove_ex_region(struct regions_data *rd,
 		 struct ex_region_info *entry)
 {
 	unsigned int i_min, i_max, mid;
-	struct ex_region_info *array = rd->entries;
+	struct ex_region_info **array = rd->entries;
 	unsigned long size = rd->curr_nr;
 
 	if (!array)
@@ -272,15 +280,15 @@ remove_ex_region(struct regions_data *rd,
 		return 0;
 
 	if (size == 1) {
-		if (array[0].vm_start == entry->vm_start)
+		if (array[0]->vm_start == entry->vm_start)
 			return 1;
 		else
 			return 0;
 	}
 
-	if (array[0].vm_start > entry->vm_start)
+	if (array[0]->vm_start > entry->vm_start)
 		return 0;
-	else if (array[size - 1].vm_start < entry->vm_start)
+	else if (array[size - 1]->vm_start < entry->vm_start)
 		return 0;
 
 	i_min = 0;
@@ -289,16 +297,16 @@ remove_ex_region(struct regions_data *rd,
 	while (i_min < i_max) {
 		mid = i_min + (i_max - i_min) / 2;
 
-		if (entry->vm_start <= array[mid].vm_start)
+		if (entry->vm_start <= array[mid]->vm_start)
 			i_max = mid;
 		else
 			i_min = mid + 1;
 	}
 
-	if (array[i_max].vm_start == entry->vm_start) {
+	if (array[i_max]->vm_start == entry->vm_start) {
 		memmove(array + i_max,
 			array + i_max + 1,
-			(size - i_max) * sizeof(*array));
+			(size - i_max - 1) * sizeof(*array));
 		return 1;
 	} else {
 		return 0;
@@ -306,7 +314,7 @@ remove_ex_region(struct regions_data *rd,
 }
 
 static struct ex_region_info *
-__search_ex_region(struct ex_region_info *array,
+__search_ex_region(struct ex_region_info **array,
 		   unsigned long size,
 		   unsigned long key)
 {
@@ -321,23 +329,56 @@ __search_ex_region(struct ex_region_info *array,
 	while (i_min < i_max) {
 		mid = i_min + (i_max - i_min) / 2;
 
-		if (key <= array[mid].vm_start)
+		if (key <= array[mid]->vm_start)
 			i_max = mid;
 		else
 			i_min = mid + 1;
 	}
 
-	if (array[i_max].vm_start == key)
-		return &array[i_max];
+	if (i_max < size && array[i_max]->vm_start == key)
+		return array[i_max];
 
 	return NULL;
 }
 
+static void mmap_put(struct quadd_mmap_area *mmap)
+{
+	int ref_count = atomic_dec_return(&mmap->ref_count);
+
+	if (ref_count == 0 &&
+	    atomic_read(&mmap->state) == QUADD_MMAP_STATE_CLOSING)
+		atomic_cmpxchg(&mmap->state, QUADD_MMAP_STATE_CLOSING,
+			       QUADD_MMAP_STATE_CLOSED);
+
+	if (ref_count < 0)
+		pr_err_once("%s: error: mmap ref_count\n", __func__);
+}
+
+/*
+ * Lockless counterpart of mmap_wait_for_close(): the reference is taken
+ * before the state is checked, while the closer publishes the state before
+ * it checks the references, so at least one side sees the other.
+ */
+static long mmap_get(struct quadd_mmap_area *mmap)
+{
+	atomic_inc(&mmap->ref_count);
+	smp_mb__after_atomic();
+
+	if (atomic_read(&mmap->state) != QUADD_MMAP_STATE_ACTIVE) {
+		mmap_put(mmap);
+		return -ENOENT;
+	}
+
+	return 0;
+}
+
+/* looks up the region and pins its mmap area on success */
 static long
-search_ex_region(unsigned long key, struct ex_region_info *ri)
+get_ex_region(unsigned long key, struct ex_region_info *ri)
 {
+	long err = -ENOENT;
 	struct regions_data *rd;
-	struct ex_region_info *ri_p = NULL;
+	struct ex_region_info *ri_p;
 
 	rcu_read_lock();
 
@@ -346,117 +387,76 @@ search_ex_region(unsigned long key, struct ex_region_info *ri)
 		goto out;
 
 	ri_p = __search_ex_region(rd->entries, rd->curr_nr, key);
-	if (ri_p)
-		memcpy(ri, ri_p, sizeof(*ri));
+	if (!ri_p)
+		goto out;
+
+	memcpy(ri, ri_p, sizeof(*ri));
+	err = mmap_get(ri->mmap);
 
 out:
 	rcu_read_unlock();
-	return ri_p ? 0 : -ENOENT;
+	return err;
 }
 
 static long
 get_extabs_ehabi(unsigned long key, struct ex_region_info *ri)
 {
-	long err = 0;
+	long err;
 	struct extab_info *ti_exidx;
-	struct quadd_mmap_area *mmap;
 
-	err = search_ex_region(key, ri);
+	err = get_ex_region(key, ri);
 	if (err < 0)
 		return err;
 
-	mmap = ri->mmap;
-
-	raw_spin_lock(&mmap->state_lock);
-
-	if (atomic_read(&mmap->state) != QUADD_MMAP_STATE_ACTIVE) {
-		err = -ENOENT;
-		goto out;
-	}
-
 	ti_exidx = &ri->ex_sec[QUADD_SEC_TYPE_EXIDX];
 
-	if (ti_exidx->length)
-		atomic_inc(&mmap->ref_count);
-	else
-		err = -ENOENT;
+	if (!ti_exidx->length) {
+		mmap_put(ri->mmap);
+		return -ENOENT;
+	}
 
-out:
-	raw_spin_unlock(&mmap->state_lock);
-	return err;
+	return 0;
 }
 
 static void put_extabs_ehabi(struct ex_region_info *ri)
 {
-	struct quadd_mmap_area *mmap = ri->mmap;
-
-	raw_spin_lock(&mmap->state_lock);
-
-	if (atomic_dec_and_test(&mmap->ref_count) &&
-	    atomic_read(&mmap->state) == QUADD_MMAP_STATE_CLOSING)
-		atomic_set(&mmap->state, QUADD_MMAP_STATE_CLOSED);
-
-	raw_spin_unlock(&mmap->state_lock);
-
-	if (atomic_read(&mmap->ref_count) < 0)
-		pr_err_once("%s: error: mmap ref_count\n", __func__);
+	mmap_put(ri->mmap);
 }
 
 long
 quadd_get_dw_frames(unsigned long key, struct ex_region_info *ri)
 {
-	long err = 0;
+	long err;
 	struct extab_info *ti, *ti_hdr;
-	struct quadd_mmap_area *mmap;
 
-	err = search_ex_region(key, ri);
+	err = get_ex_region(key, ri);
 	if (err < 0)
 		return err;
 
-	mmap = ri->mmap;
-
-	raw_spin_lock(&mmap->state_lock);
-
-	if (atomic_read(&mmap->state) != QUADD_MMAP_STATE_ACTIVE) {
-		err = -ENOENT;
-		goto out;
-	}
-
 	ti = &ri->ex_sec[QUADD_SEC_TYPE_EH_FRAME];
 	ti_hdr = &ri->ex_sec[QUADD_SEC_TYPE_EH_FRAME_HDR];
 
-	if (ti->length && ti_hdr->length) {
-		atomic_inc(&mmap->ref_count);
-		goto out;
-	}
+	if (ti->length && ti_hdr->length)
+		return 0;
 
 	ti = &ri->ex_sec[QUADD_SEC_TYPE_DEBUG_FRAME];
 	ti_hdr = &ri->ex_sec[QUADD_SEC_TYPE_DEBUG_FRAME_HDR];
 
 	if (ti->length && ti_hdr->length)
-		atomic_inc(&mmap->ref_count);
-	else
-		err = -ENOENT;
+		return 0;
 
-out:
-	raw_spin_unlock(&mmap->state_lock);
-	return err;
+	mmap_put(ri->mmap);
+	return -ENOENT;
 }
 
 void quadd_put_dw_frames(struct ex_region_info *ri)
 {
-	struct quadd_mmap_area *mmap = ri->mmap;
-
-	raw_spin_lock(&mmap->state_lock);
-
-	if (atomic_dec_and_test(&mmap->ref_count) &&
-	    atomic_read(&mmap->state) == QUADD_MMAP_STATE_CLOSING)
-		atomic_set(&mmap->state, QUADD_MMAP_STATE_CLOSED);
-
-	raw_spin_unlock(&mmap->state_lock);
+	mmap_put(ri->mmap);
+}
 
-	if (atomic_read(&mmap->ref_count) < 0)
-		pr_err_once("%s: error: mmap ref_count\n", __func__);
+unsigned int quadd_unwind_get_gen(void)
+{
+	return atomic_read(&ctx.gen);
 }
 
 static struct regions_data *rd_alloc(unsigned long size)
@@ -499,7 +499,6 @@ int quadd_unwind_set_extab(struct quadd_sections *extabs,
 {
 	int i, err = 0;
 	unsigned long nr_entries, nr_added, new_size;
-	struct ex_region_info ri_entry;
 	struct extab_info *ti;
 	struct regions_data *rd, *rd_new;
 	struct ex_region_info *ex_entry;
@@ -507,6 +506,10 @@ int quadd_unwind_set_extab(struct quadd_sections *extabs,
 	if (mmap->type != QUADD_MMAP_TYPE_EXTABS)
 		return -EIO;
 
+	ex_entry = kzalloc(sizeof(*ex_entry), GFP_ATOMIC);
+	if (!ex_entry)
+		return -ENOMEM;
+
 	raw_spin_lock(&ctx.lock);
 
 	rd = rcu_dereference(ctx.rd);
@@ -535,15 +538,15 @@ int quadd_unwind_set_extab(struct quadd_sections *extabs,
 
 	rd_new->curr_nr = nr_entries;
 
-	ri_entry.vm_start = extabs->vm_start;
-	ri_entry.vm_end = extabs->vm_end;
+	ex_entry->vm_start = extabs->vm_start;
+	ex_entry->vm_end = extabs->vm_end;
 
-	ri_entry.mmap = mmap;
+	ex_entry->mmap = mmap;
 
 	for (i = 0; i < QUADD_SEC_TYPE_MAX; i++) {
 		struct quadd_sec_info *si = &extabs->sec[i];
 
-		ti = &ri_entry.ex_sec[i];
+		ti = &ex_entry->ex_sec[i];
 
 		ti->tf_start = 0;
 		ti->tf_end = 0;
@@ -561,19 +564,12 @@ int quadd_unwind_set_extab(struct quadd_sections *extabs,
 		ti->mmap_offset = si->mmap_offset;
 	}
 
-	nr_added = add_ex_region(rd_new, &ri_entry);
+	nr_added = add_ex_region(rd_new, ex_entry);
 	if (nr_added == 0)
 		goto error_free;
 
 	rd_new->curr_nr += nr_added;
 
-	ex_entry = kzalloc(sizeof(*ex_entry), GFP_ATOMIC);
-	if (!ex_entry) {
-		err = -ENOMEM;
-		goto error_free;
-	}
-	memcpy(ex_entry, &ri_entry, sizeof(*ex_entry));
-
 	INIT_LIST_HEAD(&ex_entry->list);
 	list_add_tail(&ex_entry->list, &mmap->ex_entries);
 
@@ -590,9 +586,15 @@ error_free:
 	rd_free(rd_new);
 error_out:
 	raw_spin_unlock(&ctx.lock);
+	kfree(ex_entry);
 	return err;
 }
 
+/*
+ * The tail range only caches what the last FDE of the table already says,
+ * so it is updated in place: a reader racing with it at worst decodes
+ * that FDE once more.
+ */
 void
 quadd_unwind_set_tail_info(unsigned long vm_start,
 			   int secid,
@@ -600,8 +602,7 @@ quadd_unwind_set_tail_info(unsigned long vm_start,
 			   unsigned long tf_end)
 {
 	struct ex_region_info *ri;
-	unsigned long nr_entries, size;
-	struct regions_data *rd, *rd_new;
+	struct regions_data *rd;
 	struct extab_info *ti;
 
 	raw_spin_lock(&ctx.lock);
@@ -609,42 +610,19 @@ quadd_unwind_set_tail_info(unsigned long vm_start,
 	rd = rcu_dereference(ctx.rd);
 
 	if (!rd || rd->curr_nr == 0)
-		goto error_out;
-
-	size = rd->size;
-	nr_entries = rd->curr_nr;
-
-	rd_new = rd_alloc(size);
-	if (IS_ERR_OR_NULL(rd_new)) {
-		pr_err_once("%s: error: rd_alloc\n", __func__);
-		goto error_out;
-	}
-
-	memcpy(rd_new->entries, rd->entries,
-	       nr_entries * sizeof(*rd->entries));
-
-	rd_new->curr_nr = nr_entries;
+		goto out;
 
-	ri = __search_ex_region(rd_new->entries, nr_entries, vm_start);
+	ri = __search_ex_region(rd->entries, rd->curr_nr, vm_start);
 	if (!ri)
-		goto error_free;
+		goto out;
 
 	ti = &ri->ex_sec[secid];
 
 	ti->tf_start = tf_start;
-	ti->tf_end = tf_end;
-
-	rcu_assign_pointer(ctx.rd, rd_new);
-
-	call_rcu(&rd->rcu, rd_free_rcu);
-	raw_spin_unlock(&ctx.lock);
+	smp_wmb();
+	WRITE_ONCE(ti->tf_end, tf_end);
 
-	return;
-
-error_free:
-	rd_free(rd_new);
-
-error_out:
+out:
 	raw_spin_unlock(&ctx.lock);
 }
 
@@ -662,7 +640,7 @@ clean_mmap(struct regions_data *rd, struct quadd_mmap_area *mmap, int rm_ext)
 			nr_removed += remove_ex_region(rd, entry);
 
 		list_del(&entry->list);
-		kfree(entry);
+		kfree_rcu(entry, rcu);
 	}
 
 	return nr_removed;
@@ -703,19 +681,22 @@ __quadd_unwind_delete_mmap(struct quadd_mmap_area *mmap)
 	rcu_assign_pointer(ctx.rd, rd_new);
 	call_rcu(&rd->rcu, rd_free_rcu);
 
+	atomic_inc(&ctx.gen);
+
 error_out:
 	raw_spin_unlock(&ctx.lock);
 }
 
 static void mmap_wait_for_close(struct quadd_mmap_area *mmap)
 {
-	int state;
-
 	raw_spin_lock(&mmap->state_lock);
 
-	state = atomic_read(&mmap->ref_count) > 0 ?
-		QUADD_MMAP_STATE_CLOSING : QUADD_MMAP_STATE_CLOSED;
-	atomic_set(&mmap->state, state);
+	atomic_set(&mmap->state, QUADD_MMAP_STATE_CLOSING);
+	smp_mb();
+
+	if (atomic_read(&mmap->ref_count) == 0)
+		atomic_cmpxchg(&mmap->state, QUADD_MMAP_STATE_CLOSING,
+			       QUADD_MMAP_STATE_CLOSED);
 
 	raw_spin_unlock(&mmap->state_lock);
 
@@ -1453,15 +1434,22 @@ void quadd_unwind_stop(void)
 
 	nr_entries = rd->curr_nr;
 
+	/* the entries of an mmap are freed by the first clean_mmap() */
+	rcu_read_lock();
+
 	for (i = 0; i < nr_entries; i++) {
-		mmap = rd->entries[i].mmap;
+		mmap = rd->entries[i]->mmap;
 		mmap_wait_for_close(mmap);
 		clean_mmap(rd, mmap, 0);
 	}
 
+	rcu_read_unlock();
+
 	rcu_assign_pointer(ctx.rd, NULL);
 	call_rcu(&rd->rcu, rd_free_rcu);
 
+	atomic_inc(&ctx.gen);
+
 out:
 	raw_spin_unlock(&ctx.lock);
 	quadd_dwarf_unwind_stop();
@@ -1478,6 +1466,7 @@ int quadd_unwind_init(void)
 	raw_spin_lock_init(&ctx.lock);
 	rcu_assign_pointer(ctx.rd, NULL);
 	ctx.pid = 0;
+	atomic_set(&ctx.gen, 0);
 
 	return 0;
 }
@@ -69,10 +69,13 @@ struct ex_region_info {
 	struct quadd_mmap_area *mmap;
 
 	struct list_head list;
+	struct rcu_head rcu;
 };
 
 long
 quadd_get_dw_frames(unsigned long key, struct ex_region_info *ri);
 void quadd_put_dw_frames(struct ex_region_info *ri);
 
+unsigned int quadd_unwind_get_gen(void);
+
 #endif	/* __QUADD_EH_UNWIND_H__ */
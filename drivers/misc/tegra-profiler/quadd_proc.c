@@ -18,6 +18,7 @@
 
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include <linux/tegra_profiler.h>
 
@@ -25,6 +26,7 @@
 #include "version.h"
 #include "quadd_proc.h"
 #include "arm_pmu.h"
+#include "dwarf_unwind.h"
 
 #define YES_NO(x) ((x) ? "yes" : "no")
 
@@ -175,6 +177,33 @@ static const struct file_operations status_proc_fops = {
 	.release	= single_release,
 };
 
+static int show_unwind_cache(struct seq_file *f, void *offset)
+{
+	u64 hits, misses, total;
+
+	quadd_dwarf_unwind_get_cache_stats(&hits, &misses);
+	total = hits + misses;
+
+	seq_printf(f, "hits:            %llu\n", hits);
+	seq_printf(f, "misses:          %llu\n", misses);
+	seq_printf(f, "hit rate:        %llu%%\n",
+		   total ? div64_u64(hits * 100, total) : 0);
+
+	return 0;
+}
+
+static int show_unwind_cache_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_unwind_cache, NULL);
+}
+
+static const struct file_operations unwind_cache_proc_fops = {
+	.open		= show_unwind_cache_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void quadd_proc_init(struct quadd_ctx *context)
 {
 	ctx = context;
@@ -185,6 +214,8 @@ void quadd_proc_init(struct quadd_ctx *context)
 	proc_create(QUADD_PROC_DEV "/capabilities", 0, NULL,
 		    &capabilities_proc_fops);
 	proc_create(QUADD_PROC_DEV "/status", 0, NULL, &status_proc_fops);
+	proc_create(QUADD_PROC_DEV "/unwind_cache", 0, NULL,
+		    &unwind_cache_proc_fops);
 }
 
 void quadd_proc_deinit(void)
@@ -192,6 +223,7 @@ void quadd_proc_deinit(void)
 	remove_proc_entry(QUADD_PROC_DEV "/version", NULL);
 	remove_proc_entry(QUADD_PROC_DEV "/capabilities", NULL);
 	remove_proc_entry(QUADD_PROC_DEV "/status", NULL);
+	remove_proc_entry(QUADD_PROC_DEV "/unwind_cache", NULL);
 	remove_proc_entry(QUADD_PROC_DEV, NULL);
 }
 
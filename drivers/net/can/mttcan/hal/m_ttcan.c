@@ -562,9 +562,15 @@ int ttcan_tx_fifo_full(struct ttcan_controller *ttcan)
 
 static int process_rx_mesg(struct ttcan_controller *ttcan, u32 addr)
 {
-	struct ttcanfd_frame ttcanfd;
-	ttcan_read_rx_msg_ram(ttcan, addr, &ttcanfd);
-	return add_msg_controller_list(ttcan, &ttcanfd, &ttcan->rx_b, BUFFER);
+	struct ttcanfd_frame *ttcanfd;
+
+	ttcanfd = ttcan_rx_ring_reserve(&ttcan->rx_b);
+	if (!ttcanfd)
+		return -ENOMEM;
+
+	ttcan_read_rx_msg_ram(ttcan, addr, ttcanfd);
+	ttcan_rx_ring_commit(&ttcan->rx_b);
+	return 0;
 }
 
 int ttcan_read_rx_buffer(struct ttcan_controller *ttcan)
@@ -609,7 +615,7 @@ int ttcan_read_rx_buffer(struct ttcan_controller *ttcan)
 
 unsigned int ttcan_read_txevt_fifo(struct ttcan_controller *ttcan)
 {
-	struct mttcan_tx_evt_element txevt;
+	struct mttcan_tx_evt_element *txevt;
 	u32 txefs;
 	u32 read_addr;
 	int q_read = 0;
@@ -633,12 +639,12 @@ unsigned int ttcan_read_txevt_fifo(struct ttcan_controller *ttcan)
 		pr_debug("%s:txevt: read_addr %x EFGI %x\n", __func__,
 			 read_addr, get_idx);
 
-		ttcan_read_txevt_ram(ttcan, read_addr, &txevt);
-		if (add_event_controller_list(ttcan, &txevt,
-					      &ttcan->tx_evt) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
+		/* Ring full: leave the event in the FIFO for the next pass */
+		txevt = ttcan_txevt_ring_reserve(&ttcan->tx_evt);
+		if (!txevt)
 			return msgs_read;
-		}
+		ttcan_read_txevt_ram(ttcan, read_addr, txevt);
+		ttcan_txevt_ring_commit(&ttcan->tx_evt);
 		ttcan_write32(ttcan, ADR_MTTCAN_TXEFA, get_idx);
 		txefs = ttcan_read32(ttcan, ADR_MTTCAN_TXEFS);
 		msgs_read++;
@@ -651,7 +657,7 @@ unsigned int ttcan_read_txevt_fifo(struct ttcan_controller *ttcan)
 unsigned int ttcan_read_rx_fifo0(struct ttcan_controller *ttcan)
 {
 	u32 rxf0s_reg;
-	struct ttcanfd_frame ttcanfd;
+	struct ttcanfd_frame *ttcanfd;
 	u32 read_addr;
 	int q_read = 0;
 	unsigned int msgs_read = 0;
@@ -682,12 +688,12 @@ unsigned int ttcan_read_rx_fifo0(struct ttcan_controller *ttcan)
 		pr_debug("%s:fifo0: read_addr %x FOGI %x\n", __func__,
 			 read_addr, get_idx);
 
-		ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
-		if (add_msg_controller_list(ttcan, &ttcanfd,
-					    &ttcan->rx_q0, FIFO_0) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
+		/* Ring full: leave the frame in the FIFO for the next pass */
+		ttcanfd = ttcan_rx_ring_reserve(&ttcan->rx_q0);
+		if (!ttcanfd)
 			return msgs_read;
-		}
+		ttcan_read_rx_msg_ram(ttcan, read_addr, ttcanfd);
+		ttcan_rx_ring_commit(&ttcan->rx_q0);
 		ttcan_write32(ttcan, ADR_MTTCAN_RXF0A, get_idx);
 		rxf0s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF0S);
 		msgs_read++;
@@ -698,7 +704,7 @@ unsigned int ttcan_read_rx_fifo0(struct ttcan_controller *ttcan)
 unsigned int ttcan_read_rx_fifo1(struct ttcan_controller *ttcan)
 {
 	u32 rxf1s_reg;
-	struct ttcanfd_frame ttcanfd;
+	struct ttcanfd_frame *ttcanfd;
 	u32 read_addr;
 	int q_read = 0;
 	int msgs_read = 0;
@@ -728,12 +734,12 @@ unsigned int ttcan_read_rx_fifo1(struct ttcan_controller *ttcan)
 		pr_debug("%s:fifo1: read_addr %x FOGI %x\n", __func__,
 			 read_addr, get_idx);
 
-		ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
-		if (add_msg_controller_list(ttcan, &ttcanfd,
-					    &ttcan->rx_q1, FIFO_1) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
+		/* Ring full: leave the frame in the FIFO for the next pass */
+		ttcanfd = ttcan_rx_ring_reserve(&ttcan->rx_q1);
+		if (!ttcanfd)
 			return msgs_read;
-		}
+		ttcan_read_rx_msg_ram(ttcan, read_addr, ttcanfd);
+		ttcan_rx_ring_commit(&ttcan->rx_q1);
 		ttcan_write32(ttcan, ADR_MTTCAN_RXF1A, get_idx);
 		rxf1s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF1S);
 		msgs_read++;
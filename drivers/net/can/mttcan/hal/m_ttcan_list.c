@@ -16,98 +16,133 @@
 
 #include "m_ttcan.h"
 
-#define TTCAN_MAX_LIST_MEMBERS 128
-
-inline int is_msg_list_full(struct ttcan_controller *ttcan,
-		enum ttcan_rx_type rxtype)
+static void ttcan_reset_rx_ring(struct ttcan_rx_ring *ring)
 {
-	return ttcan->list_status & rxtype & 0xFF;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->overflow = 0;
 }
 
-int add_msg_controller_list(struct ttcan_controller *ttcan,
-			    struct ttcanfd_frame *ttcanfd,
-			    struct list_head *rx_q,
-			    enum ttcan_rx_type rxtype)
+int ttcan_alloc_rings(struct ttcan_controller *ttcan)
 {
-
-	struct ttcan_rx_msg_list *msg_list;
-
-	msg_list = (struct ttcan_rx_msg_list *)
-		kzalloc(sizeof(struct ttcan_rx_msg_list), GFP_KERNEL);
-	if (msg_list == NULL) {
+	ttcan->rx_b.frames = kcalloc(TTCAN_RX_RING_SIZE,
+				     sizeof(struct ttcanfd_frame), GFP_KERNEL);
+	ttcan->rx_q0.frames = kcalloc(TTCAN_RX_RING_SIZE,
+				      sizeof(struct ttcanfd_frame), GFP_KERNEL);
+	ttcan->rx_q1.frames = kcalloc(TTCAN_RX_RING_SIZE,
+				      sizeof(struct ttcanfd_frame), GFP_KERNEL);
+	ttcan->tx_evt.evts = kcalloc(TTCAN_TXEVT_RING_SIZE,
+				     sizeof(struct mttcan_tx_evt_element),
+				     GFP_KERNEL);
+	if (!ttcan->rx_b.frames || !ttcan->rx_q0.frames ||
+	    !ttcan->rx_q1.frames || !ttcan->tx_evt.evts) {
 		pr_err("%s: memory allocation failed\n", __func__);
+		ttcan_free_rings(ttcan);
 		return -ENOMEM;
 	}
 
-	INIT_LIST_HEAD(&msg_list->recv_list);
+	ttcan_reset_rx_ring(&ttcan->rx_b);
+	ttcan_reset_rx_ring(&ttcan->rx_q0);
+	ttcan_reset_rx_ring(&ttcan->rx_q1);
+	ttcan->tx_evt.head = 0;
+	ttcan->tx_evt.tail = 0;
+	ttcan->tx_evt.overflow = 0;
 
-	memcpy(&msg_list->msg, ttcanfd, sizeof(struct ttcanfd_frame));
+	return 0;
+}
 
-	spin_lock(&ttcan->lock);
+void ttcan_free_rings(struct ttcan_controller *ttcan)
+{
+	kfree(ttcan->rx_b.frames);
+	kfree(ttcan->rx_q0.frames);
+	kfree(ttcan->rx_q1.frames);
+	kfree(ttcan->tx_evt.evts);
+	ttcan->rx_b.frames = NULL;
+	ttcan->rx_q0.frames = NULL;
+	ttcan->rx_q1.frames = NULL;
+	ttcan->tx_evt.evts = NULL;
+}
 
-	if (is_msg_list_full(ttcan, rxtype)) {
-		pr_err("%s: mesg list is full\n", __func__);
-		kfree(msg_list);
-		spin_unlock(&ttcan->lock);
-		return -ENOMEM;
-	}
+/*
+ * Producer side. Returns the next free slot to fill in place, or NULL if
+ * the ring is full (or not allocated). The slot is not visible to the
+ * consumer until ttcan_rx_ring_commit().
+ */
+struct ttcanfd_frame *ttcan_rx_ring_reserve(struct ttcan_rx_ring *ring)
+{
+	/* Pairs with smp_store_release() in ttcan_rx_ring_release() */
+	unsigned int tail = smp_load_acquire(&ring->tail);
 
-	list_add_tail(&msg_list->recv_list, rx_q);
-
-	switch (rxtype) {
-	case BUFFER:
-		if (++ttcan->rxb_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= BUFFER;
-		break;
-	case FIFO_0:
-		if (++ttcan->rxq0_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= FIFO_0;
-		break;
-	case FIFO_1:
-		if (++ttcan->rxq1_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= FIFO_1;
-	default:
-		break;
+	if (unlikely(!ring->frames))
+		return NULL;
+
+	if (ring->head - tail >= TTCAN_RX_RING_SIZE) {
+		ring->overflow++;
+		return NULL;
 	}
-	spin_unlock(&ttcan->lock);
 
-	return 0;
+	return &ring->frames[ring->head & (TTCAN_RX_RING_SIZE - 1)];
 }
 
-int add_event_controller_list(struct ttcan_controller *ttcan,
-			    struct mttcan_tx_evt_element *txevt,
-			    struct list_head *evt_q)
+void ttcan_rx_ring_commit(struct ttcan_rx_ring *ring)
 {
+	/* Publish the slot contents before the new head */
+	smp_store_release(&ring->head, ring->head + 1);
+}
 
-	struct ttcan_txevt_msg_list *evt_list;
+/* Consumer side */
+unsigned int ttcan_rx_ring_count(struct ttcan_rx_ring *ring)
+{
+	/* Pairs with smp_store_release() in ttcan_rx_ring_commit() */
+	return smp_load_acquire(&ring->head) - ring->tail;
+}
 
-	evt_list =
-	    (struct ttcan_txevt_msg_list *)
-	    kzalloc(sizeof(struct ttcan_txevt_msg_list), GFP_KERNEL);
-	if (evt_list == NULL) {
-		pr_err("%s: memory allocation failed\n", __func__);
-		return -ENOMEM;
-	}
+struct ttcanfd_frame *ttcan_rx_ring_peek(struct ttcan_rx_ring *ring,
+	unsigned int idx)
+{
+	return &ring->frames[(ring->tail + idx) & (TTCAN_RX_RING_SIZE - 1)];
+}
 
-	INIT_LIST_HEAD(&evt_list->txevt_list);
+void ttcan_rx_ring_release(struct ttcan_rx_ring *ring, unsigned int count)
+{
+	/* Slots must be fully consumed before the producer may reuse them */
+	smp_store_release(&ring->tail, ring->tail + count);
+}
 
-	memcpy(&evt_list->txevt, txevt, sizeof(struct mttcan_tx_evt_element));
+struct mttcan_tx_evt_element *ttcan_txevt_ring_reserve(
+	struct ttcan_txevt_ring *ring)
+{
+	unsigned int tail = smp_load_acquire(&ring->tail);
 
-	spin_lock(&ttcan->lock);
+	if (unlikely(!ring->evts))
+		return NULL;
 
-	if (is_msg_list_full(ttcan, TX_EVT)) {
-		pr_err("%s: mesg list is full\n", __func__);
-		kfree(evt_list);
-		spin_unlock(&ttcan->lock);
-		return -1;
+	if (ring->head - tail >= TTCAN_TXEVT_RING_SIZE) {
+		ring->overflow++;
+		return NULL;
 	}
 
-	list_add_tail(&evt_list->txevt_list, evt_q);
+	return &ring->evts[ring->head & (TTCAN_TXEVT_RING_SIZE - 1)];
+}
 
-	if (++ttcan->evt_mem >= TTCAN_MAX_LIST_MEMBERS)
-		ttcan->list_status |= TX_EVT;
+void ttcan_txevt_ring_commit(struct ttcan_txevt_ring *ring)
+{
+	smp_store_release(&ring->head, ring->head + 1);
+}
 
-	spin_unlock(&ttcan->lock);
+unsigned int ttcan_txevt_ring_count(struct ttcan_txevt_ring *ring)
+{
+	return smp_load_acquire(&ring->head) - ring->tail;
+}
 
-	return 0;
+struct mttcan_tx_evt_element *ttcan_txevt_ring_peek(
+	struct ttcan_txevt_ring *ring, unsigned int idx)
+{
+	return &ring->evts[(ring->tail + idx) & (TTCAN_TXEVT_RING_SIZE - 1)];
+}
+
+void ttcan_txevt_ring_release(struct ttcan_txevt_ring *ring,
+	unsigned int count)
+{
+	smp_store_release(&ring->tail, ring->tail + count);
 }
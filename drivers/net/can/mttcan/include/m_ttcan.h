@@ -269,14 +269,29 @@ struct ttcan_filter_config {
 	u32 xtd_fltr_size;
 };
 
-struct ttcan_rx_msg_list {
-	struct ttcanfd_frame msg;
-	struct list_head recv_list;
+/* Ring sizes must be powers of two, head/tail free-run and are masked */
+#define TTCAN_RX_RING_SIZE	128
+#define TTCAN_TXEVT_RING_SIZE	128
+
+/*
+ * Single producer/single consumer rings between the message RAM readers
+ * and the netdev delivery path. Only the producer writes head and only
+ * the consumer writes tail, so neither side needs ttcan->lock. overflow
+ * counts the times the producer found the ring full and left the frame
+ * in message RAM.
+ */
+struct ttcan_rx_ring {
+	struct ttcanfd_frame *frames;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int overflow;
 };
 
-struct ttcan_txevt_msg_list {
-	struct mttcan_tx_evt_element txevt;
-	struct list_head txevt_list;
+struct ttcan_txevt_ring {
+	struct mttcan_tx_evt_element *evts;
+	unsigned int head;
+	unsigned int tail;
+	unsigned int overflow;
 };
 
 struct ttcan_controller {
@@ -287,10 +302,10 @@ struct ttcan_controller {
 	struct ttcan_rxbuff_config rx_config;
 	struct ttcan_filter_config fltr_config;
 	struct ttcan_mram_elem mram_cfg[MRAM_ELEMS];
-	struct list_head rx_q0;
-	struct list_head rx_q1;
-	struct list_head rx_b;
-	struct list_head tx_evt;
+	struct ttcan_rx_ring rx_q0;
+	struct ttcan_rx_ring rx_q1;
+	struct ttcan_rx_ring rx_b;
+	struct ttcan_txevt_ring tx_evt;
 	void __iomem *base;	/* controller regs space should be remapped. */
 	void __iomem *xbase;    /* extra registers are mapped */
 	void __iomem *mram_vbase;
@@ -304,12 +319,6 @@ struct ttcan_controller {
 	u32 tt_mem_elements;
 	unsigned long tx_object;
 	unsigned long tx_obj_cancelled;
-	int rxq0_mem;
-	int rxq1_mem;
-	int rxb_mem;
-	int evt_mem;
-	u16 list_status;	/* bit 0: 1=Full; */
-	u16 resv0;
 };
 
 struct ttcan_ivc_msg {
@@ -544,13 +553,24 @@ int ttcan_set_tur_config(struct ttcan_controller *ttcan, u16 denominator,
 
 void ttcan_prog_trigger_mem(struct ttcan_controller *ttcan, void *tmc_shadow);
 
-/* list APIs */
-int add_msg_controller_list(struct ttcan_controller *ttcan,
-	struct ttcanfd_frame *ttcanfd, struct list_head *rx_q,
-	enum ttcan_rx_type rxtype);
-
-int add_event_controller_list(struct ttcan_controller *ttcan,
-				struct mttcan_tx_evt_element *txevt,
-				struct list_head *evt_q);
+/* ring APIs */
+int ttcan_alloc_rings(struct ttcan_controller *ttcan);
+void ttcan_free_rings(struct ttcan_controller *ttcan);
+
+struct ttcanfd_frame *ttcan_rx_ring_reserve(struct ttcan_rx_ring *ring);
+void ttcan_rx_ring_commit(struct ttcan_rx_ring *ring);
+unsigned int ttcan_rx_ring_count(struct ttcan_rx_ring *ring);
+struct ttcanfd_frame *ttcan_rx_ring_peek(struct ttcan_rx_ring *ring,
+	unsigned int idx);
+void ttcan_rx_ring_release(struct ttcan_rx_ring *ring, unsigned int count);
+
+struct mttcan_tx_evt_element *ttcan_txevt_ring_reserve(
+	struct ttcan_txevt_ring *ring);
+void ttcan_txevt_ring_commit(struct ttcan_txevt_ring *ring);
+unsigned int ttcan_txevt_ring_count(struct ttcan_txevt_ring *ring);
+struct mttcan_tx_evt_element *ttcan_txevt_ring_peek(
+	struct ttcan_txevt_ring *ring, unsigned int idx);
+void ttcan_txevt_ring_release(struct ttcan_txevt_ring *ring,
+	unsigned int count);
 cycle_t ttcan_read_ts_cntr(const struct cyclecounter *ccnt);
 #endif
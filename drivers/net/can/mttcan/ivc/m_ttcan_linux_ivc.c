@@ -67,59 +67,55 @@ static const struct of_device_id mttcan_of_table[] = {
 MODULE_DEVICE_TABLE(of, mttcan_of_table);
 
 static int mttcan_read_rcv_list(struct net_device *dev,
-				struct list_head *rcv)
+				struct ttcan_rx_ring *ring)
 {
-	int rec_msgs = 0;
-	unsigned long flags;
-	struct mttcan_priv *priv = netdev_priv(dev);
-	struct ttcan_rx_msg_list *rx;
 	struct net_device_stats *stats = &dev->stats;
-	struct list_head *cur, *next, rx_q;
+	struct sk_buff_head rx_q;
+	struct sk_buff *skb;
+	unsigned int avail, i;
 
-	if (list_empty(rcv))
+	avail = ttcan_rx_ring_count(ring);
+	if (!avail)
 		return 0;
 
-	INIT_LIST_HEAD(&rx_q);
-
-	spin_lock_irqsave(&priv->ttcan->lock, flags);
-	priv->ttcan->rxb_mem = 0;
-	priv->ttcan->list_status &= ~(BUFFER & 0xFF);
-	list_splice_init(rcv, &rx_q);
-	spin_unlock_irqrestore(&priv->ttcan->lock, flags);
+	__skb_queue_head_init(&rx_q);
 
-	list_for_each_safe(cur, next, &rx_q) {
-		struct sk_buff *skb;
+	for (i = 0; i < avail; i++) {
+		struct ttcanfd_frame *msg = ttcan_rx_ring_peek(ring, i);
 		struct canfd_frame *fd_frame;
 		struct can_frame *frame;
-		list_del_init(cur);
 
-		rx = list_entry(cur, struct ttcan_rx_msg_list, recv_list);
-		if (rx->msg.flags & CAN_FD_FLAG) {
+		if (msg->flags & CAN_FD_FLAG) {
 			skb = alloc_canfd_skb(dev, &fd_frame);
 			if (!skb) {
 				stats->rx_dropped++;
-				return 0;
+				continue;
 			}
-			memcpy(fd_frame, &rx->msg, sizeof(struct canfd_frame));
+			memcpy(fd_frame, msg, sizeof(struct canfd_frame));
 			stats->rx_bytes += fd_frame->len;
 		} else {
 			skb = alloc_can_skb(dev, &frame);
 			if (!skb) {
 				stats->rx_dropped++;
-				return 0;
+				continue;
 			}
-			frame->can_id =  rx->msg.can_id;
-			frame->can_dlc = rx->msg.d_len;
-			memcpy(frame->data, &rx->msg.data, frame->can_dlc);
+			frame->can_id =  msg->can_id;
+			frame->can_dlc = msg->d_len;
+			memcpy(frame->data, &msg->data, frame->can_dlc);
 			stats->rx_bytes += frame->can_dlc;
 		}
 
-		kfree(rx);
+		__skb_queue_tail(&rx_q, skb);
+	}
+
+	ttcan_rx_ring_release(ring, avail);
+
+	while ((skb = __skb_dequeue(&rx_q)) != NULL) {
 		netif_receive_skb(skb);
 		stats->rx_packets++;
-		rec_msgs++;
 	}
-	return rec_msgs;
+
+	return avail;
 }
 
 static int mttcan_state_change(struct net_device *dev,
@@ -347,9 +343,15 @@ static struct net_device *alloc_mttcan_dev(void)
 
 static int process_rx_mesg_ivc(struct ttcan_controller *ttcan, u32 *addr)
 {
-	struct ttcanfd_frame ttcanfd;
-	ttcan_read_rx_msg_ram(ttcan, (u64)addr, &ttcanfd);
-	return add_msg_controller_list(ttcan, &ttcanfd, &ttcan->rx_b, BUFFER);
+	struct ttcanfd_frame *ttcanfd;
+
+	ttcanfd = ttcan_rx_ring_reserve(&ttcan->rx_b);
+	if (!ttcanfd)
+		return -ENOMEM;
+
+	ttcan_read_rx_msg_ram(ttcan, (u64)addr, ttcanfd);
+	ttcan_rx_ring_commit(&ttcan->rx_b);
+	return 0;
 }
 
 static void mttcan_ivc_rcv_msg(struct mbox_client *cl, void *mssg)
@@ -574,7 +576,16 @@ static int mttcan_probe(struct platform_device *pdev)
 	}
 	memset(priv->ttcan, 0, sizeof(struct ttcan_controller));
 	priv->ttcan->id = priv->instance;
-	INIT_LIST_HEAD(&priv->ttcan->rx_b);
+
+	/*
+	 * The mailbox callback can run whenever the channel is open, so
+	 * unlike the native driver the rings live for the whole binding.
+	 */
+	ret = ttcan_alloc_rings(priv->ttcan);
+	if (ret) {
+		dev_err(&pdev->dev, "cannot allocate rx rings\n");
+		goto exit_free_device;
+	}
 
 	platform_set_drvdata(pdev, dev);
 	SET_NETDEV_DEV(dev, &pdev->dev);
@@ -583,7 +594,7 @@ static int mttcan_probe(struct platform_device *pdev)
 	if (ret) {
 		dev_err(&pdev->dev, "registering %s failed (err=%d)\n",
 			KBUILD_MODNAME, ret);
-		goto exit_free_device;
+		goto exit_free_rings;
 	}
 
 	/* Configure mailbox for IVC to AON */
@@ -607,6 +618,8 @@ static int mttcan_probe(struct platform_device *pdev)
 
 exit_unreg_candev:
 	unregister_candev(dev);
+exit_free_rings:
+	ttcan_free_rings(priv->ttcan);
 exit_free_device:
 	platform_set_drvdata(pdev, NULL);
 	free_candev(dev);
@@ -621,6 +634,7 @@ static int mttcan_remove(struct platform_device *pdev)
 	struct mttcan_priv *priv = netdev_priv(dev);
 
 	mbox_free_channel(priv->mbox);
+	ttcan_free_rings(priv->ttcan);
 
 	dev_info(&dev->dev, "%s\n", __func__);
 
@@ -286,93 +286,76 @@ static int mttcan_do_receive(struct net_device *dev,
 }
 
 static void mttcan_rx_hwtstamp(struct mttcan_priv *priv,
-			       struct sk_buff *skb, struct ttcanfd_frame msg)
+			       struct sk_buff *skb,
+			       const struct ttcanfd_frame *msg)
 {
 	u64 ns;
 	unsigned long flags;
 	struct skb_shared_hwtstamps *hwtstamps = skb_hwtstamps(skb);
 
 	raw_spin_lock_irqsave(&priv->tc_lock, flags);
-	ns = timecounter_cyc2time(&priv->tc, msg.tstamp);
+	ns = timecounter_cyc2time(&priv->tc, msg->tstamp);
 	raw_spin_unlock_irqrestore(&priv->tc_lock, flags);
 	memset(hwtstamps, 0, sizeof(struct skb_shared_hwtstamps));
 	hwtstamps->hwtstamp = ns_to_ktime(ns);
 }
 
 static int mttcan_read_rcv_list(struct net_device *dev,
-				struct list_head *rcv,
-				enum ttcan_rx_type rx_type,
-				int rec_msgs, int quota)
+				struct ttcan_rx_ring *ring, int quota)
 {
-	unsigned int pushed;
-	unsigned long flags;
 	struct mttcan_priv *priv = netdev_priv(dev);
-	struct ttcan_rx_msg_list *rx;
 	struct net_device_stats *stats = &dev->stats;
-	struct list_head *cur, *next, rx_q;
+	struct sk_buff_head rx_q;
+	struct sk_buff *skb;
+	unsigned int avail, i;
 
-	if (list_empty(rcv))
+	avail = ttcan_rx_ring_count(ring);
+	if (!avail || quota <= 0)
 		return 0;
+	if (avail > quota)
+		avail = quota;
 
-	INIT_LIST_HEAD(&rx_q);
+	__skb_queue_head_init(&rx_q);
 
-	spin_lock_irqsave(&priv->ttcan->lock, flags);
-	switch (rx_type) {
-	case BUFFER:
-		priv->ttcan->rxb_mem = 0;
-		priv->ttcan->list_status &= ~(BUFFER & 0xFF);
-		break;
-	case FIFO_0:
-		priv->ttcan->rxq0_mem = 0;
-		priv->ttcan->list_status &= ~(FIFO_0 & 0xFF);
-		break;
-	case FIFO_1:
-		priv->ttcan->rxq1_mem = 0;
-		priv->ttcan->list_status &= ~(FIFO_1 & 0xFF);
-	default:
-		break;
-	}
-	list_splice_init(rcv, &rx_q);
-	spin_unlock_irqrestore(&priv->ttcan->lock, flags);
-
-	pushed = rec_msgs;
-	list_for_each_safe(cur, next, &rx_q) {
-		struct sk_buff *skb;
+	for (i = 0; i < avail; i++) {
+		struct ttcanfd_frame *msg = ttcan_rx_ring_peek(ring, i);
 		struct canfd_frame *fd_frame;
 		struct can_frame *frame;
-		if (!quota--)
-			break;
-		list_del_init(cur);
 
-		rx = list_entry(cur, struct ttcan_rx_msg_list, recv_list);
-		if (rx->msg.flags & CAN_FD_FLAG) {
+		if (msg->flags & CAN_FD_FLAG) {
 			skb = alloc_canfd_skb(dev, &fd_frame);
 			if (!skb) {
-				stats->rx_dropped += pushed;
-				return 0;
+				stats->rx_dropped++;
+				continue;
 			}
-			memcpy(fd_frame, &rx->msg, sizeof(struct canfd_frame));
+			memcpy(fd_frame, msg, sizeof(struct canfd_frame));
 			stats->rx_bytes += fd_frame->len;
 		} else {
 			skb = alloc_can_skb(dev, &frame);
 			if (!skb) {
-				stats->rx_dropped += pushed;
-				return 0;
+				stats->rx_dropped++;
+				continue;
 			}
-			frame->can_id =  rx->msg.can_id;
-			frame->can_dlc = rx->msg.d_len;
-			memcpy(frame->data, &rx->msg.data, frame->can_dlc);
+			frame->can_id =  msg->can_id;
+			frame->can_dlc = msg->d_len;
+			memcpy(frame->data, &msg->data, frame->can_dlc);
 			stats->rx_bytes += frame->can_dlc;
 		}
 
 		if (priv->hwts_rx_en)
-			mttcan_rx_hwtstamp(priv, skb, rx->msg);
-		kfree(rx);
+			mttcan_rx_hwtstamp(priv, skb, msg);
+		__skb_queue_tail(&rx_q, skb);
+	}
+
+	/* Hand the slots back to the producer before going up the stack */
+	ttcan_rx_ring_release(ring, avail);
+
+	while ((skb = __skb_dequeue(&rx_q)) != NULL) {
 		netif_receive_skb(skb);
 		stats->rx_packets++;
-		pushed--;
 	}
-	return rec_msgs - pushed;
+
+	return avail;
 }
 
 static int mttcan_state_change(struct net_device *dev,
@@ -509,47 +492,33 @@ static int mttcan_handle_bus_err(struct net_device *dev,
 static void mttcan_tx_event(struct net_device *dev)
 {
 	struct mttcan_priv *priv = netdev_priv(dev);
-	struct ttcan_txevt_msg_list *evt;
-	struct list_head *cur, *next, evt_q;
-	struct mttcan_tx_evt_element txevt;
+	struct ttcan_txevt_ring *ring = &priv->ttcan->tx_evt;
+	struct mttcan_tx_evt_element *txevt;
+	unsigned int avail, i;
 	u32 xtd, id;
-	unsigned long flags;
-
-	INIT_LIST_HEAD(&evt_q);
-
-	spin_lock_irqsave(&priv->ttcan->lock, flags);
 
-	if (list_empty(&priv->ttcan->tx_evt)) {
-		spin_unlock_irqrestore(&priv->ttcan->lock, flags);
+	avail = ttcan_txevt_ring_count(ring);
+	if (!avail)
 		return;
-	}
-
-	priv->ttcan->evt_mem = 0;
-	priv->ttcan->list_status &= ~(TX_EVT & 0xFF);
-	list_splice_init(&priv->ttcan->tx_evt, &evt_q);
-	spin_unlock_irqrestore(&priv->ttcan->lock, flags);
-
-	list_for_each_safe(cur, next, &evt_q) {
-		list_del_init(cur);
 
-		evt = list_entry(cur, struct ttcan_txevt_msg_list, txevt_list);
-		memcpy(&txevt, &evt->txevt,
-			sizeof(struct mttcan_tx_evt_element));
-		kfree(evt);
-		xtd = (txevt.f0 & MTT_TXEVT_ELE_F0_XTD_MASK) >>
+	for (i = 0; i < avail; i++) {
+		txevt = ttcan_txevt_ring_peek(ring, i);
+		xtd = (txevt->f0 & MTT_TXEVT_ELE_F0_XTD_MASK) >>
 			MTT_TXEVT_ELE_F0_XTD_SHIFT;
-		id = (txevt.f0 & MTT_TXEVT_ELE_F0_ID_MASK) >>
+		id = (txevt->f0 & MTT_TXEVT_ELE_F0_ID_MASK) >>
 			MTT_TXEVT_ELE_F0_ID_SHIFT;
 
 		pr_debug("%s:(index %u) ID %x(%s %s %s) Evt_Type %02d\n",
-			 __func__, (txevt.f1 & MTT_TXEVT_ELE_F1_MM_MASK) >>
+			 __func__, (txevt->f1 & MTT_TXEVT_ELE_F1_MM_MASK) >>
 			MTT_TXEVT_ELE_F1_MM_SHIFT,
 			xtd ? id : id >> 18, xtd ? "XTD" : "STD",
-			txevt.f1 & MTT_TXEVT_ELE_F1_FDF_MASK ? "FD" : "NON-FD",
-			txevt.f1 & MTT_TXEVT_ELE_F1_BRS_MASK ? "BRS" : "NOBRS",
-			(txevt.f1 & MTT_TXEVT_ELE_F1_ET_MASK)
+			txevt->f1 & MTT_TXEVT_ELE_F1_FDF_MASK ? "FD" : "NON-FD",
+			txevt->f1 & MTT_TXEVT_ELE_F1_BRS_MASK ? "BRS" : "NOBRS",
+			(txevt->f1 & MTT_TXEVT_ELE_F1_ET_MASK)
 			>> MTT_TXEVT_ELE_F1_ET_SHIFT);
 	}
+
+	ttcan_txevt_ring_release(ring, avail);
 }
 
 static void mttcan_tx_complete(struct net_device *dev)
@@ -616,7 +585,6 @@ static void mttcan_tx_cancelled(struct net_device *dev)
 static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 {
 	int work_done = 0;
-	int rec_msgs = 0;
 	struct net_device *dev = napi->dev;
 	struct mttcan_priv *priv = netdev_priv(dev);
 	u32 ir, ack, ttir, ttack, psr;
@@ -709,10 +677,9 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 		if (ir & MTT_IR_DRX_MASK) {
 			ack = MTT_IR_DRX_MASK;
 			ttcan_ir_write(priv->ttcan, ack);
-			rec_msgs = ttcan_read_rx_buffer(priv->ttcan);
+			ttcan_read_rx_buffer(priv->ttcan);
 			work_done +=
 			    mttcan_read_rcv_list(dev, &priv->ttcan->rx_b,
-						 BUFFER, rec_msgs,
 						 quota - work_done);
 			pr_debug("%s: buffer mesg received\n", __func__);
 
@@ -744,11 +711,10 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 					MTT_IR_RF1N_MASK);
 				ttcan_ir_write(priv->ttcan, ack);
 
-				rec_msgs = ttcan_read_rx_fifo1(priv->ttcan);
+				ttcan_read_rx_fifo1(priv->ttcan);
 				work_done +=
 				    mttcan_read_rcv_list(dev,
 							 &priv->ttcan->rx_q1,
-							 FIFO_1, rec_msgs,
 							 quota - work_done);
 				pr_debug("%s: msg received in Q1\n", __func__);
 			}
@@ -758,11 +724,10 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 					MTT_IR_RF0W_MASK |
 					MTT_IR_RF0N_MASK);
 				ttcan_ir_write(priv->ttcan, ack);
-				rec_msgs = ttcan_read_rx_fifo0(priv->ttcan);
+				ttcan_read_rx_fifo0(priv->ttcan);
 				work_done +=
 				    mttcan_read_rcv_list(dev,
 							 &priv->ttcan->rx_q0,
-							 FIFO_0, rec_msgs,
 							 quota - work_done);
 				pr_debug("%s: msg received in Q0\n", __func__);
 			}
@@ -1225,10 +1190,16 @@ static int mttcan_open(struct net_device *dev)
 		goto exit_open_fail;
 	}
 
+	err = ttcan_alloc_rings(priv->ttcan);
+	if (err) {
+		netdev_err(dev, "failed to allocate rx rings\n");
+		goto fail;
+	}
+
 	err = request_irq(dev->irq, mttcan_isr, 0, dev->name, dev);
 	if (err < 0) {
 		netdev_err(dev, "failed to request interrupt\n");
-		goto fail;
+		goto fail_rings;
 	}
 
 	napi_enable(&priv->napi);
@@ -1239,6 +1210,8 @@ static int mttcan_open(struct net_device *dev)
 
 	return 0;
 
+fail_rings:
+	ttcan_free_rings(priv->ttcan);
 fail:
 	close_candev(dev);
 exit_open_fail:
@@ -1254,6 +1227,7 @@ static int mttcan_close(struct net_device *dev)
 	napi_disable(&priv->napi);
 	mttcan_stop(priv);
 	free_irq(dev->irq, dev);
+	ttcan_free_rings(priv->ttcan);
 	priv->hwts_rx_en = false;
 	close_candev(dev);
 	mttcan_power_down(dev);
@@ -1744,10 +1718,6 @@ static int mttcan_probe(struct platform_device *pdev)
 	priv->ttcan->mram_base = mesg_ram->start;
 	priv->ttcan->id = priv->instance;
 	priv->ttcan->mram_vbase = mram_addr;
-	INIT_LIST_HEAD(&priv->ttcan->rx_q0);
-	INIT_LIST_HEAD(&priv->ttcan->rx_q1);
-	INIT_LIST_HEAD(&priv->ttcan->rx_b);
-	INIT_LIST_HEAD(&priv->ttcan->tx_evt);
 
 	platform_set_drvdata(pdev, dev);
 	SET_NETDEV_DEV(dev, &pdev->dev);
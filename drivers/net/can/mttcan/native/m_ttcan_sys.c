@@ -546,6 +546,17 @@ static ssize_t store_trigger_mem(struct device *dev,
 	return count;
 }
 
+static ssize_t show_ring_overflow(struct device *dev,
+	struct device_attribute *devattr, char *buf)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+	struct ttcan_controller *ttcan = priv->ttcan;
+
+	return sprintf(buf, "rxb %u\nrxq0 %u\nrxq1 %u\ntxevt %u\n",
+		ttcan->rx_b.overflow, ttcan->rx_q0.overflow,
+		ttcan->rx_q1.overflow, ttcan->tx_evt.overflow);
+}
+
 static DEVICE_ATTR(std_filter, S_IRUGO | S_IWUSR, show_std_fltr,
 	store_std_fltr);
 static DEVICE_ATTR(xtd_filter, S_IRUGO | S_IWUSR, show_xtd_fltr,
@@ -564,6 +575,7 @@ static DEVICE_ATTR(cccr_init_txbar, S_IRUGO | S_IWUSR, show_cccr_txbar,
 	store_cccr_txbar);
 static DEVICE_ATTR(trigger_mem, S_IRUGO | S_IWUSR, show_trigger_mem,
 		store_trigger_mem);
+static DEVICE_ATTR(ring_overflow, S_IRUGO, show_ring_overflow, NULL);
 
 static struct attribute *mttcan_attr[] = {
 	&dev_attr_std_filter.attr,
@@ -578,6 +590,7 @@ static struct attribute *mttcan_attr[] = {
 	&dev_attr_txbar.attr,
 	&dev_attr_cccr_init_txbar.attr,
 	&dev_attr_trigger_mem.attr,
+	&dev_attr_ring_overflow.attr,
 	NULL
 };
 
@@ -131,6 +131,26 @@ do { \
 #endif
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0)
+#define RTL_XMIT_MORE(skb) netdev_xmit_more()
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,18,0)
+#define RTL_XMIT_MORE(skb) ((skb)->xmit_more)
+#else
+#define RTL_XMIT_MORE(skb) 0
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,3,0)
+#define RTL_NETDEV_SENT_QUEUE(dev, bytes) netdev_sent_queue(dev, bytes)
+#define RTL_NETDEV_COMPLETED_QUEUE(dev, pkts, bytes) netdev_completed_queue(dev, pkts, bytes)
+#define RTL_NETDEV_RESET_QUEUE(dev) netdev_reset_queue(dev)
+#define RTL_NETIF_XMIT_STOPPED(dev) netif_xmit_stopped(netdev_get_tx_queue(dev, 0))
+#else
+#define RTL_NETDEV_SENT_QUEUE(dev, bytes) do {} while (0)
+#define RTL_NETDEV_COMPLETED_QUEUE(dev, pkts, bytes) do {} while (0)
+#define RTL_NETDEV_RESET_QUEUE(dev) do {} while (0)
+#define RTL_NETIF_XMIT_STOPPED(dev) netif_queue_stopped(dev)
+#endif
+
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,3,0)
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,0,0)
 #define netdev_features_t  u32
@@ -149,6 +169,10 @@ do { \
 #define ENABLE_R8168_PROCFS
 #endif
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,9,0)
+#define ENABLE_R8168_RX_PAGE
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
 #define NETIF_F_HW_VLAN_RX	NETIF_F_HW_VLAN_CTAG_RX
 #define NETIF_F_HW_VLAN_TX	NETIF_F_HW_VLAN_CTAG_TX
@@ -259,6 +283,12 @@ do { \
 //Hardware will continue interrupt 10 times after interrupt finished.
 #define RTK_KEEP_INTERRUPT_COUNT (10)
 
+//Adaptive interrupt moderation: the timer interrupt interval is picked from
+//the packet rate measured over at least R8168_MODER_SAMPLE_JIFFIES.
+#define R8168_MODER_SAMPLE_JIFFIES  (HZ / 20)
+#define R8168_MODER_LOW_PPS         5000
+#define R8168_MODER_HIGH_PPS        50000
+
 //Due to the hardware design of RTL8111B, the low 32 bit address of receive
 //buffer must be 8-byte alignment.
 #ifndef NET_IP_ALIGN
@@ -266,6 +296,18 @@ do { \
 #endif
 #define RTK_RX_ALIGN        8
 
+#ifdef ENABLE_R8168_RX_PAGE
+//Each mapped rx page is split into two buffers. Frames are handed to the
+//stack with build_skb() and the page flips to its other half, or is parked
+//in the per-ring pool until the stack drops it, so it is never remapped.
+#define R8168_RX_PAGE_BUF_TRUESIZE  (PAGE_SIZE / 2)
+#define R8168_RX_PAGE_HEADROOM      NET_SKB_PAD
+#define R8168_RX_PAGE_BUF_MAX       (R8168_RX_PAGE_BUF_TRUESIZE - \
+                                     R8168_RX_PAGE_HEADROOM - \
+                                     SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
+#define R8168_RX_PAGE_POOL_SIZE     128
+#endif //ENABLE_R8168_RX_PAGE
+
 #ifdef CONFIG_R8168_NAPI
 #define NAPI_SUFFIX "-NAPI"
 #else
@@ -1377,6 +1419,20 @@ struct ring_info {
         u8      __pad[sizeof(void *) - sizeof(u32)];
 };
 
+#ifdef ENABLE_R8168_RX_PAGE
+struct rtl8168_rx_buffer {
+        struct page *page;
+        dma_addr_t dma;
+        unsigned int page_offset;
+};
+
+struct rtl8168_rx_page_pool {
+        struct rtl8168_rx_buffer buf[R8168_RX_PAGE_POOL_SIZE];
+        u32 head;
+        u32 tail;
+};
+#endif //ENABLE_R8168_RX_PAGE
+
 struct pci_resource {
         u8  cmd;
         u8  cls;
@@ -1428,6 +1484,13 @@ struct rtl8168_private {
         struct sk_buff *Rx_skbuff[NUM_RX_DESC]; /* Rx data buffers */
         struct ring_info tx_skb[NUM_TX_DESC];   /* Tx data buffers */
         unsigned rx_buf_sz;
+#ifdef ENABLE_R8168_RX_PAGE
+        struct rtl8168_rx_buffer rx_buffer[NUM_RX_DESC]; /* Rx page buffers */
+        struct rtl8168_rx_page_pool rx_page_pool;
+        u8 rx_page_mode;
+        u64 rx_recycle_hit;
+        u64 rx_recycle_miss;
+#endif //ENABLE_R8168_RX_PAGE
         struct timer_list esd_timer;
         struct timer_list link_timer;
         struct pci_resource pci_cfg_space;
@@ -1483,6 +1546,10 @@ struct rtl8168_private {
 
         u32 keep_intr_cnt;
 
+        u32 intr_timer_count;   /* current timer interrupt interval */
+        u32 moder_pkts;
+        unsigned long moder_stamp;
+
         u8  HwIcVerUnknown;
         u8  NotWrRamCodeToMicroP;
         u8  NotWrMcuPatchCode;
@@ -318,6 +318,7 @@ MODULE_DEVICE_TABLE(pci, rtl8168_pci_tbl);
 static int rx_copybreak = 0;
 static int use_dac = 1;
 static int timer_count = 0x2600;
+static int adaptive_intr = 1;
 
 static struct {
         u32 msg_enable;
@@ -387,6 +388,9 @@ MODULE_PARM_DESC(use_dac, "Enable PCI DAC. Unsafe on 32 bit PCI slot.");
 module_param(timer_count, int, 0);
 MODULE_PARM_DESC(timer_count, "Timer Interrupt Interval.");
 
+module_param(adaptive_intr, int, 0);
+MODULE_PARM_DESC(adaptive_intr, "Scale the timer interrupt interval with the packet rate.");
+
 module_param(eee_enable, int, 0);
 MODULE_PARM_DESC(eee_enable, "Enable Energy Efficient Ethernet.");
 
@@ -823,6 +827,7 @@ static int proc_get_driver_variable(struct seq_file *m, void *v)
         seq_printf(m, "org_pci_offset_80\t0x%x\n", tp->org_pci_offset_80);
         seq_printf(m, "org_pci_offset_81\t0x%x\n", tp->org_pci_offset_81);
         seq_printf(m, "use_timer_interrrupt\t0x%x\n", tp->use_timer_interrrupt);
+        seq_printf(m, "intr_timer_count\t0x%x\n", tp->intr_timer_count);
         seq_printf(m, "HwIcVerUnknown\t0x%x\n", tp->HwIcVerUnknown);
         seq_printf(m, "NotWrRamCodeToMicroP\t0x%x\n", tp->NotWrRamCodeToMicroP);
         seq_printf(m, "NotWrMcuPatchCode\t0x%x\n", tp->NotWrMcuPatchCode);
@@ -1129,6 +1134,7 @@ static int proc_get_driver_variable(char *page, char **start,
                         "org_pci_offset_80\t0x%x\n"
                         "org_pci_offset_81\t0x%x\n"
                         "use_timer_interrrupt\t0x%x\n"
+                        "intr_timer_count\t0x%x\n"
                         "HwIcVerUnknown\t0x%x\n"
                         "NotWrRamCodeToMicroP\t0x%x\n"
                         "NotWrMcuPatchCode\t0x%x\n"
@@ -1203,6 +1209,7 @@ static int proc_get_driver_variable(char *page, char **start,
                         tp->org_pci_offset_80,
                         tp->org_pci_offset_81,
                         tp->use_timer_interrrupt,
+                        tp->intr_timer_count,
                         tp->HwIcVerUnknown,
                         tp->NotWrRamCodeToMicroP,
                         tp->NotWrMcuPatchCode,
@@ -3041,12 +3048,43 @@ rtl8168_switch_to_hw_interrupt(struct rtl8168_private *tp, void __iomem *ioaddr)
         rtl8168_enable_hw_interrupt(tp, ioaddr);
 }
 
+static void
+rtl8168_update_intr_moderation(struct rtl8168_private *tp)
+{
+        unsigned long elapsed = jiffies - tp->moder_stamp;
+        u64 rate;
+
+        if (!adaptive_intr || !tp->use_timer_interrrupt)
+                return;
+
+        if (elapsed < R8168_MODER_SAMPLE_JIFFIES)
+                return;
+
+        rate = div_u64((u64)tp->moder_pkts * HZ, elapsed);
+
+        /*
+         * Light traffic goes back to per-packet interrupts for latency,
+         * bulk traffic gets the full timer_count interval.
+         */
+        if (rate < R8168_MODER_LOW_PPS)
+                tp->intr_timer_count = 0;
+        else if (rate < R8168_MODER_HIGH_PPS)
+                tp->intr_timer_count = timer_count / 2;
+        else
+                tp->intr_timer_count = timer_count;
+
+        tp->moder_pkts = 0;
+        tp->moder_stamp = jiffies;
+}
+
 static inline void
 rtl8168_switch_to_timer_interrupt(struct rtl8168_private *tp, void __iomem *ioaddr)
 {
-        if (tp->use_timer_interrrupt) {
-                RTL_W32(TCTR, timer_count);
-                RTL_W32(TimeInt0, timer_count);
+        rtl8168_update_intr_moderation(tp);
+
+        if (tp->use_timer_interrrupt && tp->intr_timer_count) {
+                RTL_W32(TCTR, tp->intr_timer_count);
+                RTL_W32(TimeInt0, tp->intr_timer_count);
                 RTL_W16(IntrMask, tp->timer_intr_mask);
 
 #ifdef ENABLE_DASH_SUPPORT
@@ -3233,11 +3271,12 @@ static void rtl8168_mac_loopback_test(struct rtl8168_private *tp)
 {
         void __iomem *ioaddr = tp->mmio_addr;
         struct net_device *dev = tp->dev;
-        struct sk_buff *skb, *rx_skb;
-        dma_addr_t mapping;
+        struct sk_buff *skb;
+        dma_addr_t mapping, rx_mapping;
+        unsigned long rx_offset;
         struct TxDesc *txd;
         struct RxDesc *rxd;
-        void *tmpAddr;
+        void *tmpAddr, *rx_data;
         u32 len, rx_len, rx_cmd;
         u16 type;
         u8 pattern;
@@ -3251,7 +3290,18 @@ static void rtl8168_mac_loopback_test(struct rtl8168_private *tp)
         type = htons(ETH_P_IP);
         txd = tp->TxDescArray;
         rxd = tp->RxDescArray;
-        rx_skb = tp->Rx_skbuff[0];
+#ifdef ENABLE_R8168_RX_PAGE
+        if (tp->rx_page_mode) {
+                rx_mapping = tp->rx_buffer[0].dma;
+                rx_offset = tp->rx_buffer[0].page_offset + R8168_RX_PAGE_HEADROOM;
+                rx_data = page_address(tp->rx_buffer[0].page) + rx_offset;
+        } else
+#endif //ENABLE_R8168_RX_PAGE
+        {
+                rx_mapping = le64_to_cpu(rxd->addr);
+                rx_offset = 0;
+                rx_data = tp->Rx_skbuff[0]->data;
+        }
         RTL_W32(TxConfig, (RTL_R32(TxConfig) & ~0x00060000) | 0x00020000);
 
         do {
@@ -3299,9 +3349,9 @@ static void rtl8168_mac_loopback_test(struct rtl8168_private *tp)
                 pci_dma_sync_single_for_cpu(tp->pci_dev, le64_to_cpu(mapping), len, PCI_DMA_TODEVICE);
 
                 if (rx_len == len) {
-                        pci_dma_sync_single_for_cpu(tp->pci_dev, le64_to_cpu(rxd->addr), tp->rx_buf_sz, PCI_DMA_FROMDEVICE);
-                        i = memcmp(skb->data, rx_skb->data, rx_len);
-                        pci_dma_sync_single_for_device(tp->pci_dev, le64_to_cpu(rxd->addr), tp->rx_buf_sz, PCI_DMA_FROMDEVICE);
+                        dma_sync_single_range_for_cpu(&tp->pci_dev->dev, rx_mapping, rx_offset, tp->rx_buf_sz, DMA_FROM_DEVICE);
+                        i = memcmp(skb->data, rx_data, rx_len);
+                        dma_sync_single_range_for_device(&tp->pci_dev->dev, rx_mapping, rx_offset, tp->rx_buf_sz, DMA_FROM_DEVICE);
                         if (i == 0) {
 //              dev_printk(KERN_INFO, &tp->pci_dev->dev, "loopback test finished\n",rx_len,len);
                                 break;
@@ -5102,6 +5152,10 @@ static const char rtl8168_gstrings[][ETH_GSTRING_LEN] = {
         "multicast",
         "tx_aborted",
         "tx_underrun",
+#ifdef ENABLE_R8168_RX_PAGE
+        "rx_recycle_hit",
+        "rx_recycle_miss",
+#endif //ENABLE_R8168_RX_PAGE
 };
 #endif //#LINUX_VERSION_CODE > KERNEL_VERSION(2,4,22)
 
@@ -5174,6 +5228,10 @@ rtl8168_get_ethtool_stats(struct net_device *dev,
         data[10] = le32_to_cpu(counters->rx_multicast);
         data[11] = le16_to_cpu(counters->tx_aborted);
         data[12] = le16_to_cpu(counters->tx_underun);
+#ifdef ENABLE_R8168_RX_PAGE
+        data[13] = tp->rx_recycle_hit;
+        data[14] = tp->rx_recycle_miss;
+#endif //ENABLE_R8168_RX_PAGE
 }
 
 static void
@@ -23367,6 +23425,9 @@ rtl8168_init_software_variable(struct net_device *dev)
         if (timer_count == 0 || tp->mcfg == CFG_METHOD_DEFAULT)
                 tp->use_timer_interrrupt = FALSE;
 
+        tp->intr_timer_count = timer_count;
+        tp->moder_stamp = jiffies;
+
         switch (tp->mcfg) {
         case CFG_METHOD_1:
         case CFG_METHOD_2:
@@ -26675,6 +26736,138 @@ err_out:
         goto out;
 }
 
+#ifdef ENABLE_R8168_RX_PAGE
+static inline dma_addr_t
+rtl8168_rx_page_buf_dma(struct rtl8168_rx_buffer *rxb)
+{
+        return rxb->dma + rxb->page_offset + R8168_RX_PAGE_HEADROOM;
+}
+
+static inline bool
+rtl8168_rx_page_reusable(struct page *page)
+{
+        return !page_is_pfmemalloc(page) && page_to_nid(page) == numa_mem_id();
+}
+
+static void
+rtl8168_rx_page_release(struct rtl8168_private *tp,
+                        struct rtl8168_rx_buffer *rxb)
+{
+        /* The stack may still hold the other half, so leave the cache alone */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+        dma_unmap_page_attrs(&tp->pci_dev->dev, rxb->dma, PAGE_SIZE,
+                             DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+#else
+        dma_unmap_single_attrs(&tp->pci_dev->dev, rxb->dma, PAGE_SIZE,
+                               DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+#endif
+        put_page(rxb->page);
+        rxb->page = NULL;
+}
+
+static void
+rtl8168_rx_page_park(struct rtl8168_private *tp,
+                     struct rtl8168_rx_buffer *rxb)
+{
+        struct rtl8168_rx_page_pool *pool = &tp->rx_page_pool;
+
+        if (pool->tail - pool->head < R8168_RX_PAGE_POOL_SIZE &&
+            rtl8168_rx_page_reusable(rxb->page)) {
+                pool->buf[pool->tail++ % R8168_RX_PAGE_POOL_SIZE] = *rxb;
+                rxb->page = NULL;
+        } else {
+                rtl8168_rx_page_release(tp, rxb);
+        }
+}
+
+static void
+rtl8168_rx_page_pool_drain(struct rtl8168_private *tp)
+{
+        struct rtl8168_rx_page_pool *pool = &tp->rx_page_pool;
+
+        while (pool->head != pool->tail)
+                rtl8168_rx_page_release(tp, &pool->buf[pool->head++ %
+                                                       R8168_RX_PAGE_POOL_SIZE]);
+
+        pool->head = pool->tail = 0;
+}
+
+static int
+rtl8168_rx_page_get(struct rtl8168_private *tp,
+                    struct rtl8168_rx_buffer *rxb)
+{
+        struct rtl8168_rx_page_pool *pool = &tp->rx_page_pool;
+        struct page *page;
+        dma_addr_t mapping;
+
+        /*
+         * Pages are parked in the order they were handed to the stack, so
+         * the oldest one is the most likely to have been released already.
+         */
+        if (pool->head != pool->tail) {
+                struct rtl8168_rx_buffer *old;
+
+                old = &pool->buf[pool->head % R8168_RX_PAGE_POOL_SIZE];
+                if (page_count(old->page) == 1) {
+                        *rxb = *old;
+                        rxb->page_offset = 0;
+                        pool->head++;
+                        dma_sync_single_range_for_device(&tp->pci_dev->dev,
+                                                         rxb->dma,
+                                                         R8168_RX_PAGE_HEADROOM,
+                                                         tp->rx_buf_sz,
+                                                         DMA_FROM_DEVICE);
+                        tp->rx_recycle_hit++;
+                        return 0;
+                }
+        }
+
+        page = dev_alloc_page();
+        if (unlikely(!page))
+                return -ENOMEM;
+
+        mapping = dma_map_page(&tp->pci_dev->dev, page, 0, PAGE_SIZE,
+                               DMA_FROM_DEVICE);
+        if (unlikely(dma_mapping_error(&tp->pci_dev->dev, mapping))) {
+                if (unlikely(net_ratelimit()))
+                        netif_err(tp, drv, tp->dev, "Failed to map RX DMA!\n");
+                put_page(page);
+                return -ENOMEM;
+        }
+
+        rxb->page = page;
+        rxb->dma = mapping;
+        rxb->page_offset = 0;
+        tp->rx_recycle_miss++;
+        return 0;
+}
+
+static int
+rtl8168_alloc_rx_page(struct rtl8168_private *tp,
+                      struct rtl8168_rx_buffer *rxb,
+                      struct RxDesc *desc)
+{
+        if (unlikely(rtl8168_rx_page_get(tp, rxb) < 0)) {
+                rtl8168_make_unusable_by_asic(desc);
+                return -ENOMEM;
+        }
+
+        rtl8168_map_to_asic(desc, rtl8168_rx_page_buf_dma(rxb), tp->rx_buf_sz);
+        return 0;
+}
+
+static inline void
+rtl8168_rx_page_rearm(struct rtl8168_private *tp,
+                      struct rtl8168_rx_buffer *rxb,
+                      struct RxDesc *desc)
+{
+        dma_sync_single_range_for_device(&tp->pci_dev->dev, rxb->dma,
+                                         rxb->page_offset + R8168_RX_PAGE_HEADROOM,
+                                         tp->rx_buf_sz, DMA_FROM_DEVICE);
+        rtl8168_map_to_asic(desc, rtl8168_rx_page_buf_dma(rxb), tp->rx_buf_sz);
+}
+#endif //ENABLE_R8168_RX_PAGE
+
 static void
 rtl8168_rx_clear(struct rtl8168_private *tp)
 {
@@ -26684,7 +26877,17 @@ rtl8168_rx_clear(struct rtl8168_private *tp)
                 if (tp->Rx_skbuff[i])
                         rtl8168_free_rx_skb(tp, tp->Rx_skbuff + i,
                                             tp->RxDescArray + i);
+#ifdef ENABLE_R8168_RX_PAGE
+                if (tp->rx_buffer[i].page) {
+                        rtl8168_rx_page_release(tp, tp->rx_buffer + i);
+                        rtl8168_make_unusable_by_asic(tp->RxDescArray + i);
+                }
+#endif //ENABLE_R8168_RX_PAGE
         }
+
+#ifdef ENABLE_R8168_RX_PAGE
+        rtl8168_rx_page_pool_drain(tp);
+#endif //ENABLE_R8168_RX_PAGE
 }
 
 static u32
@@ -26699,6 +26902,19 @@ rtl8168_rx_fill(struct rtl8168_private *tp,
         for (cur = start; end - cur > 0; cur++) {
                 int ret, i = cur % NUM_RX_DESC;
 
+#ifdef ENABLE_R8168_RX_PAGE
+                if (tp->rx_page_mode) {
+                        if (tp->rx_buffer[i].page)
+                                continue;
+
+                        ret = rtl8168_alloc_rx_page(tp, tp->rx_buffer + i,
+                                                    tp->RxDescArray + i);
+                        if (ret < 0)
+                                break;
+                        continue;
+                }
+#endif //ENABLE_R8168_RX_PAGE
+
                 if (tp->Rx_skbuff[i])
                         continue;
 
@@ -26777,6 +26993,10 @@ rtl8168_init_ring(struct net_device *dev)
 
         memset(tp->tx_skb, 0x0, NUM_TX_DESC * sizeof(struct ring_info));
         memset(tp->Rx_skbuff, 0x0, NUM_RX_DESC * sizeof(struct sk_buff *));
+#ifdef ENABLE_R8168_RX_PAGE
+        memset(tp->rx_buffer, 0x0, NUM_RX_DESC * sizeof(struct rtl8168_rx_buffer));
+        tp->rx_page_mode = (tp->rx_buf_sz <= R8168_RX_PAGE_BUF_MAX);
+#endif //ENABLE_R8168_RX_PAGE
 
         rtl8168_tx_desc_init(tp);
         rtl8168_rx_desc_init(tp);
@@ -26839,6 +27059,7 @@ rtl8168_tx_clear(struct rtl8168_private *tp)
 {
         rtl8168_tx_clear_range(tp, tp->dirty_tx, NUM_TX_DESC);
         tp->cur_tx = tp->dirty_tx = 0;
+        RTL_NETDEV_RESET_QUEUE(tp->dev);
 }
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,20)
@@ -27268,6 +27489,7 @@ rtl8168_start_xmit(struct sk_buff *skb,
         u32 opts2;
         int ret = NETDEV_TX_OK;
         unsigned long flags, large_send;
+        unsigned int bytes = skb->len;
         int frags;
 
         spin_lock_irqsave(&tp->lock, flags);
@@ -27397,9 +27619,9 @@ rtl8168_start_xmit(struct sk_buff *skb,
 
         tp->cur_tx += frags + 1;
 
-        wmb();
+        RTL_NETDEV_SENT_QUEUE(dev, bytes);
 
-        RTL_W8(TxPoll, NPQ);    /* set polling bit */
+        wmb();
 
         if (TX_BUFFS_AVAIL(tp) < MAX_SKB_FRAGS) {
                 netif_stop_queue(dev);
@@ -27408,6 +27630,13 @@ rtl8168_start_xmit(struct sk_buff *skb,
                         netif_wake_queue(dev);
         }
 
+        /*
+         * Defer the doorbell while the stack has more frames queued for
+         * us; it will be rung by the last one or once the queue stops.
+         */
+        if (!RTL_XMIT_MORE(skb) || RTL_NETIF_XMIT_STOPPED(dev))
+                RTL_W8(TxPoll, NPQ);    /* set polling bit */
+
         spin_unlock_irqrestore(&tp->lock, flags);
 out:
         return ret;
@@ -27416,12 +27645,16 @@ err_dma_1:
         rtl8168_tx_clear_range(tp, tp->cur_tx + 1, frags);
 err_dma_0:
         RTLDEV->stats.tx_dropped++;
+        /* frames queued earlier may still be waiting for the doorbell */
+        if (!RTL_XMIT_MORE(skb))
+                RTL_W8(TxPoll, NPQ);
         spin_unlock_irqrestore(&tp->lock, flags);
         dev_kfree_skb_any(skb);
         ret = NETDEV_TX_OK;
         goto out;
 err_stop:
         netif_stop_queue(dev);
+        RTL_W8(TxPoll, NPQ);
         ret = NETDEV_TX_BUSY;
         RTLDEV->stats.tx_dropped++;
 
@@ -27435,6 +27668,7 @@ rtl8168_tx_interrupt(struct net_device *dev,
                      void __iomem *ioaddr)
 {
         unsigned int dirty_tx, tx_left;
+        unsigned int pkts_compl = 0, bytes_compl = 0, len_compl = 0;
 
         assert(dev != NULL);
         assert(tp != NULL);
@@ -27447,7 +27681,6 @@ rtl8168_tx_interrupt(struct net_device *dev,
         while (tx_left > 0) {
                 unsigned int entry = dirty_tx % NUM_TX_DESC;
                 struct ring_info *tx_skb = tp->tx_skb + entry;
-                u32 len = tx_skb->len;
                 u32 status;
 
                 rmb();
@@ -27455,14 +27688,15 @@ rtl8168_tx_interrupt(struct net_device *dev,
                 if (status & DescOwn)
                         break;
 
-                RTLDEV->stats.tx_bytes += len;
-                RTLDEV->stats.tx_packets++;
+                len_compl += tx_skb->len;
 
                 rtl8168_unmap_tx_skb(tp->pci_dev,
                                      tx_skb,
                                      tp->TxDescArray + entry);
 
                 if (tx_skb->skb!=NULL) {
+                        pkts_compl++;
+                        bytes_compl += tx_skb->skb->len;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)
                         dev_consume_skb_any(tx_skb->skb);
 #else
@@ -27475,6 +27709,11 @@ rtl8168_tx_interrupt(struct net_device *dev,
         }
 
         if (tp->dirty_tx != dirty_tx) {
+                RTLDEV->stats.tx_bytes += len_compl;
+                RTLDEV->stats.tx_packets += pkts_compl;
+                tp->moder_pkts += pkts_compl;
+                RTL_NETDEV_COMPLETED_QUEUE(dev, pkts_compl, bytes_compl);
+
                 tp->dirty_tx = dirty_tx;
                 smp_wmb();
                 if (netif_queue_stopped(dev) &&
@@ -27557,6 +27796,70 @@ rtl8168_try_rx_copy(struct rtl8168_private *tp,
         return ret;
 }
 
+#ifdef ENABLE_R8168_RX_PAGE
+static struct sk_buff *
+rtl8168_rx_page_skb(struct rtl8168_private *tp,
+                    struct rtl8168_rx_buffer *rxb,
+                    struct RxDesc *desc,
+                    int pkt_size)
+{
+        struct page *page = rxb->page;
+        struct sk_buff *skb;
+        bool reuse;
+        void *va;
+
+        dma_sync_single_range_for_cpu(&tp->pci_dev->dev, rxb->dma,
+                                      rxb->page_offset + R8168_RX_PAGE_HEADROOM,
+                                      pkt_size, DMA_FROM_DEVICE);
+
+        va = page_address(page) + rxb->page_offset;
+        prefetch(va + R8168_RX_PAGE_HEADROOM);
+
+        if (pkt_size < rx_copybreak) {
+                skb = RTL_ALLOC_SKB_INTR(tp, pkt_size + RTK_RX_ALIGN);
+                if (skb) {
+                        skb_reserve(skb, RTK_RX_ALIGN);
+                        memcpy(skb->data, va + R8168_RX_PAGE_HEADROOM, pkt_size);
+                        if (tp->cp_cmd & RxChkSum)
+                                rtl8168_rx_csum(tp, skb, desc);
+                }
+                rtl8168_rx_page_rearm(tp, rxb, desc);
+                return skb;
+        }
+
+        skb = build_skb(va, R8168_RX_PAGE_BUF_TRUESIZE);
+        if (unlikely(!skb)) {
+                rtl8168_rx_page_rearm(tp, rxb, desc);
+                return NULL;
+        }
+        skb_reserve(skb, R8168_RX_PAGE_HEADROOM);
+
+        if (tp->cp_cmd & RxChkSum)
+                rtl8168_rx_csum(tp, skb, desc);
+
+        /*
+         * If nobody else holds the page, the other half is free and can be
+         * given straight back to the hardware. Otherwise park the page until
+         * the stack lets go of it and refill this slot from the pool.
+         */
+        reuse = page_count(page) == 1 && rtl8168_rx_page_reusable(page);
+
+        /* reference owned by the skb */
+        get_page(page);
+
+        if (reuse) {
+                rxb->page_offset ^= R8168_RX_PAGE_BUF_TRUESIZE;
+                rtl8168_rx_page_rearm(tp, rxb, desc);
+                tp->rx_recycle_hit++;
+        } else {
+                rtl8168_rx_page_park(tp, rxb);
+                rtl8168_make_unusable_by_asic(desc);
+        }
+
+        return skb;
+}
+#endif //ENABLE_R8168_RX_PAGE
+
 static inline void
 rtl8168_rx_skb(struct rtl8168_private *tp,
                struct sk_buff *skb)
@@ -27644,24 +27947,37 @@ process_pkt:
                                 continue;
                         }
 
-                        skb = tp->Rx_skbuff[entry];
-                        if (tp->cp_cmd & RxChkSum)
-                                rtl8168_rx_csum(tp, skb, desc);
-
-                        pci_dma_sync_single_for_cpu(tp->pci_dev,
-                                                    le64_to_cpu(desc->addr), tp->rx_buf_sz,
-                                                    PCI_DMA_FROMDEVICE);
+#ifdef ENABLE_R8168_RX_PAGE
+                        if (tp->rx_page_mode) {
+                                skb = rtl8168_rx_page_skb(tp,
+                                                          tp->rx_buffer + entry,
+                                                          desc, pkt_size);
+                                if (unlikely(!skb)) {
+                                        RTLDEV->stats.rx_dropped++;
+                                        goto next_desc;
+                                }
+                        } else
+#endif //ENABLE_R8168_RX_PAGE
+                        {
+                                skb = tp->Rx_skbuff[entry];
+                                if (tp->cp_cmd & RxChkSum)
+                                        rtl8168_rx_csum(tp, skb, desc);
+
+                                pci_dma_sync_single_for_cpu(tp->pci_dev,
+                                                            le64_to_cpu(desc->addr), tp->rx_buf_sz,
+                                                            PCI_DMA_FROMDEVICE);
+
+                                pci_action = pci_dma_sync_single_for_device;
+                                if (rtl8168_try_rx_copy(tp, &skb, pkt_size,
+                                                        desc, tp->rx_buf_sz)) {
+                                        pci_action = pci_unmap_single;
+                                        tp->Rx_skbuff[entry] = NULL;
+                                }
 
-                        pci_action = pci_dma_sync_single_for_device;
-                        if (rtl8168_try_rx_copy(tp, &skb, pkt_size,
-                                                desc, tp->rx_buf_sz)) {
-                                pci_action = pci_unmap_single;
-                                tp->Rx_skbuff[entry] = NULL;
+                                pci_action(tp->pci_dev, le64_to_cpu(desc->addr),
+                                           tp->rx_buf_sz, PCI_DMA_FROMDEVICE);
                         }
 
-                        pci_action(tp->pci_dev, le64_to_cpu(desc->addr),
-                                   tp->rx_buf_sz, PCI_DMA_FROMDEVICE);
-
                         skb->dev = dev;
                         skb_put(skb, pkt_size);
                         skb->protocol = eth_type_trans(skb, dev);
@@ -27678,6 +27994,9 @@ process_pkt:
                         RTLDEV->stats.rx_packets++;
                 }
 
+#ifdef ENABLE_R8168_RX_PAGE
+next_desc:
+#endif //ENABLE_R8168_RX_PAGE
                 cur_rx++;
                 entry = cur_rx % NUM_RX_DESC;
                 desc = tp->RxDescArray + entry;
@@ -27688,6 +28007,7 @@ process_pkt:
 
         count = cur_rx - tp->cur_rx;
         tp->cur_rx = cur_rx;
+        tp->moder_pkts += count;
 
         delta = rtl8168_rx_fill(tp, dev, tp->dirty_rx, tp->cur_rx, 1);
         if (!delta && count && netif_msg_intr(tp))
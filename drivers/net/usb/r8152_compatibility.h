@@ -13,6 +13,9 @@
 #include <linux/mdio.h>
 #endif
 
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,19,0)
+	#define napi_alloc_skb(napi, length) \
+		netdev_alloc_skb_ip_align((napi)->dev, length)
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,14,0)
 	#define ether_addr_copy(dst, src)		memcpy(dst, src, ETH_ALEN)
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,10,0)
@@ -33,6 +36,8 @@
 	#define MDIO_EEE_1000T				0x0004	/* 1000T EEE cap */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,4,0)
 	#define ETH_MDIO_SUPPORTS_C22			MDIO_SUPPORTS_C22
+	#define skb_add_rx_frag(skb, i, page, off, size, truesize) \
+		skb_add_rx_frag(skb, i, page, off, size)
 
 	static inline void eth_hw_addr_random(struct net_device *dev)
 	{
@@ -136,6 +141,8 @@
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,31)
 	#define USB_SPEED_SUPER		(USB_SPEED_VARIABLE + 1)
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,29)
+	#define napi_gro_receive(napi, skb)		netif_receive_skb(skb)
+
 	static inline void usb_autopm_put_interface_async(struct usb_interface *intf)
 	{
 		struct usb_device *udev = interface_to_usbdev(intf);
@@ -315,6 +322,7 @@
 #endif /* LINUX_VERSION_CODE < KERNEL_VERSION(3,8,0) */
 #endif /* LINUX_VERSION_CODE < KERNEL_VERSION(3,10,0) */
 #endif /* LINUX_VERSION_CODE < KERNEL_VERSION(3,14,0) */
+#endif /* LINUX_VERSION_CODE < KERNEL_VERSION(3,19,0) */
 
 #ifndef FALSE
 	#define TRUE	1
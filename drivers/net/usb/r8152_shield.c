@@ -344,6 +344,7 @@
 #endif
 #define EARLY_AGG_HIGH		0x0e837a12
 #define EARLY_AGG_SLOW		0x0e83ffff
+#define EARLY_AGG_TIMEOUT_MASK	0x0000ffff
 
 /* USB_WDT11_CTRL */
 #define TIMER11_EN		0x0001
@@ -464,7 +465,12 @@ enum rtl_register_content {
 #define RTL8153_RMS		RTL8153_MAX_PACKET
 #define RTL8152_TX_TIMEOUT	(5 * HZ)
 #define AGG_BUF_SZ		16384 /* 16K */
-#define RX_THRESHOLD_CLONED	(AGG_BUF_SZ / 1)
+#define RTL8152_NAPI_WEIGHT	64
+#define RTL8152_RXFG_HEADSZ	256
+#define RTL8152_MAX_RX_SPARE	16
+#define RX_AGG_ADAPT_INTERVAL	(HZ / 4)
+#define RX_AGG_BULK_PKTS	8
+#define RX_AGG_LIGHT_PKTS	2
 
 /* rtl8152 flags */
 enum rtl8152_flags {
@@ -474,7 +480,8 @@ enum rtl8152_flags {
 	RTL8152_LINK_CHG,
 	SELECTIVE_SUSPEND,
 	PHY_RESET,
-	SCHEDULE_TASKLET,
+	SCHEDULE_NAPI,
+	RX_EARLY_AGG_CHG,
 };
 
 /* Define these values to match your device */
@@ -553,7 +560,8 @@ struct rx_agg {
 	struct list_head list;
 	struct urb *urb;
 	struct r8152 *context;
-	struct sk_buff *skb;
+	struct page *page;
+	void *head;
 };
 
 struct tx_agg {
@@ -569,14 +577,16 @@ struct tx_agg {
 struct r8152 {
 	unsigned long flags;
 	struct usb_device *udev;
-	struct tasklet_struct tl;
+	struct napi_struct napi;
 	struct usb_interface *intf;
 	struct net_device *netdev;
 	struct urb *intr_urb;
 	struct tx_agg tx_info[RTL8152_MAX_TX];
 	struct rx_agg rx_info[RTL8152_MAX_RX];
-	struct list_head rx_done, tx_free;
-	struct sk_buff_head tx_queue;
+	struct list_head rx_done, rx_wait, tx_free;
+	struct sk_buff_head tx_queue, rx_queue;
+	struct page *rx_spare[RTL8152_MAX_RX_SPARE];
+	u32 rx_spare_head, rx_spare_tail;
 	spinlock_t rx_lock, tx_lock;
 	struct delayed_work schedule;
 	struct mii_if_info mii;
@@ -605,10 +615,14 @@ struct r8152 {
 	u32 saved_wolopts;
 	u32 msg_enable;
 	u32 tx_qlen;
+	u32 rx_early_agg;	/* USB_RX_EARLY_AGG for the current speed */
+	u32 rx_agg_pkts;	/* packets per aggregate, EWMA scaled by 8 */
+	unsigned long rx_agg_stamp;
 	u16 ocp_base;
 	u8 *intr_buff;
 	u8 version;
 	u8 speed;
+	u8 rx_agg_level;	/* early agg timeout is shifted right by this */
 	u8 rtk_enable_diag;
 };
 
@@ -1186,7 +1200,7 @@ static void read_bulk_callback(struct urb *urb)
 		spin_lock(&tp->rx_lock);
 		list_add_tail(&agg->list, &tp->rx_done);
 		spin_unlock(&tp->rx_lock);
-		tasklet_schedule(&tp->tl);
+		napi_schedule(&tp->napi);
 		return;
 	case -ESHUTDOWN:
 		set_bit(RTL8152_UNPLUG, &tp->flags);
@@ -1253,7 +1267,7 @@ static void write_bulk_callback(struct urb *urb)
 		return;
 
 	if (!skb_queue_empty(&tp->tx_queue))
-		tasklet_schedule(&tp->tl);
+		napi_schedule(&tp->napi);
 }
 
 static void intr_callback(struct urb *urb)
@@ -1335,10 +1349,19 @@ static void free_all_mem(struct r8152 *tp)
 		usb_free_urb(tp->rx_info[i].urb);
 		tp->rx_info[i].urb = NULL;
 
-		kfree_skb(tp->rx_info[i].skb);
-		tp->rx_info[i].skb = NULL;
+		if (tp->rx_info[i].page)
+			put_page(tp->rx_info[i].page);
+		tp->rx_info[i].page = NULL;
+		tp->rx_info[i].head = NULL;
 	}
 
+	__skb_queue_purge(&tp->rx_queue);
+
+	while (tp->rx_spare_head != tp->rx_spare_tail)
+		put_page(tp->rx_spare[tp->rx_spare_head++ %
+				      RTL8152_MAX_RX_SPARE]);
+	tp->rx_spare_head = tp->rx_spare_tail = 0;
+
 	for (i = 0; i < RTL8152_MAX_TX; i++) {
 		usb_free_urb(tp->tx_info[i].urb);
 		tp->tx_info[i].urb = NULL;
@@ -1355,29 +1378,55 @@ static void free_all_mem(struct r8152 *tp)
 	tp->intr_buff = NULL;
 }
 
-static struct sk_buff *rtl_alloc_rx_skb(struct r8152 *tp, gfp_t gfp_mask)
+static struct page *rtl_alloc_rx_page(struct r8152 *tp, gfp_t gfp_mask)
 {
-	struct net_device *netdev = tp->netdev;
-	struct sk_buff *skb;
+	return alloc_pages(gfp_mask | __GFP_COMP | __GFP_NOWARN,
+			   get_order(AGG_BUF_SZ));
+}
 
-	skb = __netdev_alloc_skb(netdev, AGG_BUF_SZ, gfp_mask);
-	if (!skb)
-		goto out1;
+/* Pages are parked in the order the stack got them, so the oldest one is
+ * the most likely to have been released already.
+ */
+static struct page *rtl_get_spare_page(struct r8152 *tp)
+{
+	u32 head = tp->rx_spare_head % RTL8152_MAX_RX_SPARE;
 
-	if (skb->data != rx_agg_align(skb->data)) {
-		int rl;
+	if (tp->rx_spare_head != tp->rx_spare_tail &&
+	    page_count(tp->rx_spare[head]) == 1) {
+		tp->rx_spare_head++;
+		return tp->rx_spare[head];
+	}
 
-		kfree_skb(skb);
-		skb = __netdev_alloc_skb(netdev, AGG_BUF_SZ + RX_ALIGN,
-					 gfp_mask);
-		if (!skb)
-			goto out1;
+	return rtl_alloc_rx_page(tp, GFP_ATOMIC);
+}
 
-		rl = (int)(rx_agg_align(skb->data) - (void *)skb->data);
-		skb_reserve(skb, rl);
-	}
-out1:
-	return skb;
+static void rtl_put_spare_page(struct r8152 *tp, struct page *page)
+{
+	if (tp->rx_spare_tail - tp->rx_spare_head < RTL8152_MAX_RX_SPARE)
+		tp->rx_spare[tp->rx_spare_tail++ % RTL8152_MAX_RX_SPARE] = page;
+	else
+		put_page(page);
+}
+
+/* The aggregation buffer may only be handed back to the device once no skb
+ * points into it any more; otherwise swap in a spare page.
+ */
+static int rtl_rx_agg_recycle(struct r8152 *tp, struct rx_agg *agg)
+{
+	struct page *page;
+
+	if (page_count(agg->page) == 1)
+		return 0;
+
+	page = rtl_get_spare_page(tp);
+	if (!page)
+		return -ENOMEM;
+
+	rtl_put_spare_page(tp, agg->page);
+	agg->page = page;
+	agg->head = page_address(page);
+
+	return 0;
 }
 
 static int alloc_all_mem(struct r8152 *tp)
@@ -1395,24 +1444,27 @@ static int alloc_all_mem(struct r8152 *tp)
 	spin_lock_init(&tp->tx_lock);
 	INIT_LIST_HEAD(&tp->tx_free);
 	skb_queue_head_init(&tp->tx_queue);
+	skb_queue_head_init(&tp->rx_queue);
+	tp->rx_spare_head = tp->rx_spare_tail = 0;
 
 	for (i = 0; i < RTL8152_MAX_RX; i++) {
-		struct sk_buff *skb;
+		struct page *page;
 
-		skb = rtl_alloc_rx_skb(tp, GFP_KERNEL);
-		if (!skb)
+		page = rtl_alloc_rx_page(tp, GFP_KERNEL);
+		if (!page)
 			goto err1;
 
 		urb = usb_alloc_urb(0, GFP_KERNEL);
 		if (!urb) {
-			kfree_skb(skb);
+			put_page(page);
 			goto err1;
 		}
 
 		INIT_LIST_HEAD(&tp->rx_info[i].list);
 		tp->rx_info[i].context = tp;
 		tp->rx_info[i].urb = urb;
-		tp->rx_info[i].skb = skb;
+		tp->rx_info[i].page = page;
+		tp->rx_info[i].head = page_address(page);
 	}
 
 	for (i = 0; i < RTL8152_MAX_TX; i++) {
@@ -1806,28 +1858,98 @@ return_result:
 	return checksum;
 }
 
-static void rx_bottom(struct r8152 *tp)
+static struct sk_buff *rtl_rx_agg_skb(struct r8152 *tp, struct rx_agg *agg,
+				      u8 *rx_data, unsigned int pkt_len)
+{
+	unsigned int len = min_t(unsigned int, pkt_len, RTL8152_RXFG_HEADSZ);
+	struct sk_buff *skb;
+
+	/* Only the headers are copied; the payload stays in the aggregation
+	 * buffer and is attached as a page fragment.
+	 */
+	skb = napi_alloc_skb(&tp->napi, len);
+	if (!skb)
+		return NULL;
+
+	memcpy(skb->data, rx_data, len);
+	skb_put(skb, len);
+
+	if (pkt_len > len) {
+		get_page(agg->page);
+		skb_add_rx_frag(skb, 0, agg->page,
+				(int)(rx_data + len - (u8 *)agg->head),
+				pkt_len - len, SKB_DATA_ALIGN(pkt_len - len));
+	}
+
+	return skb;
+}
+
+static void rtl_rx_agg_adapt(struct r8152 *tp, unsigned int pkts)
+{
+	u32 avg;
+	u8 level;
+
+	tp->rx_agg_pkts += pkts - (tp->rx_agg_pkts >> 3);
+
+	/* only RTL8153 programs an early aggregation timeout */
+	if (!tp->rx_early_agg ||
+	    time_before(jiffies, tp->rx_agg_stamp + RX_AGG_ADAPT_INTERVAL))
+		return;
+
+	tp->rx_agg_stamp = jiffies;
+
+	/* Bulk traffic fills the aggregates and gets the full timeout. Light
+	 * traffic gets a shorter one so single frames are not held back.
+	 */
+	avg = tp->rx_agg_pkts >> 3;
+	if (avg >= RX_AGG_BULK_PKTS)
+		level = 0;
+	else if (avg >= RX_AGG_LIGHT_PKTS)
+		level = 1;
+	else
+		level = 2;
+
+	if (level != tp->rx_agg_level) {
+		tp->rx_agg_level = level;
+		set_bit(RX_EARLY_AGG_CHG, &tp->flags);
+		schedule_delayed_work(&tp->schedule, 0);
+	}
+}
+
+static int rx_bottom(struct r8152 *tp, int budget)
 {
 	unsigned long flags;
 	struct list_head *cursor, *next, rx_queue;
+	int work_done = 0;
 
-	if (list_empty(&tp->rx_done))
-		return;
+	/* frames left over from the previous poll go first */
+	while (work_done < budget && !skb_queue_empty(&tp->rx_queue)) {
+		napi_gro_receive(&tp->napi, __skb_dequeue(&tp->rx_queue));
+		work_done++;
+	}
 
+	if ((list_empty(&tp->rx_done) && list_empty(&tp->rx_wait)) ||
+	    work_done >= budget)
+		return work_done;
+
+	/* aggregates still waiting for a spare page get another try first */
 	INIT_LIST_HEAD(&rx_queue);
 	spin_lock_irqsave(&tp->rx_lock, flags);
-	list_splice_init(&tp->rx_done, &rx_queue);
+	list_splice_init(&tp->rx_wait, &rx_queue);
+	list_splice_tail_init(&tp->rx_done, &rx_queue);
 	spin_unlock_irqrestore(&tp->rx_lock, flags);
 
 	list_for_each_safe(cursor, next, &rx_queue) {
 		struct rx_desc *rx_desc;
-		struct sk_buff *rx_skb;
-		bool cloned = false;
 		struct rx_agg *agg;
+		unsigned int pkts = 0;
 		int len_used = 0;
 		struct urb *urb;
 		u8 *rx_data;
 
+		if (work_done >= budget)
+			break;
+
 		list_del_init(cursor);
 
 		agg = list_entry(cursor, struct rx_agg, list);
@@ -1835,21 +1957,10 @@ static void rx_bottom(struct r8152 *tp)
 		if (urb->actual_length < ETH_ZLEN)
 			goto submit;
 
-		rx_skb = agg->skb;
-		rx_desc = (struct rx_desc *)rx_skb->data;
-		rx_data = rx_skb->data;
+		rx_desc = agg->head;
+		rx_data = agg->head;
 		len_used += sizeof(struct rx_desc);
 
-		if (urb->actual_length > RX_THRESHOLD_CLONED) {
-			struct sk_buff *new_skb;
-
-			new_skb = rtl_alloc_rx_skb(tp, GFP_ATOMIC);
-			if (new_skb) {
-				agg->skb = new_skb;
-				cloned = true;
-			}
-		}
-
 		while (urb->actual_length > len_used) {
 			struct net_device *netdev = tp->netdev;
 			struct net_device_stats *stats;
@@ -1869,52 +1980,70 @@ static void rx_bottom(struct r8152 *tp)
 			pkt_len -= CRC_SIZE;
 			rx_data += sizeof(struct rx_desc);
 
-			if (cloned)
-				skb = skb_clone(rx_skb, GFP_ATOMIC);
-			else
-				skb = netdev_alloc_skb_ip_align(netdev,
-								pkt_len);
+			skb = rtl_rx_agg_skb(tp, agg, rx_data, pkt_len);
 			if (!skb) {
 				stats->rx_dropped++;
 				goto find_next_rx;
 			}
 
 			skb->ip_summed = r8152_rx_csum(tp, rx_desc);
-
-			if (cloned)
-				skb_reserve(skb, (int)(rx_data - rx_skb->data));
-			else
-				memcpy(skb->data, rx_data, pkt_len);
-
-			skb_put(skb, pkt_len);
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,22)
 			skb->dev = netdev;
 #endif
 			skb->protocol = eth_type_trans(skb, netdev);
 
-			if (!rtl_rx_vlan_tag(tp, rx_desc, skb))
-				netif_receive_skb(skb);
-
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,29)
 			netdev->last_rx = jiffies;
 #endif
 			stats->rx_packets++;
 			stats->rx_bytes += pkt_len;
+			pkts++;
+
+			if (rtl_rx_vlan_tag(tp, rx_desc, skb))
+				goto find_next_rx;
+
+			if (work_done < budget) {
+				napi_gro_receive(&tp->napi, skb);
+				work_done++;
+			} else {
+				__skb_queue_tail(&tp->rx_queue, skb);
+			}
 
 find_next_rx:
 			rx_data = rx_agg_align(rx_data + pkt_len + CRC_SIZE);
 			rx_desc = (struct rx_desc *)rx_data;
-			len_used = (int)(rx_data - rx_skb->data);
+			len_used = (int)(rx_data - (u8 *)agg->head);
 			len_used += sizeof(struct rx_desc);
 		}
 
-		/* free the cloned skb */
-		if (cloned)
-			kfree_skb(rx_skb);
+		rtl_rx_agg_adapt(tp, pkts);
 
 submit:
+		if (rtl_rx_agg_recycle(tp, agg)) {
+			/* no buffer to give the device, the frames in it have
+			 * been consumed. Park it for the delayed work, so the
+			 * poll doesn't spin on the allocation.
+			 */
+			urb->actual_length = 0;
+			spin_lock_irqsave(&tp->rx_lock, flags);
+			list_add_tail(&agg->list, &tp->rx_wait);
+			spin_unlock_irqrestore(&tp->rx_lock, flags);
+			set_bit(SCHEDULE_NAPI, &tp->flags);
+			schedule_delayed_work(&tp->schedule, 1);
+			continue;
+		}
+
 		r8152_submit_rx(tp, agg, GFP_ATOMIC);
 	}
+
+	/* aggregates not reached within the budget wait for the next poll */
+	if (!list_empty(&rx_queue)) {
+		spin_lock_irqsave(&tp->rx_lock, flags);
+		list_splice(&rx_queue, &tp->rx_done);
+		spin_unlock_irqrestore(&tp->rx_lock, flags);
+	}
+
+	return work_done;
 }
 
 static void tx_bottom(struct r8152 *tp)
@@ -1955,38 +2084,46 @@ static void tx_bottom(struct r8152 *tp)
 	} while (res == 0);
 }
 
-static void bottom_half(unsigned long data)
+static int r8152_poll(struct napi_struct *napi, int budget)
 {
-	struct r8152 *tp;
-
-	tp = (struct r8152 *)data;
-
-	if (test_bit(RTL8152_UNPLUG, &tp->flags))
-		return;
-
-	if (!test_bit(WORK_ENABLE, &tp->flags))
-		return;
+	struct r8152 *tp = container_of(napi, struct r8152, napi);
+	int work_done;
 
 	/* When link down, the driver would cancel all bulks. */
 	/* This avoid the re-submitting bulk */
-	if (!netif_carrier_ok(tp->netdev))
-		return;
+	if (test_bit(RTL8152_UNPLUG, &tp->flags) ||
+	    !test_bit(WORK_ENABLE, &tp->flags) ||
+	    !netif_carrier_ok(tp->netdev)) {
+		napi_complete(napi);
+		return 0;
+	}
 
-	if (test_bit(SCHEDULE_TASKLET, &tp->flags))
-		clear_bit(SCHEDULE_TASKLET, &tp->flags);
+	if (test_bit(SCHEDULE_NAPI, &tp->flags))
+		clear_bit(SCHEDULE_NAPI, &tp->flags);
 
-	rx_bottom(tp);
+	work_done = rx_bottom(tp, budget);
 	tx_bottom(tp);
+
+	if (work_done < budget) {
+		napi_complete(napi);
+
+		/* pick up completions that raced with napi_complete() */
+		if (!list_empty(&tp->rx_done) ||
+		    (!skb_queue_empty(&tp->tx_queue) &&
+		     !list_empty(&tp->tx_free)))
+			napi_schedule(napi);
+	}
+
+	return work_done;
 }
 
 static
 int r8152_submit_rx(struct r8152 *tp, struct rx_agg *agg, gfp_t mem_flags)
 {
-	struct sk_buff *skb = agg->skb;
 	int ret = 0;
 
 	usb_fill_bulk_urb(agg->urb, tp->udev, usb_rcvbulkpipe(tp->udev, 1),
-			  skb->data, AGG_BUF_SZ,
+			  agg->head, AGG_BUF_SZ,
 			  (usb_complete_t)read_bulk_callback, agg);
 
 	ret = usb_submit_urb(agg->urb, mem_flags);
@@ -2001,12 +2138,12 @@ int r8152_submit_rx(struct r8152 *tp, struct rx_agg *agg, gfp_t mem_flags)
 		list_add_tail(&agg->list, &tp->rx_done);
 		spin_unlock_irqrestore(&tp->rx_lock, flags);
 
-		/* Use workqueue to delay scheduling the tasklet.
+		/* Use workqueue to delay scheduling the napi poll.
 		 * This avoid it is run again immediately, and let
 		 * the system has a opportunity to release some
 		 * resources.
 		 */
-		set_bit(SCHEDULE_TASKLET, &tp->flags);
+		set_bit(SCHEDULE_NAPI, &tp->flags);
 		schedule_delayed_work(&tp->schedule, 1);
 	}
 
@@ -2128,11 +2265,11 @@ static netdev_tx_t rtl8152_start_xmit(struct sk_buff *skb,
 
 	if (!list_empty(&tp->tx_free)) {
 		if (test_bit(SELECTIVE_SUSPEND, &tp->flags)) {
-			set_bit(SCHEDULE_TASKLET, &tp->flags);
+			set_bit(SCHEDULE_NAPI, &tp->flags);
 			schedule_delayed_work(&tp->schedule, 0);
 		} else {
 			usb_mark_last_busy(tp->udev);
-			tasklet_schedule(&tp->tl);
+			napi_schedule(&tp->napi);
 		}
 	} else if (skb_queue_len(&tp->tx_queue) > tp->tx_qlen) {
 		netif_stop_queue(netdev);
@@ -2212,6 +2349,7 @@ static int rtl_start_rx(struct r8152 *tp)
 	int i, ret = 0;
 
 	INIT_LIST_HEAD(&tp->rx_done);
+	INIT_LIST_HEAD(&tp->rx_wait);
 	for (i = 0; i < RTL8152_MAX_RX; i++) {
 		int rr;
 
@@ -2235,6 +2373,8 @@ static int rtl_stop_rx(struct r8152 *tp)
 	for (i = 0; i < RTL8152_MAX_RX; i++)
 		usb_kill_urb(tp->rx_info[i].urb);
 
+	__skb_queue_purge(&tp->rx_queue);
+
 	return 0;
 }
 
@@ -2264,6 +2404,15 @@ static int rtl8152_enable(struct r8152 *tp)
 	return rtl_enable(tp);
 }
 
+static void r8153_set_rx_early_agg(struct r8152 *tp)
+{
+	u32 timeout = tp->rx_early_agg & EARLY_AGG_TIMEOUT_MASK;
+
+	timeout >>= tp->rx_agg_level;
+	ocp_write_dword(tp, MCU_TYPE_USB, USB_RX_EARLY_AGG,
+			(tp->rx_early_agg & ~EARLY_AGG_TIMEOUT_MASK) | timeout);
+}
+
 static void r8153_set_rx_agg(struct r8152 *tp)
 {
 	u8 speed;
@@ -2273,19 +2422,18 @@ static void r8153_set_rx_agg(struct r8152 *tp)
 		if (tp->udev->speed == USB_SPEED_SUPER) {
 			ocp_write_dword(tp, MCU_TYPE_USB, USB_RX_BUF_TH,
 					RX_THR_SUPPER);
-			ocp_write_dword(tp, MCU_TYPE_USB, USB_RX_EARLY_AGG,
-					EARLY_AGG_SUPER);
+			tp->rx_early_agg = EARLY_AGG_SUPER;
 		} else {
 			ocp_write_dword(tp, MCU_TYPE_USB, USB_RX_BUF_TH,
 					RX_THR_HIGH);
-			ocp_write_dword(tp, MCU_TYPE_USB, USB_RX_EARLY_AGG,
-					EARLY_AGG_HIGH);
+			tp->rx_early_agg = EARLY_AGG_HIGH;
 		}
 	} else {
 		ocp_write_dword(tp, MCU_TYPE_USB, USB_RX_BUF_TH, RX_THR_SLOW);
-		ocp_write_dword(tp, MCU_TYPE_USB, USB_RX_EARLY_AGG,
-				EARLY_AGG_SLOW);
+		tp->rx_early_agg = EARLY_AGG_SLOW;
 	}
+
+	r8153_set_rx_early_agg(tp);
 }
 
 static int rtl8153_enable(struct r8152 *tp)
@@ -4511,9 +4659,9 @@ static void set_carrier(struct r8152 *tp)
 	} else {
 		if (tp->speed & LINK_STATUS) {
 			netif_carrier_off(netdev);
-			tasklet_disable(&tp->tl);
+			napi_disable(&tp->napi);
 			tp->rtl_ops.disable(tp);
-			tasklet_enable(&tp->tl);
+			napi_enable(&tp->napi);
 		}
 	}
 	tp->speed = speed;
@@ -4544,11 +4692,15 @@ static inline void __rtl_work_func(struct r8152 *tp)
 	if (test_bit(RTL8152_SET_RX_MODE, &tp->flags))
 		rtl8152_set_rx_mode(tp->netdev);
 
-	/* don't schedule tasklet before linking */
-	if (test_bit(SCHEDULE_TASKLET, &tp->flags) &&
+	if (test_and_clear_bit(RX_EARLY_AGG_CHG, &tp->flags) &&
+	    (tp->speed & LINK_STATUS))
+		r8153_set_rx_early_agg(tp);
+
+	/* don't schedule napi before linking */
+	if (test_bit(SCHEDULE_NAPI, &tp->flags) &&
 	    (tp->speed & LINK_STATUS)) {
-		clear_bit(SCHEDULE_TASKLET, &tp->flags);
-		tasklet_schedule(&tp->tl);
+		clear_bit(SCHEDULE_NAPI, &tp->flags);
+		napi_schedule(&tp->napi);
 	}
 
 	if (test_bit(PHY_RESET, &tp->flags))
@@ -4626,7 +4778,7 @@ static int rtl8152_open(struct net_device *netdev)
 			   res);
 		free_all_mem(tp);
 	} else {
-		tasklet_enable(&tp->tl);
+		napi_enable(&tp->napi);
 	}
 
 	mutex_unlock(&tp->control);
@@ -4642,10 +4794,11 @@ static int rtl8152_close(struct net_device *netdev)
 	struct r8152 *tp = netdev_priv(netdev);
 	int res = 0;
 
-	tasklet_disable(&tp->tl);
 	clear_bit(WORK_ENABLE, &tp->flags);
 	usb_kill_urb(tp->intr_urb);
+	/* set_carrier() disables napi itself, so stop the work first */
 	cancel_delayed_work_sync(&tp->schedule);
+	napi_disable(&tp->napi);
 	netif_stop_queue(netdev);
 
 	res = usb_autopm_get_interface(tp->intf);
@@ -4962,7 +5115,7 @@ static int rtl8152_suspend(struct usb_interface *intf, pm_message_t message)
 	if (netif_running(netdev) && test_bit(WORK_ENABLE, &tp->flags)) {
 		clear_bit(WORK_ENABLE, &tp->flags);
 		usb_kill_urb(tp->intr_urb);
-		tasklet_disable(&tp->tl);
+		napi_disable(&tp->napi);
 		if (test_bit(SELECTIVE_SUSPEND, &tp->flags)) {
 			rtl_stop_rx(tp);
 			rtl_runtime_suspend_enable(tp, true);
@@ -4970,7 +5123,7 @@ static int rtl8152_suspend(struct usb_interface *intf, pm_message_t message)
 			cancel_delayed_work_sync(&tp->schedule);
 			tp->rtl_ops.down(tp);
 		}
-		tasklet_enable(&tp->tl);
+		napi_enable(&tp->napi);
 	}
 out1:
 	mutex_unlock(&tp->control);
@@ -5845,7 +5998,6 @@ static int rtl8152_probe(struct usb_interface *intf,
 	if (ret)
 		goto out;
 
-	tasklet_init(&tp->tl, bottom_half, (unsigned long)tp);
 	mutex_init(&tp->control);
 	INIT_DELAYED_WORK(&tp->schedule, rtl_work_func_t);
 
@@ -5888,6 +6040,7 @@ static int rtl8152_probe(struct usb_interface *intf,
 #endif /* LINUX_VERSION_CODE > KERNEL_VERSION(2,6,25) */
 
 	netdev->ethtool_ops = &ops;
+	netif_napi_add(netdev, &tp->napi, r8152_poll, RTL8152_NAPI_WEIGHT);
 
 	tp->mii.dev = netdev;
 	tp->mii.mdio_read = read_mii_word;
@@ -5915,7 +6068,6 @@ static int rtl8152_probe(struct usb_interface *intf,
 	else
 		device_set_wakeup_enable(&udev->dev, false);
 
-	tasklet_disable(&tp->tl);
 	/* usb_enable_autosuspend(udev); */
 
 	usb_disable_autosuspend(udev);
@@ -5927,7 +6079,7 @@ static int rtl8152_probe(struct usb_interface *intf,
 
 out1:
 	usb_set_intfdata(intf, NULL);
-	tasklet_kill(&tp->tl);
+	netif_napi_del(&tp->napi);
 out:
 	free_netdev(netdev);
 	return ret;
@@ -5944,8 +6096,8 @@ static void rtl8152_disconnect(struct usb_interface *intf)
 		if (udev->state == USB_STATE_NOTATTACHED)
 			set_bit(RTL8152_UNPLUG, &tp->flags);
 
-		tasklet_kill(&tp->tl);
 		unregister_netdev(tp->netdev);
+		netif_napi_del(&tp->napi);
 		tp->rtl_ops.unload(tp);
 		free_netdev(tp->netdev);
 	}
@@ -258,6 +258,35 @@ status_t nvadsp_mbox_send(struct nvadsp_mbox *mbox, uint32_t data,
 }
 EXPORT_SYMBOL(nvadsp_mbox_send);
 
+/*
+ * Queues a batch of messages in msgq and rings the mailbox doorbell once
+ * for all of them. Returns the number of messages queued; the doorbell is
+ * rung even if none fit, so that the ADSP drains the queue, and -ENOSPC
+ * is returned in that case.
+ */
+status_t nvadsp_mbox_send_msgq(struct nvadsp_mbox *mbox, msgq_t *msgq,
+			       const msgq_message_t * const *messages,
+			       int32_t count, uint32_t data, uint32_t flags,
+			       bool block, unsigned int timeout)
+{
+	int32_t queued;
+	int ret;
+
+	if (!count)
+		return 0;
+
+	queued = msgq_queue_messages(msgq, messages, count);
+	if (queued < 0)
+		return queued;
+
+	ret = nvadsp_mbox_send(mbox, data, flags, block, timeout);
+	if (ret)
+		return ret;
+
+	return queued ? queued : -ENOSPC;
+}
+EXPORT_SYMBOL(nvadsp_mbox_send_msgq);
+
 status_t nvadsp_mbox_recv(struct nvadsp_mbox *mbox, uint32_t *data, bool block,
 			  unsigned int timeout)
 {
@@ -19,6 +19,7 @@
 #define pr_fmt(fmt) "%s : %d, " fmt, __func__, __LINE__
 
 #include <linux/list.h>
+#include <linux/rbtree.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/err.h>
@@ -26,36 +27,141 @@
 
 #include "mem_manager.h"
 
-static void clear_alloc_list(struct mem_manager_info *mm_info);
+/*
+ * Free chunks are indexed twice: by address, so that a released chunk
+ * finds its neighbours for coalescing in O(log n), and by (size, address),
+ * so that the best fit is the leftmost node not smaller than the request.
+ * Chunk descriptors come from a pool preallocated at create time, nothing
+ * is allocated while the lock is held with interrupts off.
+ */
+
+static struct mem_chunk *chunk_get(struct mem_manager_info *mm_info)
+{
+	struct mem_chunk *mc;
+
+	if (list_empty(&mm_info->unused_chunks))
+		return NULL;
+
+	mc = list_first_entry(&mm_info->unused_chunks, struct mem_chunk, node);
+	list_del(&mc->node);
+	return mc;
+}
+
+static void chunk_put(struct mem_manager_info *mm_info, struct mem_chunk *mc)
+{
+	list_add(&mc->node, &mm_info->unused_chunks);
+}
+
+static void addr_tree_insert(struct rb_root *root, struct mem_chunk *mc)
+{
+	struct rb_node **link = &root->rb_node, *parent = NULL;
+	struct mem_chunk *entry;
+
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct mem_chunk, addr_node);
+		if (mc->address < entry->address)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&mc->addr_node, parent, link);
+	rb_insert_color(&mc->addr_node, root);
+}
+
+static struct mem_chunk *addr_tree_find(struct rb_root *root,
+	unsigned long address)
+{
+	struct rb_node *n = root->rb_node;
+	struct mem_chunk *entry;
+
+	while (n) {
+		entry = rb_entry(n, struct mem_chunk, addr_node);
+		if (address < entry->address)
+			n = n->rb_left;
+		else if (address > entry->address)
+			n = n->rb_right;
+		else
+			return entry;
+	}
+	return NULL;
+}
+
+static void size_tree_insert(struct rb_root *root, struct mem_chunk *mc)
+{
+	struct rb_node **link = &root->rb_node, *parent = NULL;
+	struct mem_chunk *entry;
+
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct mem_chunk, size_node);
+		if (mc->size < entry->size ||
+		    (mc->size == entry->size && mc->address < entry->address))
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&mc->size_node, parent, link);
+	rb_insert_color(&mc->size_node, root);
+}
+
+/* Smallest free chunk that can hold size, lowest address on ties */
+static struct mem_chunk *size_tree_best_fit(struct rb_root *root,
+	unsigned long size)
+{
+	struct rb_node *n = root->rb_node;
+	struct mem_chunk *entry, *best = NULL;
+
+	while (n) {
+		entry = rb_entry(n, struct mem_chunk, size_node);
+		if (entry->size >= size) {
+			best = entry;
+			n = n->rb_left;
+		} else {
+			n = n->rb_right;
+		}
+	}
+	return best;
+}
+
+static void free_chunk_insert(struct mem_manager_info *mm_info,
+	struct mem_chunk *mc)
+{
+	strlcpy(mc->name, "FREE", NAME_SIZE);
+	addr_tree_insert(&mm_info->free_tree, mc);
+	size_tree_insert(&mm_info->size_tree, mc);
+	mm_info->nr_free++;
+}
+
+static void free_chunk_remove(struct mem_manager_info *mm_info,
+	struct mem_chunk *mc)
+{
+	rb_erase(&mc->addr_node, &mm_info->free_tree);
+	rb_erase(&mc->size_node, &mm_info->size_tree);
+	mm_info->nr_free--;
+}
 
 void *mem_request(void *mem_handle, const char *name, size_t size)
 {
 	unsigned long flags;
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
-	struct mem_chunk *mc_iterator = NULL, *best_match_chunk = NULL;
-	struct mem_chunk *new_mc = NULL;
+	struct mem_chunk *best_match_chunk, *new_mc;
+
+	if (!size)
+		return ERR_PTR(-EINVAL);
 
 	spin_lock_irqsave(&mm_info->lock, flags);
 
 	/* Is mem full? */
-	if (list_empty(mm_info->free_list)) {
+	if (RB_EMPTY_ROOT(&mm_info->free_tree)) {
 		pr_err("%s : memory full\n", mm_info->name);
 		spin_unlock_irqrestore(&mm_info->lock, flags);
 		return ERR_PTR(-ENOMEM);
 	}
 
 	/* Find the best size match */
-	list_for_each_entry(mc_iterator, mm_info->free_list, node) {
-		if (mc_iterator->size >= size) {
-			if (best_match_chunk == NULL)
-				best_match_chunk = mc_iterator;
-			else if (mc_iterator->size < best_match_chunk->size)
-				best_match_chunk = mc_iterator;
-		}
-	}
-
-	/* Is free node found? */
+	best_match_chunk = size_tree_best_fit(&mm_info->size_tree, size);
 	if (best_match_chunk == NULL) {
 		pr_err("%s : no enough memory available\n", mm_info->name);
 		spin_unlock_irqrestore(&mm_info->lock, flags);
@@ -64,108 +170,102 @@ void *mem_request(void *mem_handle, const char *name, size_t size)
 
 	/* Is it exact match? */
 	if (best_match_chunk->size == size) {
-		list_del(&best_match_chunk->node);
-		list_for_each_entry(mc_iterator, mm_info->alloc_list, node) {
-			if (best_match_chunk->address < mc_iterator->address) {
-				list_add_tail(&best_match_chunk->node,
-						&mc_iterator->node);
-				strlcpy(best_match_chunk->name, name,
-						NAME_SIZE);
-				spin_unlock_irqrestore(&mm_info->lock, flags);
-				return best_match_chunk;
-			}
-		}
-		list_add(&best_match_chunk->node, mm_info->alloc_list);
-		strlcpy(best_match_chunk->name, name, NAME_SIZE);
-		spin_unlock_irqrestore(&mm_info->lock, flags);
-		return best_match_chunk;
+		free_chunk_remove(mm_info, best_match_chunk);
+		new_mc = best_match_chunk;
 	} else {
-		new_mc = kzalloc(sizeof(struct mem_chunk), GFP_ATOMIC);
+		new_mc = chunk_get(mm_info);
 		if (unlikely(!new_mc)) {
-			pr_err("failed to allocate memory for mem_chunk\n");
-
+			pr_err("%s : out of chunk descriptors\n",
+				mm_info->name);
 			spin_unlock_irqrestore(&mm_info->lock, flags);
 			return ERR_PTR(-ENOMEM);
 		}
 		new_mc->address = best_match_chunk->address;
 		new_mc->size = size;
-		strlcpy(new_mc->name, name, NAME_SIZE);
+
+		/*
+		 * The remainder keeps its place in the address tree, only
+		 * its size key changes.
+		 */
+		rb_erase(&best_match_chunk->size_node, &mm_info->size_tree);
 		best_match_chunk->address += size;
 		best_match_chunk->size -= size;
-		list_for_each_entry(mc_iterator, mm_info->alloc_list, node) {
-			if (new_mc->address < mc_iterator->address) {
-				list_add_tail(&new_mc->node,
-						&mc_iterator->node);
-				spin_unlock_irqrestore(&mm_info->lock, flags);
-				return new_mc;
-			}
-		}
-		list_add_tail(&new_mc->node, mm_info->alloc_list);
-		spin_unlock_irqrestore(&mm_info->lock, flags);
-		return new_mc;
+		size_tree_insert(&mm_info->size_tree, best_match_chunk);
 	}
+
+	strlcpy(new_mc->name, name, NAME_SIZE);
+	addr_tree_insert(&mm_info->alloc_tree, new_mc);
+	mm_info->nr_alloc++;
+	mm_info->free_bytes -= size;
+
+	spin_unlock_irqrestore(&mm_info->lock, flags);
+	return new_mc;
 }
 
 /*
- * Find the node with sepcified address and remove it from list
+ * Move the chunk back to the free trees, merging it with free neighbours
  */
 bool mem_release(void *mem_handle, void *handle)
 {
 	unsigned long flags;
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
-	struct mem_chunk *mc_curr = NULL, *mc_prev = NULL;
 	struct mem_chunk *mc_free = (struct mem_chunk *)handle;
+	struct mem_chunk *mc_prev = NULL, *mc_next = NULL, *entry;
+	struct rb_node *n;
 
 	pr_debug(" addr = %lu, size = %lu, name = %s\n",
 			mc_free->address, mc_free->size, mc_free->name);
 
 	spin_lock_irqsave(&mm_info->lock, flags);
 
-	list_for_each_entry(mc_curr, mm_info->free_list, node) {
-		if (mc_free->address < mc_curr->address) {
-
-			strlcpy(mc_free->name, "FREE", NAME_SIZE);
-
-			/* adjacent next free node */
-			if (mc_curr->address ==
-				(mc_free->address + mc_free->size)) {
-
-				mc_curr->address = mc_free->address;
-				mc_curr->size += mc_free->size;
-				list_del(&mc_free->node);
-				kfree(mc_free);
-
-				/* and adjacent prev free node */
-				if ((mc_prev != NULL) &&
-				   ((mc_prev->address + mc_prev->size) ==
-						mc_curr->address)) {
-
-					mc_prev->size += mc_curr->size;
-					list_del(&mc_curr->node);
-					kfree(mc_curr);
-				}
-			}
-			/* adjacent prev free node */
-			else if ((mc_prev != NULL) &&
-				((mc_prev->address + mc_prev->size) ==
-						mc_free->address)) {
-
-				mc_prev->size += mc_free->size;
-				list_del(&mc_free->node);
-				kfree(mc_free);
-			} else {
-				list_del(&mc_free->node);
-				list_add_tail(&mc_free->node,
-						&mc_curr->node);
-			}
-			spin_unlock_irqrestore(&mm_info->lock, flags);
-			return true;
+	if (addr_tree_find(&mm_info->alloc_tree, mc_free->address) !=
+			mc_free) {
+		spin_unlock_irqrestore(&mm_info->lock, flags);
+		return false;
+	}
+	rb_erase(&mc_free->addr_node, &mm_info->alloc_tree);
+	mm_info->nr_alloc--;
+	mm_info->free_bytes += mc_free->size;
+
+	/* locate the free chunks just below and above the released one */
+	n = mm_info->free_tree.rb_node;
+	while (n) {
+		entry = rb_entry(n, struct mem_chunk, addr_node);
+		if (entry->address < mc_free->address) {
+			mc_prev = entry;
+			n = n->rb_right;
+		} else {
+			mc_next = entry;
+			n = n->rb_left;
 		}
-		mc_prev = mc_curr;
 	}
+
+	/* adjacent prev free node */
+	if (mc_prev &&
+	    (mc_prev->address + mc_prev->size) == mc_free->address) {
+		rb_erase(&mc_prev->size_node, &mm_info->size_tree);
+		mc_prev->size += mc_free->size;
+		chunk_put(mm_info, mc_free);
+		mc_free = mc_prev;
+	} else {
+		strlcpy(mc_free->name, "FREE", NAME_SIZE);
+		addr_tree_insert(&mm_info->free_tree, mc_free);
+		mm_info->nr_free++;
+	}
+
+	/* and adjacent next free node */
+	if (mc_next &&
+	    (mc_free->address + mc_free->size) == mc_next->address) {
+		free_chunk_remove(mm_info, mc_next);
+		mc_free->size += mc_next->size;
+		chunk_put(mm_info, mc_next);
+	}
+
+	size_tree_insert(&mm_info->size_tree, mc_free);
+
 	spin_unlock_irqrestore(&mm_info->lock, flags);
-	return false;
+	return true;
 }
 
 inline unsigned long mem_get_address(void *handle)
@@ -174,27 +274,51 @@ inline unsigned long mem_get_address(void *handle)
 	return mc->address;
 }
 
+/* Share of free memory that is not part of the largest free chunk */
+static unsigned long mem_fragmentation(struct mem_manager_info *mm_info,
+	unsigned long *largest)
+{
+	struct rb_node *n = rb_last(&mm_info->size_tree);
+
+	*largest = n ? rb_entry(n, struct mem_chunk, size_node)->size : 0;
+	if (!mm_info->free_bytes)
+		return 0;
+
+	return 100 - (*largest * 100) / mm_info->free_bytes;
+}
+
 void mem_print(void *mem_handle)
 {
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
 	struct mem_chunk *mc_iterator = NULL;
+	unsigned long largest, frag;
+	struct rb_node *n;
 
 	pr_info("------------------------------------\n");
 	pr_info("%s ALLOCATED\n", mm_info->name);
-	list_for_each_entry(mc_iterator, mm_info->alloc_list, node) {
+	for (n = rb_first(&mm_info->alloc_tree); n; n = rb_next(n)) {
+		mc_iterator = rb_entry(n, struct mem_chunk, addr_node);
 		pr_info("  addr = %lu, size = %lu, name = %s\n",
 			mc_iterator->address, mc_iterator->size,
 			mc_iterator->name);
 	}
 
 	pr_info("%s FREE\n", mm_info->name);
-	list_for_each_entry(mc_iterator, mm_info->free_list, node) {
+	for (n = rb_first(&mm_info->free_tree); n; n = rb_next(n)) {
+		mc_iterator = rb_entry(n, struct mem_chunk, addr_node);
 		pr_info("  addr = %lu, size = %lu, name = %s\n",
 			mc_iterator->address, mc_iterator->size,
 			mc_iterator->name);
 	}
 
+	frag = mem_fragmentation(mm_info, &largest);
+	pr_info("%s STATS\n", mm_info->name);
+	pr_info("  allocated = %u chunks, free = %u chunks, %lu bytes\n",
+		mm_info->nr_alloc, mm_info->nr_free, mm_info->free_bytes);
+	pr_info("  largest free = %lu, fragmentation = %lu%%\n",
+		largest, frag);
+
 	pr_info("------------------------------------\n");
 }
 
@@ -203,44 +327,48 @@ void mem_dump(void *mem_handle, struct seq_file *s)
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
 	struct mem_chunk *mc_iterator = NULL;
+	unsigned long largest, frag;
+	unsigned long flags;
+	struct rb_node *n;
+
+	spin_lock_irqsave(&mm_info->lock, flags);
 
 	seq_puts(s, "---------------------------------------\n");
 	seq_printf(s, "%s ALLOCATED\n", mm_info->name);
-	list_for_each_entry(mc_iterator, mm_info->alloc_list, node) {
+	for (n = rb_first(&mm_info->alloc_tree); n; n = rb_next(n)) {
+		mc_iterator = rb_entry(n, struct mem_chunk, addr_node);
 		seq_printf(s, "  addr = %lu, size = %lu, name = %s\n",
 			mc_iterator->address, mc_iterator->size,
 			mc_iterator->name);
 	}
 
 	seq_printf(s, "%s FREE\n", mm_info->name);
-	list_for_each_entry(mc_iterator, mm_info->free_list, node) {
+	for (n = rb_first(&mm_info->free_tree); n; n = rb_next(n)) {
+		mc_iterator = rb_entry(n, struct mem_chunk, addr_node);
 		seq_printf(s, "  addr = %lu, size = %lu, name = %s\n",
 			mc_iterator->address, mc_iterator->size,
 			mc_iterator->name);
 	}
 
+	frag = mem_fragmentation(mm_info, &largest);
+	seq_printf(s, "%s STATS\n", mm_info->name);
+	seq_printf(s, "  allocated = %u chunks, free = %u chunks, %lu bytes\n",
+		mm_info->nr_alloc, mm_info->nr_free, mm_info->free_bytes);
+	seq_printf(s, "  largest free = %lu, fragmentation = %lu%%\n",
+		largest, frag);
+	seq_printf(s, "  chunk descriptors in use = %u/%u\n",
+		mm_info->nr_alloc + mm_info->nr_free, MEM_MANAGER_CHUNKS);
+
 	seq_puts(s, "---------------------------------------\n");
-}
 
-static void clear_alloc_list(struct mem_manager_info *mm_info)
-{
-	struct list_head *curr, *next;
-	struct mem_chunk *mc = NULL;
-
-	list_for_each_safe(curr, next, mm_info->alloc_list) {
-		mc = list_entry(curr, struct mem_chunk, node);
-		pr_debug("  addr = %lu, size = %lu, name = %s\n",
-			mc->address, mc->size,
-			mc->name);
-		mem_release(mm_info, mc);
-	}
+	spin_unlock_irqrestore(&mm_info->lock, flags);
 }
 
 void *create_mem_manager(const char *name, unsigned long start_address,
 				unsigned long size)
 {
-	void *ret = NULL;
 	struct mem_chunk *mc;
+	int i;
 	struct mem_manager_info *mm_info =
 			kzalloc(sizeof(struct mem_manager_info), GFP_KERNEL);
 	if (unlikely(!mm_info)) {
@@ -250,67 +378,42 @@ void *create_mem_manager(const char *name, unsigned long start_address,
 
 	strlcpy(mm_info->name, name, NAME_SIZE);
 
-	mm_info->alloc_list = kzalloc(sizeof(struct list_head), GFP_KERNEL);
-	if (unlikely(!mm_info->alloc_list)) {
-		pr_err("failed to allocate memory for alloc_list\n");
-		ret = ERR_PTR(-ENOMEM);
-		goto free_mm_info;
-	}
-
-	mm_info->free_list = kzalloc(sizeof(struct list_head), GFP_KERNEL);
-	if (unlikely(!mm_info->free_list)) {
-		pr_err("failed to allocate memory for free_list\n");
-		ret = ERR_PTR(-ENOMEM);
-		goto free_alloc_list;
+	mm_info->chunks = kcalloc(MEM_MANAGER_CHUNKS,
+			sizeof(struct mem_chunk), GFP_KERNEL);
+	if (unlikely(!mm_info->chunks)) {
+		pr_err("failed to allocate memory for mem_chunk pool\n");
+		kfree(mm_info);
+		return ERR_PTR(-ENOMEM);
 	}
 
-	INIT_LIST_HEAD(mm_info->alloc_list);
-	INIT_LIST_HEAD(mm_info->free_list);
+	mm_info->alloc_tree = RB_ROOT;
+	mm_info->free_tree = RB_ROOT;
+	mm_info->size_tree = RB_ROOT;
+	INIT_LIST_HEAD(&mm_info->unused_chunks);
+	for (i = 0; i < MEM_MANAGER_CHUNKS; i++)
+		list_add_tail(&mm_info->chunks[i].node,
+				&mm_info->unused_chunks);
 
 	mm_info->start_address = start_address;
 	mm_info->size = size;
 
 	/* Add whole memory to free list */
-	mc = kzalloc(sizeof(struct mem_chunk), GFP_KERNEL);
-	if (unlikely(!mc)) {
-		pr_err("failed to allocate memory for mem_chunk\n");
-		ret = ERR_PTR(-ENOMEM);
-		goto free_free_list;
-	}
-
+	mc = chunk_get(mm_info);
 	mc->address = mm_info->start_address;
 	mc->size = mm_info->size;
-	strlcpy(mc->name, "FREE", NAME_SIZE);
-	list_add(&mc->node, mm_info->free_list);
+	free_chunk_insert(mm_info, mc);
+	mm_info->free_bytes = mm_info->size;
 	spin_lock_init(&mm_info->lock);
 
 	return (void *)mm_info;
-
-free_free_list:
-	kfree(mm_info->free_list);
-free_alloc_list:
-	kfree(mm_info->alloc_list);
-free_mm_info:
-	kfree(mm_info);
-
-	return ret;
 }
 
 void destroy_mem_manager(void *mem_handle)
 {
 	struct mem_manager_info *mm_info =
 		(struct mem_manager_info *)mem_handle;
-	struct mem_chunk *mc_last = NULL;
-
-	/* Clear all allocated memory */
-	clear_alloc_list(mm_info);
-
-	mc_last = list_entry((mm_info->free_list)->next,
-			struct mem_chunk, node);
-	list_del(&mc_last->node);
 
-	kfree(mc_last);
-	kfree(mm_info->alloc_list);
-	kfree(mm_info->free_list);
+	/* Every chunk, allocated or not, lives in the pool */
+	kfree(mm_info->chunks);
 	kfree(mm_info);
 }
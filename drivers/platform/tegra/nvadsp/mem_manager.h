@@ -16,11 +16,22 @@
 #ifndef __TEGRA_NVADSP_MEM_MANAGER_H
 #define __TEGRA_NVADSP_MEM_MANAGER_H
 
+#include <linux/rbtree.h>
 #include <linux/sizes.h>
 
 #define NAME_SIZE SZ_16
 
+/* Chunk descriptors preallocated per manager */
+#define MEM_MANAGER_CHUNKS	256
+
+/*
+ * A chunk is either allocated, and then linked into alloc_tree by address,
+ * or free, and then linked both into free_tree by address for coalescing
+ * and into size_tree by (size, address) for best fit lookups.
+ */
 struct mem_chunk {
+	struct rb_node addr_node;
+	struct rb_node size_node;
 	struct list_head node;
 	char name[NAME_SIZE];
 	unsigned long address;
@@ -28,8 +39,14 @@ struct mem_chunk {
 };
 
 struct mem_manager_info {
-	struct list_head *alloc_list;
-	struct list_head *free_list;
+	struct rb_root alloc_tree;
+	struct rb_root free_tree;
+	struct rb_root size_tree;
+	struct mem_chunk *chunks;
+	struct list_head unused_chunks;
+	unsigned int nr_alloc;
+	unsigned int nr_free;
+	unsigned long free_bytes;
 	char name[NAME_SIZE];
 	unsigned long start_address;
 	unsigned long size;
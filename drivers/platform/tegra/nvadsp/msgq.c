@@ -14,10 +14,34 @@
  */
 
 #include <linux/tegra_nvadsp.h>
+#include <asm/barrier.h>
 
 #define msgq_wmemcpy(dest, src, words) \
 	memcpy(dest, src, (words) * sizeof(int32_t))
 
+/* words that can be queued without making read == write */
+static inline int32_t msgq_free_wsize(const msgq_t *msgq, int32_t ri,
+	int32_t wi)
+{
+	return (ri <= wi ? msgq->size - wi + ri : ri - wi) - 1;
+}
+
+/* copy words at write index wi, returns the write index past them */
+static int32_t msgq_write_words(msgq_t *msgq, int32_t wi,
+	const int32_t *src, int32_t words)
+{
+	int32_t qremainder = msgq->size - wi;
+
+	if (words < qremainder) {
+		msgq_wmemcpy(&msgq->queue[wi], src, words);
+		return wi + words;
+	}
+
+	/* words wrapped */
+	msgq_wmemcpy(&msgq->queue[wi], src, qremainder);
+	msgq_wmemcpy(msgq->queue, src + qremainder, words - qremainder);
+	return wi + words - msgq->size;
+}
 
 /**
  * msgq_init - Initialize message queue
@@ -168,3 +192,178 @@ int32_t msgq_dequeue_message(msgq_t *msgq, msgq_message_t *message)
 	return ret;
 }
 EXPORT_SYMBOL(msgq_dequeue_message);
+/**
+ * msgq_queue_messages - Queues a batch of messages in the queue
+ * @msgq:           pointer to the client message queue
+ * @messages:       array of messages to copy from
+ * @count:          number of messages in @messages
+ *
+ * This function returns the number of messages queued, in order,
+ * before the first one that did not fit. The write index is published
+ * once for the whole batch, so the consumer either sees all of them or
+ * none, and a single doorbell is enough to announce them.
+ *
+ *
+ */
+int32_t msgq_queue_messages(msgq_t *msgq,
+	const msgq_message_t * const *messages, int32_t count)
+{
+	int32_t ri, wi, space, msize;
+	int32_t i;
+
+	if (!msgq || !messages) {
+		pr_err("NULL: msgq %p messages %p\n", msgq, messages);
+		return -EFAULT; /* Bad Address */
+	}
+
+	ri = READ_ONCE(msgq->read_index);
+	wi = msgq->write_index;
+	space = msgq_free_wsize(msgq, ri, wi);
+
+	for (i = 0; i < count; i++) {
+		msize = MSGQ_MESSAGE_HEADER_WSIZE + messages[i]->size;
+		if (msize > space)
+			break;
+		wi = msgq_write_words(msgq, wi,
+			(const int32_t *)messages[i], msize);
+		space -= msize;
+	}
+
+	if (i) {
+		/* payload has to land before the index that covers it */
+		wmb();
+		WRITE_ONCE(msgq->write_index, wi);
+	}
+
+	return i;
+}
+EXPORT_SYMBOL(msgq_queue_messages);
+/**
+ * msgq_reserve_message - Reserves a message slot in place
+ * @msgq:           pointer to the client message queue
+ * @size:           payload size in words
+ *
+ * This function returns a pointer to a contiguous slot at the write
+ * index with msgq_message_t::size already set, or NULL if there is no
+ * room or the slot would wrap around the end of the queue, in which case
+ * msgq_queue_message() has to be used. The payload is written directly
+ * into the queue and published with msgq_commit_message(). The caller
+ * serializes reserve and commit against other writers, like it does for
+ * msgq_queue_message().
+ *
+ *
+ */
+msgq_message_t *msgq_reserve_message(msgq_t *msgq, int32_t size)
+{
+	int32_t ri, wi, msize;
+	msgq_message_t *msg;
+
+	if (!msgq || size < 0)
+		return NULL;
+
+	ri = READ_ONCE(msgq->read_index);
+	wi = msgq->write_index;
+	msize = MSGQ_MESSAGE_HEADER_WSIZE + size;
+
+	if (msize > msgq_free_wsize(msgq, ri, wi) ||
+	    msize > msgq->size - wi)
+		return NULL;
+
+	msg = (msgq_message_t *)&msgq->queue[wi];
+	msg->size = size;
+	return msg;
+}
+EXPORT_SYMBOL(msgq_reserve_message);
+/**
+ * msgq_commit_message - Publishes a reserved message
+ * @msgq:           pointer to the client message queue
+ * @message:        slot returned by msgq_reserve_message()
+ *
+ * msgq_message_t::size may be lowered between reserve and commit if
+ * less payload than reserved was written.
+ *
+ *
+ */
+void msgq_commit_message(msgq_t *msgq, msgq_message_t *message)
+{
+	int32_t wi = msgq->write_index + MSGQ_MESSAGE_HEADER_WSIZE +
+		message->size;
+
+	/* payload has to land before the index that covers it */
+	wmb();
+	WRITE_ONCE(msgq->write_index, wi < msgq->size ? wi : wi - msgq->size);
+}
+EXPORT_SYMBOL(msgq_commit_message);
+/**
+ * msgq_drain_messages - Hands queued messages to a handler
+ * @msgq:           pointer to the client message queue
+ * @handler:        called for every message, in queue order
+ * @data:           passed to @handler
+ * @buf:            buffer for messages that wrap around the end of the
+ *                  queue, msgq_message_t::size set to its payload size
+ *                  in words, or NULL
+ * @budget:         maximum number of messages to handle
+ *
+ * This function returns the number of messages handled. Messages that
+ * are contiguous in the queue are passed to @handler in place and stay
+ * valid until it returns; only a wrapped message is copied to @buf. The
+ * read index is advanced after every message. Draining stops early when
+ * @handler returns a negative value, or with -ENOSPC if nothing could be
+ * handled because @buf is missing or too small for a wrapped message.
+ *
+ * A notification handler calls this in a loop until it returns less
+ * than @budget, instead of dequeuing one message per doorbell.
+ *
+ *
+ */
+int32_t msgq_drain_messages(msgq_t *msgq, msgq_handler_t handler,
+	void *data, msgq_message_t *buf, int32_t budget)
+{
+	int32_t cap = buf ? buf->size : 0;
+	int32_t ri, wi, msize, qremainder;
+	const msgq_message_t *msg;
+	int32_t done = 0;
+	int ret;
+
+	if (!msgq || !handler) {
+		pr_err("NULL: msgq %p handler %p\n", msgq, handler);
+		return -EFAULT; /* Bad Address */
+	}
+
+	ri = msgq->read_index;
+	wi = READ_ONCE(msgq->write_index);
+	/* read the payload only after the index that covers it */
+	rmb();
+
+	while (ri != wi && done < budget) {
+		msg = (const msgq_message_t *)&msgq->queue[ri];
+		msize = MSGQ_MESSAGE_HEADER_WSIZE + msg->size;
+		qremainder = msgq->size - ri;
+
+		if (msize > qremainder) {
+			/* message wrapped, hand over a linear copy */
+			if (cap < msg->size)
+				return done ? done : -ENOSPC;
+			msgq_wmemcpy(buf, msg, qremainder);
+			msgq_wmemcpy((int32_t *)buf + qremainder,
+				msgq->queue, msize - qremainder);
+			msg = buf;
+		}
+
+		ret = handler(msg, data);
+
+		ri += msize;
+		if (ri >= msgq->size)
+			ri -= msgq->size;
+		/* finish with the slot before the producer may reuse it */
+		mb();
+		WRITE_ONCE(msgq->read_index, ri);
+		done++;
+
+		if (ret < 0)
+			break;
+	}
+
+	return done;
+}
+EXPORT_SYMBOL(msgq_drain_messages);
@@ -19,10 +19,16 @@
 #include <linux/tegra-capture-ivc.h>
 
 #include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/tegra-ivc.h>
 #include <linux/tegra-ivc-bus.h>
 #include <linux/nospec.h>
@@ -38,17 +44,28 @@
 #define TOTAL_CHANNELS (NUM_CAPTURE_CHANNELS + NUM_CAPTURE_TRANSACTION_IDS)
 #define TRANS_ID_START_IDX NUM_CAPTURE_CHANNELS
 
+/* Frames dispatched by the rx thread before it offers to reschedule */
+#define CAPTURE_IVC_RX_BUDGET 16
+
+/* Latency buckets, bucket n counts [2^(n-1), 2^n) us, the last is open */
+#define CAPTURE_IVC_LAT_BUCKETS 16
+
 struct tegra_capture_ivc_cb_ctx {
 	struct list_head node;
 	tegra_capture_ivc_cb_func cb_func;
 	const void *priv_context;
+	u32 lat_hist[CAPTURE_IVC_LAT_BUCKETS];
 };
 
 struct tegra_capture_ivc {
 	struct tegra_ivc_channel *chan;
 	struct mutex cb_ctx_lock;
 	struct mutex ivc_wr_lock;
-	struct work_struct work;
+	struct task_struct *rx_thread;
+	wait_queue_head_t rx_q;
+	atomic_t rx_pending;
+	ktime_t rx_stamp;
+	struct dentry *debugfs;
 	wait_queue_head_t write_q;
 	struct tegra_capture_ivc_cb_ctx cb_ctx[TOTAL_CHANNELS];
 	spinlock_t avl_ctx_list_lock;
@@ -105,6 +122,48 @@ static int tegra_capture_ivc_tx(struct tegra_capture_ivc *civc,
 	return ret;
 }
 
+/*
+ * Write a batch of descriptors under a single ivc_wr_lock hold, so the
+ * batch reaches RTCPU back to back. Returns the number of descriptors
+ * written, or an error if none could be.
+ */
+static int tegra_capture_ivc_tx_vec(struct tegra_capture_ivc *civc,
+				const struct kvec *vec, unsigned int count)
+{
+	struct tegra_ivc_channel *chan = civc->chan;
+	unsigned int i;
+	int ret;
+
+	if (WARN_ON(!chan->is_ready))
+		return -EIO;
+
+	ret = mutex_lock_interruptible(&civc->ivc_wr_lock);
+	if (unlikely(ret == -EINTR))
+		return -ERESTARTSYS;
+	if (unlikely(ret))
+		return ret;
+
+	for (i = 0; i < count; i++) {
+		ret = wait_event_interruptible(civc->write_q,
+					tegra_ivc_can_write(&chan->ivc));
+		if (likely(ret == 0))
+			ret = tegra_ivc_write(&chan->ivc, vec[i].iov_base,
+					vec[i].iov_len);
+		if (unlikely(ret < 0))
+			break;
+	}
+
+	mutex_unlock(&civc->ivc_wr_lock);
+
+	if (unlikely(ret < 0)) {
+		dev_err(&chan->dev, "tegra_ivc_write: error %d\n", ret);
+		if (i == 0)
+			return ret;
+	}
+
+	return i;
+}
+
 static struct tegra_capture_ivc *__scivc_control;
 static struct tegra_capture_ivc *__scivc_capture;
 
@@ -126,6 +185,16 @@ int tegra_capture_ivc_capture_submit(const void *capture_desc, size_t len)
 }
 EXPORT_SYMBOL(tegra_capture_ivc_capture_submit);
 
+int tegra_capture_ivc_capture_submit_vec(const struct kvec *capture_descs,
+		unsigned int count)
+{
+	if (WARN_ON(__scivc_capture == NULL))
+		return -ENODEV;
+
+	return tegra_capture_ivc_tx_vec(__scivc_capture, capture_descs, count);
+}
+EXPORT_SYMBOL(tegra_capture_ivc_capture_submit_vec);
+
 int tegra_capture_ivc_register_control_cb(
 		tegra_capture_ivc_cb_func control_resp_cb,
 		uint32_t *trans_id, const void *priv_context)
@@ -230,6 +299,8 @@ int tegra_capture_ivc_notify_chan_id(uint32_t chan_id, uint32_t trans_id)
 	civc->cb_ctx[chan_id].cb_func = civc->cb_ctx[trans_id].cb_func;
 	civc->cb_ctx[chan_id].priv_context =
 			civc->cb_ctx[trans_id].priv_context;
+	memset(civc->cb_ctx[chan_id].lat_hist, 0,
+		sizeof(civc->cb_ctx[chan_id].lat_hist));
 
 	/* Reset trans_id cb_ctx fields */
 	civc->cb_ctx[trans_id].cb_func = NULL;
@@ -279,6 +350,8 @@ int tegra_capture_ivc_register_capture_cb(
 
 	civc->cb_ctx[chan_id].cb_func = capture_status_ind_cb;
 	civc->cb_ctx[chan_id].priv_context = priv_context;
+	memset(civc->cb_ctx[chan_id].lat_hist, 0,
+		sizeof(civc->cb_ctx[chan_id].lat_hist));
 	mutex_unlock(&civc->cb_ctx_lock);
 
 	return 0;
@@ -367,19 +440,33 @@ int tegra_capture_ivc_unregister_capture_cb(uint32_t chan_id)
 }
 EXPORT_SYMBOL(tegra_capture_ivc_unregister_capture_cb);
 
-static void tegra_capture_ivc_worker(struct work_struct *work)
+static void tegra_capture_ivc_lat_account(struct tegra_capture_ivc_cb_ctx *ctx,
+		ktime_t arrival)
+{
+	s64 us = ktime_us_delta(ktime_get(), arrival);
+	unsigned int bucket = us > 0 ? ilog2(us) + 1 : 0;
+
+	if (bucket >= CAPTURE_IVC_LAT_BUCKETS)
+		bucket = CAPTURE_IVC_LAT_BUCKETS - 1;
+	ctx->lat_hist[bucket]++;
+}
+
+/* Dispatch up to a budget of frames, returns true if more may be pending */
+static bool tegra_capture_ivc_rx_batch(struct tegra_capture_ivc *civc,
+		ktime_t arrival)
 {
-	struct tegra_capture_ivc *civc = container_of(work,
-					struct tegra_capture_ivc, work);
 	struct tegra_ivc_channel *chan = civc->chan;
+	unsigned int budget = CAPTURE_IVC_RX_BUDGET;
 
 	WARN_ON(!chan->is_ready);
 
-	while (tegra_ivc_can_read(&chan->ivc)) {
+	while (budget && tegra_ivc_can_read(&chan->ivc)) {
 		const struct tegra_capture_ivc_resp *msg =
 			tegra_ivc_read_get_next_frame(&chan->ivc);
 		uint32_t id = msg->header.channel_id;
 
+		budget--;
+
 		/* Check if message is valid */
 		if (WARN(id >= TOTAL_CHANNELS, "Invalid rtcpu response id %u", id))
 			goto skip;
@@ -394,10 +481,41 @@ static void tegra_capture_ivc_worker(struct work_struct *work)
 
 		/* Invoke client callback.*/
 		civc->cb_ctx[id].cb_func(msg, civc->cb_ctx[id].priv_context);
+		tegra_capture_ivc_lat_account(&civc->cb_ctx[id], arrival);
 
 skip:
 		tegra_ivc_read_advance(&chan->ivc);
 	}
+
+	return budget == 0;
+}
+
+/*
+ * Dedicated RT thread for completions, so that they do not queue up
+ * behind unrelated work on the system workqueue.
+ */
+static int tegra_capture_ivc_rx_thread(void *data)
+{
+	struct tegra_capture_ivc *civc = data;
+	ktime_t arrival;
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(civc->rx_q,
+			atomic_read(&civc->rx_pending) ||
+			kthread_should_stop());
+
+		if (!atomic_xchg(&civc->rx_pending, 0))
+			continue;
+
+		/* pairs with smp_wmb() in tegra_capture_ivc_notify() */
+		smp_rmb();
+		arrival = civc->rx_stamp;
+
+		while (tegra_capture_ivc_rx_batch(civc, arrival))
+			cond_resched();
+	}
+
+	return 0;
 }
 
 static void tegra_capture_ivc_notify(struct tegra_ivc_channel *chan)
@@ -406,14 +524,80 @@ static void tegra_capture_ivc_notify(struct tegra_ivc_channel *chan)
 
 	/* Only 1 thread can wait on write_q, rest wait for write_lock */
 	wake_up(&civc->write_q);
-	schedule_work(&civc->work);
+
+	/* Stamp the first arrival of the batch the rx thread will pick up */
+	if (!atomic_read(&civc->rx_pending)) {
+		civc->rx_stamp = ktime_get();
+		smp_wmb();
+	}
+	atomic_set(&civc->rx_pending, 1);
+	wake_up(&civc->rx_q);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int tegra_capture_ivc_lat_show(struct seq_file *s, void *data)
+{
+	struct tegra_capture_ivc *civc = s->private;
+	unsigned int id, b;
+	bool used;
+
+	seq_puts(s, "id:");
+	for (b = 0; b < CAPTURE_IVC_LAT_BUCKETS - 1; b++)
+		seq_printf(s, " <%uus", 1U << b);
+	seq_printf(s, " >=%uus\n", 1U << (CAPTURE_IVC_LAT_BUCKETS - 2));
+
+	for (id = 0; id < TOTAL_CHANNELS; id++) {
+		const u32 *hist = civc->cb_ctx[id].lat_hist;
+
+		used = false;
+		for (b = 0; b < CAPTURE_IVC_LAT_BUCKETS; b++)
+			used |= hist[b] != 0;
+		if (!used)
+			continue;
+
+		seq_printf(s, "%u:", id);
+		for (b = 0; b < CAPTURE_IVC_LAT_BUCKETS; b++)
+			seq_printf(s, " %u", hist[b]);
+		seq_putc(s, '\n');
+	}
+
+	return 0;
+}
+
+static int tegra_capture_ivc_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_capture_ivc_lat_show, inode->i_private);
+}
+
+static const struct file_operations tegra_capture_ivc_lat_fops = {
+	.open		= tegra_capture_ivc_lat_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_capture_ivc_debugfs_init(struct tegra_capture_ivc *civc)
+{
+	struct device *dev = &civc->chan->dev;
+
+	civc->debugfs = debugfs_create_dir(dev_name(dev), NULL);
+	if (IS_ERR_OR_NULL(civc->debugfs))
+		return;
+
+	debugfs_create_file("latency", S_IRUGO, civc->debugfs, civc,
+			&tegra_capture_ivc_lat_fops);
 }
+#else
+static inline void tegra_capture_ivc_debugfs_init(
+		struct tegra_capture_ivc *civc) { }
+#endif
 
 #define NV(x) "nvidia," #x
 
 static int tegra_capture_ivc_probe(struct tegra_ivc_channel *chan)
 {
 	struct device *dev = &chan->dev;
+	struct sched_param param = { .sched_priority = MAX_USER_RT_PRIO / 2 };
 	struct tegra_capture_ivc *civc;
 	const char *service;
 	int ret;
@@ -435,8 +619,9 @@ static int tegra_capture_ivc_probe(struct tegra_ivc_channel *chan)
 	mutex_init(&civc->cb_ctx_lock);
 	mutex_init(&civc->ivc_wr_lock);
 
-	/* Initialize ivc_work */
-	INIT_WORK(&civc->work, tegra_capture_ivc_worker);
+	/* Initialize rx thread state */
+	init_waitqueue_head(&civc->rx_q);
+	atomic_set(&civc->rx_pending, 0);
 
 	/* Initialize wait queue */
 	init_waitqueue_head(&civc->write_q);
@@ -451,20 +636,41 @@ static int tegra_capture_ivc_probe(struct tegra_ivc_channel *chan)
 
 	tegra_ivc_channel_set_drvdata(chan, civc);
 
+	if (strcmp("capture-control", service) &&
+			strcmp("capture", service)) {
+		dev_err(dev, "Unknown ivc channel %s\n", service);
+		return -EINVAL;
+	}
+
+	civc->rx_thread = kthread_create(tegra_capture_ivc_rx_thread, civc,
+				"%s", service);
+	if (IS_ERR(civc->rx_thread))
+		return PTR_ERR(civc->rx_thread);
+
+	sched_setscheduler_nocheck(civc->rx_thread, SCHED_FIFO, &param);
+	wake_up_process(civc->rx_thread);
+
 	if (!strcmp("capture-control", service)) {
-		if (WARN_ON(__scivc_control != NULL))
-			return -EEXIST;
+		if (WARN_ON(__scivc_control != NULL)) {
+			ret = -EEXIST;
+			goto fail;
+		}
 		__scivc_control = civc;
-	} else if (!strcmp("capture", service)) {
-		if (WARN_ON(__scivc_capture != NULL))
-			return -EEXIST;
-		__scivc_capture = civc;
 	} else {
-		dev_err(dev, "Unknown ivc channel %s\n", service);
-		return -EINVAL;
+		if (WARN_ON(__scivc_capture != NULL)) {
+			ret = -EEXIST;
+			goto fail;
+		}
+		__scivc_capture = civc;
 	}
 
+	tegra_capture_ivc_debugfs_init(civc);
+
 	return 0;
+
+fail:
+	kthread_stop(civc->rx_thread);
+	return ret;
 }
 
 static void tegra_capture_ivc_remove(struct tegra_ivc_channel *chan)
@@ -477,6 +683,9 @@ static void tegra_capture_ivc_remove(struct tegra_ivc_channel *chan)
 		__scivc_capture = NULL;
 	else
 		dev_WARN(&chan->dev, "Unknown ivc channel\n");
+
+	debugfs_remove_recursive(civc->debugfs);
+	kthread_stop(civc->rx_thread);
 }
 
 static struct of_device_id tegra_capture_ivc_channel_of_match[] = {
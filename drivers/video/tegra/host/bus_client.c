@@ -1948,37 +1948,40 @@ void nvhost_eventlib_log_task(struct platform_device *pdev,
 			      u64 timestamp_end)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
-	struct nvhost_task_begin task_begin;
-	struct nvhost_task_end task_end;
+	struct nvhost_task_begin *task_begin;
+	struct nvhost_task_end *task_end;
+	struct keventlib_batch batch;
 
 	if (!pdata->eventlib_id)
 		return;
 
 	/*
-	 * Write task start event
+	 * Write task start and end events in place, as one batch
 	 */
-	task_begin.syncpt_id = syncpt_id;
-	task_begin.syncpt_thresh = syncpt_thresh;
-	task_begin.class_id = pdata->class;
+	if (keventlib_reserve(pdata->eventlib_id, &batch,
+			keventlib_event_size(sizeof(*task_begin)) +
+			keventlib_event_size(sizeof(*task_end))))
+		return;
 
-	keventlib_write(pdata->eventlib_id,
-			&task_begin,
-			sizeof(task_begin),
-			NVHOST_TASK_BEGIN,
-			timestamp_start);
+	task_begin = keventlib_reserve_event(&batch, sizeof(*task_begin),
+					     NVHOST_TASK_BEGIN,
+					     timestamp_start);
+	if (task_begin) {
+		task_begin->syncpt_id = syncpt_id;
+		task_begin->syncpt_thresh = syncpt_thresh;
+		task_begin->class_id = pdata->class;
+	}
 
-	/*
-	 * Write task end event
-	 */
-	task_end.syncpt_id = syncpt_id;
-	task_end.syncpt_thresh = syncpt_thresh;
-	task_end.class_id = pdata->class;
+	task_end = keventlib_reserve_event(&batch, sizeof(*task_end),
+					   NVHOST_TASK_END,
+					   timestamp_end);
+	if (task_end) {
+		task_end->syncpt_id = syncpt_id;
+		task_end->syncpt_thresh = syncpt_thresh;
+		task_end->class_id = pdata->class;
+	}
 
-	keventlib_write(pdata->eventlib_id,
-			&task_end,
-			sizeof(task_end),
-			NVHOST_TASK_END,
-			timestamp_end);
+	keventlib_commit(&batch);
 }
 
 void nvhost_eventlib_log_submit(struct platform_device *pdev,
@@ -28,6 +28,7 @@
 #include "debug.h"
 #include "nvhost_acm.h"
 #include "nvhost_channel.h"
+#include "nvhost_job.h"
 #include "chip_support.h"
 
 unsigned int nvhost_debug_trace_cmdbuf;
@@ -274,6 +275,9 @@ void nvhost_debug_init(struct nvhost_master *master)
 			&pdata->nvhost_timeout_default);
 	debugfs_create_u32("trace_actmon", S_IRUGO|S_IWUSR, de,
 			&nvhost_debug_trace_actmon);
+
+	nvhost_job_debug_init(de);
+	nvhost_intr_debug_init(de);
 }
 
 void nvhost_register_dump_device(
@@ -77,6 +77,11 @@
  */
 #define MAX_NUM_NVDLA_BUFFERS_PER_TASK	6144
 
+/**
+ * Number of address list buffers submit-pinned per nvhost_buffer call
+ */
+#define NVDLA_SUBMIT_PIN_BATCH	32
+
 /**
  * Trace Buffer Size
  */
@@ -244,6 +249,7 @@ struct nvdla_emu_task {
  * @buf_size		Total size of task dma alloc
  * @timeout		max timeout to wait for task completion
  * @op_handle		pointer to handle list of operation descriptor
+ * @chain_next		next task of a chained submit, NULL for the last one
  *
  */
 struct nvdla_task {
@@ -269,6 +275,7 @@ struct nvdla_task {
 	size_t buf_size;
 	int timeout;
 	int pool_index;
+	struct nvdla_task *chain_next;
 
 	struct dma_buf *memory_dmabuf[NVDLA_MAX_BUFFERS_PER_TASK];
 	struct dma_buf *prefences_sem_dmabuf[MAX_NUM_NVDLA_PREFENCES];
@@ -397,5 +404,7 @@ int nvdla_emulator_submit(struct nvhost_queue *queue,
 				struct nvdla_emu_task *task);
 void task_free(struct kref *ref);
 int nvdla_get_postfences(struct nvhost_queue *queue, void *in_task);
+int nvdla_get_chain_postfences(struct nvhost_queue *queue,
+				struct nvdla_task *head);
 
 #endif /* End of __NVHOST_NVDLA_H__ */
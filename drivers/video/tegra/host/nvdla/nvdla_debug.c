@@ -729,4 +729,5 @@ void nvdla_debug_init(struct platform_device *pdev)
 				pdata->isolate_contexts;
 
 	dla_fw_debugfs_init(pdev);
+	nvhost_buffer_debugfs_init(pdev);
 }
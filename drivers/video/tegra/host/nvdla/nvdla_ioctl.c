@@ -746,6 +746,87 @@ exit:
 	return 0;
 }
 
+/*
+ * Prepares all tasks first and hands them to the queue as one chain, so
+ * that the whole batch costs a single doorbell and a single completion
+ * interrupt.
+ */
+static int nvdla_submit_chain(struct nvdla_private *priv,
+			struct nvdla_ioctl_submit_task *local_tasks,
+			struct nvdla_task **tasks, u32 num_tasks)
+{
+	struct platform_device *pdev = priv->pdev;
+	struct nvhost_queue *queue = priv->queue;
+	struct nvhost_buffers *buffers = priv->buffers;
+	struct nvdla_task *task;
+	int err = 0, i, n = 0;
+
+	for (i = 0; i < num_tasks; i++) {
+		err = nvdla_get_task_mem(queue, &task);
+		if (err) {
+			nvdla_dbg_err(pdev, "failed to get task[%d] mem", i + 1);
+			goto fail_to_prepare;
+		}
+
+		err = nvdla_fill_task(queue, buffers, local_tasks + i, task);
+		if (err) {
+			nvdla_dbg_err(pdev, "failed to fill task[%d]", i + 1);
+			kref_put(&task->ref, task_free);
+			goto fail_to_prepare;
+		}
+		tasks[n++] = task;
+
+		nvdla_dump_task(task);
+
+		err = nvdla_fill_task_desc(task);
+		if (err) {
+			nvdla_dbg_err(pdev, "fail to fill task desc%d", i + 1);
+			goto fail_to_prepare;
+		}
+
+		if (i > 0)
+			tasks[i - 1]->chain_next = task;
+	}
+	nvdla_dbg_info(pdev, "chain of [%d] tasks prepared", num_tasks);
+
+	/* get expected postfences prior to submit */
+	err = nvdla_get_chain_postfences(queue, tasks[0]);
+	if (err) {
+		nvdla_dbg_err(pdev, "fail to get chain fences");
+		goto fail_to_prepare;
+	}
+
+	for (i = 0; i < num_tasks; i++) {
+		err = nvdla_update_postfences(tasks[i], local_tasks + i);
+		if (err) {
+			nvdla_dbg_err(pdev, "fail update postfence%d", i + 1);
+			goto fail_to_update_postfences;
+		}
+	}
+
+	/* send the whole chain to engine through queue framework */
+	err = nvhost_queue_submit(queue, tasks[0]);
+	if (err)
+		nvdla_dbg_err(pdev, "fail to submit chain");
+	else
+		nvdla_dbg_fn(pdev, "Task chain submitted, done!");
+
+	for (i = 0; i < num_tasks; i++)
+		kref_put(&tasks[i]->ref, task_free);
+
+	return err;
+
+fail_to_update_postfences:
+	/* drop the refs nvdla_get_chain_postfences() took for the queue */
+	for (i = 0; i < num_tasks; i++)
+		nvdla_task_put(tasks[i]);
+fail_to_prepare:
+	while (n--)
+		kref_put(&tasks[n]->ref, task_free);
+
+	return err;
+}
+
 static int nvdla_submit(struct nvdla_private *priv, void *arg)
 {
 	struct nvdla_submit_args *args =
@@ -755,8 +836,12 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 	struct platform_device *pdev;
 	struct nvhost_queue *queue;
 	struct nvhost_buffers *buffers;
+	struct nvhost_device_data *pdata;
+	struct nvdla_device *nvdla_dev;
 	u32 num_tasks;
 	struct nvdla_task *task;
+	struct nvdla_task *chain[MAX_TASKS_PER_SUBMIT];
+	bool chained;
 	int err = 0, i = 0;
 
 	if (!args || !priv)
@@ -789,6 +874,17 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 	}
 	nvdla_dbg_info(pdev, "copy of user tasks done");
 
+	/*
+	 * Chaining relies on the MMIO path fencing every task itself, the
+	 * channel path takes its fences from the host1x job instead.
+	 */
+	pdata = platform_get_drvdata(pdev);
+	nvdla_dev = pdata->private_data;
+	chained = (args->flags & NVDLA_SUBMIT_FLAGS_CHAIN) && num_tasks > 1 &&
+		nvdla_dev->submit_mode == NVDLA_SUBMIT_MODE_MMIO;
+	if (chained)
+		return nvdla_submit_chain(priv, local_tasks, chain, num_tasks);
+
 	for (i = 0; i < num_tasks; i++) {
 
 		nvdla_dbg_info(pdev, "submit [%d]th task", i + 1);
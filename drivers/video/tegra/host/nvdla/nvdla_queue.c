@@ -124,6 +124,21 @@ void nvdla_task_get(struct nvdla_task *task)
 	kref_get(&task->ref);
 }
 
+/*
+ * Address list buffers are submit-pinned in batches of
+ * NVDLA_SUBMIT_PIN_BATCH, unpin them with the same batching.
+ */
+static void nvdla_unpin_address_list(struct nvdla_task *task, u32 count)
+{
+	u32 ii, batch;
+
+	for (ii = 0; ii < count; ii += batch) {
+		batch = min_t(u32, count - ii, NVDLA_SUBMIT_PIN_BATCH);
+		nvhost_buffer_submit_unpin(task->buffers,
+					   &task->memory_dmabuf[ii], batch);
+	}
+}
+
 static int nvdla_unmap_task_memory(struct nvdla_task *task)
 {
 	int ii;
@@ -133,13 +148,9 @@ static int nvdla_unmap_task_memory(struct nvdla_task *task)
 	nvdla_dbg_fn(pdev, "task:[%p]", task);
 
 	/* unpin address list */
-	for (ii = 0; ii < task->num_addresses; ii++) {
-		if (task->memory_handles[ii].handle) {
-			nvhost_buffer_submit_unpin(task->buffers,
-				&task->memory_dmabuf[ii], 1);
-			dma_buf_put(task->memory_dmabuf[ii]);
-		}
-	}
+	nvdla_unpin_address_list(task, task->num_addresses);
+	for (ii = 0; ii < task->num_addresses; ii++)
+		dma_buf_put(task->memory_dmabuf[ii]);
 	nvdla_dbg_fn(pdev, "all mem handles unmaped");
 
 	/* unpin prefences memory */
@@ -399,12 +410,15 @@ static u8 *add_gos_action(u8 *mem, uint8_t op, uint8_t index, uint16_t offset,
 
 static int nvdla_map_task_memory(struct nvdla_task *task)
 {
-	int jj;
+	int ii, jj;
 	int err = 0;
 	size_t offset;
 	struct nvhost_buffers *buffers = task->buffers;
 	struct platform_device *pdev = task->queue->pool->pdev;
 	struct dla_task_descriptor *task_desc = task->task_desc;
+	dma_addr_t dma_addr[NVDLA_SUBMIT_PIN_BATCH];
+	size_t dma_size[NVDLA_SUBMIT_PIN_BATCH];
+	u32 batch;
 	u8 *next;
 
 	nvdla_dbg_fn(pdev, "");
@@ -423,41 +437,55 @@ static int nvdla_map_task_memory(struct nvdla_task *task)
 	task_desc->address_list = (uint64_t)((u8 *)task->task_desc_pa + offset);
 	task_desc->num_addresses = task->num_addresses;
 
-	/* update address list with all dma */
+	/* get all the buffers first */
 	for (jj = 0; jj < task->num_addresses; jj++) {
-		dma_addr_t dma_addr;
-		size_t dma_size;
-		err = -EFAULT;
-
 		nvdla_dbg_info(pdev, "count[%d] handle[%u] offset[%u]",
 				jj,
 				task->memory_handles[jj].handle,
 				task->memory_handles[jj].offset);
 
+		err = -EFAULT;
 		if (!task->memory_handles[jj].handle)
-			goto fail_to_pin_mem;
+			goto fail_to_get_buf;
 
 		task->memory_dmabuf[jj] =
 			dma_buf_get(task->memory_handles[jj].handle);
 		if (IS_ERR_OR_NULL(task->memory_dmabuf[jj])) {
 			task->memory_dmabuf[jj] = NULL;
-			err = -EFAULT;
 			nvdla_dbg_err(pdev, "fail to get buf");
-			goto fail_to_pin_mem;
+			goto fail_to_get_buf;
 		}
+	}
+
+	/* then pin and update address list with all dma, in batches */
+	for (jj = 0; jj < task->num_addresses; jj += batch) {
+		batch = min_t(u32, task->num_addresses - jj,
+			      NVDLA_SUBMIT_PIN_BATCH);
 
 		err = nvhost_buffer_submit_pin(buffers,
 				&task->memory_dmabuf[jj],
-				1, &dma_addr, &dma_size, NULL);
+				batch, dma_addr, dma_size, NULL);
 		if (err) {
 			nvdla_dbg_err(pdev, "fail to pin address list");
 			goto fail_to_pin_mem;
 		}
-		next = add_address(next,
-			dma_addr + task->memory_handles[jj].offset);
+
+		for (ii = 0; ii < batch; ii++)
+			next = add_address(next, dma_addr[ii] +
+				task->memory_handles[jj + ii].offset);
 	}
 
+	return 0;
+
 fail_to_pin_mem:
+	/* a failed batch unpins itself, undo the complete ones */
+	nvdla_unpin_address_list(task, jj);
+	jj = task->num_addresses;
+fail_to_get_buf:
+	for (ii = 0; ii < jj; ii++) {
+		dma_buf_put(task->memory_dmabuf[ii]);
+		task->memory_dmabuf[ii] = NULL;
+	}
 	return err;
 }
 
@@ -1039,24 +1067,13 @@ int nvdla_emulator_submit(struct nvhost_queue *queue, struct nvdla_emu_task *tas
 	return 0;
 }
 
-int nvdla_get_postfences(struct nvhost_queue *queue, void *in_task)
+static void nvdla_set_postfences(struct nvhost_queue *queue,
+				struct nvdla_task *task, u32 task_fence)
 {
-	struct nvdla_task *task = (struct nvdla_task *)in_task;
 	struct platform_device *pdev = queue->pool->pdev;
-	uint32_t counter, task_fence;
+	uint32_t counter;
 	int i;
 
-	nvdla_dbg_fn(pdev, "");
-
-	/* get task ref */
-	nvdla_task_get(task);
-
-	if (task->fence_counter == 0)
-		task->fence_counter = 1;
-
-	task_fence = nvhost_syncpt_read_maxval(pdev, queue->syncpt_id) +
-			task->fence_counter;
-
 	/* Update postfences for all */
 	counter = task->fence_counter - 1;
 	for (i = 0; i < task->num_postfences; i++) {
@@ -1074,6 +1091,56 @@ int nvdla_get_postfences(struct nvhost_queue *queue, void *in_task)
 			counter = counter - 1;
 		}
 	}
+}
+
+int nvdla_get_postfences(struct nvhost_queue *queue, void *in_task)
+{
+	struct nvdla_task *task = (struct nvdla_task *)in_task;
+	struct platform_device *pdev = queue->pool->pdev;
+	uint32_t task_fence;
+
+	nvdla_dbg_fn(pdev, "");
+
+	/* get task ref */
+	nvdla_task_get(task);
+
+	if (task->fence_counter == 0)
+		task->fence_counter = 1;
+
+	task_fence = nvhost_syncpt_read_maxval(pdev, queue->syncpt_id) +
+			task->fence_counter;
+
+	nvdla_set_postfences(queue, task, task_fence);
+
+	return 0;
+}
+
+/*
+ * Chained tasks are submitted back to back under one list_lock hold, so
+ * the fences of every task follow directly on the ones of its predecessor.
+ */
+int nvdla_get_chain_postfences(struct nvhost_queue *queue,
+				struct nvdla_task *head)
+{
+	struct platform_device *pdev = queue->pool->pdev;
+	struct nvdla_task *task;
+	uint32_t task_fence;
+
+	nvdla_dbg_fn(pdev, "");
+
+	task_fence = nvhost_syncpt_read_maxval(pdev, queue->syncpt_id);
+
+	for (task = head; task; task = task->chain_next) {
+		/* get task ref */
+		nvdla_task_get(task);
+
+		if (task->fence_counter == 0)
+			task->fence_counter = 1;
+
+		task_fence += task->fence_counter;
+		nvdla_set_postfences(queue, task, task_fence);
+	}
+
 	return 0;
 }
 
@@ -1082,6 +1149,8 @@ static int nvdla_queue_submit(struct nvhost_queue *queue, void *in_task)
 {
 	struct nvdla_task *task = (struct nvdla_task *)in_task;
 	struct nvdla_task *last_task = NULL;
+	struct nvdla_task *tail = task;
+	struct nvdla_task *cur;
 	struct platform_device *pdev = queue->pool->pdev;
 	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
 	struct nvdla_device *nvdla_dev = pdata->private_data;
@@ -1095,29 +1164,41 @@ static int nvdla_queue_submit(struct nvhost_queue *queue, void *in_task)
 
 	mutex_lock(&queue->list_lock);
 
-	/* get fence from nvhost for MMIO mode*/
-	if (nvdla_dev->submit_mode == NVDLA_SUBMIT_MODE_MMIO) {
-		task->fence = nvhost_syncpt_incr_max(task->sp,
-						queue->syncpt_id,
-						task->fence_counter);
-	}
+	/*
+	 * A chained submit links all its tasks into the descriptor list
+	 * here; the engine walks task_desc->next on its own, so only the
+	 * head gets a doorbell and only the tail gets a notifier.
+	 */
+	for (cur = task; cur; cur = cur->chain_next) {
+		/* get fence from nvhost for MMIO mode*/
+		if (nvdla_dev->submit_mode == NVDLA_SUBMIT_MODE_MMIO) {
+			cur->fence = nvhost_syncpt_incr_max(cur->sp,
+							queue->syncpt_id,
+							cur->fence_counter);
+		}
 
-	/* update last task desc's next */
-	if (!list_empty(&queue->tasklist)) {
-		last_task = list_last_entry(&queue->tasklist,
-						struct nvdla_task, list);
-		last_task->task_desc->next = (uint64_t)task->task_desc_pa;
+		/* update last task desc's next */
+		if (!list_empty(&queue->tasklist)) {
+			last_task = list_last_entry(&queue->tasklist,
+							struct nvdla_task, list);
+			last_task->task_desc->next =
+					(uint64_t)cur->task_desc_pa;
 
-		nvdla_dbg_info(pdev, "last task[%p] last_task_desc_pa[%llu]",
-				last_task, task->task_desc_pa);
-	}
-	list_add_tail(&task->list, &queue->tasklist);
+			nvdla_dbg_info(pdev,
+				"last task[%p] last_task_desc_pa[%llu]",
+				last_task, cur->task_desc_pa);
+		}
+		list_add_tail(&cur->list, &queue->tasklist);
 
-	nvdla_dbg_info(pdev, "task[%p] added to list", task);
+		nvdla_dbg_info(pdev, "task[%p] added to list", cur);
 
-	nvdla_dbg_fn(pdev, "syncpt[%d] fence[%d] task[%p] fence_counter[%u]",
-				queue->syncpt_id, task->fence,
-				task, task->fence_counter);
+		nvdla_dbg_fn(pdev,
+			"syncpt[%d] fence[%d] task[%p] fence_counter[%u]",
+			queue->syncpt_id, cur->fence,
+			cur, cur->fence_counter);
+
+		tail = cur;
+	}
 
 	/* enable INT_ON_COMPLETE and INT_ON_ERROR falcon interrupts */
 	method_id = (DLA_CMD_SUBMIT_TASK & DLA_METHOD_ID_CMD_MASK) |
@@ -1149,13 +1230,13 @@ static int nvdla_queue_submit(struct nvhost_queue *queue, void *in_task)
 
 	/* register notifier with fence */
 	err = nvhost_intr_register_notifier(pdev, queue->syncpt_id,
-		task->fence, nvdla_queue_update, queue);
+		tail->fence, nvdla_queue_update, queue);
 	if (err)
 		goto fail_to_register;
 
 	nvhost_eventlib_log_submit(queue->pool->pdev,
 			   queue->syncpt_id,
-			   task->fence,
+			   tail->fence,
 			   timestamp);
 
 	/* prepare command for MMIO submit */
@@ -1169,7 +1250,7 @@ static int nvdla_queue_submit(struct nvhost_queue *queue, void *in_task)
 		if (err) {
 			nvdla_dbg_err(pdev, "task[%p] submit failed", task);
 			nvdla_task_syncpt_reset(task->sp, queue->syncpt_id,
-					task->fence);
+					tail->fence);
 		}
 	}
 	mutex_unlock(&queue->list_lock);
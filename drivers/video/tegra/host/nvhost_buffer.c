@@ -22,6 +22,9 @@
 #include <linux/slab.h>
 #include <linux/dma-buf.h>
 #include <linux/cvnas.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include "dev.h"
 #include "nvhost_buffer.h"
@@ -35,9 +38,12 @@
  * @addr:		Physical address of the buffer
  * @size:		Size of the buffer
  * @user_map_count:	Buffer reference count from user space
- * @submit_map_count:	Buffer reference count from task submit
- * @rb_node:		pinned buffer node
+ * @submit_map_count:	Buffer reference count from task submit, -1 once
+ *			the mapping is being torn down
+ * @hash_node:		pinned buffer node
  * @list_head:		List entry
+ * @lru:		Idle list entry, empty while the buffer is in use
+ * @rcu:		Deferred free for lockless readers
  *
  */
 struct nvhost_vm_buffer {
@@ -50,29 +56,23 @@ struct nvhost_vm_buffer {
 	enum nvhost_buffers_heap heap;
 
 	s32 user_map_count;
-	s32 submit_map_count;
+	atomic_t submit_map_count;
 
-	struct rb_node rb_node;
+	struct hlist_node hash_node;
 	struct list_head list_head;
+	struct list_head lru;
+	struct rcu_head rcu;
 };
 
+/* Caller holds rcu_read_lock() or nvhost_buffers->mutex */
 static struct nvhost_vm_buffer *nvhost_find_map_buffer(
 		struct nvhost_buffers *nvhost_buffers, struct dma_buf *dmabuf)
 {
-	struct rb_root *root = &nvhost_buffers->rb_root;
-	struct rb_node *node = root->rb_node;
 	struct nvhost_vm_buffer *vm;
 
-	/* check in a sorted tree */
-	while (node) {
-		vm = rb_entry(node, struct nvhost_vm_buffer,
-						rb_node);
-
-		if (vm->dmabuf > dmabuf)
-			node = node->rb_left;
-		else if (vm->dmabuf != dmabuf)
-			node = node->rb_right;
-		else
+	hash_for_each_possible_rcu(nvhost_buffers->hash, vm, hash_node,
+				   (unsigned long)dmabuf) {
+		if (vm->dmabuf == dmabuf)
 			return vm;
 	}
 
@@ -83,28 +83,13 @@ static void nvhost_buffer_insert_map_buffer(
 				struct nvhost_buffers *nvhost_buffers,
 				struct nvhost_vm_buffer *new_vm)
 {
-	struct rb_node **new_node = &(nvhost_buffers->rb_root.rb_node);
-	struct rb_node *parent = NULL;
-
-	/* Figure out where to put the new node */
-	while (*new_node) {
-		struct nvhost_vm_buffer *vm =
-			rb_entry(*new_node, struct nvhost_vm_buffer,
-						rb_node);
-		parent = *new_node;
-
-		if (vm->dmabuf > new_vm->dmabuf)
-			new_node = &((*new_node)->rb_left);
-		else
-			new_node = &((*new_node)->rb_right);
-	}
-
-	/* Add new node and rebalance tree */
-	rb_link_node(&new_vm->rb_node, parent, new_node);
-	rb_insert_color(&new_vm->rb_node, &nvhost_buffers->rb_root);
+	INIT_LIST_HEAD(&new_vm->lru);
+	hash_add_rcu(nvhost_buffers->hash, &new_vm->hash_node,
+		     (unsigned long)new_vm->dmabuf);
 
 	/* Add the node into a list  */
 	list_add_tail(&new_vm->list_head, &nvhost_buffers->list_head);
+	nvhost_buffers->stats.pinned_bytes += new_vm->size;
 }
 
 int nvhost_get_iova_addr(struct nvhost_buffers *nvhost_buffers,
@@ -113,7 +98,7 @@ int nvhost_get_iova_addr(struct nvhost_buffers *nvhost_buffers,
 	struct nvhost_vm_buffer *vm;
 	int err = -EINVAL;
 
-	mutex_lock(&nvhost_buffers->mutex);
+	rcu_read_lock();
 
 	vm = nvhost_find_map_buffer(nvhost_buffers, dmabuf);
 	if (vm) {
@@ -121,7 +106,7 @@ int nvhost_get_iova_addr(struct nvhost_buffers *nvhost_buffers,
 		err = 0;
 	}
 
-	mutex_unlock(&nvhost_buffers->mutex);
+	rcu_read_unlock();
 
 	return err;
 }
@@ -187,6 +172,10 @@ buf_attach_err:
 	return err;
 }
 
+/* Live buffer lists of all devices, for nvhost_buffer_get_stats() */
+static LIST_HEAD(nvhost_buffers_list);
+static DEFINE_MUTEX(nvhost_buffers_list_lock);
+
 static void nvhost_free_buffers(struct kref *kref)
 {
 	struct nvhost_buffers *nvhost_buffers =
@@ -195,22 +184,79 @@ static void nvhost_free_buffers(struct kref *kref)
 	kfree(nvhost_buffers);
 }
 
+static void nvhost_buffer_lru_del(struct nvhost_buffers *nvhost_buffers,
+				  struct nvhost_vm_buffer *vm)
+{
+	if (list_empty(&vm->lru))
+		return;
+
+	list_del_init(&vm->lru);
+	nvhost_buffers->stats.idle_bytes -= vm->size;
+}
+
+/* Returns true if the mapping was torn down */
+static bool nvhost_buffer_destroy(struct nvhost_buffers *nvhost_buffers,
+				  struct nvhost_vm_buffer *vm)
+{
+	/* A lockless submit pin may race with us; it wins */
+	if (atomic_cmpxchg(&vm->submit_map_count, 0, -1) != 0)
+		return false;
+
+	nvhost_buffer_lru_del(nvhost_buffers, vm);
+	hash_del_rcu(&vm->hash_node);
+	list_del(&vm->list_head);
+	nvhost_buffers->stats.pinned_bytes -= vm->size;
+
+	dma_buf_unmap_attachment(vm->attach, vm->sgt, DMA_BIDIRECTIONAL);
+	dma_buf_detach(vm->dmabuf, vm->attach);
+	dma_buf_put(vm->dmabuf);
+
+	kfree_rcu(vm, rcu);
+
+	return true;
+}
+
+static void nvhost_buffer_evict(struct nvhost_buffers *nvhost_buffers)
+{
+	struct nvhost_vm_buffer *vm, *n;
+
+	list_for_each_entry_safe(vm, n, &nvhost_buffers->lru, lru) {
+		if (nvhost_buffers->stats.pinned_bytes <=
+		    nvhost_buffers->iova_budget)
+			break;
+
+		if (nvhost_buffer_destroy(nvhost_buffers, vm))
+			nvhost_buffers->stats.evictions++;
+		else
+			nvhost_buffer_lru_del(nvhost_buffers, vm);
+	}
+}
+
+/*
+ * Called with the mutex held when a reference was dropped. A mapping
+ * nobody uses any more is parked on the lru instead of being unmapped,
+ * so that the next pin of the same buffer is a cache hit.
+ */
 static void nvhost_buffer_unmap(struct nvhost_buffers *nvhost_buffers,
 				struct nvhost_vm_buffer *vm)
 {
 	nvhost_dbg_fn("");
 
-	if ((vm->user_map_count != 0) || (vm->submit_map_count != 0))
+	if ((vm->user_map_count != 0) ||
+	    (atomic_read(&vm->submit_map_count) != 0))
 		return;
 
-	dma_buf_unmap_attachment(vm->attach, vm->sgt, DMA_BIDIRECTIONAL);
-	dma_buf_detach(vm->dmabuf, vm->attach);
-	dma_buf_put(vm->dmabuf);
+	if (nvhost_buffers->released) {
+		nvhost_buffer_destroy(nvhost_buffers, vm);
+		return;
+	}
 
-	rb_erase(&vm->rb_node, &nvhost_buffers->rb_root);
-	list_del(&vm->list_head);
+	if (list_empty(&vm->lru)) {
+		list_add_tail(&vm->lru, &nvhost_buffers->lru);
+		nvhost_buffers->stats.idle_bytes += vm->size;
+	}
 
-	kfree(vm);
+	nvhost_buffer_evict(nvhost_buffers);
 }
 
 struct nvhost_buffers *nvhost_buffer_init(struct platform_device *pdev)
@@ -226,16 +272,62 @@ struct nvhost_buffers *nvhost_buffer_init(struct platform_device *pdev)
 
 	nvhost_buffers->pdev = pdev;
 	mutex_init(&nvhost_buffers->mutex);
-	nvhost_buffers->rb_root = RB_ROOT;
+	hash_init(nvhost_buffers->hash);
 	INIT_LIST_HEAD(&nvhost_buffers->list_head);
+	INIT_LIST_HEAD(&nvhost_buffers->lru);
+	nvhost_buffers->iova_budget = NVHOST_BUFFERS_DEFAULT_IOVA_BUDGET;
 	kref_init(&nvhost_buffers->kref);
 
+	mutex_lock(&nvhost_buffers_list_lock);
+	list_add_tail(&nvhost_buffers->node, &nvhost_buffers_list);
+	mutex_unlock(&nvhost_buffers_list_lock);
+
 	return nvhost_buffers;
 
 nvhost_buffer_init_err:
 	return ERR_PTR(err);
 }
 
+/*
+ * Fast path for buffers the user still has pinned: no mutex, just an
+ * rcu lookup and an atomic increment that fails once teardown started.
+ */
+static struct nvhost_vm_buffer *nvhost_buffer_get_submit_fast(
+		struct nvhost_buffers *nvhost_buffers, struct dma_buf *dmabuf)
+{
+	struct nvhost_vm_buffer *vm;
+
+	vm = nvhost_find_map_buffer(nvhost_buffers, dmabuf);
+	if (vm == NULL || READ_ONCE(vm->user_map_count) <= 0)
+		return NULL;
+
+	if (!atomic_inc_unless_negative(&vm->submit_map_count))
+		return NULL;
+
+	return vm;
+}
+
+static struct nvhost_vm_buffer *nvhost_buffer_get_submit_slow(
+		struct nvhost_buffers *nvhost_buffers, struct dma_buf *dmabuf)
+{
+	struct nvhost_vm_buffer *vm;
+
+	mutex_lock(&nvhost_buffers->mutex);
+
+	vm = nvhost_find_map_buffer(nvhost_buffers, dmabuf);
+	if (vm && (vm->user_map_count > 0 ||
+		   atomic_read(&vm->submit_map_count) > 0)) {
+		atomic_inc(&vm->submit_map_count);
+		nvhost_buffer_lru_del(nvhost_buffers, vm);
+	} else {
+		vm = NULL;
+	}
+
+	mutex_unlock(&nvhost_buffers->mutex);
+
+	return vm;
+}
+
 int nvhost_buffer_submit_pin(struct nvhost_buffers *nvhost_buffers,
 			     struct dma_buf **dmabufs, u32 count,
 			     dma_addr_t *paddr, size_t *psize,
@@ -246,14 +338,18 @@ int nvhost_buffer_submit_pin(struct nvhost_buffers *nvhost_buffers,
 
 	kref_get(&nvhost_buffers->kref);
 
-	mutex_lock(&nvhost_buffers->mutex);
-
 	for (i = 0; i < count; i++) {
-		vm = nvhost_find_map_buffer(nvhost_buffers, dmabufs[i]);
+		rcu_read_lock();
+		vm = nvhost_buffer_get_submit_fast(nvhost_buffers, dmabufs[i]);
+		rcu_read_unlock();
+
+		/* vm stays valid while we hold a submit reference */
+		if (vm == NULL)
+			vm = nvhost_buffer_get_submit_slow(nvhost_buffers,
+							   dmabufs[i]);
 		if (vm == NULL)
 			goto submit_err;
 
-		vm->submit_map_count++;
 		paddr[i] = vm->addr;
 		psize[i] = vm->size;
 
@@ -262,12 +358,9 @@ int nvhost_buffer_submit_pin(struct nvhost_buffers *nvhost_buffers,
 			heap[i] = vm->heap;
 	}
 
-	mutex_unlock(&nvhost_buffers->mutex);
 	return 0;
 
 submit_err:
-	mutex_unlock(&nvhost_buffers->mutex);
-
 	count = i;
 
 	nvhost_buffer_submit_unpin(nvhost_buffers, dmabufs, count);
@@ -289,6 +382,8 @@ int nvhost_buffer_pin(struct nvhost_buffers *nvhost_buffers,
 		vm = nvhost_find_map_buffer(nvhost_buffers, dmabufs[i]);
 		if (vm) {
 			vm->user_map_count++;
+			nvhost_buffer_lru_del(nvhost_buffers, vm);
+			nvhost_buffers->stats.hits++;
 			continue;
 		}
 
@@ -303,8 +398,12 @@ int nvhost_buffer_pin(struct nvhost_buffers *nvhost_buffers,
 			goto free_vm;
 
 		nvhost_buffer_insert_map_buffer(nvhost_buffers, vm);
+		nvhost_buffers->stats.misses++;
 	}
 
+	/* New mappings may have pushed us over budget */
+	nvhost_buffer_evict(nvhost_buffers);
+
 	mutex_unlock(&nvhost_buffers->mutex);
 	return err;
 
@@ -324,9 +423,10 @@ void nvhost_buffer_submit_unpin(struct nvhost_buffers *nvhost_buffers,
 				struct dma_buf **dmabufs, u32 count)
 {
 	struct nvhost_vm_buffer *vm;
+	bool idle = false;
 	int i = 0;
 
-	mutex_lock(&nvhost_buffers->mutex);
+	rcu_read_lock();
 
 	for (i = 0; i < count; i++) {
 
@@ -334,12 +434,27 @@ void nvhost_buffer_submit_unpin(struct nvhost_buffers *nvhost_buffers,
 		if (vm == NULL)
 			continue;
 
-		if (vm->submit_map_count-- < 0)
-			vm->submit_map_count = 0;
-		nvhost_buffer_unmap(nvhost_buffers, vm);
+		/*
+		 * Fully ordered, pairs with smp_mb() in nvhost_buffer_unpin()
+		 * so that one side always sees the buffer going idle.
+		 */
+		if (atomic_dec_if_positive(&vm->submit_map_count) == 0 &&
+		    READ_ONCE(vm->user_map_count) == 0)
+			idle = true;
 	}
 
-	mutex_unlock(&nvhost_buffers->mutex);
+	rcu_read_unlock();
+
+	if (idle) {
+		mutex_lock(&nvhost_buffers->mutex);
+		for (i = 0; i < count; i++) {
+			vm = nvhost_find_map_buffer(nvhost_buffers,
+						    dmabufs[i]);
+			if (vm)
+				nvhost_buffer_unmap(nvhost_buffers, vm);
+		}
+		mutex_unlock(&nvhost_buffers->mutex);
+	}
 
 	kref_put(&nvhost_buffers->kref, nvhost_free_buffers);
 }
@@ -360,18 +475,103 @@ void nvhost_buffer_unpin(struct nvhost_buffers *nvhost_buffers,
 
 		if (vm->user_map_count-- < 0)
 			vm->user_map_count = 0;
+
+		/* Pairs with atomic_dec_if_positive() in submit_unpin */
+		smp_mb();
 		nvhost_buffer_unmap(nvhost_buffers, vm);
 	}
 
 	mutex_unlock(&nvhost_buffers->mutex);
 }
 
+void nvhost_buffer_get_stats(struct platform_device *pdev,
+			     struct nvhost_buffers_stats *stats,
+			     unsigned int *nr_clients)
+{
+	struct nvhost_buffers *nvhost_buffers;
+	unsigned int nr = 0;
+
+	memset(stats, 0, sizeof(*stats));
+
+	mutex_lock(&nvhost_buffers_list_lock);
+	list_for_each_entry(nvhost_buffers, &nvhost_buffers_list, node) {
+		if (nvhost_buffers->pdev != pdev)
+			continue;
+
+		mutex_lock(&nvhost_buffers->mutex);
+		stats->hits += nvhost_buffers->stats.hits;
+		stats->misses += nvhost_buffers->stats.misses;
+		stats->evictions += nvhost_buffers->stats.evictions;
+		stats->pinned_bytes += nvhost_buffers->stats.pinned_bytes;
+		stats->idle_bytes += nvhost_buffers->stats.idle_bytes;
+		mutex_unlock(&nvhost_buffers->mutex);
+		nr++;
+	}
+	mutex_unlock(&nvhost_buffers_list_lock);
+
+	if (nr_clients)
+		*nr_clients = nr;
+}
+
+static int nvhost_buffer_stats_show(struct seq_file *s, void *data)
+{
+	struct platform_device *pdev = s->private;
+	struct nvhost_buffers_stats stats;
+	unsigned int nr_clients;
+	u64 lookups;
+
+	nvhost_buffer_get_stats(pdev, &stats, &nr_clients);
+	lookups = stats.hits + stats.misses;
+
+	seq_printf(s, "clients:      %u\n", nr_clients);
+	seq_printf(s, "hits:         %llu\n", stats.hits);
+	seq_printf(s, "misses:       %llu\n", stats.misses);
+	seq_printf(s, "hit rate:     %llu%%\n",
+		   lookups ? div64_u64(stats.hits * 100, lookups) : 0);
+	seq_printf(s, "evictions:    %llu\n", stats.evictions);
+	seq_printf(s, "pinned bytes: %zu\n", stats.pinned_bytes);
+	seq_printf(s, "idle bytes:   %zu\n", stats.idle_bytes);
+
+	return 0;
+}
+
+static int nvhost_buffer_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_buffer_stats_show, inode->i_private);
+}
+
+static const struct file_operations nvhost_buffer_stats_fops = {
+	.open = nvhost_buffer_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+void nvhost_buffer_debugfs_init(struct platform_device *pdev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+
+	if (!pdata->debugfs)
+		return;
+
+	if (!debugfs_create_file("buffer_cache", S_IRUGO, pdata->debugfs,
+				 pdev, &nvhost_buffer_stats_fops))
+		nvhost_dbg_info("Failed to create buffer_cache node");
+}
+
 void nvhost_buffer_release(struct nvhost_buffers *nvhost_buffers)
 {
+	struct nvhost_buffers_stats *stats = &nvhost_buffers->stats;
 	struct nvhost_vm_buffer *vm, *n;
 
 	/* Go through each entry and remove it safely */
 	mutex_lock(&nvhost_buffers->mutex);
+
+	nvhost_dbg_info("buffer cache: %llu hits %llu misses %llu evictions, %zu bytes pinned",
+			stats->hits, stats->misses, stats->evictions,
+			stats->pinned_bytes);
+
+	nvhost_buffers->released = true;
 	list_for_each_entry_safe(vm, n, &nvhost_buffers->list_head,
 				 list_head) {
 		vm->user_map_count = 0;
@@ -379,5 +579,9 @@ void nvhost_buffer_release(struct nvhost_buffers *nvhost_buffers)
 	}
 	mutex_unlock(&nvhost_buffers->mutex);
 
+	mutex_lock(&nvhost_buffers_list_lock);
+	list_del(&nvhost_buffers->node);
+	mutex_unlock(&nvhost_buffers_list_lock);
+
 	kref_put(&nvhost_buffers->kref, nvhost_free_buffers);
 }
@@ -20,30 +20,67 @@
 #define __NVHOST_NVHOST_BUFFER_H__
 
 #include <linux/dma-buf.h>
+#include <linux/hashtable.h>
+#include <linux/sizes.h>
+
+#define NVHOST_BUFFERS_HASH_BITS		6
+#define NVHOST_BUFFERS_DEFAULT_IOVA_BUDGET	SZ_256M
 
 enum nvhost_buffers_heap {
 	NVHOST_BUFFERS_HEAP_DRAM = 0,
 	NVHOST_BUFFERS_HEAP_CVNAS
 };
 
+/**
+ * @brief		Mapping cache statistics
+ *
+ * hits			User pins served from an existing mapping
+ * misses		User pins that had to create a mapping
+ * evictions		Idle mappings dropped to stay within the IOVA budget
+ * pinned_bytes		Bytes currently mapped, including idle mappings
+ * idle_bytes		Bytes mapped but not pinned by user or task
+ *
+ */
+struct nvhost_buffers_stats {
+	u64 hits;
+	u64 misses;
+	u64 evictions;
+	size_t pinned_bytes;
+	size_t idle_bytes;
+};
+
 /**
  * @brief		Information needed for buffers
  *
  * pdev			Pointer to NVHOST device
- * rb_root		RB tree root for of all the buffers used by a file pointer
+ * hash			RCU hash of all the buffers used by a file pointer,
+ *			readers need no lock, updates hold mutex
  * list			List for traversing through all the buffers
- * mutex		Mutex for the buffer tree and the buffer list
+ * lru			Idle mappings, least recently used first
+ * mutex		Mutex for hash updates, the buffer list and the lru
  * kref			Reference count for the bufferlist
+ * iova_budget		Idle mappings are evicted while pinned_bytes exceeds
+ *			this
+ * released		Set once the owner is gone, nothing is kept idle
+ * stats		Mapping cache statistics, protected by mutex
+ * node			Entry in the list of live buffers, for the per
+ *			device statistics
  *
  */
 struct nvhost_buffers {
 	struct platform_device *pdev;
 
+	DECLARE_HASHTABLE(hash, NVHOST_BUFFERS_HASH_BITS);
 	struct list_head list_head;
-	struct rb_root rb_root;
+	struct list_head lru;
 	struct mutex mutex;
 
 	struct kref kref;
+
+	size_t iova_budget;
+	bool released;
+	struct nvhost_buffers_stats stats;
+	struct list_head node;
 };
 
 /**
@@ -78,6 +115,9 @@ int nvhost_buffer_pin(struct nvhost_buffers *nvhost_buffers,
 /**
  * @brief			UnPins the mapped address space.
  *
+ * Buffers that become unused stay mapped on an idle list and are only
+ * unmapped once the IOVA budget is exceeded or the owner is released.
+ *
  * @param nvhost_buffers	Pointer to nvhost_buffer struct
  * @param dmabufs		Pointer to dmabuffer list
  * @param count			Number of memhandles in the list
@@ -92,7 +132,9 @@ void nvhost_buffer_unpin(struct nvhost_buffers *nvhost_buffers,
  * @brief			Pin the mapped buffer for a task submit
  *
  * This function increased the reference count for a mapped buffer during
- * task submission.
+ * task submission. Buffers already pinned by the user are looked up
+ * without taking the mutex, so callers should pass a whole task buffer
+ * list in one call.
  *
  * @param nvhost_buffers	Pointer to nvhost_buffer struct
  * @param dmabufs		Pointer to dmabuffer list
@@ -114,7 +156,8 @@ int nvhost_buffer_submit_pin(struct nvhost_buffers *nvhost_buffers,
  * @brief		UnPins the mapped address space on task completion.
  *
  * This function decrease the reference count for a mapped buffer when the
- * task get completed or aborted.
+ * task get completed or aborted. The mutex is only taken if a buffer
+ * becomes idle.
  *
  * @param nvhost_buffers	Pointer to nvhost_buffer struct
  * @param dmabufs		Pointer to dmabuffer list
@@ -125,6 +168,33 @@ int nvhost_buffer_submit_pin(struct nvhost_buffers *nvhost_buffers,
 void nvhost_buffer_submit_unpin(struct nvhost_buffers *nvhost_buffers,
 					struct dma_buf **dmabufs, u32 count);
 
+/**
+ * @brief			Read the mapping cache statistics of a device
+ *
+ * The statistics of all live buffer lists of the device are summed up.
+ *
+ * @param pdev			Pointer to NVHOST device
+ * @param stats			Pointer to statistics to fill
+ * @param nr_clients		Number of live buffer lists, may be NULL
+ * @return			None
+ *
+ */
+void nvhost_buffer_get_stats(struct platform_device *pdev,
+			     struct nvhost_buffers_stats *stats,
+			     unsigned int *nr_clients);
+
+/**
+ * @brief			Create the buffer_cache debugfs node
+ *
+ * The node reports the mapping cache statistics of the device under its
+ * debugfs directory.
+ *
+ * @param pdev			Pointer to NVHOST device
+ * @return			None
+ *
+ */
+void nvhost_buffer_debugfs_init(struct platform_device *pdev);
+
 /**
  * @brief			Drop a user reference to buffer structure
  *
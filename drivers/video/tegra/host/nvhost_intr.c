@@ -29,6 +29,12 @@
 #include <linux/interrupt.h>
 #include <linux/slab.h>
 #include <linux/irq.h>
+#include <linux/vmalloc.h>
+#include <linux/random.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/ktime.h>
 #include <trace/events/nvhost.h>
 
 #include "nvhost_channel.h"
@@ -79,42 +85,74 @@ int nvhost_intr_release_time(void *ref, struct nvhost_timespec *ts)
 }
 
 /**
- * add a waiter to a waiter queue, sorted by threshold
- * returns true if it was added at the head of the queue
+ * add a waiter to the waiter tree of a sync point, ordered by threshold.
+ * Waiters with equal thresholds are kept in submission order. Thresholds
+ * are compared wrap-safe, so pending thresholds must stay within 2^31 of
+ * each other, as they must for the hardware comparison too.
+ * returns true if it became the first waiter
  */
 static bool add_waiter_to_queue(struct nvhost_waitlist *waiter,
-				struct list_head *queue)
+				struct nvhost_intr_syncpt *syncpt)
 {
-	struct nvhost_waitlist *pos;
+	struct rb_node **p = &syncpt->wait_tree.rb_node;
+	struct rb_node *parent = NULL;
 	u32 thresh = waiter->thresh;
-
-	list_for_each_entry_reverse(pos, queue, list)
-		if ((s32)(pos->thresh - thresh) <= 0) {
-			list_add(&waiter->list, &pos->list);
-			return false;
+	bool first = true;
+
+	while (*p) {
+		struct nvhost_waitlist *pos =
+			rb_entry(*p, struct nvhost_waitlist, node);
+
+		parent = *p;
+		if ((s32)(thresh - pos->thresh) < 0) {
+			p = &parent->rb_left;
+		} else {
+			p = &parent->rb_right;
+			first = false;
 		}
+	}
+
+	rb_link_node(&waiter->node, parent, p);
+	rb_insert_color(&waiter->node, &syncpt->wait_tree);
+	syncpt->nr_waiters++;
+
+	if (first)
+		syncpt->wait_first = &waiter->node;
+
+	return first;
+}
+
+static void remove_waiter_from_queue(struct nvhost_waitlist *waiter,
+				     struct nvhost_intr_syncpt *syncpt)
+{
+	if (syncpt->wait_first == &waiter->node)
+		syncpt->wait_first = rb_next(&waiter->node);
 
-	list_add(&waiter->list, queue);
-	return true;
+	rb_erase(&waiter->node, &syncpt->wait_tree);
+	syncpt->nr_waiters--;
 }
 
 /**
- * run through a waiter queue for a single sync point ID
- * and gather all completed waiters into lists by actions
+ * take all completed waiters of a single sync point off its waiter tree
+ * and gather them into lists by actions
  */
-static void remove_completed_waiters(struct list_head *head, u32 sync,
-			struct nvhost_timespec isr_recv,
+static void remove_completed_waiters(struct nvhost_intr_syncpt *syncpt,
+			u32 sync, struct nvhost_timespec isr_recv,
 			struct list_head *completed[NVHOST_INTR_ACTION_COUNT])
 {
 	struct list_head *dest;
-	struct nvhost_waitlist *waiter, *next, *prev;
+	struct nvhost_waitlist *waiter, *prev;
 
-	list_for_each_entry_safe(waiter, next, head, list) {
+	while (syncpt->wait_first) {
 		bool removed = false;
 
+		waiter = rb_entry(syncpt->wait_first,
+				  struct nvhost_waitlist, node);
 		if ((s32)(waiter->thresh - sync) > 0)
 			break;
 
+		remove_waiter_from_queue(waiter, syncpt);
+
 		waiter->isr_recv = isr_recv;
 		dest = *(completed + waiter->action);
 
@@ -137,18 +175,18 @@ static void remove_completed_waiters(struct list_head *head, u32 sync,
 		if ((atomic_inc_return(&waiter->state) == WLS_HANDLED)
 								|| removed) {
 			atomic_set(&waiter->state, WLS_CLEANUP);
-			list_move(&waiter->list, dest);
+			list_add(&waiter->list, dest);
 		} else
-			list_move_tail(&waiter->list, dest);
+			list_add_tail(&waiter->list, dest);
 	}
 }
 
 static void reset_threshold_interrupt(struct nvhost_intr *intr,
-			       struct list_head *head,
+			       struct nvhost_intr_syncpt *syncpt,
 			       unsigned int id)
 {
-	u32 thresh = list_first_entry(head,
-				struct nvhost_waitlist, list)->thresh;
+	u32 thresh = rb_entry(syncpt->wait_first,
+				struct nvhost_waitlist, node)->thresh;
 
 	intr_op().set_syncpt_threshold(intr, id, thresh);
 	intr_op().enable_syncpt_intr(intr, id);
@@ -288,18 +326,17 @@ static int process_wait_list(struct nvhost_intr *intr,
 		completed[i] = syncpt->low_prio_handlers + j;
 
 	/* this functions fills completed data */
-	remove_completed_waiters(&syncpt->wait_head, threshold,
+	remove_completed_waiters(syncpt, threshold,
 		syncpt->isr_recv, completed);
 
 	/* check if there are still waiters left */
-	empty = list_empty(&syncpt->wait_head);
+	empty = RB_EMPTY_ROOT(&syncpt->wait_tree);
 
 	/* if not, disable interrupt. If yes, update the inetrrupt */
 	if (empty)
 		intr_op().disable_syncpt_intr(intr, syncpt->id);
 	else
-		reset_threshold_interrupt(intr, &syncpt->wait_head,
-					  syncpt->id);
+		reset_threshold_interrupt(intr, syncpt, syncpt->id);
 
 	/* remove low priority handlers from this list */
 	for (i = NVHOST_INTR_HIGH_PRIO_COUNT;
@@ -389,17 +426,20 @@ bool nvhost_intr_has_pending_jobs(struct nvhost_intr *intr, u32 id,
 {
 	struct nvhost_intr_syncpt *syncpt;
 	struct nvhost_waitlist *waiter;
+	struct rb_node *node;
 	bool res = false;
 
 	syncpt = intr->syncpt + id;
 	spin_lock(&syncpt->lock);
-	list_for_each_entry(waiter, &syncpt->wait_head, list)
+	for (node = syncpt->wait_first; node; node = rb_next(node)) {
+		waiter = rb_entry(node, struct nvhost_waitlist, node);
 		if (((waiter->action ==
 			NVHOST_INTR_ACTION_SUBMIT_COMPLETE) &&
 			(waiter->data != exclude_data))) {
 			res = true;
 			break;
 		}
+	}
 
 	spin_unlock(&syncpt->lock);
 
@@ -443,9 +483,9 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 
 	spin_lock(&syncpt->lock);
 
-	queue_was_empty = list_empty(&syncpt->wait_head);
+	queue_was_empty = RB_EMPTY_ROOT(&syncpt->wait_tree);
 
-	if (add_waiter_to_queue(waiter, &syncpt->wait_head)) {
+	if (add_waiter_to_queue(waiter, syncpt)) {
 		/* added at head of list - new threshold value */
 		intr_op().set_syncpt_threshold(intr, id, thresh);
 
@@ -586,7 +626,9 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 		syncpt->intr = &host->intr;
 		syncpt->id = id;
 		spin_lock_init(&syncpt->lock);
-		INIT_LIST_HEAD(&syncpt->wait_head);
+		syncpt->wait_tree = RB_ROOT;
+		syncpt->wait_first = NULL;
+		syncpt->nr_waiters = 0;
 		snprintf(syncpt->thresh_irq_name,
 			sizeof(syncpt->thresh_irq_name),
 			"host_sp_%02d", id);
@@ -636,19 +678,22 @@ int nvhost_intr_stop(struct nvhost_intr *intr)
 	for (id = 0, syncpt = intr->syncpt;
 	     id < nb_pts;
 	     ++id, ++syncpt) {
-		struct nvhost_waitlist *waiter, *next;
+		struct nvhost_waitlist *waiter;
+		struct rb_node *node = syncpt->wait_first;
 
 		intr_op().disable_syncpt_intr(intr, id);
 
-		list_for_each_entry_safe(waiter, next, &syncpt->wait_head, list) {
+		while (node) {
+			waiter = rb_entry(node, struct nvhost_waitlist, node);
+			node = rb_next(node);
 			if (atomic_cmpxchg(&waiter->state, WLS_CANCELLED, WLS_HANDLED)
 				== WLS_CANCELLED) {
-				list_del(&waiter->list);
+				remove_waiter_from_queue(waiter, syncpt);
 				kref_put(&waiter->refcount, waiter_release);
 			}
 		}
 
-		if (!list_empty(&syncpt->wait_head)) {  /* output diagnostics */
+		if (!RB_EMPTY_ROOT(&syncpt->wait_tree)) {  /* output diagnostics */
 			intr_op().enable_syncpt_intr(intr, id);
 			mutex_unlock(&intr->mutex);
 			return -EBUSY;
@@ -697,3 +742,165 @@ void nvhost_intr_disable_module_intr(struct nvhost_intr *intr, int module_irq)
 	intr_op().disable_module_intr(intr, module_irq);
 	mutex_unlock(&intr->mutex);
 }
+
+/*** Debug ***/
+
+/*
+ * waiter_stress: "echo <waiters> > waiter_stress" queues <waiters> waiters
+ * with random thresholds on a fake sync point whose value starts just below
+ * the 32-bit wrap, and completes them by advancing the value in random
+ * steps. No hardware is touched. The run checks that waiters complete in
+ * threshold order, that none completes early and that none is left behind.
+ * Reading shows the last result.
+ */
+#define WAITER_STRESS_MAX	(1 << 20)
+#define WAITER_STRESS_MAX_STEP	64
+
+static DEFINE_MUTEX(waiter_stress_lock);
+static struct {
+	u32 waiters;
+	u32 batches;
+	u32 errors;
+	u64 insert_ns;
+	u64 complete_ns;
+} waiter_stress;
+
+static int nvhost_intr_waiter_stress_run(u32 count)
+{
+	struct list_head lists[NVHOST_INTR_ACTION_COUNT];
+	struct list_head *completed[NVHOST_INTR_ACTION_COUNT];
+	struct nvhost_timespec isr_recv = { };
+	struct nvhost_intr_syncpt *syncpt;
+	struct nvhost_waitlist *waiters;
+	u32 base = U32_MAX - count / 2;
+	u32 sync = base;
+	u32 batches = 0, errors = 0, done = 0;
+	u64 t;
+	u32 i;
+
+	syncpt = kzalloc(sizeof(*syncpt), GFP_KERNEL);
+	waiters = vzalloc(sizeof(*waiters) * count);
+	if (!syncpt || !waiters) {
+		kfree(syncpt);
+		vfree(waiters);
+		return -ENOMEM;
+	}
+
+	spin_lock_init(&syncpt->lock);
+	syncpt->wait_tree = RB_ROOT;
+	for (i = 0; i < NVHOST_INTR_ACTION_COUNT; i++) {
+		INIT_LIST_HEAD(&lists[i]);
+		completed[i] = &lists[i];
+	}
+
+	for (i = 0; i < count; i++) {
+		waiters[i].thresh = base + 1 + prandom_u32() % (2 * count);
+		waiters[i].action = NVHOST_INTR_ACTION_WAKEUP;
+		atomic_set(&waiters[i].state, WLS_PENDING);
+	}
+
+	t = ktime_get_ns();
+	for (i = 0; i < count; i++) {
+		spin_lock(&syncpt->lock);
+		add_waiter_to_queue(&waiters[i], syncpt);
+		spin_unlock(&syncpt->lock);
+	}
+	waiter_stress.insert_ns = ktime_get_ns() - t;
+
+	t = ktime_get_ns();
+	while (syncpt->nr_waiters) {
+		struct list_head *head = completed[NVHOST_INTR_ACTION_WAKEUP];
+		struct nvhost_waitlist *waiter, *next;
+		u32 prev = base;
+
+		sync += 1 + prandom_u32() % WAITER_STRESS_MAX_STEP;
+
+		spin_lock(&syncpt->lock);
+		remove_completed_waiters(syncpt, sync, isr_recv, completed);
+		spin_unlock(&syncpt->lock);
+		batches++;
+
+		list_for_each_entry_safe(waiter, next, head, list) {
+			if ((s32)(waiter->thresh - sync) > 0 ||
+			    (s32)(waiter->thresh - prev) < 0 ||
+			    atomic_read(&waiter->state) != WLS_REMOVED)
+				errors++;
+			prev = waiter->thresh;
+			list_del(&waiter->list);
+			done++;
+		}
+
+		/* the first waiter left must not have been due */
+		if (syncpt->wait_first &&
+		    (s32)(rb_entry(syncpt->wait_first, struct nvhost_waitlist,
+				   node)->thresh - sync) <= 0)
+			errors++;
+	}
+	waiter_stress.complete_ns = ktime_get_ns() - t;
+
+	if (done != count)
+		errors++;
+
+	waiter_stress.waiters = count;
+	waiter_stress.batches = batches;
+	waiter_stress.errors = errors;
+
+	vfree(waiters);
+	kfree(syncpt);
+	return 0;
+}
+
+static int nvhost_intr_waiter_stress_show(struct seq_file *s, void *unused)
+{
+	mutex_lock(&waiter_stress_lock);
+	seq_printf(s, "waiters: %u batches: %u errors: %u\n",
+		   waiter_stress.waiters, waiter_stress.batches,
+		   waiter_stress.errors);
+	seq_printf(s, "insert: %lluus complete: %lluus\n",
+		   div64_u64(waiter_stress.insert_ns, NSEC_PER_USEC),
+		   div64_u64(waiter_stress.complete_ns, NSEC_PER_USEC));
+	mutex_unlock(&waiter_stress_lock);
+	return 0;
+}
+
+static int nvhost_intr_waiter_stress_open(struct inode *inode,
+					  struct file *file)
+{
+	return single_open(file, nvhost_intr_waiter_stress_show,
+			   inode->i_private);
+}
+
+static ssize_t nvhost_intr_waiter_stress_write(struct file *file,
+		const char __user *buffer, size_t count, loff_t *pos)
+{
+	char buf[16] = { 0 };
+	u32 waiters;
+	int ret;
+
+	if (copy_from_user(buf, buffer, min(count, sizeof(buf) - 1)))
+		return -EFAULT;
+
+	if (kstrtou32(strim(buf), 0, &waiters) || !waiters ||
+	    waiters > WAITER_STRESS_MAX)
+		return -EINVAL;
+
+	mutex_lock(&waiter_stress_lock);
+	ret = nvhost_intr_waiter_stress_run(waiters);
+	mutex_unlock(&waiter_stress_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations nvhost_intr_waiter_stress_fops = {
+	.open		= nvhost_intr_waiter_stress_open,
+	.read		= seq_read,
+	.write		= nvhost_intr_waiter_stress_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void nvhost_intr_debug_init(struct dentry *de)
+{
+	debugfs_create_file("waiter_stress", S_IRUGO|S_IWUSR, de,
+			NULL, &nvhost_intr_waiter_stress_fops);
+}
@@ -26,6 +26,7 @@
 #include <linux/interrupt.h>
 #include <linux/workqueue.h>
 #include <linux/spinlock.h>
+#include <linux/rbtree.h>
 #include <linux/version.h>
 #if LINUX_VERSION_CODE > KERNEL_VERSION(4, 13, 0)
 #include <linux/wait.h>
@@ -35,6 +36,7 @@
 
 struct nvhost_channel;
 struct platform_device;
+struct dentry;
 
 enum nvhost_intr_action {
 	/**
@@ -86,6 +88,7 @@ struct nvhost_intr;
 
 struct nvhost_waitlist {
 	struct nvhost_master *host;
+	struct rb_node node;
 	struct list_head list;
 	struct kref refcount;
 	u32 thresh;
@@ -101,7 +104,10 @@ struct nvhost_intr_syncpt {
 	struct nvhost_intr *intr;
 	u32 id;
 	spinlock_t lock;
-	struct list_head wait_head;
+	/* pending waiters ordered by wrap-safe threshold, first is cached */
+	struct rb_root wait_tree;
+	struct rb_node *wait_first;
+	u32 nr_waiters;
 	char thresh_irq_name[12];
 	struct nvhost_timespec isr_recv;
 	struct work_struct low_prio_work;
@@ -165,6 +171,8 @@ void nvhost_intr_disable_host_irq(struct nvhost_intr *intr, int irq);
 void nvhost_intr_enable_module_intr(struct nvhost_intr *intr, int module_irq);
 void nvhost_intr_disable_module_intr(struct nvhost_intr *intr, int module_irq);
 
+void nvhost_intr_debug_init(struct dentry *de);
+
 void nvhost_syncpt_thresh_fn(void *dev_id);
 irqreturn_t nvhost_intr_irq_fn(int irq, void *dev_id);
 #if defined(CONFIG_TEGRA_GRHOST_SCALE)
@@ -24,6 +24,9 @@
 #include <linux/vmalloc.h>
 #include <linux/sort.h>
 #include <linux/scatterlist.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 #include <trace/events/nvhost.h>
 #include "nvhost_channel.h"
 #include "nvhost_vm.h"
@@ -45,6 +48,7 @@ static size_t job_size(u32 num_cmdbufs, u32 num_relocs, u32 num_waitchks,
 		+ (u64)num_relocs * ALIGN(sizeof(struct nvhost_reloc), 8)
 		+ (u64)num_relocs * ALIGN(sizeof(struct nvhost_reloc_shift), 8)
 		+ (u64)num_relocs * ALIGN(sizeof(struct nvhost_reloc_type), 8)
+		+ (u64)num_relocs * ALIGN(sizeof(struct nvhost_reloc_order), 8)
 		+ num_unpins * ALIGN(sizeof(struct nvhost_job_unpin), 8)
 		+ (u64)num_waitchks * ALIGN(sizeof(struct nvhost_waitchk), 8)
 		+ (u64)num_cmdbufs * ALIGN(sizeof(struct nvhost_job_gather), 8)
@@ -80,6 +84,8 @@ static void init_fields(struct nvhost_job *job,
 	mem += num_relocs * ALIGN(sizeof(struct nvhost_reloc_shift), 8);
 	job->reloctypearray = num_relocs ? mem : NULL;
 	mem += num_relocs * ALIGN(sizeof(struct nvhost_reloc_type), 8);
+	job->reloc_order = num_relocs ? mem : NULL;
+	mem += num_relocs * ALIGN(sizeof(struct nvhost_reloc_order), 8);
 	job->unpins = num_unpins ? mem : NULL;
 	mem += num_unpins * ALIGN(sizeof(struct nvhost_job_unpin), 8);
 	job->waitchk = num_waitchks ? mem : NULL;
@@ -480,114 +486,219 @@ static int pin_job_mem(struct nvhost_job *job)
 	return result;
 }
 
+static int reloc_order_cmp(const void *_a, const void *_b)
+{
+	const struct nvhost_reloc_order *a = _a;
+	const struct nvhost_reloc_order *b = _b;
+
+	if (a->cmdbuf_mem != b->cmdbuf_mem)
+		return a->cmdbuf_mem < b->cmdbuf_mem ? -1 : 1;
+	if (a->cmdbuf_offset != b->cmdbuf_offset)
+		return a->cmdbuf_offset < b->cmdbuf_offset ? -1 : 1;
+
+	return 0;
+}
+
+/*
+ * Sort the relocs by (cmdbuf_mem, cmdbuf_offset) once per job so that the
+ * relocs of each gather memory form one run, ordered by patch address.
+ */
+static void sort_relocs(struct nvhost_job *job)
+{
+	int i;
+
+	for (i = 0; i < job->num_relocs; i++) {
+		job->reloc_order[i].cmdbuf_mem =
+			job->relocarray[i].cmdbuf_mem;
+		job->reloc_order[i].cmdbuf_offset =
+			job->relocarray[i].cmdbuf_offset;
+		job->reloc_order[i].index = i;
+	}
+
+	sort(job->reloc_order, job->num_relocs,
+		sizeof(*job->reloc_order), reloc_order_cmp, NULL);
+}
+
+/* Find the first sorted reloc that patches cmdbuf_mem */
+static int find_reloc_run(struct nvhost_job *job, u32 cmdbuf_mem)
+{
+	int lo = 0, hi = job->num_relocs;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (job->reloc_order[mid].cmdbuf_mem < cmdbuf_mem)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void patch_reloc(struct nvhost_job *job,
+		struct nvhost_device_data *pdata, u32 index, void *addr)
+{
+	struct nvhost_reloc *reloc = &job->relocarray[index];
+	struct nvhost_reloc_shift *shift = &job->relocshiftarray[index];
+	struct nvhost_reloc_type *type = &job->reloctypearray[index];
+	dma_addr_t phys_addr;
+
+	if (pdata->get_reloc_phys_addr)
+		phys_addr = pdata->get_reloc_phys_addr(
+					job->reloc_addr_phys[index],
+					type->reloc_type);
+	else
+		phys_addr = job->reloc_addr_phys[index];
+
+	__raw_writel((phys_addr + reloc->target_offset) >> shift->shift,
+		     (void __iomem *)addr);
+}
+
+/*
+ * Patch the relocs of one gather memory. The relocs are sorted by offset,
+ * so CPU access is begun once for the pages they span and the buffer is
+ * vmapped as a whole when more than one page needs patching. If the
+ * exporter cannot vmap the buffer, pages are kmapped one at a time.
+ */
 static int do_relocs(struct nvhost_job *job,
 		u32 cmdbuf_mem, struct dma_buf *buf)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
-	int i = 0;
-	int last_page = -1;
-	size_t last_offset;
+	struct nvhost_reloc_order *order;
+	int first = find_reloc_run(job, cmdbuf_mem);
+	int i, count = 0;
+	unsigned long first_page, last_page;
+	size_t start, len;
+	void *vaddr = NULL;
 	void *cmdbuf_page_addr = NULL;
-	dma_addr_t phys_addr;
+	unsigned long mapped_page = 0;
 	int err;
 
-	/* pin & patch the relocs for one gather */
-	while (i < job->num_relocs) {
-		struct nvhost_reloc *reloc = &job->relocarray[i];
-		struct nvhost_reloc_shift *shift = &job->relocshiftarray[i];
-		struct nvhost_reloc_type *type = &job->reloctypearray[i];
+	order = &job->reloc_order[first];
+	while (first + count < job->num_relocs &&
+	       order[count].cmdbuf_mem == cmdbuf_mem)
+		count++;
 
-		/* skip all other gathers */
-		if (cmdbuf_mem != reloc->cmdbuf_mem) {
-			i++;
-			continue;
-		}
+	if (!count)
+		return 0;
 
-		if (reloc->cmdbuf_offset & 3 ||
-		    reloc->cmdbuf_offset >= buf->size) {
+	/* sorted by offset, so only the ends need range checks */
+	for (i = 0; i < count; i++) {
+		if (order[i].cmdbuf_offset & 3) {
 			nvhost_err(&pdata->pdev->dev,
 				   "invalid cmdbuf_offset=0x%x",
-				   reloc->cmdbuf_offset);
+				   order[i].cmdbuf_offset);
 			return -EINVAL;
 		}
+	}
 
-		if (last_page != reloc->cmdbuf_offset >> PAGE_SHIFT) {
-			if (cmdbuf_page_addr) {
-				dma_buf_kunmap(buf, last_page,
-						cmdbuf_page_addr);
-				dma_buf_end_cpu_access(buf, last_offset,
-					PAGE_SIZE, DMA_TO_DEVICE);
-			}
+	if (order[count - 1].cmdbuf_offset >= buf->size) {
+		nvhost_err(&pdata->pdev->dev,
+			   "invalid cmdbuf_offset=0x%x",
+			   order[count - 1].cmdbuf_offset);
+		return -EINVAL;
+	}
+
+	first_page = order[0].cmdbuf_offset >> PAGE_SHIFT;
+	last_page = order[count - 1].cmdbuf_offset >> PAGE_SHIFT;
+	start = first_page << PAGE_SHIFT;
+	len = (last_page - first_page + 1) << PAGE_SHIFT;
+
+	if (last_page != first_page)
+		vaddr = dma_buf_vmap(buf);
+
+	err = dma_buf_begin_cpu_access(buf, start, len, DMA_TO_DEVICE);
+	if (err) {
+		nvhost_err(&pdata->pdev->dev,
+			"begin_cpu_access() failed for patching reloc %d",
+			err);
+		goto out_vunmap;
+	}
 
-			cmdbuf_page_addr = dma_buf_kmap(buf,
-					reloc->cmdbuf_offset >> PAGE_SHIFT);
-			last_page = reloc->cmdbuf_offset >> PAGE_SHIFT;
-			last_offset = reloc->cmdbuf_offset & PAGE_MASK;
+	for (i = 0; i < count; i++) {
+		u32 offset = order[i].cmdbuf_offset;
+		unsigned long page = offset >> PAGE_SHIFT;
+
+		if (vaddr) {
+			patch_reloc(job, pdata, order[i].index,
+				    vaddr + offset);
+			continue;
+		}
 
+		if (!cmdbuf_page_addr || mapped_page != page) {
+			if (cmdbuf_page_addr)
+				dma_buf_kunmap(buf, mapped_page,
+						cmdbuf_page_addr);
+
+			cmdbuf_page_addr = dma_buf_kmap(buf, page);
+			mapped_page = page;
 			if (unlikely(!cmdbuf_page_addr)) {
 				pr_err("Couldn't map cmdbuf for relocation\n");
-				return -ENOMEM;
-			}
-
-			err = dma_buf_begin_cpu_access(buf, last_offset,
-					PAGE_SIZE, DMA_TO_DEVICE);
-			if (err) {
-				nvhost_err(&pdata->pdev->dev,
-					"begin_cpu_access() failed for patching reloc %d",
-					err);
-				return err;
+				err = -ENOMEM;
+				break;
 			}
 		}
 
-		if (pdata->get_reloc_phys_addr)
-			phys_addr = pdata->get_reloc_phys_addr(
-						job->reloc_addr_phys[i],
-						type->reloc_type);
-		else
-			phys_addr = job->reloc_addr_phys[i];
-
-		__raw_writel(
-			(phys_addr +
-				reloc->target_offset) >> shift->shift,
-			(void __iomem *)(cmdbuf_page_addr +
-				(reloc->cmdbuf_offset & ~PAGE_MASK)));
-
-		/* remove completed reloc from the job */
-		if (i != job->num_relocs - 1) {
-			struct nvhost_reloc *reloc_last =
-				&job->relocarray[job->num_relocs - 1];
-			struct nvhost_reloc_shift *shift_last =
-				&job->relocshiftarray[job->num_relocs - 1];
-			struct nvhost_reloc_type *type_last =
-				&job->reloctypearray[job->num_relocs - 1];
-			reloc->cmdbuf_mem	= reloc_last->cmdbuf_mem;
-			reloc->cmdbuf_offset	= reloc_last->cmdbuf_offset;
-			reloc->target		= reloc_last->target;
-			reloc->target_offset	= reloc_last->target_offset;
-			shift->shift		= shift_last->shift;
-			type->reloc_type	= type_last->reloc_type;
-			job->reloc_addr_phys[i] =
-				job->reloc_addr_phys[job->num_relocs - 1];
-			job->num_relocs--;
-		} else {
-			break;
-		}
+		patch_reloc(job, pdata, order[i].index,
+			    cmdbuf_page_addr + (offset & ~PAGE_MASK));
 	}
 
-	if (cmdbuf_page_addr) {
-		dma_buf_kunmap(buf, last_page, cmdbuf_page_addr);
-		dma_buf_end_cpu_access(buf, last_offset,
-				PAGE_SIZE, DMA_TO_DEVICE);
-	}
+	if (cmdbuf_page_addr)
+		dma_buf_kunmap(buf, mapped_page, cmdbuf_page_addr);
+	dma_buf_end_cpu_access(buf, start, len, DMA_TO_DEVICE);
 
-	return 0;
+out_vunmap:
+	if (vaddr)
+		dma_buf_vunmap(buf, vaddr);
+
+	return err;
 }
 
+/*
+ * Job pin latency histogram. Bucket i counts pins that took less than
+ * 2^(i + PIN_HIST_MIN_SHIFT) ns, the last bucket everything slower.
+ */
+#define PIN_HIST_BUCKETS	12
+#define PIN_HIST_MIN_SHIFT	14
+
+static struct {
+	atomic64_t buckets[PIN_HIST_BUCKETS];
+	atomic64_t count;
+	atomic64_t relocs;
+	atomic64_t total_ns;
+	atomic64_t max_ns;
+} pin_stats;
+
+static void pin_stats_account(struct nvhost_job *job, u64 delta)
+{
+	int bucket = 0;
+	u64 max;
+
+	while (bucket < PIN_HIST_BUCKETS - 1 &&
+	       delta >= (1ULL << (bucket + PIN_HIST_MIN_SHIFT)))
+		bucket++;
+
+	atomic64_inc(&pin_stats.buckets[bucket]);
+	atomic64_inc(&pin_stats.count);
+	atomic64_add(job->num_relocs, &pin_stats.relocs);
+	atomic64_add(delta, &pin_stats.total_ns);
+
+	max = atomic64_read(&pin_stats.max_ns);
+	while (delta > max) {
+		u64 old = atomic64_cmpxchg(&pin_stats.max_ns, max, delta);
+
+		if (old == max)
+			break;
+		max = old;
+	}
+}
 
 int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 {
 	int err = 0, i = 0, j = 0;
 	int nb_hw_pts = nvhost_syncpt_nb_hw_pts(sp);
+	u64 t_start = ktime_get_ns();
 	DECLARE_BITMAP(waitchk_mask, nb_hw_pts);
 
 	bitmap_zero(waitchk_mask, nb_hw_pts);
@@ -606,6 +717,8 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 	if (err <= 0)
 		goto fail;
 
+	sort_relocs(job);
+
 	/* patch gathers */
 	for (i = 0; i < job->num_gathers; i++) {
 		struct nvhost_job_gather *g = &job->gathers[i];
@@ -648,6 +761,9 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 				break;
 		}
 	}
+
+	if (!err)
+		pin_stats_account(job, ktime_get_ns() - t_start);
 fail:
 	return err;
 }
@@ -685,3 +801,70 @@ void nvhost_job_dump(struct device *dev, struct nvhost_job *job)
 	dev_info(dev, "    NUM_HANDLES %d\n",
 		job->num_unpins);
 }
+
+static int nvhost_job_pin_stats_show(struct seq_file *s, void *unused)
+{
+	u64 count = atomic64_read(&pin_stats.count);
+	u64 total = atomic64_read(&pin_stats.total_ns);
+	u64 lo = 0;
+	int i;
+
+	seq_printf(s, "pins:      %llu\n", count);
+	seq_printf(s, "relocs:    %llu\n", atomic64_read(&pin_stats.relocs));
+	seq_printf(s, "avg (us):  %llu\n",
+		   count ? div64_u64(total, count) / NSEC_PER_USEC : 0);
+	seq_printf(s, "max (us):  %llu\n",
+		   (u64)atomic64_read(&pin_stats.max_ns) / NSEC_PER_USEC);
+	seq_puts(s, "latency (us)        count\n");
+
+	for (i = 0; i < PIN_HIST_BUCKETS; i++) {
+		u64 hi = 1ULL << (i + PIN_HIST_MIN_SHIFT);
+
+		if (i < PIN_HIST_BUCKETS - 1)
+			seq_printf(s, "%7llu - %7llu  %llu\n",
+				   lo / NSEC_PER_USEC, hi / NSEC_PER_USEC,
+				   atomic64_read(&pin_stats.buckets[i]));
+		else
+			seq_printf(s, "%7llu -     inf  %llu\n",
+				   lo / NSEC_PER_USEC,
+				   atomic64_read(&pin_stats.buckets[i]));
+		lo = hi;
+	}
+
+	return 0;
+}
+
+static int nvhost_job_pin_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_job_pin_stats_show, inode->i_private);
+}
+
+static ssize_t nvhost_job_pin_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	int i;
+
+	/* any write clears the statistics */
+	for (i = 0; i < PIN_HIST_BUCKETS; i++)
+		atomic64_set(&pin_stats.buckets[i], 0);
+	atomic64_set(&pin_stats.count, 0);
+	atomic64_set(&pin_stats.relocs, 0);
+	atomic64_set(&pin_stats.total_ns, 0);
+	atomic64_set(&pin_stats.max_ns, 0);
+
+	return count;
+}
+
+static const struct file_operations nvhost_job_pin_stats_fops = {
+	.open		= nvhost_job_pin_stats_open,
+	.read		= seq_read,
+	.write		= nvhost_job_pin_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void nvhost_job_debug_init(struct dentry *de)
+{
+	debugfs_create_file("job_pin_latency", S_IRUGO|S_IWUSR, de,
+			NULL, &nvhost_job_pin_stats_fops);
+}
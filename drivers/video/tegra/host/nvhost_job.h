@@ -29,6 +29,7 @@ struct nvhost_channel;
 struct nvhost_waitchk;
 struct nvhost_syncpt;
 struct sg_table;
+struct dentry;
 
 struct nvhost_job_gather {
 	u32 words;
@@ -53,6 +54,13 @@ struct nvhost_pinid {
 	enum dma_data_direction direction;
 };
 
+/* Sort key used to patch the relocs of each gather in one pass */
+struct nvhost_reloc_order {
+	u32 cmdbuf_mem;
+	u32 cmdbuf_offset;
+	u32 index;
+};
+
 struct nvhost_job_unpin {
 	struct sg_table *sgt;
 	struct dma_buf *buf;
@@ -91,6 +99,7 @@ struct nvhost_job {
 	struct nvhost_reloc *relocarray;
 	struct nvhost_reloc_shift *relocshiftarray;
 	struct nvhost_reloc_type *reloctypearray;
+	struct nvhost_reloc_order *reloc_order;
 	int num_relocs;
 	struct nvhost_job_unpin *unpins;
 	int num_unpins;
@@ -166,4 +175,9 @@ void nvhost_job_dump(struct device *dev, struct nvhost_job *job);
  */
 void nvhost_job_set_notifier(struct nvhost_job *job, u32 error);
 
+/*
+ * Create the job pin latency statistics under the given debugfs directory.
+ */
+void nvhost_job_debug_init(struct dentry *de);
+
 #endif
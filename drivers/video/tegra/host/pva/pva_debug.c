@@ -22,6 +22,7 @@
 #include <linux/platform_device.h>
 #include "dev.h"
 #include "pva.h"
+#include "nvhost_buffer.h"
 
 static void pva_read_crashdump(struct seq_file *s, struct pva_seg_info *seg_info)
 {
@@ -243,4 +244,6 @@ void pva_debugfs_init(struct platform_device *pdev)
 				 &pva->slcg_disable);
 	if (!ret)
 		nvhost_dbg_info("Failed to create cg_disable node");
+
+	nvhost_buffer_debugfs_init(pdev);
 }
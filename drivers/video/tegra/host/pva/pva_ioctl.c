@@ -150,8 +150,9 @@ err_out:
  *
  * This function takes the given list of tasks, converts
  * them into kernel internal representation and submits
- * them to the task queue. On success, it populates
- * the post-fence structures in userspace and returns 0.
+ * them to the task queue. The post-fence structures of every
+ * task that reached the queue are populated in userspace, also
+ * when a later task of the list fails to be submitted.
  *
  * @param priv	PVA Private data
  * @param arg	ioctl data
@@ -193,6 +194,14 @@ static int pva_submit(struct pva_private *priv, void *arg)
 		goto err_alloc_task_mem;
 	}
 
+	/* ..and for the post-fences returned by the submit */
+	tasks_header.postfences = kcalloc(ioctl_tasks_header->num_tasks,
+			sizeof(*tasks_header.postfences), GFP_KERNEL);
+	if (!tasks_header.postfences) {
+		err = -ENOMEM;
+		goto err_alloc_fence_mem;
+	}
+
 	/* Copy the tasks from userspace */
 	err = copy_from_user(ioctl_tasks,
 			(void __user *)ioctl_tasks_header->tasks,
@@ -236,37 +245,33 @@ static int pva_submit(struct pva_private *priv, void *arg)
 	/* ..and submit them */
 	err = nvhost_queue_submit(priv->queue, &tasks_header);
 
-	if (err < 0) {
-		goto err_submit_task;
-	}
-
-	/* Copy post-fences back to userspace */
-	for (i = 0; i < ioctl_tasks_header->num_tasks; i++) {
+	/*
+	 * Copy post-fences of the submitted tasks back to userspace. The
+	 * tasks themselves may already be completed and freed.
+	 */
+	for (i = 0; i < tasks_header.num_submitted; i++) {
 		struct pva_fence __user *postfences =
 				(struct pva_fence __user *)
 				ioctl_tasks[i].postfences;
 
-		task = tasks_header.tasks[i];
-		err = copy_to_user(postfences,
-				task->postfences, sizeof(struct pva_fence) *
-				task->num_postfences);
-		if (err < 0) {
+		if (copy_to_user(postfences, tasks_header.postfences[i],
+				sizeof(struct pva_fence) *
+				ioctl_tasks[i].num_postfences)) {
 			nvhost_warn(&priv->pva->pdev->dev,
 					"Failed to copy fences to userspace");
 		}
 	}
 
-	kfree(ioctl_tasks);
-	return 0;
-
-err_submit_task:
 err_get_task_buffer:
 err_copy_tasks:
-	for (i = 0; i < tasks_header.num_tasks; i++) {
+	/* Tasks that were submitted are released by the completion path */
+	for (i = tasks_header.num_submitted; i < tasks_header.num_tasks; i++) {
 		task = tasks_header.tasks[i];
 		/* Release memory that was allocated for the task */
 		nvhost_queue_free_task_memory(task->queue, task->pool_index);
 	}
+	kfree(tasks_header.postfences);
+err_alloc_fence_mem:
 err_alloc_task_mem:
 	kfree(ioctl_tasks);
 err_check_version:
@@ -662,15 +662,16 @@ static void pva_task_write_postactions(struct pva_submit_task *task,
 		}
 	}
 
-	/* Make a syncpoint increment */
-	if (syncpt_gos_addr) {
+	/* Make a syncpoint increment, once per chain */
+	if (syncpt_gos_addr && !task->chained) {
 		thresh = nvhost_syncpt_read_maxval(host1x_pdev,
 				task->queue->syncpt_id) + 1;
 		ptr += pva_task_write_ptr_op(&hw_postactions[ptr],
 			TASK_ACT_PTR_WRITE_VAL, syncpt_gos_addr, thresh);
 	}
-	ptr += pva_task_write_ptr_op(&hw_postactions[ptr],
-		TASK_ACT_PTR_WRITE_VAL, syncpt_addr, 1);
+	if (!task->chained)
+		ptr += pva_task_write_ptr_op(&hw_postactions[ptr],
+			TASK_ACT_PTR_WRITE_VAL, syncpt_addr, 1);
 
 	output_status_addr = task->dma_addr +
 			     offsetof(struct pva_hw_task, statistics);
@@ -908,6 +909,7 @@ static int pva_task_write(struct pva_submit_task *task, bool atomic)
 						  input_parameter_array);
 	hw_task->task.output_parameters = offsetof(struct pva_hw_task,
 						  output_parameter_array);
+	hw_task->task.gen_task.next = 0;
 	hw_task->task.gen_task.versionid = TASK_VERSION_ID;
 	hw_task->task.gen_task.engineid = PVA_ENGINE_ID;
 	hw_task->task.gen_task.sequence = 0;
@@ -964,6 +966,7 @@ static int pva_task_write(struct pva_submit_task *task, bool atomic)
 static void pva_task_update(struct pva_submit_task *task)
 {
 	struct nvhost_queue *queue = task->queue;
+	bool chained = task->chained;
 	struct pva_hw_task *hw_task = task->va;
 	struct pva *pva = task->pva;
 	struct platform_device *pdev = pva->pdev;
@@ -1012,24 +1015,30 @@ static void pva_task_update(struct pva_submit_task *task)
 	/* Unpin job memory. PVA shouldn't be using it anymore */
 	pva_task_unpin_mem(task);
 
-	/* Drop PM runtime reference of PVA */
-	nvhost_module_idle(task->pva->pdev);
-
 	/* remove the task from the queue */
 	list_del(&task->node);
 
-	/* Release memory that was allocated for the task */
-	nvhost_queue_free_task_memory(task->queue, task->pool_index);
+	/*
+	 * Release memory that was allocated for the task. The slot may be
+	 * reused right away, so the task must not be touched past this.
+	 */
+	nvhost_queue_free_task_memory(queue, task->pool_index);
 
-	/* Drop queue reference to allow reusing it */
-	nvhost_queue_put(queue);
+	/*
+	 * Drop queue reference to allow reusing it. Only the last task of
+	 * a chain holds one, the PM reference is dropped by the caller.
+	 */
+	if (!chained)
+		nvhost_queue_put(queue);
 }
 
 static void pva_queue_update(void *priv, int nr_completed)
 {
 	struct nvhost_queue *queue = priv;
+	struct platform_device *pdev = queue->pool->pdev;
 	struct pva_submit_task *task, *n;
 	struct list_head completed;
+	int refs = 0;
 
 	INIT_LIST_HEAD(&completed);
 
@@ -1046,8 +1055,15 @@ static void pva_queue_update(void *priv, int nr_completed)
 	mutex_unlock(&queue->list_lock);
 
 	/* Handle completed tasks */
-	list_for_each_entry_safe(task, n, &completed, node)
+	list_for_each_entry_safe(task, n, &completed, node) {
+		if (!task->chained)
+			refs++;
 		pva_task_update(task);
+	}
+
+	/* Drop the PM runtime references of all completed chains at once */
+	if (refs)
+		nvhost_module_idle_mult(pdev, refs);
 }
 
 static void pva_queue_dump(struct nvhost_queue *queue, struct seq_file *s)
@@ -1212,8 +1228,68 @@ err_submit:
 	return err;
 }
 
-static int pva_task_submit(struct pva_submit_task *task)
+static int pva_task_write_postfences(struct pva_submit_task *task,
+				     u32 thresh)
 {
+	struct platform_device *host1x_pdev =
+			to_platform_device(task->pva->pdev->dev.parent);
+	struct nvhost_queue *queue = task->queue;
+	unsigned int i;
+	int err = 0;
+
+	task->syncpt_thresh = thresh;
+
+	/* Return post-fences */
+	for (i = 0; i < task->num_postfences; i++) {
+		struct pva_fence *fence = task->postfences + i;
+
+		switch (fence->type) {
+		case PVA_FENCE_TYPE_SYNCPT: {
+			fence->syncpoint_index = queue->syncpt_id;
+			fence->syncpoint_value = thresh;
+			break;
+		}
+		case PVA_FENCE_TYPE_SYNC_FD: {
+			struct nvhost_ctrl_sync_fence_info pts;
+
+			/* Fail if any previous sync_create_fence_fd failed */
+			if (err < 0)
+				break;
+
+			pts.id = queue->syncpt_id;
+			pts.thresh = thresh;
+
+			err = nvhost_sync_create_fence_fd(host1x_pdev,
+					&pts, 1, "fence_pva", &fence->sync_fd);
+
+			break;
+		}
+		case PVA_FENCE_TYPE_SEMAPHORE:
+			break;
+		default:
+			return -ENOSYS;
+		}
+	}
+
+	return err;
+}
+
+/*
+ * Submit a list of tasks that has been linked through gen_task.next. The
+ * hardware is told about the first task only and only the last one
+ * increments the syncpoint, so the whole list costs one doorbell, one
+ * threshold and one completion interrupt. The queue and PM references
+ * taken here belong to the last task.
+ *
+ * The tasks are tasks[first..first + num_tasks) of the header. Their
+ * post-fences are copied to the header before the tasks become visible to
+ * the completion path, and num_submitted is advanced once they are queued.
+ */
+static int pva_task_submit(struct pva_submit_tasks *task_header, u32 first,
+			   u32 num_tasks)
+{
+	struct pva_submit_task **tasks = task_header->tasks + first;
+	struct pva_submit_task *task = tasks[0];
 	struct platform_device *host1x_pdev =
 			to_platform_device(task->pva->pdev->dev.parent);
 	struct nvhost_queue *queue = task->queue;
@@ -1222,8 +1298,8 @@ static int pva_task_submit(struct pva_submit_task *task)
 	u64 timestamp;
 	int err = 0;
 
-	nvhost_dbg_info("Submitting task %p (0x%llx)", task,
-			(u64)task->dma_addr);
+	nvhost_dbg_info("Submitting %u task(s) from %p (0x%llx)", num_tasks,
+			task, (u64)task->dma_addr);
 
 	/* Get a reference of the queue to avoid it being reused. It
 	 * gets freed in the callback...
@@ -1264,52 +1340,27 @@ static int pva_task_submit(struct pva_submit_task *task)
 				   thresh,
 				   timestamp);
 
-	task->syncpt_thresh = thresh;
-
 	nvhost_dbg_info("Postfence id=%u, value=%u",
 			queue->syncpt_id, thresh);
 
-	/* Return post-fences */
-	for (i = 0; i < task->num_postfences; i++) {
-		struct pva_fence *fence = task->postfences + i;
-
-		switch (fence->type) {
-		case PVA_FENCE_TYPE_SYNCPT: {
-			fence->syncpoint_index = queue->syncpt_id;
-			fence->syncpoint_value = thresh;
-			break;
-		}
-		case PVA_FENCE_TYPE_SYNC_FD: {
-			struct nvhost_ctrl_sync_fence_info pts;
-
-			/* Fail if any previous sync_create_fence_fd failed */
-			if (err < 0)
-				break;
-
-			pts.id = queue->syncpt_id;
-			pts.thresh = thresh;
+	for (i = 0; i < num_tasks; i++) {
+		int fence_err = pva_task_write_postfences(tasks[i], thresh);
 
-			err = nvhost_sync_create_fence_fd(host1x_pdev,
-					&pts, 1, "fence_pva", &fence->sync_fd);
+		if (fence_err < 0 && err == 0)
+			err = fence_err;
 
-			break;
-		}
-		case PVA_FENCE_TYPE_SEMAPHORE:
-			break;
-		default:
-			err = -ENOSYS;
-			goto err_write_fences;
-		}
+		memcpy(task_header->postfences[first + i], tasks[i]->postfences,
+		       sizeof(tasks[i]->postfences));
 	}
 
-err_write_fences:
 	/*
 	 * Tasks in the queue list can be modified by the interrupt handler.
 	 * Adding the task into the list must be the last step before
 	 * registering the interrupt handler.
 	 */
 	mutex_lock(&queue->list_lock);
-	list_add_tail(&task->node, &queue->tasklist);
+	for (i = 0; i < num_tasks; i++)
+		list_add_tail(&tasks[i]->node, &queue->tasklist);
 	mutex_unlock(&queue->list_lock);
 
 	/*
@@ -1321,12 +1372,53 @@ err_write_fences:
 					      queue->syncpt_id, thresh,
 					      pva_queue_update, queue));
 
+	task_header->num_submitted = first + num_tasks;
+
 	return err;
 
 err_submit:
 	nvhost_module_idle(task->pva->pdev);
 err_module_busy:
 	nvhost_queue_put(queue);
+	for (i = 0; i < num_tasks; i++)
+		pva_task_unpin_mem(tasks[i]);
+	return err;
+}
+
+static int pva_queue_submit_chain(struct nvhost_queue *queue,
+				  struct pva_submit_tasks *task_header)
+{
+	struct pva_submit_task **tasks = task_header->tasks;
+	u32 num_tasks = task_header->num_tasks;
+	struct pva_hw_task *hw_task;
+	int err = 0;
+	u32 i;
+
+	/* Pin the memory of all tasks before touching the hardware */
+	for (i = 0; i < num_tasks; i++) {
+		pva_task_dump(tasks[i]);
+
+		err = pva_task_pin_mem(tasks[i]);
+		if (err < 0)
+			goto err_pin;
+	}
+
+	for (i = 0; i < num_tasks; i++) {
+		tasks[i]->chained = (i + 1 < num_tasks);
+		pva_task_write(tasks[i], false);
+	}
+
+	/* Link the tasks, the last one terminates the list */
+	for (i = 0; i + 1 < num_tasks; i++) {
+		hw_task = tasks[i]->va;
+		hw_task->task.gen_task.next = tasks[i + 1]->dma_addr;
+	}
+
+	return pva_task_submit(task_header, 0, num_tasks);
+
+err_pin:
+	while (i--)
+		pva_task_unpin_mem(tasks[i]);
 	return err;
 }
 
@@ -1336,6 +1428,10 @@ static int pva_queue_submit(struct nvhost_queue *queue, void *args)
 	int err = 0;
 	int i;
 
+	if ((task_header->flags & PVA_SUBMIT_FLAGS_CHAIN) &&
+	    task_header->num_tasks > 1)
+		return pva_queue_submit_chain(queue, task_header);
+
 	for (i = 0; i < task_header->num_tasks; i++) {
 		struct pva_submit_task *task = task_header->tasks[i];
 
@@ -1348,9 +1444,10 @@ static int pva_queue_submit(struct nvhost_queue *queue, void *args)
 			break;
 
 		/* Write the task data */
+		task->chained = false;
 		pva_task_write(task, false);
 
-		err = pva_task_submit(task);
+		err = pva_task_submit(task_header, i, 1);
 		if (err < 0)
 			break;
 	}
@@ -1474,7 +1571,8 @@ static void pva_queue_cleanup(struct nvhost_queue *queue,
 					task->postfences_sema_ext + i);
 
 	/* Finish syncpoint increments to release waiters */
-	nvhost_syncpt_cpu_incr_ext(pdev, queue->syncpt_id);
+	if (!task->chained)
+		nvhost_syncpt_cpu_incr_ext(pdev, queue->syncpt_id);
 }
 
 static int pva_queue_abort(struct nvhost_queue *queue)
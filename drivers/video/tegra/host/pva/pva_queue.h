@@ -59,6 +59,9 @@ struct pva_parameter_ext {
  * operation			task operation
  * timeout			Latest Unix time when the task must complete or
  *				0 if disabled.
+ * chained			Task is followed by another task of the same
+ *				submit chain. It neither increments the syncpoint
+ *				nor holds queue and PM references of its own.
  * prefences			Pre-fence structures
  * postfences			Post-fence structures
  * input_surfaces		Input surfaces structures
@@ -91,6 +94,7 @@ struct pva_submit_task {
 	u32 operation;
 	u64 timeout;
 	bool invalid;
+	bool chained;
 	u32 syncpt_thresh;
 
 	/* Data provided by userspace "as is" */
@@ -123,10 +127,23 @@ struct pva_submit_task {
 	struct pva_parameter_ext pointers_ext[PVA_MAX_POINTERS];
 };
 
+/*
+ * tasks		Tasks to submit
+ * postfences		Post-fences of tasks[i], filled in at submit time.
+ *			The tasks may complete and be freed at any point
+ *			after submission, so fences are only read from here.
+ * flags		PVA_SUBMIT_FLAGS_*
+ * num_tasks		Number of tasks
+ * num_submitted	Number of leading tasks that were handed to the
+ *			hardware. Those are released by the completion path
+ *			even if the submit returns an error.
+ */
 struct pva_submit_tasks {
 	struct pva_submit_task *tasks[PVA_MAX_TASKS];
+	struct pva_fence (*postfences)[PVA_MAX_POSTFENCES];
 	u16 flags;
 	u16 num_tasks;
+	u16 num_submitted;
 };
 
 struct pva_queue_attribute {
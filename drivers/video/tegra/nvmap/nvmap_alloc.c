@@ -28,8 +28,15 @@ bool nvmap_convert_iovmm_to_carveout;
 
 u32 nvmap_max_handle_count;
 u64 nvmap_big_page_allocs;
+u64 nvmap_huge_page_allocs;
 u64 nvmap_total_page_allocs;
 
+/* Live iovmm pages by the largest granule the SMMU can map them with */
+atomic64_t nvmap_tlb_pages[NVMAP_TLB_NR_GRANULES];
+
+/* Pages per NVMAP_HUGE_PAGE_SIZE run */
+#define NVMAP_HUGE_PAGES	(NVMAP_HUGE_PAGE_SIZE >> PAGE_SHIFT)
+
 /* handles may be arbitrarily large (16+MiB), and any handle allocated from
  * the kernel (i.e., not a carveout handle) includes its array of pages. to
  * preserve kmalloc space, if the array of pages exceeds PAGELIST_VMALLOC_MIN,
@@ -74,6 +81,61 @@ static struct page *nvmap_alloc_pages_exact(gfp_t gfp, size_t size)
 	return page;
 }
 
+static bool nvmap_pages_contig(struct page **pages, int idx, int nr)
+{
+	int i;
+
+	if (page_to_phys(pages[idx]) & ((nr << PAGE_SHIFT) - 1))
+		return false;
+
+	for (i = 1; i < nr; i++)
+		if (pages[idx + i] != nth_page(pages[idx], i))
+			return false;
+	return true;
+}
+
+/*
+ * Count how many pages of the handle sit in naturally aligned, physically
+ * contiguous 2M and 64K runs, i.e. how much of it the SMMU can map with
+ * large TLB entries (assuming a suitably aligned IOVA).
+ */
+static void nvmap_pgalloc_tlb_account(struct nvmap_handle *h, int nr_page)
+{
+	struct page **pages = h->pgalloc.pages;
+	int big = NVMAP_PP_BIG_PAGE_SIZE >> PAGE_SHIFT;
+	int i = 0;
+
+	h->pgalloc.pages_2m = 0;
+	h->pgalloc.pages_64k = 0;
+
+	while (i < nr_page) {
+		if (!(i % NVMAP_HUGE_PAGES) && nr_page - i >= NVMAP_HUGE_PAGES &&
+		    nvmap_pages_contig(pages, i, NVMAP_HUGE_PAGES)) {
+			h->pgalloc.pages_2m += NVMAP_HUGE_PAGES;
+			i += NVMAP_HUGE_PAGES;
+		} else if (!(i % big) && nr_page - i >= big &&
+			   nvmap_pages_contig(pages, i, big)) {
+			h->pgalloc.pages_64k += big;
+			i += big;
+		} else {
+			i++;
+		}
+	}
+
+	atomic64_add(h->pgalloc.pages_2m, &nvmap_tlb_pages[NVMAP_TLB_2M]);
+	atomic64_add(h->pgalloc.pages_64k, &nvmap_tlb_pages[NVMAP_TLB_64K]);
+	atomic64_add(nr_page - h->pgalloc.pages_2m - h->pgalloc.pages_64k,
+		     &nvmap_tlb_pages[NVMAP_TLB_4K]);
+}
+
+static void nvmap_pgalloc_tlb_unaccount(struct nvmap_handle *h, int nr_page)
+{
+	atomic64_sub(h->pgalloc.pages_2m, &nvmap_tlb_pages[NVMAP_TLB_2M]);
+	atomic64_sub(h->pgalloc.pages_64k, &nvmap_tlb_pages[NVMAP_TLB_64K]);
+	atomic64_sub(nr_page - h->pgalloc.pages_2m - h->pgalloc.pages_64k,
+		     &nvmap_tlb_pages[NVMAP_TLB_4K]);
+}
+
 static int handle_page_alloc(struct nvmap_client *client,
 			     struct nvmap_handle *h, bool contiguous)
 {
@@ -82,7 +144,13 @@ static int handle_page_alloc(struct nvmap_client *client,
 	int i = 0, page_index = 0;
 	struct page **pages;
 	gfp_t gfp = GFP_NVMAP | __GFP_ZERO;
+	/*
+	 * set the gfp not to trigger direct/kswapd reclaims and
+	 * not to use emergency reserves.
+	 */
+	gfp_t gfp_no_reclaim = (gfp | __GFP_NOMEMALLOC) & ~__GFP_RECLAIM;
 	int pages_per_big_pg = NVMAP_PP_BIG_PAGE_SIZE >> PAGE_SHIFT;
+	int huge_pages;
 
 	pages = nvmap_altalloc(nr_page * sizeof(*pages));
 	if (!pages)
@@ -98,10 +166,35 @@ static int handle_page_alloc(struct nvmap_client *client,
 			pages[i] = nth_page(page, i);
 
 	} else {
+		/*
+		 * Large handles first try for 2M runs so that the SMMU can
+		 * map them with section sized entries.
+		 */
+		for (i = 0; (nr_page - i) >= NVMAP_HUGE_PAGES;
+		     i += NVMAP_HUGE_PAGES) {
+			struct page *page;
+			int idx;
+
+			page = alloc_pages(gfp_no_reclaim | __GFP_NOWARN,
+					   get_order(NVMAP_HUGE_PAGE_SIZE));
+			if (!page)
+				break;
+			split_page(page, get_order(NVMAP_HUGE_PAGE_SIZE));
+
+			for (idx = 0; idx < NVMAP_HUGE_PAGES; idx++)
+				pages[i + idx] = nth_page(page, idx);
+			nvmap_clean_cache(&pages[i], NVMAP_HUGE_PAGES);
+		}
+		page_index = huge_pages = i;
+		nvmap_huge_page_allocs += huge_pages;
+
 #ifdef CONFIG_NVMAP_PAGE_POOLS
+		nvmap_page_pool_note_alloc(&nvmap_dev->pool, size);
+
 		/* Get as many big pages from the pool as possible. */
-		page_index = nvmap_page_pool_alloc_lots_bp(&nvmap_dev->pool, pages,
-								 nr_page);
+		page_index += nvmap_page_pool_alloc_lots_bp(&nvmap_dev->pool,
+						&pages[page_index],
+						nr_page - page_index);
 		pages_per_big_pg = nvmap_dev->pool.pages_per_big_pg;
 #endif
 		/* Try to allocate big pages from page allocator */
@@ -110,11 +203,6 @@ static int handle_page_alloc(struct nvmap_client *client,
 		     i += pages_per_big_pg, page_index += pages_per_big_pg) {
 			struct page *page;
 			int idx;
-			/*
-			 * set the gfp not to trigger direct/kswapd reclaims and
-			 * not to use emergency reserves.
-			 */
-			gfp_t gfp_no_reclaim = (gfp | __GFP_NOMEMALLOC) & ~__GFP_RECLAIM;
 
 			page = nvmap_alloc_pages_exact(gfp_no_reclaim,
 					pages_per_big_pg << PAGE_SHIFT);
@@ -125,7 +213,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 				pages[i + idx] = nth_page(page, idx);
 			nvmap_clean_cache(&pages[i], pages_per_big_pg);
 		}
-		nvmap_big_page_allocs += page_index;
+		nvmap_big_page_allocs += page_index - huge_pages;
 
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 		/* Get as many 4K pages from the pool as possible. */
@@ -154,6 +242,7 @@ static int handle_page_alloc(struct nvmap_client *client,
 	h->pgalloc.pages = pages;
 	h->pgalloc.contig = contiguous;
 	atomic_set(&h->pgalloc.ndirty, 0);
+	nvmap_pgalloc_tlb_account(h, nr_page);
 	return 0;
 
 fail:
@@ -450,6 +539,9 @@ out:
 			nvmap_stats_inc(NS_KALLOC, h->size);
 		else
 			nvmap_stats_inc(NS_UALLOC, h->size);
+		/* the histogram only covers handles served by the page pool */
+		if (h->heap_pgalloc)
+			client->alloc_hist[nvmap_alloc_hist_bucket(h->size)]++;
 		NVMAP_TAG_TRACE(trace_nvmap_alloc_handle_done,
 			NVMAP_TP_ARGS_CHR(client, h, NULL));
 		err = 0;
@@ -561,6 +653,9 @@ void _nvmap_handle_free(struct nvmap_handle *h)
 	for (i = 0; i < nr_page; i++)
 		h->pgalloc.pages[i] = nvmap_to_page(h->pgalloc.pages[i]);
 
+	if (!h->from_va && h->heap_type == NVMAP_HEAP_IOVMM)
+		nvmap_pgalloc_tlb_unaccount(h, nr_page);
+
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 	if (!h->from_va)
 		page_index = nvmap_page_pool_fill_lots(&nvmap_dev->pool,
@@ -579,7 +674,8 @@ void _nvmap_handle_free(struct nvmap_handle *h)
 out:
 	NVMAP_TAG_TRACE(trace_nvmap_destroy_handle,
 		NULL, get_current()->pid, 0, NVMAP_TP_ARGS_H(h));
-	kfree(h);
+	/* nvmap_validate_get() may still be looking at h under RCU */
+	kfree_rcu(h, rcu);
 }
 
 void nvmap_free_handle(struct nvmap_client *client,
@@ -608,6 +704,7 @@ void nvmap_free_handle(struct nvmap_client *client,
 
 	smp_rmb();
 	rb_erase(&ref->node, &client->handle_refs);
+	hash_del_rcu(&ref->hnode);
 	client->handle_count--;
 	atomic_dec(&ref->handle->share_count);
 
@@ -619,7 +716,7 @@ void nvmap_free_handle(struct nvmap_client *client,
 	dma_buf_put(ref->handle->dmabuf);
 	NVMAP_TAG_TRACE(trace_nvmap_free_handle,
 		NVMAP_TP_ARGS_CHR(client, h, ref));
-	kfree(ref);
+	kfree_rcu(ref, rcu);
 
 out:
 	BUG_ON(!atomic_read(&h->ref));
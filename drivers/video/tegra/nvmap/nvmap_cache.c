@@ -19,8 +19,14 @@
 #include <linux/io.h>
 #include <linux/debugfs.h>
 #include <linux/of.h>
+#include <linux/sort.h>
+#include <linux/version.h>
 #include <soc/tegra/chip-id.h>
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
+#include <linux/sched/clock.h>
+#endif
+
 #include <trace/events/nvmap.h>
 
 #include "nvmap_priv.h"
@@ -36,6 +42,24 @@ size_t cache_maint_inner_threshold = 8 * SZ_2M;
 
 static struct static_key nvmap_disable_vaddr_for_cache_maint;
 
+/*
+ * Costs measured by nvmap_cache_maint_calibrate(), indexed by
+ * cache_maint_cost_idx(). A zero crossover means "not calibrated" and
+ * cache_maint_inner_threshold is used instead.
+ */
+#define CACHE_MAINT_CALIB_ORDER		8
+#define CACHE_MAINT_CALIB_RUNS		3
+
+static u64 cache_maint_line_ns_per_mb[2];
+static u64 cache_maint_full_ns[2];
+static size_t cache_maint_crossover[2];
+
+/* Cache maint list planner statistics */
+static u64 cache_maint_lists;
+static u64 cache_maint_ranges_in;
+static u64 cache_maint_ranges_out;
+static u64 cache_maint_full_flushes;
+
 inline static void nvmap_flush_dcache_all(void *dummy)
 {
 #if defined(CONFIG_DENVER_CPU)
@@ -462,6 +486,147 @@ out:
 	return err;
 }
 
+static inline int cache_maint_cost_idx(unsigned int op)
+{
+	return op == NVMAP_CACHE_OP_WB ? 0 : 1;
+}
+
+static size_t cache_maint_threshold(unsigned int op)
+{
+	if (!nvmap_cache_maint_by_set_ways)
+		return SIZE_MAX;
+
+	return cache_maint_crossover[cache_maint_cost_idx(op)] ?:
+		cache_maint_inner_threshold;
+}
+
+/*
+ * One physically contiguous range to maintain. vaddr is the linear map
+ * address of start, or NULL if the range is only reachable by physical
+ * address (carveouts, highmem).
+ */
+struct cache_maint_range {
+	phys_addr_t start;
+	phys_addr_t end;
+	void *vaddr;
+};
+
+/* Lists resolving to more ranges than this are not planned */
+#define CACHE_MAINT_PLAN_MAX_RANGES	4096
+
+static int cache_maint_range_cmp(const void *a, const void *b)
+{
+	const struct cache_maint_range *ra = a, *rb = b;
+
+	if (ra->start < rb->start)
+		return -1;
+	return ra->start > rb->start;
+}
+
+static bool cache_maint_range_extend(struct cache_maint_range *r,
+				     phys_addr_t start, phys_addr_t end,
+				     void *vaddr)
+{
+	if (start > r->end || !r->vaddr != !vaddr)
+		return false;
+
+	r->end = max(r->end, end);
+	return true;
+}
+
+/* Add the physical ranges backing [offset, offset + size) of h to plan */
+static int cache_maint_plan_add(struct cache_maint_range *plan, int n,
+				struct nvmap_handle *h, u64 offset, u64 size)
+{
+	u64 end = offset + size;
+
+	if (!h->heap_pgalloc) {
+		plan[n].start = h->carveout->base + offset;
+		plan[n].end = h->carveout->base + end;
+		plan[n].vaddr = NULL;
+		return n + 1;
+	}
+
+	while (offset < end) {
+		struct page *page;
+		u64 next = min_t(u64, (offset + PAGE_SIZE) & PAGE_MASK, end);
+		phys_addr_t paddr;
+		void *vaddr = NULL;
+
+		page = nvmap_to_page(h->pgalloc.pages[offset >> PAGE_SHIFT]);
+		paddr = page_to_phys(page) + (offset & ~PAGE_MASK);
+		if (!PageHighMem(page))
+			vaddr = page_address(page) + (offset & ~PAGE_MASK);
+
+		if (!n || plan[n - 1].end != paddr ||
+		    !cache_maint_range_extend(&plan[n - 1], paddr,
+					      paddr + next - offset, vaddr)) {
+			plan[n].start = paddr;
+			plan[n].end = paddr + next - offset;
+			plan[n].vaddr = vaddr;
+			n++;
+		}
+		offset = next;
+	}
+
+	return n;
+}
+
+/* Sort the plan by physical address and merge overlapping/adjacent ranges */
+static int cache_maint_plan_merge(struct cache_maint_range *plan, int n)
+{
+	int i, out = 0;
+
+	if (!n)
+		return 0;
+
+	sort(plan, n, sizeof(*plan), cache_maint_range_cmp, NULL);
+
+	for (i = 1; i < n; i++) {
+		if (cache_maint_range_extend(&plan[out], plan[i].start,
+					     plan[i].end, plan[i].vaddr))
+			continue;
+		plan[++out] = plan[i];
+	}
+
+	return out + 1;
+}
+
+/*
+ * Resolve list entry i to [*offset, *offset + *size) within h. A zero size
+ * is normalized to the handle size before the range is validated.
+ */
+static int cache_maint_list_entry(struct nvmap_handle *h, u64 *offsets,
+				  u64 *sizes, bool is_32, int i,
+				  u64 *offset, u64 *size)
+{
+	u32 *offs_32 = (u32 *)offsets, *sizes_32 = (u32 *)sizes;
+
+	*offset = is_32 ? offs_32[i] : offsets[i];
+	*size = is_32 ? sizes_32[i] : sizes[i];
+	*size = *size ?: h->size;
+
+	if (*offset >= h->size || *size > h->size - *offset)
+		return -EFAULT;
+
+	return 0;
+}
+
+static void cache_maint_full(unsigned int op, u64 total)
+{
+	if (op == NVMAP_CACHE_OP_WB)
+		inner_clean_cache_all();
+	else
+		inner_flush_cache_all();
+	cache_maint_full_flushes++;
+	nvmap_stats_inc(NS_CFLUSH_RQ, total);
+	nvmap_stats_inc(NS_CFLUSH_DONE, cache_maint_threshold(op));
+	trace_nvmap_cache_flush(total,
+				nvmap_stats_read(NS_ALLOC),
+				nvmap_stats_read(NS_CFLUSH_RQ),
+				nvmap_stats_read(NS_CFLUSH_DONE));
+}
+
 /*
  * Perform cache op on the list of memory regions within passed handles.
  * A memory region within handle[i] is identified by offsets[i], sizes[i]
@@ -470,18 +635,25 @@ out:
  * this is done by replacing offsets[i] = 0, sizes[i] = handles[i]->size.
  * So, the input arrays sizes, offsets  are not guaranteed to be read-only
  *
- * This will optimze the op if it can.
- * In the case that all the handles together are larger than the inner cache
- * maint threshold it is possible to just do an entire inner cache flush.
+ * The whole list is planned as one batch: every region is resolved to its
+ * physical ranges, the ranges are sorted and overlapping or adjacent ones are
+ * merged. The merged size is then compared against the calibrated crossover
+ * (see nvmap_cache_maint_calibrate()) to choose between one set/way
+ * operation and per-line maintenance of each merged range. Lists of more
+ * than CACHE_MAINT_PLAN_MAX_RANGES ranges skip the plan and are maintained
+ * handle by handle, or with one set/way operation above the threshold.
  *
  * NOTE: this omits outer cache operations which is fine for ARM64
  */
 static int __nvmap_do_cache_maint_list(struct nvmap_handle **handles,
 				u64 *offsets, u64 *sizes, int op, int nr)
 {
-	int i;
+	int i, n = 0;
 	u64 total = 0;
-	u64 thresh = ~0;
+	u64 merged = 0;
+	size_t thresh;
+	size_t nr_ranges = 0;
+	struct cache_maint_range *plan;
 	bool is_32 = (op & NVMAP_ELEM_SIZE_U64) ? false : true;
 
 	op &= ~NVMAP_ELEM_SIZE_U64;
@@ -489,60 +661,88 @@ static int __nvmap_do_cache_maint_list(struct nvmap_handle **handles,
 	WARN(!IS_ENABLED(CONFIG_ARM64),
 		"cache list operation may not function properly");
 
-	if (nvmap_cache_maint_by_set_ways)
-		thresh = cache_maint_inner_threshold;
+	/* Invalidate-only on partial lines could drop dirty data */
+	if (op == NVMAP_CACHE_OP_INV)
+		op = NVMAP_CACHE_OP_WB_INV;
+
+	thresh = cache_maint_threshold(op);
 
 	for (i = 0; i < nr; i++) {
 		bool inner, outer;
-		u32 *sizes_32 = (u32 *)sizes;
-		u64 size = is_32 ? sizes_32[i] : sizes[i];
+		u64 size, offset;
+		struct nvmap_handle *h = handles[i];
 
-		nvmap_handle_get_cacheability(handles[i], &inner, &outer);
+		nvmap_handle_get_cacheability(h, &inner, &outer);
 
 		if (!inner && !outer)
 			continue;
 
-		if ((op == NVMAP_CACHE_OP_WB) && nvmap_handle_track_dirty(handles[i]))
-			total += atomic_read(&handles[i]->pgalloc.ndirty);
+		if (!h->alloc || cache_maint_list_entry(h, offsets, sizes,
+						is_32, i, &offset, &size))
+			return -EFAULT;
+
+		if (!(h->heap_type & nvmap_dev->cpu_access_mask))
+			return -EPERM;
+
+		if ((op == NVMAP_CACHE_OP_WB) && nvmap_handle_track_dirty(h))
+			total += atomic_read(&h->pgalloc.ndirty);
 		else
-			total += size ? size : handles[i]->size;
+			total += size;
+
+		nr_ranges += h->heap_pgalloc ?
+			DIV_ROUND_UP((offset & ~PAGE_MASK) + size, PAGE_SIZE) : 1;
 	}
 
 	if (!total)
 		return 0;
 
-	/* Full flush in the case the passed list is bigger than our
-	 * threshold. */
-	if (total >= thresh) {
-		for (i = 0; i < nr; i++) {
-			if (handles[i]->userflags &
-			    NVMAP_HANDLE_CACHE_SYNC) {
-				nvmap_handle_mkclean(handles[i], 0,
-						     handles[i]->size);
-				nvmap_zap_handle(handles[i], 0,
-						 handles[i]->size);
-			}
+	cache_maint_lists++;
+
+	/*
+	 * Overlaps can only shrink the list, so if it is far above the
+	 * crossover don't bother resolving the ranges. The plan size comes
+	 * from the user's list, so long lists are never planned either.
+	 */
+	plan = NULL;
+	if (total / 4 < thresh && nr_ranges <= CACHE_MAINT_PLAN_MAX_RANGES)
+		plan = nvmap_altalloc(nr_ranges * sizeof(*plan));
+
+	for (i = 0; i < nr; i++) {
+		struct nvmap_handle *h = handles[i];
+		u64 size, offset;
+		bool inner, outer;
+
+		nvmap_handle_get_cacheability(h, &inner, &outer);
+		if (!inner && !outer)
+			continue;
+
+		/* validated by the first pass */
+		cache_maint_list_entry(h, offsets, sizes, is_32, i,
+				       &offset, &size);
+		if (h->userflags & NVMAP_HANDLE_CACHE_SYNC) {
+			nvmap_handle_mkclean(h, offset, size);
+			nvmap_zap_handle(h, offset, size);
 		}
 
-		if (op == NVMAP_CACHE_OP_WB)
-			inner_clean_cache_all();
-		else
-			inner_flush_cache_all();
-		nvmap_stats_inc(NS_CFLUSH_RQ, total);
-		nvmap_stats_inc(NS_CFLUSH_DONE, thresh);
-		trace_nvmap_cache_flush(total,
-					nvmap_stats_read(NS_ALLOC),
-					nvmap_stats_read(NS_CFLUSH_RQ),
-					nvmap_stats_read(NS_CFLUSH_DONE));
-	} else {
+		if (plan)
+			n = cache_maint_plan_add(plan, n, h, offset, size);
+	}
+
+	if (!plan) {
+		if (total >= thresh) {
+			cache_maint_full(op, total);
+			return 0;
+		}
+		/* No plan, fall back to per-handle ops */
 		for (i = 0; i < nr; i++) {
-			u32 *offs_32 = (u32 *)offsets, *sizes_32 = (u32 *)sizes;
-			u64 size = is_32 ? sizes_32[i] : sizes[i];
-			u64 offset = is_32 ? offs_32[i] : offsets[i];
+			u64 size, offset;
 			int err;
 
-			size = size ?: handles[i]->size;
-			offset = offset ?: 0;
+			err = cache_maint_list_entry(handles[i], offsets, sizes,
+						     is_32, i, &offset, &size);
+			if (err)
+				return err;
+
 			err = __nvmap_do_cache_maint(handles[i]->owner,
 						     handles[i], offset,
 						     offset + size,
@@ -552,11 +752,106 @@ static int __nvmap_do_cache_maint_list(struct nvmap_handle **handles,
 				return err;
 			}
 		}
+		return 0;
 	}
 
+	cache_maint_ranges_in += n;
+	n = cache_maint_plan_merge(plan, n);
+	cache_maint_ranges_out += n;
+
+	for (i = 0; i < n; i++)
+		merged += plan[i].end - plan[i].start;
+
+	if (min(merged, total) >= thresh) {
+		cache_maint_full(op, total);
+		goto out;
+	}
+
+	for (i = 0; i < n; i++) {
+		int err = 0;
+
+		if (plan[i].vaddr)
+			inner_cache_maint(op, plan[i].vaddr,
+					  plan[i].end - plan[i].start);
+		else
+			err = nvmap_cache_maint_phys_range(op, plan[i].start,
+						plan[i].end, true, false);
+		if (err) {
+			pr_err("cache maint of range failed\n");
+			nvmap_altfree(plan, nr_ranges * sizeof(*plan));
+			return err;
+		}
+	}
+
+	nvmap_stats_inc(NS_CFLUSH_RQ, total);
+	nvmap_stats_inc(NS_CFLUSH_DONE, merged);
+	trace_nvmap_cache_flush(merged,
+				nvmap_stats_read(NS_ALLOC),
+				nvmap_stats_read(NS_CFLUSH_RQ),
+				nvmap_stats_read(NS_CFLUSH_DONE));
+out:
+	nvmap_altfree(plan, nr_ranges * sizeof(*plan));
 	return 0;
 }
 
+/*
+ * Measure per-line maintenance of a buffer against a full set/way operation
+ * and derive the size above which the full operation is cheaper.
+ */
+void nvmap_cache_maint_calibrate(void)
+{
+	size_t size = PAGE_SIZE << CACHE_MAINT_CALIB_ORDER;
+	struct page *pages;
+	void *vaddr;
+	int idx, run;
+
+	if (!nvmap_cache_maint_by_set_ways)
+		return;
+
+	pages = alloc_pages(GFP_KERNEL, CACHE_MAINT_CALIB_ORDER);
+	if (!pages)
+		return;
+	vaddr = page_address(pages);
+
+	for (idx = 0; idx < 2; idx++) {
+		unsigned int op = idx ? NVMAP_CACHE_OP_WB_INV :
+					NVMAP_CACHE_OP_WB;
+		u64 line_ns = U64_MAX, full_ns = U64_MAX;
+
+		for (run = 0; run < CACHE_MAINT_CALIB_RUNS; run++) {
+			u64 t;
+
+			memset(vaddr, 0x5a, size);
+			t = sched_clock();
+			inner_cache_maint(op, vaddr, size);
+			line_ns = min(line_ns, sched_clock() - t);
+
+			memset(vaddr, 0xa5, size);
+			t = sched_clock();
+			if (op == NVMAP_CACHE_OP_WB)
+				inner_clean_cache_all();
+			else
+				inner_flush_cache_all();
+			full_ns = min(full_ns, sched_clock() - t);
+		}
+
+		if (!line_ns)
+			continue;
+
+		cache_maint_line_ns_per_mb[idx] = div64_u64(line_ns * SZ_1M,
+							    size);
+		cache_maint_full_ns[idx] = full_ns;
+		cache_maint_crossover[idx] = div64_u64(full_ns * size,
+						       line_ns);
+		pr_info("%s: line %lluns/MB full %lluns crossover %zuKB\n",
+			idx ? "flush" : "clean",
+			cache_maint_line_ns_per_mb[idx], full_ns,
+			cache_maint_crossover[idx] >> 10);
+	}
+
+	__free_pages(pages, CACHE_MAINT_CALIB_ORDER);
+}
+
 inline int nvmap_do_cache_maint_list(struct nvmap_handle **handles,
 				u64 *offsets, u64 *sizes, int op, int nr)
 {
@@ -613,11 +908,55 @@ static ssize_t cache_inner_threshold_write(struct file *file,
 	if (ret != 1)
 		return -EINVAL;
 
+	/* An explicit threshold overrides the calibrated crossover */
+	memset(cache_maint_crossover, 0, sizeof(cache_maint_crossover));
+
 	pr_debug("nvmap:cache_maint_inner_threshold is now :%zuB\n",
 			cache_maint_inner_threshold);
 	return count;
 }
 
+static int cache_maint_calibrate_show(struct seq_file *m, void *v)
+{
+	int idx;
+
+	for (idx = 0; idx < 2; idx++)
+		seq_printf(m, "%s: line %lluns/MB full %lluns crossover %zuB\n",
+			   idx ? "flush" : "clean",
+			   cache_maint_line_ns_per_mb[idx],
+			   cache_maint_full_ns[idx],
+			   cache_maint_crossover[idx]);
+	seq_printf(m, "lists %llu ranges %llu merged %llu full %llu\n",
+		   cache_maint_lists, cache_maint_ranges_in,
+		   cache_maint_ranges_out, cache_maint_full_flushes);
+	return 0;
+}
+
+static int cache_maint_calibrate_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cache_maint_calibrate_show, inode->i_private);
+}
+
+/* Any write re-runs the calibration */
+static ssize_t cache_maint_calibrate_write(struct file *file,
+					const char __user *buffer,
+					size_t count, loff_t *pos)
+{
+	if (!nvmap_cache_maint_by_set_ways)
+		return -EINVAL;
+
+	nvmap_cache_maint_calibrate();
+	return count;
+}
+
+static const struct file_operations cache_maint_calibrate_fops = {
+	.open		= cache_maint_calibrate_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+	.write		= cache_maint_calibrate_write,
+};
+
 static const struct file_operations cache_inner_threshold_fops = {
 	.open		= cache_inner_threshold_open,
 	.read		= seq_read,
@@ -648,6 +987,12 @@ int nvmap_cache_debugfs_init(struct dentry *nvmap_root)
 			    cache_root,
 			    NULL,
 			    &cache_inner_threshold_fops);
+
+	debugfs_create_file("cache_maint_calibrate",
+			    S_IRUSR | S_IWUSR,
+			    cache_root,
+			    NULL,
+			    &cache_maint_calibrate_fops);
 	}
 
 	debugfs_create_atomic_t("nvmap_disable_vaddr_for_cache_maint",
@@ -117,6 +117,31 @@ struct nvmap_handle_ref *__nvmap_validate_locked(struct nvmap_client *c,
 	return NULL;
 }
 
+/*
+ * Lockless variant of __nvmap_validate_locked(): returns the client's
+ * reference to the handle with its dupes count raised, or NULL if the client
+ * holds no live reference. A reference whose dupes already dropped to zero is
+ * being freed and is never revived.
+ */
+struct nvmap_handle_ref *nvmap_validate_ref_get(struct nvmap_client *c,
+						struct nvmap_handle *h)
+{
+	struct nvmap_handle_ref *ref;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(c->ref_hash, ref, hnode, (unsigned long)h) {
+		if (ref->handle != h)
+			continue;
+		if (!atomic_inc_not_zero(&ref->dupes))
+			ref = NULL;
+		rcu_read_unlock();
+		return ref;
+	}
+	rcu_read_unlock();
+
+	return NULL;
+}
+
 /*
  * This routine is used to flush the carveout memory from cache.
  * Why cache flush is needed for carveout? Consider the case, where a piece of
@@ -211,6 +236,7 @@ int nvmap_handle_remove(struct nvmap_device *dev, struct nvmap_handle *h)
 
 	nvmap_lru_del(h);
 	rb_erase(&h->node, &dev->handles);
+	hash_del_rcu(&h->hnode);
 
 	spin_unlock(&dev->handle_lock);
 	return 0;
@@ -236,34 +262,32 @@ void nvmap_handle_add(struct nvmap_device *dev, struct nvmap_handle *h)
 	}
 	rb_link_node(&h->node, parent, p);
 	rb_insert_color(&h->node, &dev->handles);
+	hash_add_rcu(dev->handle_hash, &h->hnode, (unsigned long)h);
 	nvmap_lru_add(h);
 	spin_unlock(&dev->handle_lock);
 }
 
 /* Validates that a handle is in the device master tree and that the
- * client has permission to access it. */
+ * client has permission to access it.
+ *
+ * The lookup runs under RCU only; handles are freed with kfree_rcu() and a
+ * handle whose ref already dropped to zero is never revived, so a racing
+ * nvmap_handle_remove() always sees the count it expects. */
 struct nvmap_handle *nvmap_validate_get(struct nvmap_handle *id)
 {
-	struct nvmap_handle *h = NULL;
-	struct rb_node *n;
-
-	spin_lock(&nvmap_dev->handle_lock);
-
-	n = nvmap_dev->handles.rb_node;
+	struct nvmap_handle *h;
 
-	while (n) {
-		h = rb_entry(n, struct nvmap_handle, node);
-		if (h == id) {
-			h = nvmap_handle_get(h);
-			spin_unlock(&nvmap_dev->handle_lock);
-			return h;
-		}
-		if (id > h)
-			n = n->rb_right;
-		else
-			n = n->rb_left;
+	rcu_read_lock();
+	hash_for_each_possible_rcu(nvmap_dev->handle_hash, h, hnode,
+				   (unsigned long)id) {
+		if (h != id)
+			continue;
+		if (!atomic_inc_not_zero(&h->ref))
+			h = NULL;
+		rcu_read_unlock();
+		return h;
 	}
-	spin_unlock(&nvmap_dev->handle_lock);
+	rcu_read_unlock();
 	return NULL;
 }
 
@@ -367,6 +391,7 @@ struct nvmap_client *__nvmap_create_client(struct nvmap_device *dev,
 	client->name = name;
 	client->kernel_client = true;
 	client->handle_refs = RB_ROOT;
+	hash_init(client->ref_hash);
 
 	get_task_struct(current->group_leader);
 	task_lock(current->group_leader);
@@ -420,13 +445,14 @@ static void destroy_client(struct nvmap_client *client)
 
 		dma_buf_put(ref->handle->dmabuf);
 		rb_erase(&ref->node, &client->handle_refs);
+		hash_del_rcu(&ref->hnode);
 		atomic_dec(&ref->handle->share_count);
 
 		dupes = atomic_read(&ref->dupes);
 		while (dupes--)
 			nvmap_handle_put(ref->handle);
 
-		kfree(ref);
+		kfree_rcu(ref, rcu);
 	}
 
 	if (client->task)
@@ -1355,6 +1381,221 @@ static int nvmap_debug_iovmm_procrank_show(struct seq_file *s, void *unused)
 
 DEBUGFS_OPEN_FOPS(iovmm_procrank);
 
+static int nvmap_debug_tlb_coverage_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[NVMAP_TLB_NR_GRANULES] = {
+		"4K", "64K", "2M",
+	};
+	u64 pages[NVMAP_TLB_NR_GRANULES], total = 0;
+	int i;
+
+	for (i = 0; i < NVMAP_TLB_NR_GRANULES; i++) {
+		pages[i] = max_t(s64, atomic64_read(&nvmap_tlb_pages[i]), 0);
+		total += pages[i];
+	}
+
+	seq_printf(s, "%-8s %12s %6s\n", "GRANULE", "SIZE", "SHARE");
+	for (i = 0; i < NVMAP_TLB_NR_GRANULES; i++)
+		seq_printf(s, "%-8s %11lluK %5llu%%\n", names[i],
+			   K(pages[i] << PAGE_SHIFT),
+			   total ? div64_u64(pages[i] * 100, total) : 0);
+	return 0;
+}
+
+DEBUGFS_OPEN_FOPS(tlb_coverage);
+
+static int nvmap_debug_alloc_histogram_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[NVMAP_ALLOC_HIST_BUCKETS] = {
+		"<=4K", "<=16K", "<=64K", "<=256K", "<=1M", "<=4M", "<=16M",
+		">16M",
+	};
+	struct nvmap_client *client;
+	int i;
+
+	seq_printf(s, "%-18s %18s %8s", "CLIENT", "PROCESS", "PID");
+	for (i = 0; i < NVMAP_ALLOC_HIST_BUCKETS; i++)
+		seq_printf(s, " %8s", names[i]);
+	seq_puts(s, "\n");
+
+	mutex_lock(&nvmap_dev->clients_lock);
+	list_for_each_entry(client, &nvmap_dev->clients, list) {
+		client_stringify(client, s);
+		for (i = 0; i < NVMAP_ALLOC_HIST_BUCKETS; i++)
+			seq_printf(s, " %8u", client->alloc_hist[i]);
+		seq_puts(s, "\n");
+	}
+	mutex_unlock(&nvmap_dev->clients_lock);
+	return 0;
+}
+
+DEBUGFS_OPEN_FOPS(alloc_histogram);
+
+/*
+ * handle_lookup_bench: "echo <threads> [rbtree] > handle_lookup_bench" runs
+ * <threads> kthreads doing NVMAP_LOOKUP_BENCH_ITERS validate/get/put cycles
+ * each on one handle. "rbtree" times the old handle_lock protected tree walk
+ * instead of the RCU hash, for comparison. Reading shows the last result.
+ */
+#define NVMAP_LOOKUP_BENCH_ITERS	100000
+#define NVMAP_LOOKUP_BENCH_MAX_THREADS	64
+
+struct nvmap_lookup_bench {
+	struct nvmap_handle *h;
+	bool rbtree;
+	atomic_t running;
+	struct completion done;
+};
+
+static DEFINE_MUTEX(lookup_bench_lock);
+static u32 lookup_bench_threads;
+static bool lookup_bench_rbtree;
+static u64 lookup_bench_ns;
+
+static struct nvmap_handle *nvmap_validate_get_rbtree(struct nvmap_handle *id)
+{
+	struct nvmap_handle *h = NULL;
+	struct rb_node *n;
+
+	spin_lock(&nvmap_dev->handle_lock);
+	n = nvmap_dev->handles.rb_node;
+	while (n) {
+		h = rb_entry(n, struct nvmap_handle, node);
+		if (h == id) {
+			h = nvmap_handle_get(h);
+			spin_unlock(&nvmap_dev->handle_lock);
+			return h;
+		}
+		if (id > h)
+			n = n->rb_right;
+		else
+			n = n->rb_left;
+	}
+	spin_unlock(&nvmap_dev->handle_lock);
+	return NULL;
+}
+
+static int nvmap_lookup_bench_thread(void *data)
+{
+	struct nvmap_lookup_bench *b = data;
+	int i;
+
+	for (i = 0; i < NVMAP_LOOKUP_BENCH_ITERS; i++) {
+		struct nvmap_handle *h;
+
+		h = b->rbtree ? nvmap_validate_get_rbtree(b->h) :
+				nvmap_validate_get(b->h);
+		if (h)
+			nvmap_handle_put(h);
+	}
+
+	if (atomic_dec_and_test(&b->running))
+		complete(&b->done);
+	return 0;
+}
+
+static int nvmap_lookup_bench_run(u32 threads, bool rbtree)
+{
+	struct nvmap_lookup_bench b;
+	struct nvmap_client *client;
+	struct nvmap_handle_ref *ref;
+	u64 t;
+	u32 i;
+
+	client = __nvmap_create_client(nvmap_dev, "lookup_bench");
+	if (!client)
+		return -ENOMEM;
+
+	ref = nvmap_create_handle(client, PAGE_SIZE);
+	if (IS_ERR(ref)) {
+		destroy_client(client);
+		return PTR_ERR(ref);
+	}
+
+	b.h = ref->handle;
+	b.rbtree = rbtree;
+	atomic_set(&b.running, threads);
+	init_completion(&b.done);
+
+	t = sched_clock();
+	for (i = 0; i < threads; i++) {
+		struct task_struct *task;
+
+		task = kthread_run(nvmap_lookup_bench_thread, &b,
+				   "nvmap-lookup/%u", i);
+		if (IS_ERR(task)) {
+			/* Account for the threads that never started */
+			if (atomic_sub_and_test(threads - i, &b.running))
+				complete(&b.done);
+			break;
+		}
+	}
+	wait_for_completion(&b.done);
+
+	lookup_bench_ns = sched_clock() - t;
+	lookup_bench_threads = i;
+	lookup_bench_rbtree = rbtree;
+
+	nvmap_free_handle(client, b.h);
+	destroy_client(client);
+	return 0;
+}
+
+static int nvmap_debug_lookup_bench_show(struct seq_file *s, void *unused)
+{
+	u64 ops;
+
+	mutex_lock(&lookup_bench_lock);
+	ops = (u64)lookup_bench_threads * NVMAP_LOOKUP_BENCH_ITERS;
+	seq_printf(s, "mode: %s threads: %u ops: %llu\n",
+		   lookup_bench_rbtree ? "rbtree" : "rcu",
+		   lookup_bench_threads, ops);
+	if (ops && lookup_bench_ns)
+		seq_printf(s, "time: %lluus %llu ops/ms\n",
+			   div64_u64(lookup_bench_ns, NSEC_PER_USEC),
+			   div64_u64(ops * NSEC_PER_MSEC, lookup_bench_ns));
+	mutex_unlock(&lookup_bench_lock);
+	return 0;
+}
+
+static int nvmap_debug_lookup_bench_open(struct inode *inode,
+					 struct file *file)
+{
+	return single_open(file, nvmap_debug_lookup_bench_show,
+			   inode->i_private);
+}
+
+static ssize_t nvmap_debug_lookup_bench_write(struct file *file,
+					      const char __user *buffer,
+					      size_t count, loff_t *pos)
+{
+	char buf[32] = { 0 };
+	char mode[16] = { 0 };
+	u32 threads;
+	int ret;
+
+	if (copy_from_user(buf, buffer, min(count, sizeof(buf) - 1)))
+		return -EFAULT;
+
+	if (sscanf(buf, "%u %15s", &threads, mode) < 1 || !threads ||
+	    threads > NVMAP_LOOKUP_BENCH_MAX_THREADS)
+		return -EINVAL;
+
+	mutex_lock(&lookup_bench_lock);
+	ret = nvmap_lookup_bench_run(threads, !strcmp(mode, "rbtree"));
+	mutex_unlock(&lookup_bench_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations debug_lookup_bench_fops = {
+	.open = nvmap_debug_lookup_bench_open,
+	.read = seq_read,
+	.write = nvmap_debug_lookup_bench_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 ulong nvmap_iovmm_get_used_pages(void)
 {
 	u64 total;
@@ -1557,6 +1798,10 @@ static void nvmap_iovmm_debugfs_init(void)
 				&debug_maps_fops);
 			debugfs_create_file("procrank", S_IRUGO, iovmm_root,
 				nvmap_dev, &debug_iovmm_procrank_fops);
+			debugfs_create_file("tlb_coverage", S_IRUGO,
+				iovmm_root, NULL, &debug_tlb_coverage_fops);
+			debugfs_create_file("alloc_histogram", S_IRUGO,
+				iovmm_root, NULL, &debug_alloc_histogram_fops);
 		}
 	}
 }
@@ -1604,12 +1849,14 @@ int __init nvmap_probe(struct platform_device *pdev)
 	dev->dev_user.fops = &nvmap_user_fops;
 	dev->dev_user.parent = &pdev->dev;
 	dev->handles = RB_ROOT;
+	hash_init(dev->handle_hash);
 
 	if (of_property_read_bool(pdev->dev.of_node,
 				"no-cache-maint-by-set-ways"))
 		nvmap_cache_maint_by_set_ways = 0;
 
 	nvmap_override_cache_ops();
+	nvmap_cache_maint_calibrate();
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 	e = nvmap_page_pool_init(dev);
 	if (e)
@@ -1639,6 +1886,8 @@ int __init nvmap_probe(struct platform_device *pdev)
 
 	debugfs_create_u32("max_handle_count", S_IRUGO,
 			nvmap_debug_root, &nvmap_max_handle_count);
+	debugfs_create_file("handle_lookup_bench", S_IRUSR | S_IWUSR,
+			nvmap_debug_root, NULL, &debug_lookup_bench_fops);
 
 	nvmap_dev->dynamic_dma_map_mask = ~0;
 	nvmap_dev->cpu_access_mask = ~0;
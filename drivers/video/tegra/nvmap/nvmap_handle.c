@@ -53,6 +53,7 @@ static void add_handle_ref(struct nvmap_client *client,
 	}
 	rb_link_node(&ref->node, parent, p);
 	rb_insert_color(&ref->node, &client->handle_refs);
+	hash_add_rcu(client->ref_hash, &ref->hnode, (unsigned long)ref->handle);
 	client->handle_count++;
 	if (client->handle_count > nvmap_max_handle_count)
 		nvmap_max_handle_count = client->handle_count;
@@ -242,18 +243,11 @@ struct nvmap_handle_ref *nvmap_duplicate_handle(struct nvmap_client *client,
 		return ERR_PTR(-EINVAL);
 	}
 
-	nvmap_ref_lock(client);
-	ref = __nvmap_validate_locked(client, h);
-
-	if (ref) {
-		/* handle already duplicated in client; just increment
-		 * the reference count rather than re-duplicating it */
-		atomic_inc(&ref->dupes);
-		nvmap_ref_unlock(client);
+	/* handle already duplicated in client; just increment
+	 * the reference count rather than re-duplicating it */
+	ref = nvmap_validate_ref_get(client, h);
+	if (ref)
 		goto out;
-	}
-
-	nvmap_ref_unlock(client);
 
 	ref = kzalloc(sizeof(*ref), GFP_KERNEL);
 	if (!ref) {
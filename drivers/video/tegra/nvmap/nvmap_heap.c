@@ -29,6 +29,7 @@
 #include <linux/stat.h>
 #include <linux/sizes.h>
 #include <linux/io.h>
+#include <linux/seq_file.h>
 #include <linux/version.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
@@ -53,6 +54,27 @@
 
 static struct kmem_cache *heap_block_cache;
 
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+/*
+ * With CONFIG_NVMAP_CARVEOUT_SUBALLOC, blocks up to NVMAP_SUBALLOC_MAX_SIZE
+ * are carved out of NVMAP_SUBALLOC_CHUNK_SIZE chunks by a buddy allocator.
+ * Each order is a size class with its own free list, so alloc and free are
+ * bounded by the number of orders rather than by the number of blocks.
+ */
+#define NVMAP_SUBALLOC_CHUNK_ORDER	10
+#define NVMAP_SUBALLOC_MAX_ORDER	8
+#define NVMAP_SUBALLOC_ORDERS		(NVMAP_SUBALLOC_CHUNK_ORDER + 1)
+#define NVMAP_SUBALLOC_CHUNK_SIZE	(PAGE_SIZE << NVMAP_SUBALLOC_CHUNK_ORDER)
+#define NVMAP_SUBALLOC_MAX_SIZE		(PAGE_SIZE << NVMAP_SUBALLOC_MAX_ORDER)
+
+struct nvmap_heap_chunk {
+	struct list_head list;
+	phys_addr_t base;
+	size_t free;			/* free bytes in this chunk */
+	struct list_block **free_at;	/* free block starting at page idx */
+};
+#endif
+
 struct list_block {
 	struct nvmap_heap_block block;
 	struct list_head all_list;
@@ -62,6 +84,10 @@ struct list_block {
 	size_t align;
 	struct nvmap_heap *heap;
 	struct list_head free_list;
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+	struct nvmap_heap_chunk *chunk;	/* NULL if not suballocated */
+	unsigned int order;
+#endif
 };
 
 struct nvmap_heap {
@@ -80,6 +106,17 @@ struct nvmap_heap {
 	int peer; /* Used only if is_ivm == true */
 	int vm_id; /* Used only if is_ivm == true */
 	struct nvmap_pm_ops pm_ops;
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+	bool suballoc;
+	struct list_head chunks;
+	u32 nr_chunks;
+	struct list_head free_lists[NVMAP_SUBALLOC_ORDERS];
+	u32 nr_free[NVMAP_SUBALLOC_ORDERS];
+	size_t sub_free;	/* free bytes in all chunks */
+	u64 sub_allocs;		/* allocations served from chunks */
+	u64 sub_fallbacks;	/* small allocations that went to the DMA API */
+	u64 frag_fails;		/* misses with enough free, but no extent */
+#endif
 };
 
 struct device *dma_dev_from_handle(unsigned long type)
@@ -114,6 +151,65 @@ size_t nvmap_query_heap_size(struct nvmap_heap *heap)
 	return heap->len;
 }
 
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+static int nvmap_heap_frag_show(struct seq_file *s, void *unused)
+{
+	struct nvmap_heap *heap = s->private;
+	struct nvmap_heap_chunk *chunk;
+	size_t largest = 0;
+	int i;
+
+	mutex_lock(&heap->lock);
+
+	/* Buddies that are free but not merged still form one extent */
+	list_for_each_entry(chunk, &heap->chunks, list) {
+		size_t extent = 0;
+
+		for (i = 0; i < (1 << NVMAP_SUBALLOC_CHUNK_ORDER);) {
+			struct list_block *lb = chunk->free_at[i];
+
+			if (!lb) {
+				largest = max(largest, extent);
+				extent = 0;
+				i++;
+				continue;
+			}
+			extent += PAGE_SIZE << lb->order;
+			i += 1 << lb->order;
+		}
+		largest = max(largest, extent);
+	}
+
+	seq_printf(s, "chunks: %u (%zuKiB reserved)\n", heap->nr_chunks,
+		   (heap->nr_chunks * NVMAP_SUBALLOC_CHUNK_SIZE) >> 10);
+	seq_printf(s, "free: %zuKiB\n", heap->sub_free >> 10);
+	seq_printf(s, "largest free extent: %zuKiB\n", largest >> 10);
+	seq_puts(s, "size class free blocks:\n");
+	for (i = 0; i < NVMAP_SUBALLOC_ORDERS; i++)
+		seq_printf(s, "  %8luKiB: %6u blocks %8luKiB\n",
+			   (PAGE_SIZE << i) >> 10, heap->nr_free[i],
+			   (heap->nr_free[i] * (PAGE_SIZE << i)) >> 10);
+	seq_printf(s, "suballocs: %llu\n", heap->sub_allocs);
+	seq_printf(s, "fallbacks: %llu\n", heap->sub_fallbacks);
+	seq_printf(s, "fragmentation failures: %llu\n", heap->frag_fails);
+
+	mutex_unlock(&heap->lock);
+	return 0;
+}
+
+static int nvmap_heap_frag_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvmap_heap_frag_show, inode->i_private);
+}
+
+static const struct file_operations nvmap_heap_frag_fops = {
+	.open = nvmap_heap_frag_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 void nvmap_heap_debugfs_init(struct dentry *heap_root, struct nvmap_heap *heap)
 {
 	if (sizeof(heap->base) == sizeof(u64))
@@ -128,6 +224,11 @@ void nvmap_heap_debugfs_init(struct dentry *heap_root, struct nvmap_heap *heap)
 	else
 		debugfs_create_x32("size", S_IRUGO,
 			heap_root, (u32 *)&heap->len);
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+	if (heap->suballoc)
+		debugfs_create_file("fragmentation", S_IRUGO,
+			heap_root, heap, &nvmap_heap_frag_fops);
+#endif
 }
 
 static phys_addr_t nvmap_alloc_mem(struct nvmap_heap *h, size_t len,
@@ -199,6 +300,176 @@ static void nvmap_free_mem(struct nvmap_heap *h, phys_addr_t base,
 	}
 }
 
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+static inline u32 sub_block_idx(struct list_block *lb)
+{
+	return (lb->block.base - lb->chunk->base) >> PAGE_SHIFT;
+}
+
+static void sub_free_insert(struct nvmap_heap *heap, struct list_block *lb)
+{
+	size_t size = PAGE_SIZE << lb->order;
+
+	list_add(&lb->free_list, &heap->free_lists[lb->order]);
+	lb->chunk->free_at[sub_block_idx(lb)] = lb;
+	lb->chunk->free += size;
+	heap->nr_free[lb->order]++;
+	heap->sub_free += size;
+}
+
+static void sub_free_remove(struct nvmap_heap *heap, struct list_block *lb)
+{
+	size_t size = PAGE_SIZE << lb->order;
+
+	list_del(&lb->free_list);
+	lb->chunk->free_at[sub_block_idx(lb)] = NULL;
+	lb->chunk->free -= size;
+	heap->nr_free[lb->order]--;
+	heap->sub_free -= size;
+}
+
+/* Reserve a new chunk from the carveout and add it as one free block */
+static int sub_chunk_add(struct nvmap_heap *heap)
+{
+	struct nvmap_heap_chunk *chunk;
+	struct list_block *lb;
+	phys_addr_t pa;
+
+	chunk = kzalloc(sizeof(*chunk), GFP_KERNEL);
+	if (!chunk)
+		return -ENOMEM;
+
+	chunk->free_at = kcalloc(1 << NVMAP_SUBALLOC_CHUNK_ORDER,
+				 sizeof(*chunk->free_at), GFP_KERNEL);
+	lb = kmem_cache_zalloc(heap_block_cache, GFP_KERNEL);
+	if (!chunk->free_at || !lb)
+		goto fail;
+
+	pa = nvmap_alloc_mem(heap, NVMAP_SUBALLOC_CHUNK_SIZE, NULL);
+	if (dma_mapping_error(heap->dma_dev, pa))
+		goto fail;
+
+	chunk->base = pa;
+	list_add_tail(&chunk->list, &heap->chunks);
+	heap->nr_chunks++;
+
+	lb->heap = heap;
+	lb->chunk = chunk;
+	lb->order = NVMAP_SUBALLOC_CHUNK_ORDER;
+	lb->block.base = pa;
+	sub_free_insert(heap, lb);
+	return 0;
+
+fail:
+	if (lb)
+		kmem_cache_free(heap_block_cache, lb);
+	kfree(chunk->free_at);
+	kfree(chunk);
+	return -ENOMEM;
+}
+
+static void sub_chunk_release(struct nvmap_heap *heap, struct list_block *lb)
+{
+	struct nvmap_heap_chunk *chunk = lb->chunk;
+
+	sub_free_remove(heap, lb);
+	kmem_cache_free(heap_block_cache, lb);
+
+	list_del(&chunk->list);
+	heap->nr_chunks--;
+	nvmap_free_mem(heap, chunk->base, NVMAP_SUBALLOC_CHUNK_SIZE);
+	kfree(chunk->free_at);
+	kfree(chunk);
+}
+
+static struct list_block *sub_alloc(struct nvmap_heap *heap, size_t len,
+				    size_t align)
+{
+	unsigned int order = get_order(len);
+	struct list_block *lb = NULL;
+	unsigned int o;
+	bool grown = false, frag = false;
+
+retry:
+	for (o = order; o < NVMAP_SUBALLOC_ORDERS; o++) {
+		if (list_empty(&heap->free_lists[o]))
+			continue;
+		lb = list_first_entry(&heap->free_lists[o],
+				      struct list_block, free_list);
+		break;
+	}
+
+	if (!lb) {
+		/* enough free bytes but no extent, unless a new chunk helps */
+		if (!grown)
+			frag = heap->sub_free >= len;
+		if (grown || sub_chunk_add(heap)) {
+			if (frag)
+				heap->frag_fails++;
+			return NULL;
+		}
+		grown = true;
+		goto retry;
+	}
+
+	/* Only possible if the chunk itself is poorly aligned */
+	if (!IS_ALIGNED(lb->block.base, align))
+		return NULL;
+
+	sub_free_remove(heap, lb);
+
+	/* Split down to the requested size class, freeing the upper halves */
+	while (o > order) {
+		struct list_block *buddy;
+
+		buddy = kmem_cache_zalloc(heap_block_cache, GFP_KERNEL);
+		if (!buddy) {
+			lb->order = o;
+			sub_free_insert(heap, lb);
+			return NULL;
+		}
+		o--;
+		buddy->heap = heap;
+		buddy->chunk = lb->chunk;
+		buddy->order = o;
+		buddy->block.base = lb->block.base + (PAGE_SIZE << o);
+		sub_free_insert(heap, buddy);
+	}
+
+	lb->order = order;
+	heap->sub_allocs++;
+	return lb;
+}
+
+static void sub_free(struct nvmap_heap *heap, struct list_block *lb)
+{
+	struct nvmap_heap_chunk *chunk = lb->chunk;
+
+	lb->block.handle = NULL;
+
+	while (lb->order < NVMAP_SUBALLOC_CHUNK_ORDER) {
+		u32 idx = sub_block_idx(lb) ^ (1 << lb->order);
+		struct list_block *buddy = chunk->free_at[idx];
+
+		if (!buddy || buddy->order != lb->order)
+			break;
+
+		sub_free_remove(heap, buddy);
+		if (buddy->block.base < lb->block.base)
+			swap(buddy, lb);
+		kmem_cache_free(heap_block_cache, buddy);
+		lb->order++;
+	}
+
+	sub_free_insert(heap, lb);
+
+	/* Keep one empty chunk around, give the rest back to the carveout */
+	if (lb->order == NVMAP_SUBALLOC_CHUNK_ORDER &&
+	    heap->nr_free[NVMAP_SUBALLOC_CHUNK_ORDER] > 1)
+		sub_chunk_release(heap, lb);
+}
+#endif
+
 /*
  * base_max limits position of allocated chunk in memory.
  * if base_max is 0 then there is no such limitation.
@@ -227,6 +498,18 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 	if (heap->is_ivm)
 		align = max_t(size_t, align, NVMAP_IVM_ALIGNMENT);
 
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+	if (heap->suballoc && len <= NVMAP_SUBALLOC_MAX_SIZE &&
+	    align <= (PAGE_SIZE << get_order(len))) {
+		heap_block = sub_alloc(heap, len, align);
+		if (heap_block) {
+			dev_base = heap_block->block.base;
+			goto got_block;
+		}
+		heap->sub_fallbacks++;
+	}
+#endif
+
 	heap_block = kmem_cache_zalloc(heap_block_cache, GFP_KERNEL);
 	if (!heap_block) {
 		dev_err(dev, "%s: failed to alloc heap block %s\n",
@@ -244,10 +527,17 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 			dma_get_coherent_stats(dev, &stats);
 			dev_err(dev, "used:%zu,curr_size:%zu max:%zu\n",
 				stats.used, stats.size, stats.max);
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+			if (stats.size - stats.used >= len)
+				heap->frag_fails++;
+#endif
 		}
 		goto fail_dma_alloc;
 	}
 
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+got_block:
+#endif
 	heap_block->block.base = dev_base;
 	heap_block->orig_addr = dev_base;
 	heap_block->size = len;
@@ -271,6 +561,13 @@ static struct list_block *do_heap_free(struct nvmap_heap_block *block)
 
 	list_del(&b->all_list);
 
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+	if (b->chunk) {
+		sub_free(heap, b);
+		return b;
+	}
+#endif
+
 	nvmap_free_mem(heap, block->base, b->size);
 	kmem_cache_free(heap_block_cache, b);
 
@@ -452,6 +749,17 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent,
 
 	INIT_LIST_HEAD(&h->all_list);
 	mutex_init(&h->lock);
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+	{
+		int i;
+
+		/* IVM heaps hand out offsets that peers depend on */
+		h->suballoc = !h->is_ivm;
+		INIT_LIST_HEAD(&h->chunks);
+		for (i = 0; i < NVMAP_SUBALLOC_ORDERS; i++)
+			INIT_LIST_HEAD(&h->free_lists[i]);
+	}
+#endif
 	if (!co->no_cpu_access &&
 		nvmap_cache_maint_phys_range(NVMAP_CACHE_OP_WB_INV,
 				base, base + len, true, true)) {
@@ -485,6 +793,27 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 		list_del(&l->all_list);
 		kmem_cache_free(heap_block_cache, l);
 	}
+#ifdef CONFIG_NVMAP_CARVEOUT_SUBALLOC
+	while (!list_empty(&heap->chunks)) {
+		struct nvmap_heap_chunk *chunk;
+		int i;
+
+		chunk = list_first_entry(&heap->chunks,
+					 struct nvmap_heap_chunk, list);
+		for (i = 0; i < (1 << NVMAP_SUBALLOC_CHUNK_ORDER); i++) {
+			struct list_block *lb = chunk->free_at[i];
+
+			if (!lb)
+				continue;
+			sub_free_remove(heap, lb);
+			kmem_cache_free(heap_block_cache, lb);
+		}
+		list_del(&chunk->list);
+		nvmap_free_mem(heap, chunk->base, NVMAP_SUBALLOC_CHUNK_SIZE);
+		kfree(chunk->free_at);
+		kfree(chunk);
+	}
+#endif
 	kfree(heap);
 }
 
@@ -26,6 +26,9 @@
 #include <linux/debugfs.h>
 #include <linux/freezer.h>
 #include <linux/highmem.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
 #include <linux/version.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
@@ -39,11 +42,28 @@
 
 #define NVMAP_TEST_PAGE_POOL_SHRINKER     1
 #define PENDING_PAGES_SIZE                (SZ_1M / PAGE_SIZE)
+/* Smallest share of the zero_list backlog worth waking another worker for */
+#define NVMAP_PP_ZERO_MIN_BATCH           (SZ_128K / PAGE_SIZE)
+#define NVMAP_PP_MAX_ZERO_WORKERS         (8)
+/* Halve the allocation size history once it covers this many bytes */
+#define NVMAP_PP_HIST_DECAY_BYTES         (SZ_1G)
+/* Small pages searched for big page runs per rebalance pass */
+#define NVMAP_PP_BP_SCAN_PAGES            (2048)
+/* No rebalancing for this long after the shrinker took pages */
+#define NVMAP_PP_SHRINK_BACKOFF           (HZ)
 
 static bool enable_pp = 1;
 static u32 pool_size;
 
-static struct task_struct *background_allocator;
+struct nvmap_pp_zero_worker {
+	struct task_struct *task;
+	int id;
+	bool boosted;
+	struct page *pending[PENDING_PAGES_SIZE];
+};
+
+static struct nvmap_pp_zero_worker *zero_workers[NVMAP_PP_MAX_ZERO_WORKERS];
+static int nr_zero_workers;
 static DECLARE_WAIT_QUEUE_HEAD(nvmap_bg_wait);
 
 #ifdef CONFIG_NVMAP_PAGE_POOL_DEBUG
@@ -113,9 +133,167 @@ static inline struct page *get_page_list_page_bp(struct nvmap_page_pool *pool)
 	return page;
 }
 
-static inline bool nvmap_bg_should_run(struct nvmap_page_pool *pool)
+static bool nvmap_pp_bp_unbalanced(struct nvmap_page_pool *pool)
+{
+	u32 target = READ_ONCE(pool->big_page_target);
+	u32 bp = READ_ONCE(pool->big_page_count);
+	u32 ppb = pool->pages_per_big_pg;
+
+	if (ppb <= 1)
+		return false;
+
+	if (time_before(jiffies, READ_ONCE(pool->shrink_jiffies) +
+			NVMAP_PP_SHRINK_BACKOFF))
+		return false;
+
+	if (bp > target + ppb)
+		return true;
+
+	return !READ_ONCE(pool->bp_grow_failed) && bp + ppb <= target &&
+		READ_ONCE(pool->count) >= bp + ppb;
+}
+
+/*
+ * Worker @id only runs while the backlog is big enough to give it at least
+ * NVMAP_PP_ZERO_MIN_BATCH pages of its own, so small backlogs are handled by
+ * worker 0 alone and a free storm fans out to all workers. Worker 0 also
+ * rebalances the big page list.
+ */
+static inline bool nvmap_bg_should_run(struct nvmap_page_pool *pool, int id)
+{
+	if (list_empty(&pool->zero_list))
+		return !id && nvmap_pp_bp_unbalanced(pool);
+
+	return READ_ONCE(pool->to_zero) > id * NVMAP_PP_ZERO_MIN_BATCH;
+}
+
+/*
+ * Per-CPU magazines sit in front of the global lists so that most allocs and
+ * frees only take the (uncontended) magazine spinlock. The lock order is
+ * pool->lock -> mag->lock; the fast paths never take pool->lock while holding
+ * a magazine lock.
+ *
+ * Hand out up to @nr zeroed pages from this CPU's clean stack.
+ */
+static u32 nvmap_pp_mag_alloc(struct nvmap_page_pool *pool,
+			      struct page **pages, u32 nr)
+{
+	struct nvmap_pp_magazine *mag = raw_cpu_ptr(pool->mags);
+	u32 i, n;
+
+	spin_lock(&mag->lock);
+	n = min(nr, mag->clean_count);
+	for (i = 0; i < n; i++)
+		pages[i] = mag->clean[--mag->clean_count];
+	mag->hits += n;
+	mag->misses += nr - n;
+	spin_unlock(&mag->lock);
+
+	if (n)
+		atomic_sub(n, &pool->mag_count);
+
+	return n;
+}
+
+/*
+ * Stash up to @nr freed pages on this CPU's dirty stack. Pages are not
+ * accepted once the pool as a whole would go over its limit; the caller
+ * then falls back to the global zero_list path.
+ */
+static u32 nvmap_pp_mag_fill(struct nvmap_page_pool *pool,
+			     struct page **pages, u32 nr)
+{
+	struct nvmap_pp_magazine *mag = raw_cpu_ptr(pool->mags);
+	int avail;
+	u32 i, n, held = 0;
+
+	avail = (int)READ_ONCE(pool->max) - (int)READ_ONCE(pool->count) -
+		(int)READ_ONCE(pool->to_zero) -
+		(int)READ_ONCE(pool->under_zero) -
+		atomic_read(&pool->mag_count);
+	if (avail <= 0)
+		return 0;
+
+	spin_lock(&mag->lock);
+	n = min3(nr, (u32)avail, NVMAP_PP_MAG_BATCH - mag->dirty_count);
+	for (i = 0; i < n; i++) {
+		/* See nvmap_page_pool_fill_lots() for pages with extra refs */
+		if (page_count(pages[i]) > 1) {
+			__free_page(pages[i]);
+		} else {
+			mag->dirty[mag->dirty_count++] = pages[i];
+			held++;
+		}
+	}
+	mag->frees += n;
+	spin_unlock(&mag->lock);
+
+	atomic_add(held, &pool->mag_count);
+
+	return n;
+}
+
+/*
+ * Move this CPU's dirty stack to zero_list and top up its clean stack from
+ * page_list. Called with pool->lock held on the slow paths.
+ */
+static void nvmap_pp_mag_exchange_locked(struct nvmap_page_pool *pool)
+{
+	struct nvmap_pp_magazine *mag = raw_cpu_ptr(pool->mags);
+	int moved = 0;
+
+	spin_lock(&mag->lock);
+	while (mag->dirty_count) {
+		list_add_tail(&mag->dirty[--mag->dirty_count]->lru,
+			      &pool->zero_list);
+		pool->to_zero++;
+		moved--;
+	}
+	if (moved)
+		wake_up_interruptible(&nvmap_bg_wait);
+
+	while (mag->clean_count < NVMAP_PP_MAG_BATCH) {
+		struct page *page = get_page_list_page(pool);
+
+		if (!page)
+			break;
+		mag->clean[mag->clean_count++] = page;
+		moved++;
+	}
+	spin_unlock(&mag->lock);
+
+	atomic_add(moved, &pool->mag_count);
+}
+
+/*
+ * Return every page held by every magazine to the global lists so that the
+ * shrinker, resizes and clears see all of the pool.
+ */
+static void nvmap_pp_mags_flush_locked(struct nvmap_page_pool *pool)
 {
-	return !list_empty(&pool->zero_list);
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct nvmap_pp_magazine *mag = per_cpu_ptr(pool->mags, cpu);
+		int moved = 0;
+
+		spin_lock(&mag->lock);
+		while (mag->clean_count) {
+			list_add_tail(&mag->clean[--mag->clean_count]->lru,
+				      &pool->page_list);
+			pool->count++;
+			moved++;
+		}
+		while (mag->dirty_count) {
+			list_add_tail(&mag->dirty[--mag->dirty_count]->lru,
+				      &pool->zero_list);
+			pool->to_zero++;
+			moved++;
+		}
+		spin_unlock(&mag->lock);
+
+		atomic_sub(moved, &pool->mag_count);
+	}
 }
 
 static void nvmap_pp_zero_pages(struct page **pages, int nr)
@@ -130,42 +308,214 @@ static void nvmap_pp_zero_pages(struct page **pages, int nr)
 	trace_nvmap_pp_zero_pages(nr);
 }
 
-static void nvmap_pp_do_background_zero_pages(struct nvmap_page_pool *pool)
+/*
+ * Zero a whole batch first and then do the cache clean for it in one go.
+ * Large batches are cleaned by set/ways, the same way fast_cache_maint()
+ * handles large ranges.
+ */
+static void nvmap_pp_zero_pages_batch(struct page **pages, int nr)
 {
 	int i;
+
+	for (i = 0; i < nr; i++)
+		clear_highpage(pages[i]);
+
+	if (nvmap_cache_maint_by_set_ways && inner_clean_cache_all &&
+	    ((size_t)nr << PAGE_SHIFT) >= cache_maint_inner_threshold)
+		inner_clean_cache_all();
+	else
+		for (i = 0; i < nr; i++)
+			nvmap_clean_cache_page(pages[i]);
+
+	trace_nvmap_pp_zero_pages(nr);
+}
+
+/*
+ * Run at normal priority while the backlog is more than a quarter of the pool
+ * so that allocations stop missing the pool, and drop back to SCHED_IDLE once
+ * it has been worked down.
+ */
+static void nvmap_pp_zero_adjust_prio(struct nvmap_page_pool *pool,
+				      struct nvmap_pp_zero_worker *w)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	bool boost = (u64)READ_ONCE(pool->to_zero) * 4 > READ_ONCE(pool->max);
+
+	if (boost == w->boosted)
+		return;
+
+	sched_setscheduler(current, boost ? SCHED_NORMAL : SCHED_IDLE, &param);
+	w->boosted = boost;
+	trace_nvmap_pp_zero_prio(w->id, boost, pool->to_zero);
+}
+
+static void nvmap_pp_do_background_zero_pages(struct nvmap_page_pool *pool,
+					      struct nvmap_pp_zero_worker *w)
+{
+	int i, nr;
 	struct page *page;
 	int ret;
-	/*
-	 * Statically declared array of pages to be zeroed in a batch,
-	 * local to this thread but too big for the stack.
-	 */
-	static struct page *pending_zero_pages[PENDING_PAGES_SIZE];
+	u64 t1, t2;
 
 	rt_mutex_lock(&pool->lock);
-	for (i = 0; i < PENDING_PAGES_SIZE; i++) {
+	/* Split the backlog evenly between the workers */
+	nr = clamp_t(int, DIV_ROUND_UP(pool->to_zero, nr_zero_workers),
+		     NVMAP_PP_ZERO_MIN_BATCH, PENDING_PAGES_SIZE);
+	for (i = 0; i < nr; i++) {
 		page = get_zero_list_page(pool);
 		if (page == NULL)
 			break;
-		pending_zero_pages[i] = page;
+		w->pending[i] = page;
 		pool->under_zero++;
 	}
+	if (i && !pool->drain_start_ns) {
+		pool->drain_start_ns = sched_clock();
+		pool->drain_pages = 0;
+	}
 	rt_mutex_unlock(&pool->lock);
 
-	nvmap_pp_zero_pages(pending_zero_pages, i);
+	t1 = sched_clock();
+	nvmap_pp_zero_pages_batch(w->pending, i);
+	t2 = sched_clock();
 
 	rt_mutex_lock(&pool->lock);
-	ret = __nvmap_page_pool_fill_lots_locked(pool, pending_zero_pages, i);
+	ret = __nvmap_page_pool_fill_lots_locked(pool, w->pending, i);
 	pool->under_zero -= i;
+	pool->zeroed_pages += i;
+	pool->zero_time_ns += t2 - t1;
+	pool->drain_pages += i;
+	if (pool->drain_start_ns && !pool->to_zero && !pool->under_zero) {
+		pool->last_drain_ns = t2 - pool->drain_start_ns;
+		pool->last_drain_pages = pool->drain_pages;
+		pool->drain_start_ns = 0;
+		trace_nvmap_pp_zero_drained(pool->last_drain_pages,
+					    pool->last_drain_ns);
+	}
 	rt_mutex_unlock(&pool->lock);
 
 	trace_nvmap_pp_do_background_zero_pages(ret, i);
+	trace_nvmap_pp_zero_batch(w->id, i, t2 - t1, pool->to_zero);
 
 	for (; ret < i; ret++)
-		__free_page(pending_zero_pages[ret]);
+		__free_page(w->pending[ret]);
+}
+
+static int nvmap_pp_page_cmp(const void *a, const void *b)
+{
+	unsigned long pa = page_to_pfn(*(struct page * const *)a);
+	unsigned long pb = page_to_pfn(*(struct page * const *)b);
+
+	if (pa < pb)
+		return -1;
+	return pa > pb;
 }
 
 /*
- * This thread fills the page pools with zeroed pages. We avoid releasing the
+ * Move pool capacity between the small and big page lists towards
+ * big_page_target. Only pages already in the pool are converted: surplus
+ * big pages are split onto page_list, and naturally aligned runs of small
+ * pages on page_list are merged onto page_list_bp. Nothing is allocated, so
+ * this never works against the shrinker.
+ */
+static void nvmap_pp_rebalance(struct nvmap_page_pool *pool)
+{
+	static struct page *scan[NVMAP_PP_BP_SCAN_PAGES];
+	u32 ppb = pool->pages_per_big_pg;
+	struct page *page;
+	int n = 0, i, j;
+
+	rt_mutex_lock(&pool->lock);
+	while (pool->big_page_count > pool->big_page_target + ppb) {
+		page = get_page_list_page_bp(pool);
+		if (!page)
+			break;
+		for (i = 0; i < ppb; i++)
+			list_add_tail(&nth_page(page, i)->lru, &pool->page_list);
+		pool->count += ppb;
+	}
+
+	if (pool->big_page_count + ppb > pool->big_page_target)
+		goto out;
+
+	/* Only worker 0 rebalances, so the scan buffer is not shared */
+	list_for_each_entry(page, &pool->page_list, lru) {
+		if (n == NVMAP_PP_BP_SCAN_PAGES)
+			break;
+		scan[n++] = page;
+	}
+	sort(scan, n, sizeof(scan[0]), nvmap_pp_page_cmp, NULL);
+
+	for (i = 0; i + ppb <= n &&
+	     pool->big_page_count + ppb <= pool->big_page_target;) {
+		if (page_to_phys(scan[i]) & (pool->big_pg_sz - 1)) {
+			i++;
+			continue;
+		}
+		for (j = 1; j < ppb; j++)
+			if (scan[i + j] != nth_page(scan[i], j))
+				break;
+		if (j < ppb) {
+			i += j;
+			continue;
+		}
+
+		for (j = 0; j < ppb; j++)
+			list_del(&scan[i + j]->lru);
+		list_add_tail(&scan[i]->lru, &pool->page_list_bp);
+		pool->big_page_count += ppb;
+		i += ppb;
+	}
+
+	/* Wait for the target to move before looking again */
+	if (pool->big_page_count + ppb <= pool->big_page_target)
+		WRITE_ONCE(pool->bp_grow_failed, true);
+out:
+	rt_mutex_unlock(&pool->lock);
+
+	trace_nvmap_pp_rebalance(pool->big_page_target, pool->big_page_count,
+				 pool->count);
+}
+
+/*
+ * Feed the size of a new iovmm handle into the big page policy. The share of
+ * recently allocated bytes in handles of at least one big page decides how
+ * much of the pool is kept as big pages.
+ */
+void nvmap_page_pool_note_alloc(struct nvmap_page_pool *pool, size_t size)
+{
+	u64 big, small, target;
+	u32 ppb = pool->pages_per_big_pg;
+
+	if (!enable_pp || ppb <= 1)
+		return;
+
+	if (size >= pool->big_pg_sz)
+		big = atomic64_add_return(size, &pool->alloc_bytes_big);
+	else
+		big = atomic64_read(&pool->alloc_bytes_big);
+	if (size < pool->big_pg_sz)
+		small = atomic64_add_return(size, &pool->alloc_bytes_small);
+	else
+		small = atomic64_read(&pool->alloc_bytes_small);
+
+	if (big + small > NVMAP_PP_HIST_DECAY_BYTES) {
+		atomic64_set(&pool->alloc_bytes_big, big / 2);
+		atomic64_set(&pool->alloc_bytes_small, small / 2);
+	}
+
+	target = div64_u64((u64)pool->max * big, big + small);
+	target = rounddown(target, ppb);
+	if (target == pool->big_page_target)
+		return;
+
+	WRITE_ONCE(pool->big_page_target, target);
+	WRITE_ONCE(pool->bp_grow_failed, false);
+	if (nvmap_pp_bp_unbalanced(pool))
+		wake_up_interruptible(&nvmap_bg_wait);
+}
+
+/*
+ * These threads fill the page pools with zeroed pages. We avoid releasing the
  * pages directly back into the page pools since we would then have to zero
  * them ourselves. Instead it is easier to just reallocate zeroed pages. This
  * happens in the background so that the overhead of allocating zeroed pages is
@@ -174,26 +524,74 @@ static void nvmap_pp_do_background_zero_pages(struct nvmap_page_pool *pool)
  */
 static int nvmap_background_zero_thread(void *arg)
 {
+	struct nvmap_pp_zero_worker *w = arg;
 	struct nvmap_page_pool *pool = &nvmap_dev->pool;
 	struct sched_param param = { .sched_priority = 0 };
 
-	pr_info("PP zeroing thread starting.\n");
+	pr_info("PP zeroing thread %d starting.\n", w->id);
 
 	set_freezable();
 	sched_setscheduler(current, SCHED_IDLE, &param);
 
 	while (!kthread_should_stop()) {
-		while (nvmap_bg_should_run(pool))
-			nvmap_pp_do_background_zero_pages(pool);
+		while (nvmap_bg_should_run(pool, w->id)) {
+			nvmap_pp_zero_adjust_prio(pool, w);
+			if (list_empty(&pool->zero_list)) {
+				nvmap_pp_rebalance(pool);
+				continue;
+			}
+			nvmap_pp_do_background_zero_pages(pool, w);
+		}
+		nvmap_pp_zero_adjust_prio(pool, w);
 
 		wait_event_freezable(nvmap_bg_wait,
-				nvmap_bg_should_run(pool) ||
+				nvmap_bg_should_run(pool, w->id) ||
 				kthread_should_stop());
 	}
 
 	return 0;
 }
 
+static int nvmap_pp_zero_workers_start(void)
+{
+	int i;
+
+	nr_zero_workers = clamp_t(int, num_online_cpus(), 1,
+				  NVMAP_PP_MAX_ZERO_WORKERS);
+
+	for (i = 0; i < nr_zero_workers; i++) {
+		struct nvmap_pp_zero_worker *w;
+
+		w = kzalloc(sizeof(*w), GFP_KERNEL);
+		if (!w)
+			break;
+		w->id = i;
+		w->task = kthread_run(nvmap_background_zero_thread, w,
+				      "nvmap-bz/%d", i);
+		if (IS_ERR(w->task)) {
+			kfree(w);
+			break;
+		}
+		zero_workers[i] = w;
+	}
+
+	/* Run with whatever we got as long as there is at least one */
+	nr_zero_workers = i;
+	return i ? 0 : -ENOMEM;
+}
+
+static void nvmap_pp_zero_workers_stop(void)
+{
+	int i;
+
+	for (i = 0; i < nr_zero_workers; i++) {
+		kthread_stop(zero_workers[i]->task);
+		kfree(zero_workers[i]);
+		zero_workers[i] = NULL;
+	}
+	nr_zero_workers = 0;
+}
+
 static void nvmap_pgcount(struct page *page, bool incr)
 {
 #if LINUX_VERSION_CODE < KERNEL_VERSION(4, 9, 0)
@@ -211,7 +609,7 @@ static void nvmap_pgcount(struct page *page, bool incr)
  * of whether the page pools are enabled. This lets one disable the page pools
  * and then free all the memory therein.
  *
- * FIXME: Pages in pending_zero_pages[] can still be unreleased.
+ * FIXME: Pages in the zero workers' pending[] can still be unreleased.
  */
 static ulong nvmap_page_pool_free_pages_locked(struct nvmap_page_pool *pool,
 						      ulong nr_pages)
@@ -222,6 +620,8 @@ static ulong nvmap_page_pool_free_pages_locked(struct nvmap_page_pool *pool,
 
 	pr_debug("req to release pages=%ld\n", nr_pages);
 
+	nvmap_pp_mags_flush_locked(pool);
+
 	while (nr_pages) {
 		int i;
 
@@ -277,6 +677,18 @@ int nvmap_page_pool_alloc_lots(struct nvmap_page_pool *pool,
 	if (!enable_pp || !nr)
 		return 0;
 
+	ind = nvmap_pp_mag_alloc(pool, pages, nr);
+	if (IS_ENABLED(CONFIG_NVMAP_PAGE_POOL_DEBUG)) {
+		u32 i;
+
+		for (i = 0; i < ind; i++) {
+			nvmap_pgcount(pages[i], false);
+			BUG_ON(page_count(pages[i]) != 1);
+		}
+	}
+	if (ind == nr)
+		goto out;
+
 	rt_mutex_lock(&pool->lock);
 
 	while (ind < nr) {
@@ -301,12 +713,16 @@ int nvmap_page_pool_alloc_lots(struct nvmap_page_pool *pool,
 		}
 	}
 
+	/* Refill this CPU's magazine while we hold the lock anyway */
+	nvmap_pp_mag_exchange_locked(pool);
+
 	rt_mutex_unlock(&pool->lock);
 
 	/* Zero non-zeroed pages, if any */
 	if (non_zero_cnt)
 		nvmap_pp_zero_pages(&pages[non_zero_idx], non_zero_cnt);
 
+out:
 	pp_alloc_add(pool, ind);
 	pp_hit_add(pool, ind);
 	pp_miss_add(pool, nr - ind);
@@ -384,8 +800,12 @@ static int __nvmap_page_pool_fill_lots_locked(struct nvmap_page_pool *pool,
 	if (!enable_pp)
 		return 0;
 
-	real_nr = min_t(u32, pool->max - pool->count, nr);
-	BUG_ON(real_nr < 0);
+	/* Pages held by the per-CPU magazines count against pool->max too */
+	real_nr = (int)pool->max - (int)pool->count -
+		atomic_read(&pool->mag_count);
+	if (real_nr <= 0)
+		return 0;
+	real_nr = min_t(u32, real_nr, nr);
 	if (real_nr == 0)
 		return 0;
 
@@ -417,16 +837,29 @@ int nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
 				       struct page **pages, u32 nr)
 {
 	int ret = 0;
-	int i;
+	int i, mag_nr = 0;
 	u32 save_to_zero;
 
+	if (enable_pp) {
+		mag_nr = nvmap_pp_mag_fill(pool, pages, nr);
+		if (mag_nr == nr)
+			return mag_nr;
+	}
+
 	rt_mutex_lock(&pool->lock);
 
+	/* Hand the full dirty stack over to the zeroing thread */
+	if (enable_pp)
+		nvmap_pp_mag_exchange_locked(pool);
+
 	save_to_zero = pool->to_zero;
 
-	ret = min(nr, pool->max - pool->count - pool->to_zero - pool->under_zero);
+	ret = mag_nr + min_t(int, nr - mag_nr,
+			     (int)pool->max - (int)pool->count -
+			     (int)pool->to_zero - (int)pool->under_zero -
+			     atomic_read(&pool->mag_count));
 
-	for (i = 0; i < ret; i++) {
+	for (i = mag_nr; i < ret; i++) {
 		/* If page has additonal referecnces, Don't add it into
 		 * page pool. get_user_pages() on mmap'ed nvmap handle can
 		 * hold a refcount on the page. These pages can't be
@@ -459,7 +892,8 @@ ulong nvmap_page_pool_get_unused_pages(void)
 	if (!nvmap_dev)
 		return 0;
 
-	total = nvmap_dev->pool.count + nvmap_dev->pool.to_zero;
+	total = nvmap_dev->pool.count + nvmap_dev->pool.to_zero +
+		atomic_read(&nvmap_dev->pool.mag_count);
 
 	return total;
 }
@@ -474,7 +908,8 @@ int nvmap_page_pool_clear(void)
 
 	rt_mutex_lock(&pool->lock);
 
-	(void)nvmap_page_pool_free_pages_locked(pool, pool->count + pool->to_zero);
+	(void)nvmap_page_pool_free_pages_locked(pool,
+			nvmap_page_pool_get_unused_pages());
 
 	/* For some reason, if an error occured... */
 	if (!list_empty(&pool->page_list) || !list_empty(&pool->zero_list)) {
@@ -521,6 +956,8 @@ static unsigned long nvmap_page_pool_scan_objects(struct shrinker *shrinker,
 
 	pr_debug("sh_pages=%lu", sc->nr_to_scan);
 
+	WRITE_ONCE(nvmap_dev->pool.shrink_jiffies, jiffies);
+
 	rt_mutex_lock(&nvmap_dev->pool.lock);
 	remaining = nvmap_page_pool_free_pages_locked(
 			&nvmap_dev->pool, sc->nr_to_scan);
@@ -633,6 +1070,100 @@ static struct kernel_param_ops pool_size_ops = {
 
 module_param_cb(pool_size, &pool_size_ops, &pool_size, 0644);
 
+static int nvmap_pp_pcp_stats_show(struct seq_file *s, void *unused)
+{
+	struct nvmap_page_pool *pool = &nvmap_dev->pool;
+	u64 hits = 0, misses = 0;
+	int cpu;
+
+	seq_printf(s, "%-4s %8s %8s %12s %12s %12s %6s\n", "CPU", "clean",
+		   "dirty", "hits", "misses", "frees", "hit%");
+	for_each_possible_cpu(cpu) {
+		struct nvmap_pp_magazine *mag = per_cpu_ptr(pool->mags, cpu);
+		u64 total = mag->hits + mag->misses;
+
+		seq_printf(s, "%-4d %8u %8u %12llu %12llu %12llu %6llu\n",
+			   cpu, mag->clean_count, mag->dirty_count,
+			   mag->hits, mag->misses, mag->frees,
+			   total ? div64_u64(mag->hits * 100, total) : 0);
+		hits += mag->hits;
+		misses += mag->misses;
+	}
+	seq_printf(s, "total: %d pages in magazines, hit rate %llu%%\n",
+		   atomic_read(&pool->mag_count),
+		   (hits + misses) ? div64_u64(hits * 100, hits + misses) : 0);
+
+	return 0;
+}
+
+static int nvmap_pp_pcp_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvmap_pp_pcp_stats_show, inode->i_private);
+}
+
+static const struct file_operations nvmap_pp_pcp_stats_fops = {
+	.open = nvmap_pp_pcp_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Bytes per nanosecond scaled to MB/s */
+static u64 nvmap_pp_mbps(u64 pages, u64 ns)
+{
+	if (!ns)
+		return 0;
+	return div64_u64((pages << PAGE_SHIFT) * 1000, ns);
+}
+
+static int nvmap_pp_zero_stats_show(struct seq_file *s, void *unused)
+{
+	struct nvmap_page_pool *pool = &nvmap_dev->pool;
+	u64 zeroed, zero_ns, drain_ns, drain_pages, rate, backlog;
+	int i, boosted = 0;
+
+	rt_mutex_lock(&pool->lock);
+	backlog = pool->to_zero + pool->under_zero;
+	zeroed = pool->zeroed_pages;
+	zero_ns = pool->zero_time_ns;
+	drain_ns = pool->last_drain_ns;
+	drain_pages = pool->last_drain_pages;
+	rt_mutex_unlock(&pool->lock);
+
+	for (i = 0; i < nr_zero_workers; i++)
+		boosted += zero_workers[i]->boosted;
+
+	/* Wall clock rate of the last drain covers all workers together */
+	rate = nvmap_pp_mbps(drain_pages, drain_ns);
+	if (!rate)
+		rate = nvmap_pp_mbps(zeroed, zero_ns);
+
+	seq_printf(s, "workers: %d (%d boosted)\n", nr_zero_workers, boosted);
+	seq_printf(s, "backlog: %llu pages\n", backlog);
+	seq_printf(s, "zeroed: %llu pages\n", zeroed);
+	seq_printf(s, "per-worker throughput: %llu MB/s\n",
+		   nvmap_pp_mbps(zeroed, zero_ns));
+	seq_printf(s, "last drain: %llu pages in %llu us (%llu MB/s)\n",
+		   drain_pages, div64_u64(drain_ns, NSEC_PER_USEC),
+		   nvmap_pp_mbps(drain_pages, drain_ns));
+	seq_printf(s, "estimated time to drain: %llu us\n",
+		   rate ? div64_u64(backlog << PAGE_SHIFT, rate) : 0);
+
+	return 0;
+}
+
+static int nvmap_pp_zero_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvmap_pp_zero_stats_show, inode->i_private);
+}
+
+static const struct file_operations nvmap_pp_zero_stats_fops = {
+	.open = nvmap_pp_zero_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 int nvmap_page_pool_debugfs_init(struct dentry *nvmap_root)
 {
 	struct dentry *pp_root;
@@ -659,6 +1190,12 @@ int nvmap_page_pool_debugfs_init(struct dentry *nvmap_root)
 	debugfs_create_u64("total_big_page_allocs",
 			   S_IRUGO, pp_root,
 			   &nvmap_big_page_allocs);
+	debugfs_create_u64("total_huge_page_allocs",
+			   S_IRUGO, pp_root,
+			   &nvmap_huge_page_allocs);
+	debugfs_create_u32("page_pool_big_page_target",
+			   S_IRUGO, pp_root,
+			   &nvmap_dev->pool.big_page_target);
 	debugfs_create_u64("total_page_allocs",
 			   S_IRUGO, pp_root,
 			   &nvmap_total_page_allocs);
@@ -677,6 +1214,12 @@ int nvmap_page_pool_debugfs_init(struct dentry *nvmap_root)
 			   S_IRUGO, pp_root,
 			   &nvmap_dev->pool.misses);
 #endif
+	debugfs_create_file("page_pool_pcp_stats",
+			    S_IRUGO, pp_root, NULL,
+			    &nvmap_pp_pcp_stats_fops);
+	debugfs_create_file("page_pool_zero_stats",
+			    S_IRUGO, pp_root, NULL,
+			    &nvmap_pp_zero_stats_fops);
 
 	return 0;
 }
@@ -685,12 +1228,21 @@ int nvmap_page_pool_init(struct nvmap_device *dev)
 {
 	struct sysinfo info;
 	struct nvmap_page_pool *pool = &dev->pool;
+	int cpu;
 
 	memset(pool, 0x0, sizeof(*pool));
 	rt_mutex_init(&pool->lock);
 	INIT_LIST_HEAD(&pool->page_list);
 	INIT_LIST_HEAD(&pool->zero_list);
 	INIT_LIST_HEAD(&pool->page_list_bp);
+	pool->shrink_jiffies = jiffies - NVMAP_PP_SHRINK_BACKOFF;
+
+	pool->mags = alloc_percpu(struct nvmap_pp_magazine);
+	if (!pool->mags)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(pool->mags, cpu)->lock);
+	atomic_set(&pool->mag_count, 0);
 
 	pool->big_pg_sz = NVMAP_PP_BIG_PAGE_SIZE;
 	pool->pages_per_big_pg = NVMAP_PP_BIG_PAGE_SIZE >> PAGE_SHIFT;
@@ -712,9 +1264,7 @@ int nvmap_page_pool_init(struct nvmap_device *dev)
 	pr_info("nvmap page pool size: %u pages (%u MB)\n", pool->max,
 		(pool->max * info.mem_unit) >> 20);
 
-	background_allocator = kthread_run(nvmap_background_zero_thread,
-					    NULL, "nvmap-bz");
-	if (IS_ERR(background_allocator))
+	if (nvmap_pp_zero_workers_start())
 		goto fail;
 
 	register_shrinker(&nvmap_page_pool_shrinker);
@@ -730,13 +1280,21 @@ int nvmap_page_pool_fini(struct nvmap_device *dev)
 	struct nvmap_page_pool *pool = &dev->pool;
 
 	/*
-	 * if background allocator is not initialzed or not
+	 * if zeroing workers are not initialzed or not
 	 * properly initialized, then shrinker is also not
 	 * registered
 	 */
-	if (!IS_ERR_OR_NULL(background_allocator)) {
+	if (nr_zero_workers) {
 		unregister_shrinker(&nvmap_page_pool_shrinker);
-		kthread_stop(background_allocator);
+		nvmap_pp_zero_workers_stop();
+	}
+
+	if (pool->mags) {
+		rt_mutex_lock(&pool->lock);
+		nvmap_pp_mags_flush_locked(pool);
+		rt_mutex_unlock(&pool->lock);
+		free_percpu(pool->mags);
+		pool->mags = NULL;
 	}
 
 	WARN_ON(!list_empty(&pool->page_list));
@@ -23,6 +23,8 @@
 #include <linux/mutex.h>
 #include <linux/rtmutex.h>
 #include <linux/rbtree.h>
+#include <linux/hashtable.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/atomic.h>
@@ -85,6 +87,7 @@ void _nvmap_handle_free(struct nvmap_handle *h);
 /* holds max number of handles allocted per process at any time */
 extern u32 nvmap_max_handle_count;
 extern u64 nvmap_big_page_allocs;
+extern u64 nvmap_huge_page_allocs;
 extern u64 nvmap_total_page_allocs;
 
 extern bool nvmap_convert_iovmm_to_carveout;
@@ -130,8 +133,31 @@ struct nvmap_pgalloc {
 	bool contig;			/* contiguous system memory */
 	atomic_t reserved;
 	atomic_t ndirty;	/* count number of dirty pages */
+	u32 pages_2m;		/* pages in aligned 2M runs */
+	u32 pages_64k;		/* pages in aligned 64K runs (not in 2M) */
 };
 
+#define NVMAP_HUGE_PAGE_SIZE		SZ_2M
+
+enum nvmap_tlb_granule {
+	NVMAP_TLB_4K = 0,
+	NVMAP_TLB_64K,
+	NVMAP_TLB_2M,
+	NVMAP_TLB_NR_GRANULES,
+};
+
+extern atomic64_t nvmap_tlb_pages[NVMAP_TLB_NR_GRANULES];
+
+/* Allocation size histogram buckets: <=4K, 16K, 64K, 256K, 1M, 4M, 16M, more */
+#define NVMAP_ALLOC_HIST_BUCKETS	8
+
+static inline int nvmap_alloc_hist_bucket(size_t size)
+{
+	int order = get_order(size);
+
+	return min((order + 1) / 2, NVMAP_ALLOC_HIST_BUCKETS - 1);
+}
+
 /* bit 31-29: IVM peer
  * bit 28-16: offset (aligned to 32K)
  * bit 15-00: len (aligned to page_size)
@@ -156,6 +182,8 @@ struct nvmap_handle_dmabuf_priv {
 
 struct nvmap_handle {
 	struct rb_node node;	/* entry on global handle tree */
+	struct hlist_node hnode; /* entry on global handle hash */
+	struct rcu_head rcu;
 	atomic_t ref;		/* reference count (i.e., # of duplications) */
 	atomic_t pin;		/* pin count */
 	u32 flags;		/* caching flags */
@@ -204,6 +232,8 @@ struct nvmap_tag_entry {
 struct nvmap_handle_ref {
 	struct nvmap_handle *handle;
 	struct rb_node	node;
+	struct hlist_node hnode;	/* entry on client's ref_hash */
+	struct rcu_head	rcu;
 	atomic_t	dupes;	/* number of times to free on file close */
 };
 
@@ -218,6 +248,25 @@ struct nvmap_handle_ref {
 
 #define NVMAP_PP_BIG_PAGE_SIZE           (0x10000)
 
+/*
+ * Per-CPU magazine size. The clean stack caches zeroed pages taken from
+ * page_list, the dirty stack batches freed pages before they are handed
+ * to zero_list. Each holds up to NVMAP_PP_MAG_BATCH pages, which are moved
+ * to/from the global lists together.
+ */
+#define NVMAP_PP_MAG_BATCH               (64)
+
+struct nvmap_pp_magazine {
+	spinlock_t lock;
+	u32 clean_count;
+	u32 dirty_count;
+	struct page *clean[NVMAP_PP_MAG_BATCH];
+	struct page *dirty[NVMAP_PP_MAG_BATCH];
+	u64 hits;       /* Pages served from the clean stack */
+	u64 misses;     /* Pages that had to go to the global lists */
+	u64 frees;      /* Pages put on the dirty stack */
+};
+
 struct nvmap_page_pool {
 	struct rt_mutex lock;
 	u32 count;      /* Number of pages in the page & dirty list. */
@@ -230,6 +279,23 @@ struct nvmap_page_pool {
 	struct list_head page_list;
 	struct list_head zero_list;
 	struct list_head page_list_bp;
+	struct nvmap_pp_magazine __percpu *mags;
+	atomic_t mag_count;   /* Number of pages held in all magazines */
+
+	/* Big page share of the pool, tuned from the allocation sizes */
+	u32 big_page_target;  /* Pages the big page list should hold */
+	bool bp_grow_failed;  /* Don't retry growing until target changes */
+	unsigned long shrink_jiffies; /* Last shrinker scan, pauses rebalancing */
+	atomic64_t alloc_bytes_small; /* Decaying bytes in small handles */
+	atomic64_t alloc_bytes_big;   /* Decaying bytes in big page handles */
+
+	/* Background zeroing statistics, protected by lock */
+	u64 zeroed_pages;     /* Pages zeroed by the workers */
+	u64 zero_time_ns;     /* Time the workers spent zeroing */
+	u64 drain_start_ns;   /* When the current backlog started draining */
+	u64 drain_pages;      /* Pages zeroed in the current drain */
+	u64 last_drain_ns;    /* Duration of the last complete drain */
+	u64 last_drain_pages; /* Pages zeroed in the last complete drain */
 
 #ifdef CONFIG_NVMAP_PAGE_POOL_DEBUG
 	u64 allocs;
@@ -248,15 +314,24 @@ int nvmap_page_pool_alloc_lots_bp(struct nvmap_page_pool *pool,
 					struct page **pages, u32 nr);
 int nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
 				       struct page **pages, u32 nr);
+void nvmap_page_pool_note_alloc(struct nvmap_page_pool *pool, size_t size);
 int nvmap_page_pool_clear(void);
 int nvmap_page_pool_debugfs_init(struct dentry *nvmap_root);
 #endif
 
 #define NVMAP_IVM_INVALID_PEER		(-1)
 
+/*
+ * The rbtrees are kept for ordered walks under the locks; lookups by handle
+ * go through these RCU protected hashes and never take the locks.
+ */
+#define NVMAP_HANDLE_HASH_BITS		10
+#define NVMAP_CLIENT_REF_HASH_BITS	8
+
 struct nvmap_client {
 	const char			*name;
 	struct rb_root			handle_refs;
+	DECLARE_HASHTABLE(ref_hash, NVMAP_CLIENT_REF_HASH_BITS);
 	struct mutex			ref_lock;
 	bool				kernel_client;
 	atomic_t			count;
@@ -266,6 +341,7 @@ struct nvmap_client {
 	u32				next_fd;
 	int				warned;
 	int				tag_warned;
+	u32				alloc_hist[NVMAP_ALLOC_HIST_BUCKETS];
 };
 
 struct nvmap_vma_priv {
@@ -277,6 +353,7 @@ struct nvmap_vma_priv {
 struct nvmap_device {
 	struct rb_root	handles;
 	spinlock_t	handle_lock;
+	DECLARE_HASHTABLE(handle_hash, NVMAP_HANDLE_HASH_BITS);
 	struct miscdevice dev_user;
 	struct nvmap_carveout_node *heaps;
 	int nr_heaps;
@@ -405,6 +482,9 @@ struct nvmap_handle_ref *__nvmap_validate_locked(struct nvmap_client *priv,
 
 struct nvmap_handle *nvmap_validate_get(struct nvmap_handle *h);
 
+struct nvmap_handle_ref *nvmap_validate_ref_get(struct nvmap_client *c,
+						struct nvmap_handle *h);
+
 struct nvmap_handle_ref *nvmap_create_handle(struct nvmap_client *client,
 					     size_t size);
 
@@ -470,6 +550,7 @@ struct nvmap_handle *nvmap_handle_get_from_fd(int fd);
 /* MM definitions. */
 extern size_t cache_maint_inner_threshold;
 extern int nvmap_cache_maint_by_set_ways;
+void nvmap_cache_maint_calibrate(void);
 
 extern void v7_flush_kern_cache_all(void);
 extern void v7_clean_kern_cache_all(void *);
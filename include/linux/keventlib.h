@@ -22,6 +22,31 @@
 int
 keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts);
 
+/*
+ * Zero-copy writes: keventlib_reserve() reserves space for one or more
+ * events of a provider, keventlib_reserve_event() returns where the payload
+ * of each goes so it can be serialized in place, and keventlib_commit()
+ * publishes them all at once. The reserved size is the sum of
+ * keventlib_event_size() of the events; a batch can hold at most one
+ * maximum sized event. Interrupts stay disabled from reserve to commit, so
+ * the caller must not sleep in between. keventlib_reserve_one() reserves
+ * a single event.
+ */
+struct keventlib_batch {
+	/* private to keventlib */
+	void *provider;
+	unsigned long flags;
+	u64 resv[8];
+};
+
+size_t keventlib_event_size(size_t size);
+int keventlib_reserve(int id, struct keventlib_batch *batch, size_t size);
+void *keventlib_reserve_event(struct keventlib_batch *batch, size_t size,
+			      uint32_t type, uint64_t ts);
+void keventlib_commit(struct keventlib_batch *batch);
+void *keventlib_reserve_one(int id, struct keventlib_batch *batch,
+			    size_t size, uint32_t type, uint64_t ts);
+
 int keventlib_register(size_t size, const char *name,
 		       const char *schema, size_t schema_size);
 void keventlib_unregister(int id);
@@ -72,7 +72,8 @@ struct nvdla_pin_unpin_args {
  *
  * @tasks		pointer to task list
  * @num_tasks		number of tasks count
- * @flags		flags for task submit, like atomic
+ * @flags		flags for task submit, like atomic or chain; a chained
+ *			submit hands all tasks to the engine with one doorbell
  * @version		version of task structure
  *
  */
@@ -81,6 +82,7 @@ struct nvdla_submit_args {
 	__u16 num_tasks;
 #define MAX_TASKS_PER_SUBMIT		24
 #define NVDLA_SUBMIT_FLAGS_ATOMIC	(1 << 0)
+#define NVDLA_SUBMIT_FLAGS_CHAIN	(1 << 1)
 	__u16 flags;
 	__u32 version;
 };
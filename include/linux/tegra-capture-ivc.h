@@ -14,6 +14,7 @@
 #define INCLUDE_CAPTURE_IVC_H
 
 #include <linux/types.h>
+#include <linux/uio.h>
 
 /*
  * Submit the control message binary blob to capture-IVC driver,
@@ -35,6 +36,20 @@ int tegra_capture_ivc_control_submit(const void *control_desc, size_t len);
  */
 int tegra_capture_ivc_capture_submit(const void *capture_desc, size_t len);
 
+/*
+ * Submit a batch of capture message binary blobs to capture-IVC driver,
+ * written to the capture IVC channel back to back under one lock.
+ *
+ * @param[in] capture_descs: array of capture message descriptors, opaque to
+ * capture-IVC driver.
+ * @param[in] count: number of entries in capture_descs.
+ *
+ * Returns the number of descriptors submitted, or a negative error if none
+ * could be.
+ */
+int tegra_capture_ivc_capture_submit_vec(const struct kvec *capture_descs,
+		unsigned int count);
+
 /*
  * Callback function to be registered by client to receive the rtcpu
  * notifications through control or capture IVC channel.
@@ -152,6 +152,25 @@ int32_t msgq_queue_message(msgq_t *msgq, const msgq_message_t *message);
 int32_t msgq_dequeue_message(msgq_t *msgq, msgq_message_t *message);
 #define msgq_discard_message(msgq) msgq_dequeue_message(msgq, NULL)
 
+/*
+ * Bulk and zero-copy access. A batch is published with one index update
+ * and announced with a single mailbox doorbell, see nvadsp_mbox_send_msgq().
+ */
+typedef int (*msgq_handler_t)(const msgq_message_t *message, void *data);
+
+int32_t msgq_queue_messages(msgq_t *msgq,
+			    const msgq_message_t * const *messages,
+			    int32_t count);
+msgq_message_t *msgq_reserve_message(msgq_t *msgq, int32_t size);
+void msgq_commit_message(msgq_t *msgq, msgq_message_t *message);
+int32_t msgq_drain_messages(msgq_t *msgq, msgq_handler_t handler,
+			    void *data, msgq_message_t *buf, int32_t budget);
+
+status_t nvadsp_mbox_send_msgq(struct nvadsp_mbox *mbox, msgq_t *msgq,
+			       const msgq_message_t * const *messages,
+			       int32_t count, uint32_t data, uint32_t flags,
+			       bool block, unsigned int timeout);
+
 /*
  * DRAM Sharing
  */
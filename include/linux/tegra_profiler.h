@@ -19,8 +19,8 @@
 
 #include <linux/ioctl.h>
 
-#define QUADD_SAMPLES_VERSION	43
-#define QUADD_IO_VERSION	25
+#define QUADD_SAMPLES_VERSION	44
+#define QUADD_IO_VERSION	26
 
 #define QUADD_IO_VERSION_DYNAMIC_RB		5
 #define QUADD_IO_VERSION_RB_MAX_FILL_COUNT	6
@@ -43,6 +43,7 @@
 #define QUADD_IO_VERSION_SAMPLING_MODE		23
 #define QUADD_IO_VERSION_FORCE_ARCH_TIMER	24
 #define QUADD_IO_VERSION_SAMPLE_ALL_TASKS	25
+#define QUADD_IO_VERSION_RB_POLL		26
 
 #define QUADD_SAMPLE_VERSION_THUMB_MODE_FLAG		17
 #define QUADD_SAMPLE_VERSION_GROUP_SAMPLES		18
@@ -69,6 +70,7 @@
 #define QUADD_SAMPLE_VERSION_SCHED_REPORT_VPID		41
 #define QUADD_SAMPLE_VERSION_SAMPLING_MODE		42
 #define QUADD_SAMPLE_VERSION_SAMPLE_ALL_TASKS		43
+#define QUADD_SAMPLE_VERSION_LOST_RECORDS		44
 
 #define QUADD_MMAP_HEADER_VERSION	1
 
@@ -176,6 +178,7 @@ enum quadd_record_type {
 	QUADD_RECORD_TYPE_ADDITIONAL_SAMPLE,
 	QUADD_RECORD_TYPE_SCHED,
 	QUADD_RECORD_TYPE_HOTPLUG,
+	QUADD_RECORD_TYPE_LOST,
 };
 
 enum quadd_event_source {
@@ -293,6 +296,14 @@ struct quadd_hotplug_data {
 	    reserved:31;
 };
 
+/* emitted in place of samples dropped while the ring buffer was full */
+struct quadd_lost_data {
+	u64 time;
+	u32 cpu;
+
+	u32 count;
+};
+
 struct quadd_additional_sample {
 	u8 type;
 
@@ -399,6 +410,7 @@ struct quadd_record_data {
 		struct quadd_header_data	hdr;
 		struct quadd_power_rate_data	power_rate;
 		struct quadd_hotplug_data	hotplug;
+		struct quadd_lost_data		lost;
 		struct quadd_sched_data		sched;
 		struct quadd_additional_sample	additional_sample;
 	};
@@ -508,6 +520,7 @@ enum {
 #define QUADD_COMM_CAP_EXTRA_RB_MMAP_OP		(1 << 9)
 #define QUADD_COMM_CAP_EXTRA_CPU_MASK		(1 << 10)
 #define QUADD_COMM_CAP_EXTRA_ARCH_TIMER_USR	(1 << 11)
+#define QUADD_COMM_CAP_EXTRA_RB_POLL		(1 << 12)
 
 struct quadd_comm_cap {
 	u32	pmu:1,
@@ -589,6 +602,10 @@ struct quadd_sections {
 	u64 reserved[4];	/* reserved fields for future extensions */
 };
 
+enum {
+	QUADD_MMAP_RB_IDX_WAKEUP_WATERMARK = 0,
+};
+
 struct quadd_mmap_rb_info {
 	u32 cpu_id;
 
@@ -616,6 +633,11 @@ enum {
 	QUADD_RB_STATE_STOPPED,
 };
 
+enum {
+	QUADD_RB_HDR_IDX_WAKEUP_WATERMARK = 0,
+	QUADD_RB_HDR_IDX_LOST_RECORDS,
+};
+
 struct quadd_ring_buffer_hdr {
 	u32 state;
 	u32 size;
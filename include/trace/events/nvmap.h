@@ -728,6 +728,90 @@ TRACE_EVENT(nvmap_pp_do_background_zero_pages,
 		__entry->zeroed - __entry->inserted)
 );
 
+TRACE_EVENT(nvmap_pp_zero_batch,
+	TP_PROTO(int worker, u32 count, u64 ns, u32 backlog),
+
+	TP_ARGS(worker, count, ns, backlog),
+
+	TP_STRUCT__entry(
+		__field(int, worker)
+		__field(u32, count)
+		__field(u64, ns)
+		__field(u32, backlog)
+	),
+
+	TP_fast_assign(
+		__entry->worker = worker;
+		__entry->count = count;
+		__entry->ns = ns;
+		__entry->backlog = backlog;
+	),
+
+	TP_printk("worker=%d zeroed=%u time=%lluns backlog=%u",
+		__entry->worker, __entry->count, __entry->ns, __entry->backlog)
+);
+
+TRACE_EVENT(nvmap_pp_zero_drained,
+	TP_PROTO(u64 count, u64 ns),
+
+	TP_ARGS(count, ns),
+
+	TP_STRUCT__entry(
+		__field(u64, count)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->count = count;
+		__entry->ns = ns;
+	),
+
+	TP_printk("zero_list drained: pages=%llu time=%lluns",
+		__entry->count, __entry->ns)
+);
+
+TRACE_EVENT(nvmap_pp_zero_prio,
+	TP_PROTO(int worker, bool boost, u32 backlog),
+
+	TP_ARGS(worker, boost, backlog),
+
+	TP_STRUCT__entry(
+		__field(int, worker)
+		__field(bool, boost)
+		__field(u32, backlog)
+	),
+
+	TP_fast_assign(
+		__entry->worker = worker;
+		__entry->boost = boost;
+		__entry->backlog = backlog;
+	),
+
+	TP_printk("worker=%d policy=%s backlog=%u", __entry->worker,
+		__entry->boost ? "normal" : "idle", __entry->backlog)
+);
+
+TRACE_EVENT(nvmap_pp_rebalance,
+	TP_PROTO(u32 target, u32 big_pages, u32 count),
+
+	TP_ARGS(target, big_pages, count),
+
+	TP_STRUCT__entry(
+		__field(u32, target)
+		__field(u32, big_pages)
+		__field(u32, count)
+	),
+
+	TP_fast_assign(
+		__entry->target = target;
+		__entry->big_pages = big_pages;
+		__entry->count = count;
+	),
+
+	TP_printk("big page target=%u big pages=%u total pages=%u",
+		__entry->target, __entry->big_pages, __entry->count)
+);
+
 TRACE_EVENT(nvmap_pp_alloc_locked,
 	TP_PROTO(int force_alloc),
 
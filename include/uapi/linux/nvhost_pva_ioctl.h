@@ -186,7 +186,7 @@ struct pva_fence {
 	__u32 semaphore_value;
 };
 
-#define PVA_MAX_TASKS			1
+#define PVA_MAX_TASKS			16
 #define PVA_MAX_PREFENCES		8
 #define PVA_MAX_POSTFENCES		8
 #define PVA_MAX_INPUT_STATUS		8
@@ -256,9 +256,15 @@ struct pva_ioctl_submit_task {
  * This ioctl is used for submitting tasks to PVA. The given structures
  * are modified to include information about post-fences.
  *
+ * With PVA_SUBMIT_FLAGS_CHAIN the tasks are linked into one list and
+ * submitted together. Only the last task increments the queue syncpoint,
+ * so all syncpoint and sync_fd post-fences of the list signal when the
+ * last task completes.
+ *
  */
 struct pva_ioctl_submit_args {
 	__u64 tasks;
+#define PVA_SUBMIT_FLAGS_CHAIN		(1 << 0)
 	__u16 flags;
 	__u16 num_tasks;
 	__u32 version;
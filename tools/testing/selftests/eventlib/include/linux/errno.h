@@ -0,0 +1,9 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef EVENTLIB_TEST_LINUX_ERRNO_H
+#define EVENTLIB_TEST_LINUX_ERRNO_H
+
+/* glibc's <errno.h> reaches the uapi header through this one */
+#include_next <linux/errno.h>
+#include <errno.h>
+
+#endif
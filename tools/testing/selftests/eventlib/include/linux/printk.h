@@ -0,0 +1,9 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef EVENTLIB_TEST_LINUX_PRINTK_H
+#define EVENTLIB_TEST_LINUX_PRINTK_H
+
+#include <stdio.h>
+
+#define pr_err_once(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+
+#endif
@@ -0,0 +1,11 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef EVENTLIB_TEST_LINUX_STDDEF_H
+#define EVENTLIB_TEST_LINUX_STDDEF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define __aligned(x)	__attribute__((aligned(x)))
+#define __packed	__attribute__((__packed__))
+
+#endif
@@ -0,0 +1,7 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef EVENTLIB_TEST_LINUX_TYPES_H
+#define EVENTLIB_TEST_LINUX_TYPES_H
+
+#include <linux/stddef.h>
+
+#endif
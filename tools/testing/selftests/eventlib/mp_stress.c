@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2017, NVIDIA CORPORATION. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Multi-writer stress test for eventlib.
+ *
+ * <threads> writers share one EVENTLIB_FLAG_MULTI_WRITER context and add
+ * <events> checksummed events each, alternating between eventlib_write()
+ * and eventlib_reserve()/eventlib_commit(). A reader context on the same
+ * shared memory keeps calling eventlib_read() meanwhile. Every record read
+ * must be intact, per-writer counters must strictly decrease within one
+ * read and exceed everything delivered by earlier reads, and in the end
+ * delivered plus lost events must add up to the number written.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eventlib.h"
+
+#define SHM_SIZE		(64 * 1024)
+#define MAX_THREADS		64
+#define SAMPLE_MAGIC		0x4d505354
+
+struct sample {
+	uint32_t magic;
+	uint32_t thread;
+	uint32_t count;
+	uint32_t check;
+} __packed;
+
+struct writer {
+	pthread_t id;
+	uint32_t thread;
+	unsigned int errors;
+};
+
+static struct eventlib_ctx wctx;
+static uint32_t nr_events;
+static uint32_t writers_running;
+
+static uint32_t sample_check(const struct sample *s)
+{
+	const uint8_t *p = (const uint8_t *)s;
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	for (i = 0; i < offsetof(struct sample, check); i++)
+		h = (h ^ p[i]) * 16777619u;
+
+	return h;
+}
+
+static void *writer_fn(void *data)
+{
+	struct writer *w = data;
+	struct eventlib_resv resv;
+	struct sample s;
+	uint32_t i;
+	void *p;
+
+	for (i = 1; i <= nr_events; i++) {
+		s.magic = SAMPLE_MAGIC;
+		s.thread = w->thread;
+		s.count = i;
+		s.check = sample_check(&s);
+
+		if (i & 1) {
+			eventlib_write(&wctx, 0, w->thread, i, &s, sizeof(s));
+			continue;
+		}
+
+		if (eventlib_reserve(&wctx, 0, &resv,
+				eventlib_event_size(&wctx, 0, sizeof(s)))) {
+			w->errors++;
+			continue;
+		}
+
+		p = eventlib_reserve_event(&wctx, &resv, w->thread, i,
+			sizeof(s));
+		if (p)
+			memcpy(p, &s, sizeof(s));
+		else
+			w->errors++;
+
+		eventlib_commit(&wctx, &resv);
+	}
+
+	__atomic_sub_fetch(&writers_running, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+/* Check one eventlib_read() result; returns the number of bad records */
+static unsigned int check_read(const uint8_t *buf, uint32_t size,
+	uint32_t threads, uint32_t *seen, uint64_t *pulled)
+{
+	uint32_t last[MAX_THREADS];
+	uint32_t newest[MAX_THREADS];
+	unsigned int errors = 0;
+	struct record rec;
+	struct sample s;
+	uint32_t off = 0;
+	uint32_t t;
+
+	for (t = 0; t < threads; t++) {
+		last[t] = UINT32_MAX;
+		newest[t] = seen[t];
+	}
+
+	while (off < size) {
+		if (size - off < sizeof(rec))
+			return errors + 1;
+
+		memcpy(&rec, buf + off, sizeof(rec));
+		off += sizeof(rec);
+
+		if (rec.size != sizeof(s) || size - off < rec.size)
+			return errors + 1;
+
+		memcpy(&s, buf + off, sizeof(s));
+		off += rec.size;
+		(*pulled)++;
+
+		if (s.magic != SAMPLE_MAGIC || s.check != sample_check(&s) ||
+		    s.thread >= threads || rec.type != s.thread ||
+		    rec.ts != s.count) {
+			errors++;
+			continue;
+		}
+
+		/* records come newest first */
+		if (s.count >= last[s.thread] || s.count <= seen[s.thread])
+			errors++;
+
+		if (last[s.thread] == UINT32_MAX)
+			newest[s.thread] = s.count;
+		last[s.thread] = s.count;
+	}
+
+	for (t = 0; t < threads; t++)
+		seen[t] = newest[t];
+
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	struct writer writers[MAX_THREADS];
+	uint32_t seen[MAX_THREADS] = { 0 };
+	struct eventlib_ctx rctx;
+	uint64_t pulled = 0, lost = 0, n;
+	unsigned int errors = 0, reads = 0, retries = 0;
+	uint32_t threads = 4, i, size;
+	uint8_t *buf;
+	void *shm;
+	int last = 0;
+	int ret;
+
+	if (argc > 1)
+		threads = strtoul(argv[1], NULL, 0);
+	nr_events = argc > 2 ? strtoul(argv[2], NULL, 0) : 100000;
+
+	if (!threads || threads > MAX_THREADS || !nr_events) {
+		fprintf(stderr, "usage: %s [threads (1-%d)] [events]\n",
+			argv[0], MAX_THREADS);
+		return 2;
+	}
+
+	shm = aligned_alloc(64, SHM_SIZE);
+	buf = malloc(SHM_SIZE);
+	if (!shm || !buf)
+		return 1;
+	memset(shm, 0, SHM_SIZE);
+
+	memset(&wctx, 0, sizeof(wctx));
+	wctx.direction = EVENTLIB_DIRECTION_WRITER;
+	wctx.flags = EVENTLIB_FLAG_MULTI_WRITER;
+	wctx.w2r_shm = shm;
+	wctx.w2r_shm_size = SHM_SIZE;
+	ret = eventlib_init(&wctx);
+	if (ret) {
+		fprintf(stderr, "writer init failed: %d\n", ret);
+		return 1;
+	}
+
+	memset(&rctx, 0, sizeof(rctx));
+	rctx.direction = EVENTLIB_DIRECTION_READER;
+	rctx.w2r_shm = shm;
+	rctx.w2r_shm_size = SHM_SIZE;
+	ret = eventlib_init(&rctx);
+	if (ret) {
+		fprintf(stderr, "reader init failed: %d\n", ret);
+		return 1;
+	}
+
+	writers_running = threads;
+	for (i = 0; i < threads; i++) {
+		writers[i].thread = i;
+		writers[i].errors = 0;
+		if (pthread_create(&writers[i].id, NULL, writer_fn,
+				&writers[i])) {
+			fprintf(stderr, "unable to start writer %u\n", i);
+			return 1;
+		}
+	}
+
+	/* keep reading until one read has started after all writers quit */
+	while (!last) {
+		last = !__atomic_load_n(&writers_running, __ATOMIC_ACQUIRE);
+
+		size = SHM_SIZE;
+		ret = eventlib_read(&rctx, buf, &size, &n);
+		if (ret == -EINTR) {
+			retries++;
+			last = 0;
+			continue;
+		}
+		if (ret) {
+			fprintf(stderr, "eventlib_read failed: %d\n", ret);
+			errors++;
+			break;
+		}
+
+		reads++;
+		lost += n;
+		errors += check_read(buf, size, threads, seen, &pulled);
+		sched_yield();
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_join(writers[i].id, NULL);
+		errors += writers[i].errors;
+	}
+
+	if (pulled + lost != (uint64_t)threads * nr_events)
+		errors++;
+
+	printf("%u writers, %u events each: %u reads, %u restarts, %llu delivered, %llu lost, %u errors\n",
+		threads, nr_events, reads, retries,
+		(unsigned long long)pulled, (unsigned long long)lost, errors);
+
+	eventlib_close(&rctx);
+	eventlib_close(&wctx);
+	free(buf);
+	free(shm);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,43 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef NVADSP_TEST_LINUX_KERNEL_H
+#define NVADSP_TEST_LINUX_KERNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define likely(x)	__builtin_expect(!!(x), 1)
+#define unlikely(x)	__builtin_expect(!!(x), 0)
+
+#ifndef pr_fmt
+#define pr_fmt(fmt) fmt
+#endif
+
+/* Expected failures are exercised on purpose, keep them quiet */
+extern int mm_test_verbose;
+
+#define pr_err(fmt, ...) \
+	do { \
+		if (mm_test_verbose) \
+			fprintf(stderr, pr_fmt(fmt), ##__VA_ARGS__); \
+	} while (0)
+#define pr_info(fmt, ...)	printf(pr_fmt(fmt), ##__VA_ARGS__)
+#define pr_debug(fmt, ...) \
+	do { \
+		if (0) \
+			printf(pr_fmt(fmt), ##__VA_ARGS__); \
+	} while (0)
+
+/* Single threaded test, the lock only has to compile */
+typedef struct {
+	int locked;
+} spinlock_t;
+
+#define spin_lock_init(l)		((l)->locked = 0)
+#define spin_lock_irqsave(l, f)		((f) = 0, (l)->locked++)
+#define spin_unlock_irqrestore(l, f)	((void)(f), (l)->locked--)
+
+#endif
@@ -0,0 +1,114 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef NVADSP_TEST_LINUX_RBTREE_H
+#define NVADSP_TEST_LINUX_RBTREE_H
+
+#include <linux/kernel.h>
+
+/*
+ * Same interface as the kernel rbtree, but a plain unbalanced binary
+ * search tree: rb_insert_color() does not rebalance. Callers only rely
+ * on the ordering, which is all the tests check.
+ */
+struct rb_node {
+	struct rb_node *parent;
+	struct rb_node *rb_right;
+	struct rb_node *rb_left;
+};
+
+struct rb_root {
+	struct rb_node *rb_node;
+};
+
+#define RB_ROOT			((struct rb_root) { NULL, })
+#define RB_EMPTY_ROOT(root)	((root)->rb_node == NULL)
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+	struct rb_node **rb_link)
+{
+	node->parent = parent;
+	node->rb_left = node->rb_right = NULL;
+	*rb_link = node;
+}
+
+static inline void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+}
+
+static inline void rb_replace_child(struct rb_node *old, struct rb_node *new,
+	struct rb_root *root)
+{
+	struct rb_node *parent = old->parent;
+
+	if (!parent)
+		root->rb_node = new;
+	else if (parent->rb_left == old)
+		parent->rb_left = new;
+	else
+		parent->rb_right = new;
+	if (new)
+		new->parent = parent;
+}
+
+static inline void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+	struct rb_node *succ;
+
+	if (!node->rb_left) {
+		rb_replace_child(node, node->rb_right, root);
+		return;
+	}
+	if (!node->rb_right) {
+		rb_replace_child(node, node->rb_left, root);
+		return;
+	}
+
+	succ = node->rb_right;
+	while (succ->rb_left)
+		succ = succ->rb_left;
+
+	if (succ->parent != node) {
+		rb_replace_child(succ, succ->rb_right, root);
+		succ->rb_right = node->rb_right;
+		succ->rb_right->parent = succ;
+	}
+	rb_replace_child(node, succ, root);
+	succ->rb_left = node->rb_left;
+	succ->rb_left->parent = succ;
+}
+
+static inline struct rb_node *rb_first(const struct rb_root *root)
+{
+	struct rb_node *n = root->rb_node;
+
+	while (n && n->rb_left)
+		n = n->rb_left;
+	return n;
+}
+
+static inline struct rb_node *rb_last(const struct rb_root *root)
+{
+	struct rb_node *n = root->rb_node;
+
+	while (n && n->rb_right)
+		n = n->rb_right;
+	return n;
+}
+
+static inline struct rb_node *rb_next(const struct rb_node *node)
+{
+	struct rb_node *parent;
+
+	if (node->rb_right) {
+		node = node->rb_right;
+		while (node->rb_left)
+			node = node->rb_left;
+		return (struct rb_node *)node;
+	}
+
+	while ((parent = node->parent) && node == parent->rb_right)
+		node = parent;
+	return parent;
+}
+
+#endif
@@ -0,0 +1,26 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef NVADSP_TEST_LINUX_SEQ_FILE_H
+#define NVADSP_TEST_LINUX_SEQ_FILE_H
+
+#include <stdarg.h>
+#include <stdio.h>
+
+struct seq_file {
+	FILE *fp;
+};
+
+static inline void seq_puts(struct seq_file *m, const char *s)
+{
+	fputs(s, m->fp);
+}
+
+static inline void seq_printf(struct seq_file *m, const char *fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vfprintf(m->fp, fmt, args);
+	va_end(args);
+}
+
+#endif
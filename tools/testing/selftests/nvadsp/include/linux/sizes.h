@@ -0,0 +1,7 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef NVADSP_TEST_LINUX_SIZES_H
+#define NVADSP_TEST_LINUX_SIZES_H
+
+#define SZ_16		0x00000010
+
+#endif
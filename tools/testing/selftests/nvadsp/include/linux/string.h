@@ -0,0 +1,22 @@
+/* User-space stand-in for the kernel header, see ../../Makefile */
+#ifndef NVADSP_TEST_LINUX_STRING_H
+#define NVADSP_TEST_LINUX_STRING_H
+
+#include <string.h>
+
+static inline size_t mm_test_strlcpy(char *dest, const char *src, size_t size)
+{
+	size_t ret = strlen(src);
+
+	if (size) {
+		size_t len = ret >= size ? size - 1 : ret;
+
+		memcpy(dest, src, len);
+		dest[len] = '\0';
+	}
+	return ret;
+}
+
+#define strlcpy mm_test_strlcpy
+
+#endif
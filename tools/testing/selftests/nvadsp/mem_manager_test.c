@@ -0,0 +1,428 @@
+/*
+ * User-space unit test for the nvadsp memory manager
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+/*
+ * Every test runs on a fresh manager over a synthetic range starting at
+ * BASE. After each step the internal trees are checked: allocated and free
+ * chunks must tile the range exactly, free chunks must never be adjacent,
+ * the size tree must hold the same chunks ordered by (size, address), and
+ * every descriptor must be accounted for.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/err.h>
+#include <linux/list.h>
+#include <linux/rbtree.h>
+#include <linux/seq_file.h>
+
+#include "mem_manager.h"
+
+#define BASE		0x40000000UL
+#define U		0x100UL
+
+/* A corrupted tree can loop forever; fail instead of hanging */
+#define TIMEOUT_SECS	60
+
+int mm_test_verbose;
+
+static unsigned int failures;
+static const char *current_test;
+
+#define CHECK(cond)							\
+do {									\
+	if (!(cond)) {							\
+		fprintf(stderr, "%s:%d: %s: check failed: %s\n",	\
+			__FILE__, __LINE__, current_test, #cond);	\
+		failures++;						\
+	}								\
+} while (0)
+
+static struct mem_manager_info *mm_create(unsigned long size)
+{
+	struct mem_manager_info *mm = create_mem_manager("test", BASE, size);
+
+	if (IS_ERR(mm)) {
+		fprintf(stderr, "create_mem_manager failed\n");
+		exit(1);
+	}
+	return mm;
+}
+
+static unsigned int list_count(struct list_head *head)
+{
+	struct list_head *p;
+	unsigned int n = 0;
+
+	for (p = head->next; p != head; p = p->next)
+		n++;
+	return n;
+}
+
+/* Check the invariants listed at the top of the file */
+static void mm_check(struct mem_manager_info *mm)
+{
+	struct rb_node *a = rb_first(&mm->alloc_tree);
+	struct rb_node *f = rb_first(&mm->free_tree);
+	struct mem_chunk *mc, *prev = NULL;
+	unsigned long addr = mm->start_address, free_bytes = 0;
+	unsigned int nr_alloc = 0, nr_free = 0, nr_size = 0;
+	bool prev_free = false, is_free;
+	struct rb_node *n;
+
+	/* walk both address trees in address order */
+	while (a || f) {
+		struct mem_chunk *ma = a ?
+			rb_entry(a, struct mem_chunk, addr_node) : NULL;
+		struct mem_chunk *mf = f ?
+			rb_entry(f, struct mem_chunk, addr_node) : NULL;
+
+		is_free = !ma || (mf && mf->address < ma->address);
+		mc = is_free ? mf : ma;
+
+		CHECK(mc->address == addr);
+		CHECK(mc->size != 0);
+		if (is_free) {
+			CHECK(!prev_free);
+			CHECK(!strcmp(mc->name, "FREE"));
+			free_bytes += mc->size;
+			nr_free++;
+			f = rb_next(f);
+		} else {
+			nr_alloc++;
+			a = rb_next(a);
+		}
+		addr = mc->address + mc->size;
+		prev_free = is_free;
+	}
+	CHECK(addr == mm->start_address + mm->size);
+
+	for (n = rb_first(&mm->size_tree); n; n = rb_next(n)) {
+		mc = rb_entry(n, struct mem_chunk, size_node);
+		CHECK(!prev || prev->size < mc->size ||
+		      (prev->size == mc->size && prev->address < mc->address));
+		CHECK(!strcmp(mc->name, "FREE"));
+		prev = mc;
+		nr_size++;
+	}
+
+	CHECK(nr_alloc == mm->nr_alloc);
+	CHECK(nr_free == mm->nr_free);
+	CHECK(nr_size == nr_free);
+	CHECK(free_bytes == mm->free_bytes);
+	CHECK(nr_alloc + nr_free + list_count(&mm->unused_chunks) ==
+	      MEM_MANAGER_CHUNKS);
+}
+
+/* Check that the free chunks are exactly exp[0..n), in address order */
+static void mm_check_free(struct mem_manager_info *mm,
+	const unsigned long (*exp)[2], unsigned int n)
+{
+	struct rb_node *node = rb_first(&mm->free_tree);
+	unsigned int i;
+
+	mm_check(mm);
+
+	for (i = 0; i < n; i++, node = rb_next(node)) {
+		struct mem_chunk *mc;
+
+		CHECK(node != NULL);
+		if (!node)
+			return;
+		mc = rb_entry(node, struct mem_chunk, addr_node);
+		CHECK(mc->address == exp[i][0]);
+		CHECK(mc->size == exp[i][1]);
+	}
+	CHECK(node == NULL);
+}
+
+static void *request(struct mem_manager_info *mm, size_t size)
+{
+	void *h = mem_request(mm, "chunk", size);
+
+	CHECK(!IS_ERR(h));
+	mm_check(mm);
+	return h;
+}
+
+static void release(struct mem_manager_info *mm, void *h)
+{
+	CHECK(mem_release(mm, h));
+	mm_check(mm);
+}
+
+/* Fill a manager of nr * size bytes with nr chunks of size bytes */
+static struct mem_manager_info *mm_create_full(void **h, unsigned int nr,
+	unsigned long size)
+{
+	struct mem_manager_info *mm = mm_create(nr * size);
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		h[i] = request(mm, size);
+		CHECK(mem_get_address(h[i]) == BASE + i * size);
+	}
+	CHECK(RB_EMPTY_ROOT(&mm->free_tree));
+	return mm;
+}
+
+static void test_best_fit_ties(void)
+{
+	struct mem_manager_info *mm;
+	void *h[8], *a, *b;
+
+	/* equally good holes: the lowest address wins */
+	mm = mm_create_full(h, 8, U);
+	release(mm, h[5]);
+	release(mm, h[3]);
+	release(mm, h[1]);
+
+	a = request(mm, U / 2);
+	CHECK(mem_get_address(a) == BASE + 1 * U);
+
+	/* the half hole at 1 is now too small, 3 and 5 tie */
+	b = request(mm, U);
+	CHECK(mem_get_address(b) == BASE + 3 * U);
+	destroy_mem_manager(mm);
+
+	/* a smaller hole wins over a lower address */
+	mm = mm_create(8 * U);
+	h[0] = request(mm, 2 * U);
+	h[1] = request(mm, U);
+	h[2] = request(mm, U);
+	h[3] = request(mm, 4 * U);
+	release(mm, h[0]);
+	release(mm, h[2]);
+
+	a = request(mm, U);
+	CHECK(mem_get_address(a) == BASE + 3 * U);
+	destroy_mem_manager(mm);
+}
+
+static void test_coalesce(void)
+{
+	static const unsigned long prev_exp[][2] = {
+		{ BASE, 2 * U },
+	};
+	static const unsigned long both_exp[][2] = {
+		{ BASE, 3 * U },
+	};
+	struct mem_manager_info *mm;
+	void *h[4], *a;
+
+	/* with the previous neighbour */
+	mm = mm_create_full(h, 4, U);
+	release(mm, h[0]);
+	release(mm, h[1]);
+	mm_check_free(mm, prev_exp, 1);
+	a = request(mm, 2 * U);
+	CHECK(mem_get_address(a) == BASE);
+	destroy_mem_manager(mm);
+
+	/* with the next neighbour */
+	mm = mm_create_full(h, 4, U);
+	release(mm, h[1]);
+	release(mm, h[0]);
+	mm_check_free(mm, prev_exp, 1);
+	destroy_mem_manager(mm);
+
+	/* with both neighbours */
+	mm = mm_create_full(h, 4, U);
+	release(mm, h[0]);
+	release(mm, h[2]);
+	CHECK(mm->nr_free == 2);
+	release(mm, h[1]);
+	mm_check_free(mm, both_exp, 1);
+	destroy_mem_manager(mm);
+}
+
+static void test_release_above_highest_free(void)
+{
+	static const unsigned long exp[][2] = {
+		{ BASE, U },
+		{ BASE + 3 * U, U },
+	};
+	static const unsigned long exp_all[][2] = {
+		{ BASE, 4 * U },
+	};
+	struct mem_manager_info *mm;
+	void *h[4];
+
+	mm = mm_create_full(h, 4, U);
+
+	/* nothing free at all yet */
+	release(mm, h[0]);
+
+	/* above the only free chunk, with no free chunk after it */
+	release(mm, h[3]);
+	mm_check_free(mm, exp, 2);
+
+	release(mm, h[2]);
+	release(mm, h[1]);
+	mm_check_free(mm, exp_all, 1);
+	destroy_mem_manager(mm);
+}
+
+static void test_invalid_release(void)
+{
+	struct mem_manager_info *mm;
+	struct mem_chunk fake;
+	unsigned long free_bytes;
+	void *h[4];
+
+	mm = mm_create_full(h, 4, U);
+
+	CHECK(PTR_ERR(mem_request(mm, "zero", 0)) == -EINVAL);
+
+	release(mm, h[1]);
+	free_bytes = mm->free_bytes;
+
+	/* double release */
+	CHECK(!mem_release(mm, h[1]));
+
+	/* a copy of an allocated chunk is not that chunk */
+	memcpy(&fake, h[2], sizeof(fake));
+	CHECK(!mem_release(mm, &fake));
+
+	/* an address that was never handed out */
+	fake.address = BASE + 2 * U + U / 2;
+	CHECK(!mem_release(mm, &fake));
+
+	CHECK(mm->free_bytes == free_bytes);
+	mm_check(mm);
+
+	/* nothing was disturbed */
+	release(mm, h[2]);
+	release(mm, h[0]);
+	release(mm, h[3]);
+	CHECK(mm->free_bytes == 4 * U);
+	destroy_mem_manager(mm);
+}
+
+static void test_out_of_descriptors(void)
+{
+	static const unsigned long exp_all[][2] = {
+		{ BASE, 4096 * U },
+	};
+	struct mem_manager_info *mm;
+	void *h[MEM_MANAGER_CHUNKS + 1], *e;
+	unsigned int i, nr = 0;
+
+	mm = mm_create(4096 * U);
+
+	/* one descriptor stays with the free remainder */
+	while (nr < MEM_MANAGER_CHUNKS) {
+		e = mem_request(mm, "small", U);
+		if (IS_ERR(e)) {
+			CHECK(PTR_ERR(e) == -ENOMEM);
+			break;
+		}
+		h[nr++] = e;
+	}
+	CHECK(nr == MEM_MANAGER_CHUNKS - 1);
+	CHECK(list_empty(&mm->unused_chunks));
+	mm_check(mm);
+
+	/* an exact fit reuses the free chunk's descriptor */
+	h[nr++] = request(mm, mm->free_bytes);
+	CHECK(RB_EMPTY_ROOT(&mm->free_tree));
+
+	/* memory full */
+	e = mem_request(mm, "small", U);
+	CHECK(IS_ERR(e) && PTR_ERR(e) == -ENOMEM);
+
+	/* splitting works again once a merge gave a descriptor back */
+	release(mm, h[1]);
+	release(mm, h[2]);
+	e = request(mm, U / 2);
+	CHECK(mem_get_address(e) == BASE + U);
+	release(mm, e);
+
+	for (i = 0; i < nr; i += 2)
+		if (i != 2)
+			release(mm, h[i]);
+	for (i = 3; i < nr; i += 2)
+		release(mm, h[i]);
+
+	mm_check_free(mm, exp_all, 1);
+	CHECK(mm->nr_alloc == 0);
+	destroy_mem_manager(mm);
+}
+
+/* Random requests and releases, checking the invariants after each one */
+static void test_random(void)
+{
+	struct mem_manager_info *mm;
+	void *h[MEM_MANAGER_CHUNKS];
+	unsigned int i, nr = 0;
+	void *e;
+
+	srand(1);
+	mm = mm_create(256 * U);
+
+	for (i = 0; i < 20000; i++) {
+		if (nr && (rand() % 5 < 2 || nr == MEM_MANAGER_CHUNKS)) {
+			unsigned int j = rand() % nr;
+
+			release(mm, h[j]);
+			h[j] = h[--nr];
+			continue;
+		}
+
+		e = mem_request(mm, "rand", 1 + rand() % (4 * U));
+		mm_check(mm);
+		if (IS_ERR(e))
+			CHECK(PTR_ERR(e) == -ENOMEM);
+		else
+			h[nr++] = e;
+	}
+
+	while (nr)
+		release(mm, h[--nr]);
+	CHECK(mm->nr_free == 1 && mm->free_bytes == 256 * U);
+	destroy_mem_manager(mm);
+}
+
+static const struct {
+	const char *name;
+	void (*fn)(void);
+} tests[] = {
+	{ "best_fit_ties", test_best_fit_ties },
+	{ "coalesce", test_coalesce },
+	{ "release_above_highest_free", test_release_above_highest_free },
+	{ "invalid_release", test_invalid_release },
+	{ "out_of_descriptors", test_out_of_descriptors },
+	{ "random", test_random },
+};
+
+int main(int argc, char **argv)
+{
+	unsigned int i, before;
+
+	mm_test_verbose = argc > 1 && !strcmp(argv[1], "-v");
+	alarm(TIMEOUT_SECS);
+
+	for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+		current_test = tests[i].name;
+		before = failures;
+		tests[i].fn();
+		printf("%s: %s\n", before == failures ? "ok" : "FAIL",
+		       tests[i].name);
+	}
+
+	return failures ? 1 : 0;
+}